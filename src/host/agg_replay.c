@@ -0,0 +1,474 @@
+/* Replays a sensor trace through the report-on-change stage
+ * (main/aht10_agg.c) and the uploader's batching (main/upload_frame.c), and
+ * compares what goes over the air with sending every sample.
+ *
+ * usage: agg_replay [-f trace.csv | -n hours] [-m sensors] [-w trace.csv]
+ *                   [-H heartbeat_s] [-d hum,temp] [-y hysteresis_pct]
+ *                   [-c confirm] [-e ewma_shift] [-v]
+ *
+ * A trace is CSV, one sample per line: t_ms,sensor,rh,temp_c ('#' starts a
+ * comment). Without -f a synthetic one is generated: -n hours of -m rooms
+ * at the 5 s cadence, with sensor noise, a daily drift, and heating and
+ * shower events. -w writes the trace used, for editing and replaying later.
+ * -d takes the deadbands in 1/100 %RH and 1/100 C, -v prints every report.
+ *
+ * Checks (non-zero exit on failure): no report gap is longer than the
+ * heartbeat (plus a cadence), every summary matches the window recomputed
+ * here from the raw samples, the windows account for every sample, and the
+ * reported stream survives the frame encoder unchanged. For the synthetic trace it also
+ * expects at least AGG_EXPECTED_REDUCTION times fewer frames. */
+
+/* Toolchain headers */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* local headers */
+#include "aht10_agg.h"
+#include "aht10_convert.h"
+#include "upload_frame.h"
+
+#define AGG_CADENCE_MS                      5000                /* AHT10_SAMPLE_PERIOD_MS */
+#define AGG_FLUSH_FILL                      24                  /* UPLOAD_FLUSH_FILL */
+#define AGG_FLUSH_INTERVAL_MS               (5 * 60 * 1000)     /* UPLOAD_FLUSH_INTERVAL_MS */
+#define AGG_EXPECTED_REDUCTION              5
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); s_failures++; } } while (0)
+
+/* the uploader's batching, counting what it sends */
+typedef struct batcher {
+    upload_frame_t frame;
+    uint32_t first_ms;
+    uint16_t seq;
+    unsigned long frames, bytes, records;
+    int keep;                           /* keep every record in sent, for the round trip */
+    aht10_sample_t *sent;
+    size_t nsent, cap;
+} batcher_t;
+
+/* the window as this tool sees it, to check the summaries against */
+typedef struct shadow {
+    uint32_t count;
+    uint32_t hum_min, hum_max, temp_min, temp_max;
+    uint64_t hum_sum, temp_sum;
+    uint32_t last_report_ms;
+    int reported;
+} shadow_t;
+
+static const uint8_t s_device_id[UPLOAD_FRAME_DEVICE_ID_LEN] = { 0x5c, 0xcf, 0x7f, 0x00, 0x00, 0x02 };
+static unsigned s_failures;
+
+static uint32_t hum_code(double rh)
+{
+    double code = rh / 100.0 * (1 << 20);
+    return (code < 0) ? 0 : (code > AHT10_CODE_MAX) ? AHT10_CODE_MAX : (uint32_t)lround(code);
+}
+
+static uint32_t temp_code(double c)
+{
+    double code = (c + 50.0) / 200.0 * (1 << 20);
+    return (code < 0) ? 0 : (code > AHT10_CODE_MAX) ? AHT10_CODE_MAX : (uint32_t)lround(code);
+}
+
+static void make_sample(aht10_sample_t *sample, uint32_t t_ms, unsigned sensor, double rh, double c)
+{
+    aht10_reading_t reading = { .status = 0x1C, .humidity_raw = hum_code(rh), .temperature_raw = temp_code(c) };
+
+    aht10_sample_pack(sample, t_ms, &reading);
+    sample->sensor = (uint8_t)sensor;
+}
+
+/* an event that ramps up over rise_s and decays with tau_s */
+static double event(double t_s, double at_s, double amplitude, double rise_s, double tau_s)
+{
+    double dt = t_s - at_s;
+
+    if (dt < 0)
+    {
+        return 0;
+    }
+    if (dt < rise_s)
+    {
+        return amplitude * dt / rise_s;
+    }
+    return amplitude * exp(-(dt - rise_s) / tau_s);
+}
+
+static double noise(unsigned *seed, double amplitude)
+{
+    return ((double)(rand_r(seed) % 2001) - 1000.0) / 1000.0 * amplitude;
+}
+
+/* sensor 0 a living room with the heating coming on in the morning and the
+ * evening, sensor 1 a bathroom with two showers a day, more sensors quiet
+ * rooms; everything drifts a little over the day */
+static size_t make_trace(aht10_sample_t **out, double hours, unsigned sensors)
+{
+    size_t count = (size_t)(hours * 3600 * 1000 / AGG_CADENCE_MS) * sensors;
+    aht10_sample_t *samples = malloc(count * sizeof(*samples));
+    unsigned seed = 11;
+    double t_s, day_s, rh, c;
+    size_t i;
+    unsigned k;
+
+    for (i = 0; i < count; i++)
+    {
+        k = (unsigned)(i % sensors);
+        t_s = (double)(i / sensors) * AGG_CADENCE_MS / 1000.0;
+        day_s = fmod(t_s, 86400.0);
+        c = 20.5 - 0.6 * cos(2 * M_PI * day_s / 86400.0) - 0.3 * k;
+        rh = 45.0 + 2.5 * cos(2 * M_PI * day_s / 86400.0) + 4.0 * k;
+        if (k == 0)
+        {
+            c += event(day_s, 6.5 * 3600, 1.8, 1800, 5400) + event(day_s, 17.0 * 3600, 1.5, 1800, 7200);
+        }
+        else if (k == 1)
+        {
+            rh += event(day_s, 7.0 * 3600, 28.0, 600, 1800) + event(day_s, 21.5 * 3600, 22.0, 600, 1800);
+            c += event(day_s, 7.0 * 3600, 1.2, 600, 2400) + event(day_s, 21.5 * 3600, 1.0, 600, 2400);
+        }
+        make_sample(&samples[i], (uint32_t)(t_s * 1000) + k, k, rh + noise(&seed, 0.10), c + noise(&seed, 0.03));
+    }
+    *out = samples;
+    return count;
+}
+
+static size_t read_trace(const char *path, aht10_sample_t **out, unsigned *sensors)
+{
+    FILE *f = fopen(path, "r");
+    aht10_sample_t *samples = NULL;
+    size_t count = 0, cap = 0;
+    char line[256];
+    unsigned long t_ms;
+    unsigned sensor;
+    double rh, c;
+
+    if (f == NULL)
+    {
+        perror(path);
+        exit(2);
+    }
+    *sensors = 1;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        if (line[0] == '#' || sscanf(line, "%lu,%u,%lf,%lf", &t_ms, &sensor, &rh, &c) != 4)
+        {
+            continue;
+        }
+        if (count == cap)
+        {
+            cap = cap ? cap * 2 : 4096;
+            samples = realloc(samples, cap * sizeof(*samples));
+        }
+        make_sample(&samples[count++], (uint32_t)t_ms, sensor, rh, c);
+        if (sensor + 1 > *sensors)
+        {
+            *sensors = sensor + 1;
+        }
+    }
+    fclose(f);
+    *out = samples;
+    return count;
+}
+
+static void write_trace(const char *path, const aht10_sample_t *samples, size_t count)
+{
+    FILE *f = fopen(path, "w");
+    size_t i;
+
+    if (f == NULL)
+    {
+        perror(path);
+        exit(2);
+    }
+    fprintf(f, "# t_ms,sensor,rh,temp_c\n");
+    for (i = 0; i < count; i++)
+    {
+        fprintf(f, "%u,%u,%.3f,%.3f\n", samples[i].timestamp_ms, samples[i].sensor,
+                aht10_sample_humidity_raw(&samples[i]) * 100.0 / (1 << 20),
+                aht10_sample_temperature_raw(&samples[i]) * 200.0 / (1 << 20) - 50.0);
+    }
+    fclose(f);
+}
+
+static void batcher_flush(batcher_t *b)
+{
+    if (b->frame.count == 0)
+    {
+        return;
+    }
+    upload_frame_finish(&b->frame);
+    b->frames++;
+    b->bytes += b->frame.len;
+    upload_frame_begin(&b->frame, s_device_id, ++b->seq);
+}
+
+static void batcher_add(batcher_t *b, const aht10_sample_t *sample)
+{
+    if (b->frame.count > 0 && sample->timestamp_ms - b->first_ms >= AGG_FLUSH_INTERVAL_MS)
+    {
+        batcher_flush(b);
+    }
+    if (b->frame.count == 0)
+    {
+        b->first_ms = sample->timestamp_ms;
+    }
+    upload_frame_add(&b->frame, sample);
+    b->records++;
+    if (b->keep)
+    {
+        if (b->nsent == b->cap)
+        {
+            b->cap = b->cap ? b->cap * 2 : 4096;
+            b->sent = realloc(b->sent, b->cap * sizeof(*b->sent));
+        }
+        b->sent[b->nsent++] = *sample;
+    }
+    if (b->frame.count >= AGG_FLUSH_FILL)
+    {
+        batcher_flush(b);
+    }
+}
+
+static int same_sample(const aht10_sample_t *a, const aht10_sample_t *b)
+{
+    return a->timestamp_ms == b->timestamp_ms && a->status == b->status && a->sensor == b->sensor
+           && memcmp(a->data, b->data, sizeof(a->data)) == 0;
+}
+
+/* encode the reported stream into frames and decode it again */
+static void check_round_trip(const aht10_sample_t *records, size_t count)
+{
+    upload_frame_t frame;
+    upload_frame_header_t header;
+    aht10_sample_t decoded[UPLOAD_FRAME_MAX_SAMPLES];
+    size_t i, j, n, bad = 0;
+
+    for (i = 0; i < count; i += n)
+    {
+        n = (count - i < AGG_FLUSH_FILL) ? count - i : AGG_FLUSH_FILL;
+        upload_frame_begin(&frame, s_device_id, 0);
+        for (j = 0; j < n; j++)
+        {
+            upload_frame_add(&frame, &records[i + j]);
+        }
+        upload_frame_finish(&frame);
+        if (upload_frame_decode(frame.buf, frame.len, &header, decoded, UPLOAD_FRAME_MAX_SAMPLES) != ESP_OK)
+        {
+            bad += n;
+            continue;
+        }
+        for (j = 0; j < n; j++)
+        {
+            bad += !same_sample(&decoded[j], &records[i + j]);
+        }
+    }
+    CHECK(bad == 0, "%zu of %zu reported records changed through the frame codec", bad, count);
+}
+
+static void shadow_reset(shadow_t *w)
+{
+    w->count = 0;
+    w->hum_sum = w->temp_sum = 0;
+    w->hum_min = w->temp_min = AHT10_CODE_MAX;
+    w->hum_max = w->temp_max = 0;
+}
+
+static void shadow_add(shadow_t *w, const aht10_sample_t *sample)
+{
+    uint32_t h = aht10_sample_humidity_raw(sample), t = aht10_sample_temperature_raw(sample);
+
+    w->count++;
+    w->hum_sum += h;
+    w->temp_sum += t;
+    w->hum_min = (h < w->hum_min) ? h : w->hum_min;
+    w->hum_max = (h > w->hum_max) ? h : w->hum_max;
+    w->temp_min = (t < w->temp_min) ? t : w->temp_min;
+    w->temp_max = (t > w->temp_max) ? t : w->temp_max;
+}
+
+/* the summary records that follow a report against the shadow window */
+static void check_summary(const shadow_t *w, const aht10_sample_t *out, uint8_t n)
+{
+    uint32_t hum_mean, temp_mean;
+
+    if (w->count <= 1)
+    {
+        CHECK(n == 1, "a window of one sample got a summary");
+        return;
+    }
+    CHECK(n == 5, "report without a summary after %u samples", w->count);
+    if (n != 5)
+    {
+        return;
+    }
+    hum_mean = (uint32_t)((w->hum_sum + w->count / 2) / w->count);
+    temp_mean = (uint32_t)((w->temp_sum + w->count / 2) / w->count);
+    CHECK(out[1].status == AHT10_AGG_SUMMARY_MEAN && aht10_sample_humidity_raw(&out[1]) == hum_mean
+          && aht10_sample_temperature_raw(&out[1]) == temp_mean, "mean differs at t=%u", out[0].timestamp_ms);
+    CHECK(out[2].status == AHT10_AGG_SUMMARY_MIN && aht10_sample_humidity_raw(&out[2]) == w->hum_min
+          && aht10_sample_temperature_raw(&out[2]) == w->temp_min, "min differs at t=%u", out[0].timestamp_ms);
+    CHECK(out[3].status == AHT10_AGG_SUMMARY_MAX && aht10_sample_humidity_raw(&out[3]) == w->hum_max
+          && aht10_sample_temperature_raw(&out[3]) == w->temp_max, "max differs at t=%u", out[0].timestamp_ms);
+    CHECK(out[4].status == AHT10_AGG_SUMMARY_WINDOW && aht10_sample_humidity_raw(&out[4]) == w->count,
+          "window count differs at t=%u", out[0].timestamp_ms);
+}
+
+int main(int argc, char **argv)
+{
+    aht10_agg_config_t cfg;
+    aht10_agg_t agg;
+    aht10_sample_t *samples, out[AHT10_AGG_MAX_OUT];
+    shadow_t shadow[AHT10_AGG_MAX_SENSORS];
+    batcher_t all, reported;
+    const char *in_path = NULL, *out_path = NULL;
+    double hours = 24, err, err_hum_max = 0, err_temp_max = 0;
+    uint32_t last_hum[AHT10_AGG_MAX_SENSORS] = { 0 }, last_temp[AHT10_AGG_MAX_SENSORS] = { 0 };
+    uint32_t gap, gap_max = 0;
+    unsigned sensors = 2, hum_db, temp_db, k;
+    uint64_t windowed[AHT10_AGG_MAX_SENSORS] = { 0 };
+    unsigned long fed[AHT10_AGG_MAX_SENSORS] = { 0 };
+    size_t count, i;
+    int verbose = 0, opt;
+    uint8_t n, j;
+
+    aht10_agg_default_config(&cfg);
+    while ((opt = getopt(argc, argv, "f:n:m:w:H:d:y:c:e:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f': in_path = optarg; break;
+            case 'n': hours = strtod(optarg, NULL); break;
+            case 'm': sensors = (unsigned)strtoul(optarg, NULL, 0); break;
+            case 'w': out_path = optarg; break;
+            case 'H': cfg.heartbeat_ms = (uint32_t)strtoul(optarg, NULL, 0) * 1000; break;
+            case 'd':
+                if (sscanf(optarg, "%u,%u", &hum_db, &temp_db) != 2)
+                {
+                    fprintf(stderr, "-d takes hum,temp in 1/100 units\n");
+                    return 2;
+                }
+                cfg.hum_deadband = (uint16_t)hum_db;
+                cfg.temp_deadband = (uint16_t)temp_db;
+                break;
+            case 'y': cfg.hysteresis_pct = (uint8_t)strtoul(optarg, NULL, 0); break;
+            case 'c': cfg.confirm = (uint8_t)strtoul(optarg, NULL, 0); break;
+            case 'e': cfg.ewma_shift = (uint8_t)strtoul(optarg, NULL, 0); break;
+            case 'v': verbose = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-f trace.csv | -n hours] [-m sensors] [-w trace.csv] [-H heartbeat_s] "
+                        "[-d hum,temp] [-y hysteresis_pct] [-c confirm] [-e ewma_shift] [-v]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (sensors == 0 || sensors > AHT10_AGG_MAX_SENSORS)
+    {
+        fprintf(stderr, "sensors must be 1..%d\n", AHT10_AGG_MAX_SENSORS);
+        return 2;
+    }
+
+    count = in_path ? read_trace(in_path, &samples, &sensors) : make_trace(&samples, hours, sensors);
+    if (out_path != NULL)
+    {
+        write_trace(out_path, samples, count);
+    }
+
+    aht10_agg_init(&agg, &cfg);
+    memset(&all, 0, sizeof(all));
+    memset(&reported, 0, sizeof(reported));
+    reported.keep = 1;
+    upload_frame_begin(&all.frame, s_device_id, 0);
+    upload_frame_begin(&reported.frame, s_device_id, 0);
+    for (k = 0; k < AHT10_AGG_MAX_SENSORS; k++)
+    {
+        shadow_reset(&shadow[k]);
+        shadow[k].reported = 0;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        k = samples[i].sensor;
+        if (k >= AHT10_AGG_MAX_SENSORS)
+        {
+            continue;
+        }
+        fed[k]++;
+        batcher_add(&all, &samples[i]);
+        shadow_add(&shadow[k], &samples[i]);
+
+        n = aht10_agg_feed(&agg, &samples[i], out);
+        if (n > 0)
+        {
+            if (shadow[k].reported)
+            {
+                gap = samples[i].timestamp_ms - shadow[k].last_report_ms;
+                gap_max = (gap > gap_max) ? gap : gap_max;
+                CHECK(gap <= cfg.heartbeat_ms + AGG_CADENCE_MS, "sensor %u went %u ms without a report", k, gap);
+            }
+            check_summary(&shadow[k], out, n);
+            if (verbose)
+            {
+                printf("t=%u sensor %u: %.2f %%RH %.2f C after %u samples%s\n", out[0].timestamp_ms, k,
+                       aht10_sample_humidity_raw(&out[0]) * 100.0 / (1 << 20),
+                       aht10_sample_temperature_raw(&out[0]) * 200.0 / (1 << 20) - 50.0, shadow[k].count,
+                       (samples[i].timestamp_ms - shadow[k].last_report_ms >= cfg.heartbeat_ms) ? " (heartbeat)" : "");
+            }
+            windowed[k] += shadow[k].count;
+            shadow_reset(&shadow[k]);
+            shadow[k].reported = 1;
+            shadow[k].last_report_ms = samples[i].timestamp_ms;
+            last_hum[k] = aht10_sample_humidity_raw(&out[0]);
+            last_temp[k] = aht10_sample_temperature_raw(&out[0]);
+            for (j = 0; j < n; j++)
+            {
+                batcher_add(&reported, &out[j]);
+            }
+        }
+
+        /* what the collector believes (the last report) against the truth */
+        err = fabs(((double)aht10_sample_humidity_raw(&samples[i]) - last_hum[k]) * 100.0 / (1 << 20));
+        err_hum_max = (err > err_hum_max) ? err : err_hum_max;
+        err = fabs(((double)aht10_sample_temperature_raw(&samples[i]) - last_temp[k]) * 200.0 / (1 << 20));
+        err_temp_max = (err > err_temp_max) ? err : err_temp_max;
+    }
+    batcher_flush(&all);
+    batcher_flush(&reported);
+
+    for (k = 0; k < sensors; k++)
+    {
+        CHECK(windowed[k] + agg.sensors[k].window.count == fed[k],
+              "sensor %u: windows hold %llu + %u samples, fed %lu", k,
+              (unsigned long long)windowed[k], agg.sensors[k].window.count, fed[k]);
+    }
+    check_round_trip(reported.sent, reported.nsent);
+
+    printf("%zu samples from %u sensors over %.1f h, deadband %u.%02u %%RH / %u.%02u C, heartbeat %u s\n",
+           count, sensors, count ? (samples[count - 1].timestamp_ms - samples[0].timestamp_ms) / 3.6e6 : 0.0,
+           cfg.hum_deadband / 100, cfg.hum_deadband % 100, cfg.temp_deadband / 100, cfg.temp_deadband % 100,
+           cfg.heartbeat_ms / 1000);
+    printf("every sample:     %7lu records %6lu frames %8lu bytes\n", all.records, all.frames, all.bytes);
+    printf("report on change: %7lu records %6lu frames %8lu bytes (%u reports, %u heartbeats)\n",
+           reported.records, reported.frames, reported.bytes, agg.reports, agg.heartbeats);
+    printf("reduction: %.1fx frames, %.1fx bytes; last report vs sample: max %.2f %%RH %.2f C; longest gap %u s\n",
+           reported.frames ? (double)all.frames / reported.frames : 0.0,
+           reported.bytes ? (double)all.bytes / reported.bytes : 0.0,
+           err_hum_max, err_temp_max, gap_max / 1000);
+    if (in_path == NULL)
+    {
+        CHECK(reported.frames * AGG_EXPECTED_REDUCTION <= all.frames,
+              "only %lu -> %lu frames on the synthetic trace", all.frames, reported.frames);
+    }
+
+    free(samples);
+    free(reported.sent);
+    if (s_failures)
+    {
+        printf("%u checks failed\n", s_failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
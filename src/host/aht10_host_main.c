@@ -0,0 +1,222 @@
+/* Runs the AHT10 driver from main/ against the simulated sensor on Linux.
+ *
+ * usage: aht10_host [-n samples] [-t temp_c] [-r rh] [-l latency_ms]
+ *                   [-N nacks] [-T timeouts] [-u] [-e] [-c] [-p period_ms]
+ *                   [-s] [-v | -b]
+ *
+ * -e runs the non-blocking measurement engine (aht10_meas.c) the way the
+ * firmware task does instead of the blocking aht10_sample() loop.
+ * -c switches the engine to cycle mode (AHT10_MODE_CYCLE) halfway through the
+ * run, the way aht10_task_set_mode() does on the target, prints the sample
+ * latency in each mode and fails if a cycle mode sample (after the first,
+ * which waits for the sensor's first conversion) takes more than
+ * CYCLE_SAMPLE_MAX_US. Implies -e.
+ * -p sleeps this long (simulated) between samples.
+ * -v prints the driver's deferred log records after each sample, -b writes
+ * them as the binary frames the firmware sends with AHT10_LOG_BINARY, for
+ * piping into log_decode.
+ * -s prints the latency histograms (main/aht10_stats.h) as they go into the
+ * status packet plus p50/p99 for each, and fails if they alone no longer
+ * leave room in the packet for the rest of the status. */
+
+/* Toolchain headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* local headers */
+#include "aht10_i2c.h"
+#include "aht10_log.h"
+#include "aht10_meas.h"
+#include "aht10_sim.h"
+#include "aht10_stats.h"
+#include "status.h"
+
+/* budget for the rest of the status packet with four sensors and three tasks */
+#define STATUS_NON_HIST_BYTES               900
+/* one 6 byte read at 100 kHz plus slack; anything longer means it waited for a conversion */
+#define CYCLE_SAMPLE_MAX_US                 2000
+
+static const aht10_sim_t *s_sim;
+
+/* log records carry simulated time */
+static uint32_t log_now_ms(void)
+{
+    return (uint32_t)(s_sim->now_us / 1000);
+}
+
+/* what the firmware's drain task does, text or binary */
+static void drain_log(int binary)
+{
+    aht10_log_record_t rec;
+    char line[AHT10_LOG_LINE_MAX];
+    uint8_t frame[AHT10_LOG_WIRE_MAX];
+
+    while (aht10_log_get(&rec) == ESP_OK)
+    {
+        if (binary)
+        {
+            fwrite(frame, 1, aht10_log_encode(&rec, frame), stdout);
+        }
+        else
+        {
+            aht10_log_format(&rec, line, sizeof(line));
+            printf("  %s\n", line);
+        }
+    }
+}
+
+static int print_stats(void)
+{
+    static char json[STATUS_PACKET_MAX];
+    const aht10_hist_t *hist;
+    aht10_stat_id_t id;
+    size_t pos = 0;
+
+    aht10_stats_json_hists(json, sizeof(json), &pos);
+    printf("{%s}\n", json);
+    for (id = 0; id < AHT10_STAT_COUNT; id++)
+    {
+        hist = aht10_stats_hist(id);
+        if (hist->count > 0)
+        {
+            printf("%-14s n %-6u p50 <= %-7u p99 <= %-7u max %u\n", hist->key, hist->count,
+                   aht10_hist_quantile(hist, 500), aht10_hist_quantile(hist, 990), hist->max);
+        }
+    }
+    printf("histograms take %zu of %d status bytes\n", pos, STATUS_PACKET_MAX);
+    return (pos + STATUS_NON_HIST_BYTES <= STATUS_PACKET_MAX) ? 0 : 1;
+}
+
+/* drive one engine cycle, sleeping (in simulated time) whenever it asks to */
+static void run_engine_cycle(aht10_meas_t *meas, aht10_reading_t *reading)
+{
+    const aht10_hal_t *hal = meas->hal;
+    uint32_t next_ms;
+
+    if (aht10_meas_start(meas, &next_ms) != ESP_OK)
+    {
+        return;
+    }
+    while (meas->state != AHT10_MEAS_CONVERTED)
+    {
+        hal->delay_ms(hal->ctx, next_ms);
+        aht10_meas_step(meas, &next_ms);
+    }
+    aht10_meas_take(meas, reading);
+}
+
+int main(int argc, char **argv)
+{
+    aht10_sim_config_t cfg;
+    aht10_sim_t sim;
+    aht10_reading_t reading;
+    const aht10_hal_t *hal;
+    aht10_meas_t meas;
+    long samples = 3;
+    int engine = 0, log_mode = 0, stats = 0, cycle = 0, ret = 0;
+    uint32_t period_ms = 0;
+    int opt, i, switch_at;
+    int64_t start_us, latency_us;
+    esp_err_t err;
+    int64_t mode_sum_us[2] = { 0 }, mode_max_us[2] = { 0 };
+    long mode_count[2] = { 0 };
+
+    aht10_sim_default_config(&cfg);
+    aht10_sim_init(&sim, &cfg);
+
+    while ((opt = getopt(argc, argv, "n:t:r:l:N:T:uecp:svb")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': samples = strtol(optarg, NULL, 0); break;
+            case 't': cfg.temperature_c = strtod(optarg, NULL); break;
+            case 'r': cfg.humidity_rh = strtod(optarg, NULL); break;
+            case 'l': cfg.meas_latency_us = (uint32_t)strtoul(optarg, NULL, 0) * 1000; break;
+            case 'N': sim.inject_nack = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'T': sim.inject_timeout = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'u': cfg.calibrated = 0; break;
+            case 'e': engine = 1; break;
+            case 'c': engine = 1; cycle = 1; break;
+            case 'p': period_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's': stats = 1; break;
+            case 'v': log_mode = 1; break;
+            case 'b': log_mode = 2; break;
+            default:
+                fprintf(stderr, "usage: %s [-n samples] [-t temp_c] [-r rh] [-l latency_ms] [-N nacks] [-T timeouts] [-u] [-e] [-c] [-p period_ms] [-s] [-v | -b]\n", argv[0]);
+                return 2;
+        }
+    }
+    sim.cfg = cfg;
+    sim.calibrated = cfg.calibrated;
+    hal = aht10_sim_hal(&sim);
+
+    s_sim = &sim;
+    aht10_log_init(log_now_ms);
+    aht10_init(hal);
+    aht10_meas_init(&meas, hal);
+    switch_at = cycle ? (int)(samples / 2) : -1;
+    for (i = 0; i < samples; i++)
+    {
+        if (i == switch_at && aht10_meas_set_mode(&meas, AHT10_MODE_CYCLE) != ESP_OK)
+        {
+            printf("switching to cycle mode failed\n");
+            ret = 1;
+        }
+        if (i > 0 && period_ms > 0)
+        {
+            hal->delay_ms(hal->ctx, period_ms);
+        }
+        start_us = hal->time_us(hal->ctx);
+        if (engine)
+        {
+            run_engine_cycle(&meas, &reading);
+        }
+        else if ((err = aht10_sample(hal, &reading)) != ESP_OK)
+        {
+            printf("sample %d: failed, error %d after %lld us (simulated)\n\n", i, err,
+                   (long long)(hal->time_us(hal->ctx) - start_us));
+            continue;
+        }
+        if (log_mode)
+        {
+            drain_log(log_mode == 2);
+        }
+        latency_us = hal->time_us(hal->ctx) - start_us;
+        mode_sum_us[meas.mode] += latency_us;
+        mode_count[meas.mode]++;
+        if (latency_us > mode_max_us[meas.mode])
+        {
+            mode_max_us[meas.mode] = latency_us;
+        }
+        if (meas.mode == AHT10_MODE_CYCLE && i > switch_at && latency_us > CYCLE_SAMPLE_MAX_US)
+        {
+            printf("cycle mode sample %d took %lld us\n", i, (long long)latency_us);
+            ret = 1;
+        }
+        printf("sample %d: status 0x%02X hum %lu." AHT10_CONVERT_FRAC_FMT " %%RH temp %s%lu." AHT10_CONVERT_FRAC_FMT
+               " C, cycle %lld us (simulated)\n\n",
+               i, reading.status, AHT10_FIX_WHOLE(reading.humidity), AHT10_FIX_FRAC(reading.humidity),
+               AHT10_FIX_SIGN(reading.temperature), AHT10_FIX_WHOLE(reading.temperature), AHT10_FIX_FRAC(reading.temperature),
+               (long long)latency_us);
+    }
+
+    if (engine)
+    {
+        printf("engine: %u cycles, %u transactions, %u busy polls, latency avg %llu us max %u us\n",
+               meas.cycles, meas.transactions, meas.busy_polls,
+               (unsigned long long)(meas.cycles ? meas.latency_sum_us / meas.cycles : 0), meas.latency_max_us);
+    }
+    for (i = AHT10_MODE_NORMAL; cycle && i <= AHT10_MODE_CYCLE; i++)
+    {
+        printf("%-6s mode: %ld samples, latency avg %lld us max %lld us\n", i ? "cycle" : "normal",
+               mode_count[i], (long long)(mode_count[i] ? mode_sum_us[i] / mode_count[i] : 0), (long long)mode_max_us[i]);
+    }
+    printf("simulated time %lld us, %u writes, %u reads, %u nacks, %u timeouts, %u conversions\n",
+           (long long)sim.now_us, sim.writes, sim.reads, sim.nacks, sim.timeouts, sim.measurements);
+    if (stats)
+    {
+        ret |= print_stats();
+    }
+    return ret;
+}
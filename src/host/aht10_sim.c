@@ -0,0 +1,325 @@
+/* associated header file */
+#include "aht10_sim.h"
+
+/* others necessary headers */
+#include <math.h>
+#include <string.h>
+#include "aht10_i2c.h"
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+/* start + (address + payload) * 9 bits + stop */
+static void sim_charge_transaction(aht10_sim_t *sim, size_t data_len)
+{
+    uint64_t bits = 2 + (1 + (uint64_t)data_len) * 9;
+    sim->now_us += (int64_t)((bits * 1000000ULL) / sim->cfg.bus_hz);
+}
+
+/* xorshift32, uniform in (0, 1) */
+static double sim_uniform(aht10_sim_t *sim)
+{
+    sim->rng ^= sim->rng << 13;
+    sim->rng ^= sim->rng >> 17;
+    sim->rng ^= sim->rng << 5;
+    return ((double)sim->rng + 0.5) / 4294967296.0;
+}
+
+/* Box-Muller, one of the pair is enough here */
+static double sim_gauss(aht10_sim_t *sim, double sd)
+{
+    if (sd <= 0.0)
+    {
+        return 0.0;
+    }
+    return sd * sqrt(-2.0 * log(sim_uniform(sim))) * cos(2.0 * M_PI * sim_uniform(sim));
+}
+
+static void sim_update(aht10_sim_t *sim)
+{
+    double temperature_c = sim->cfg.temperature_c;
+    double humidity_rh = sim->cfg.humidity_rh;
+    uint32_t hum, temp;
+
+    /* in cycle mode the part converts on its own, busy only until the first
+     * result after the mode change */
+    if ((!sim->busy && sim->mode != 0x10) || sim->stuck_busy || sim->wedged || sim->now_us < sim->ready_us)
+    {
+        return;
+    }
+    if (sim->mode == 0x10)
+    {
+        /* conversions it finished while nobody looked are simply overwritten */
+        sim->ready_us += ((sim->now_us - sim->ready_us) / sim->cfg.meas_latency_us + 1) * sim->cfg.meas_latency_us;
+    }
+
+    if (sim->cfg.environment != NULL)
+    {
+        sim->cfg.environment(sim->cfg.environment_user, sim->now_us, &temperature_c, &humidity_rh);
+    }
+    temperature_c += sim_gauss(sim, sim->cfg.noise_c);
+    humidity_rh += sim_gauss(sim, sim->cfg.noise_rh);
+    hum = aht10_sim_humidity_code(humidity_rh);
+    temp = aht10_sim_temperature_code(temperature_c);
+    if (sim->cfg.spike_per_mille > 0 && sim_uniform(sim) * 1000.0 < sim->cfg.spike_per_mille)
+    {
+        /* a glitched transfer: either plausible but far off, or all ones */
+        sim->spikes++;
+        if (sim_uniform(sim) < 0.5)
+        {
+            hum = aht10_sim_humidity_code(humidity_rh + (sim_uniform(sim) < 0.5 ? -25.0 : 25.0));
+            temp = aht10_sim_temperature_code(temperature_c + (sim_uniform(sim) < 0.5 ? -8.0 : 8.0));
+        }
+        else
+        {
+            hum = AHT10_CODE_MAX;
+            temp = AHT10_CODE_MAX;
+        }
+    }
+    sim->result_uncal = 0;
+    if (sim->inject_uncal > 0)
+    {
+        sim->inject_uncal--;
+        sim->result_uncal = 1;
+    }
+
+    sim->data[1] = (uint8_t)(hum >> 12);
+    sim->data[2] = (uint8_t)(hum >> 4);
+    sim->data[3] = (uint8_t)(((hum & 0x0F) << 4) | ((temp >> 16) & 0x0F));
+    sim->data[4] = (uint8_t)(temp >> 8);
+    sim->data[5] = (uint8_t)temp;
+    sim->busy = 0;
+    sim->measurements++;
+}
+
+static uint8_t sim_status(const aht10_sim_t *sim)
+{
+    uint8_t status = sim->mode & AHT10_STATUS_BITS_MODE;
+    if (sim->busy)
+    {
+        status |= AHT10_STATUS_BITS_BUSY;
+    }
+    if (sim->calibrated && !sim->result_uncal)
+    {
+        status |= AHT10_STATUS_BITS_CAL;
+    }
+    return status;
+}
+
+/* returns ESP_OK if the transaction reaches the sensor */
+static esp_err_t sim_bus_phase(aht10_sim_t *sim, uint8_t addr, size_t data_len)
+{
+    if (sim->inject_timeout > 0)
+    {
+        sim->inject_timeout--;
+        sim->timeouts++;
+        sim->now_us += (int64_t)AHT10_SIM_BUS_TIMEOUT_MS * 1000;
+        return ESP_ERR_TIMEOUT;
+    }
+
+    /* the address byte goes out no matter who is listening */
+    sim_charge_transaction(sim, 0);
+    if (sim->stuck_sda)
+    {
+        /* the master loses arbitration on its own start condition */
+        sim->nacks++;
+        return ESP_FAIL;
+    }
+    if (sim->inject_nack > 0 || addr != sim->cfg.addr || sim->now_us < sim->reset_until_us)
+    {
+        if (sim->inject_nack > 0)
+        {
+            sim->inject_nack--;
+        }
+        sim->nacks++;
+        return ESP_FAIL;
+    }
+    sim->now_us += (int64_t)((data_len * 9ULL * 1000000ULL) / sim->cfg.bus_hz);
+    return ESP_OK;
+}
+
+static esp_err_t sim_init(void *ctx)
+{
+    return ESP_OK;
+}
+
+static esp_err_t sim_write(void *ctx, uint8_t addr, const uint8_t *data, size_t data_len)
+{
+    aht10_sim_t *sim = (aht10_sim_t *)ctx;
+    esp_err_t ret;
+
+    sim->writes++;
+    ret = sim_bus_phase(sim, addr, data_len);
+    if (ret != ESP_OK || data_len == 0)
+    {
+        return ret;
+    }
+    sim_update(sim);
+
+    switch (data[0])
+    {
+        case AHT10_CMD_INIT:
+            if (data_len > 1)
+            {
+                if (data[1] & AHT10_INIT_REG_CMD)
+                {
+                    sim->mode = 0x20;
+                }
+                else if (data[1] & AHT10_INIT_REG_CYCLE)
+                {
+                    sim->mode = 0x10;
+                    sim->busy = 1;
+                    sim->ready_us = sim->now_us + sim->cfg.meas_latency_us;
+                }
+                else
+                {
+                    sim->mode = 0x00;
+                }
+                if (data[1] & AHT10_INIT_REG_CAL)
+                {
+                    sim->calibrated = 1;
+                }
+            }
+            break;
+        case AHT10_CMD_MEASURE:
+            /* a trigger while converting is ignored by the part */
+            if (!sim->busy)
+            {
+                sim->busy = 1;
+                sim->ready_us = sim->now_us + sim->cfg.meas_latency_us;
+            }
+            break;
+        case AHT10_CMD_SOFTRESET:
+            sim->resets++;
+            sim->wedged = 0;
+            sim->busy = 0;
+            sim->mode = 0x00;
+            sim->calibrated = sim->cfg.calibrated;
+            sim->reset_until_us = sim->now_us + (int64_t)AHT10_DELAY_SOFT_RESET * 1000;
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t sim_read(void *ctx, uint8_t addr, uint8_t *data, size_t data_len)
+{
+    aht10_sim_t *sim = (aht10_sim_t *)ctx;
+    esp_err_t ret;
+    size_t i;
+
+    sim->reads++;
+    ret = sim_bus_phase(sim, addr, data_len);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    sim_update(sim);
+
+    sim->data[0] = sim_status(sim);
+    for (i = 0; i < data_len; i++)
+    {
+        /* past the result the part just keeps clocking out 0xFF */
+        data[i] = (i < sizeof(sim->data)) ? sim->data[i] : 0xFF;
+    }
+    return ESP_OK;
+}
+
+static void sim_delay_ms(void *ctx, uint32_t ms)
+{
+    aht10_sim_t *sim = (aht10_sim_t *)ctx;
+    sim->now_us += (int64_t)ms * 1000;
+}
+
+static int64_t sim_time_us(void *ctx)
+{
+    return ((aht10_sim_t *)ctx)->now_us;
+}
+
+static void sim_deinit(void *ctx)
+{
+}
+
+static esp_err_t sim_recover(void *ctx)
+{
+    aht10_sim_t *sim = (aht10_sim_t *)ctx;
+
+    /* nine clocks and a STOP */
+    sim->recovers++;
+    sim->now_us += (int64_t)(((I2C_AHT10_RECOVER_CLOCKS + 1) * 1000000ULL) / sim->cfg.bus_hz);
+    sim->stuck_sda = 0;
+    return ESP_OK;
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void aht10_sim_default_config(aht10_sim_config_t *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->meas_latency_us = AHT10_SIM_MEAS_LATENCY_US;
+    cfg->bus_hz = AHT10_SIM_BUS_HZ;
+    cfg->addr = AHT10_SENSOR_ADDR;
+    cfg->calibrated = 1;
+    cfg->temperature_c = 21.5;
+    cfg->humidity_rh = 40.0;
+}
+
+void aht10_sim_init(aht10_sim_t *sim, const aht10_sim_config_t *cfg)
+{
+    memset(sim, 0, sizeof(*sim));
+    if (cfg != NULL)
+    {
+        sim->cfg = *cfg;
+    }
+    else
+    {
+        aht10_sim_default_config(&sim->cfg);
+    }
+    sim->calibrated = sim->cfg.calibrated;
+    sim->rng = sim->cfg.seed ? sim->cfg.seed : 1;
+
+    sim->hal.ctx = sim;
+    sim->hal.init = sim_init;
+    sim->hal.write = sim_write;
+    sim->hal.read = sim_read;
+    sim->hal.delay_ms = sim_delay_ms;
+    sim->hal.time_us = sim_time_us;
+    sim->hal.deinit = sim_deinit;
+    sim->hal.recover = sim_recover;
+}
+
+const aht10_hal_t *aht10_sim_hal(aht10_sim_t *sim)
+{
+    return &sim->hal;
+}
+
+uint32_t aht10_sim_humidity_code(double humidity_rh)
+{
+    double code = humidity_rh / 100.0 * 1048576.0;
+    if (code < 0.0)
+    {
+        return 0;
+    }
+    if (code > 1048575.0)
+    {
+        return 1048575;
+    }
+    return (uint32_t)(code + 0.5);
+}
+
+uint32_t aht10_sim_temperature_code(double temperature_c)
+{
+    double code = (temperature_c + 50.0) / 200.0 * 1048576.0;
+    if (code < 0.0)
+    {
+        return 0;
+    }
+    if (code > 1048575.0)
+    {
+        return 1048575;
+    }
+    return (uint32_t)(code + 0.5);
+}
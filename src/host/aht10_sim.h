@@ -0,0 +1,92 @@
+#ifndef _AHT10_SIM_H
+#define _AHT10_SIM_H
+
+#include <stdint.h>
+#include "aht10_hal.h"
+#include "aht10_i2c.h"
+
+/* Simulated AHT10 for host builds.
+ *
+ * The simulator owns a virtual clock: every delay_ms() and every bus
+ * transaction advances it, so a whole measurement cycle runs in a few
+ * microseconds of real time while still reporting realistic latencies.
+ *
+ * It models
+ * - the busy bit (AHT10_STATUS_BITS_BUSY) during a conversion
+ * - the measurement latency after AHT10_CMD_MEASURE
+ * - cycle mode (AHT10_INIT_REG_CYCLE): a new result every conversion time,
+ *   without any measure command
+ * - the calibration bit (AHT10_STATUS_BITS_CAL) and mode bits
+ * - NACKs (wrong address or injected) and bus timeouts (injected)
+ * - a slave holding SDA low (injected): every transaction fails until the
+ *   HAL's recover op clocks it free
+ * - soft reset: the part ignores the bus for AHT10_DELAY_SOFT_RESET, then
+ *   comes back in normal mode, un-wedged (see wedged below)
+ * - measurement noise and spikes (optional, from a seeded generator so runs
+ *   repeat), and results with the calibration bit clear (injected) */
+
+#define AHT10_SIM_MEAS_LATENCY_US       75000       /* typical conversion time from the datasheet */
+#define AHT10_SIM_BUS_HZ                100000      /* standard mode I2C */
+#define AHT10_SIM_BUS_TIMEOUT_MS        I2C_AHT10_CMD_TIMEOUT_MS    /* same timeout the ESP HAL passes to i2c_master_cmd_begin */
+
+typedef struct aht10_sim_config {
+    uint32_t meas_latency_us;           /* conversion time after a measure command */
+    uint32_t bus_hz;                    /* SCL frequency, used to charge time per transaction */
+    uint8_t addr;                       /* 7-bit address the sensor answers to */
+    uint8_t calibrated;                 /* factory calibration coefficients loaded */
+    double temperature_c;               /* environment the sensor sits in */
+    double humidity_rh;                 /* relative humidity in percent */
+    /* optional hook to vary the environment with time (NULL keeps it constant) */
+    void (*environment)(void *user, int64_t now_us, double *temperature_c, double *humidity_rh);
+    void *environment_user;
+    double noise_c;                     /* standard deviation of each reading, 0 for none */
+    double noise_rh;
+    uint32_t spike_per_mille;           /* readings that come back way off (half of them all ones) */
+    uint32_t seed;
+} aht10_sim_config_t;
+
+typedef struct aht10_sim {
+    aht10_sim_config_t cfg;
+    aht10_hal_t hal;
+
+    /* virtual time */
+    int64_t now_us;
+    int64_t ready_us;                   /* when the running conversion completes */
+    int64_t reset_until_us;             /* sensor ignores the bus until then after a soft reset */
+
+    /* sensor state */
+    uint8_t busy;
+    uint8_t mode;                       /* AHT10_STATUS_BITS_MODE field */
+    uint8_t calibrated;
+    uint8_t data[6];                    /* status + latest 40 bits of result */
+
+    /* fault injection, each consumes one transaction */
+    uint32_t inject_nack;               /* NACK the next N transactions */
+    uint32_t inject_timeout;            /* time out the next N transactions */
+    uint8_t stuck_busy;                 /* never complete a conversion, a dead part */
+    uint8_t wedged;                     /* same, but a soft reset clears it */
+    uint8_t stuck_sda;                  /* SDA held low, cleared by the recover op */
+    uint32_t inject_uncal;              /* the next N results come with the cal bit clear */
+    uint8_t result_uncal;               /* the current one does */
+    uint32_t rng;
+
+    /* statistics */
+    uint32_t writes;
+    uint32_t reads;
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t measurements;
+    uint32_t spikes;
+    uint32_t recovers;                  /* recover op calls */
+    uint32_t resets;                    /* soft reset commands */
+} aht10_sim_t;
+
+void aht10_sim_default_config(aht10_sim_config_t *cfg);
+void aht10_sim_init(aht10_sim_t *sim, const aht10_sim_config_t *cfg);
+const aht10_hal_t *aht10_sim_hal(aht10_sim_t *sim);
+
+/* helpers for the environment, also used to produce reference codes */
+uint32_t aht10_sim_humidity_code(double humidity_rh);
+uint32_t aht10_sim_temperature_code(double temperature_c);
+
+#endif /* _AHT10_SIM_H */
@@ -0,0 +1,151 @@
+/* Checks the fixed-point transfer functions in aht10_convert.h against a
+ * double precision reference for every one of the 2^20 codes on both
+ * channels, then times them against the old single precision float path.
+ *
+ * usage: bench_convert [rounds]
+ *
+ * Exits non-zero if any code converts differently from the reference. The
+ * timing uses the CPU cycle counter when there is one (rdtsc on x86, ccount
+ * on Xtensa), so on the host it only shows the relative cost; the float path
+ * is hardware on a PC and soft-float on the L106. */
+
+/* Toolchain headers */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* local headers */
+#include "aht10_convert.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES()      __rdtsc()
+#define BENCH_UNIT          "cycles"
+#elif defined(__XTENSA__)
+static inline uint64_t bench_ccount(void)
+{
+    uint32_t ccount;
+    __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+    return ccount;
+}
+#define BENCH_CYCLES()      bench_ccount()
+#define BENCH_UNIT          "cycles"
+#else
+static inline uint64_t bench_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#define BENCH_CYCLES()      bench_ns()
+#define BENCH_UNIT          "ns"
+#endif
+
+#define CODE_COUNT          (AHT10_CODE_MAX + 1)
+
+static volatile int32_t s_sink;
+static volatile float s_float_sink;
+
+/* the transfer functions exactly as the firmware used to evaluate them */
+static float float_humidity(uint32_t code)
+{
+    float humidity = (float)code;
+    humidity /= 1048576.0F;
+    return humidity * 100.0F;
+}
+
+static float float_temperature(uint32_t code)
+{
+    float temperature = (float)code;
+    temperature *= 200.0F;
+    temperature /= 1048576.0F;
+    temperature -= 50.0F;
+    return temperature;
+}
+
+static int verify(void)
+{
+    uint32_t code;
+    unsigned long mismatches = 0;
+    double float_err_max = 0.0;
+
+    for (code = 0; code < CODE_COUNT; code++)
+    {
+        /* reference: round half up of the exact value in output units */
+        int64_t hum_ref = (int64_t)floor((double)code * 100.0 * AHT10_CONVERT_SCALE / 1048576.0 + 0.5);
+        int64_t temp_ref = (int64_t)floor((double)code * 200.0 * AHT10_CONVERT_SCALE / 1048576.0 + 0.5)
+                           - AHT10_CONVERT_TEMP_OFFSET;
+        uint32_t hum = aht10_convert_humidity(code);
+        int32_t temp = aht10_convert_temperature(code);
+        double err;
+
+        if ((int64_t)hum != hum_ref || (int64_t)temp != temp_ref)
+        {
+            if (mismatches < 10)
+            {
+                printf("mismatch at code 0x%05X: hum %u (ref %lld) temp %d (ref %lld)\n",
+                       code, hum, (long long)hum_ref, temp, (long long)temp_ref);
+            }
+            mismatches++;
+        }
+
+        /* how far the old float path was off, in output units */
+        err = fabs((double)float_temperature(code) * AHT10_CONVERT_SCALE - (double)temp);
+        if (err > float_err_max)
+        {
+            float_err_max = err;
+        }
+        err = fabs((double)float_humidity(code) * AHT10_CONVERT_SCALE - (double)hum);
+        if (err > float_err_max)
+        {
+            float_err_max = err;
+        }
+    }
+
+    printf("verify: %u codes x 2 channels at 1/%d resolution, %lu mismatches\n",
+           CODE_COUNT, AHT10_CONVERT_SCALE, mismatches);
+    printf("verify: old float path deviates by up to %.3f output units\n", float_err_max);
+    return mismatches == 0 ? 0 : 1;
+}
+
+static void bench(unsigned rounds)
+{
+    uint64_t start, fixed_ticks, float_ticks;
+    unsigned r;
+    uint32_t code;
+    double per_code;
+
+    start = BENCH_CYCLES();
+    for (r = 0; r < rounds; r++)
+    {
+        for (code = 0; code < CODE_COUNT; code++)
+        {
+            s_sink = (int32_t)aht10_convert_humidity(code) + aht10_convert_temperature(code);
+        }
+    }
+    fixed_ticks = BENCH_CYCLES() - start;
+
+    start = BENCH_CYCLES();
+    for (r = 0; r < rounds; r++)
+    {
+        for (code = 0; code < CODE_COUNT; code++)
+        {
+            s_float_sink = float_humidity(code) + float_temperature(code);
+        }
+    }
+    float_ticks = BENCH_CYCLES() - start;
+
+    per_code = (double)rounds * CODE_COUNT;
+    printf("bench: fixed-point %.2f %s per sample (both channels)\n", fixed_ticks / per_code, BENCH_UNIT);
+    printf("bench: float       %.2f %s per sample (both channels)\n", float_ticks / per_code, BENCH_UNIT);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned rounds = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : 8;
+    int ret = verify();
+
+    bench(rounds);
+    return ret;
+}
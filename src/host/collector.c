@@ -0,0 +1,161 @@
+/* Stand-in for the server side: receives batch frames (main/upload_frame.h)
+ * over UDP, acks and decodes them and prints what arrived. Status packets
+ * (main/status.h) are printed as they are.
+ *
+ * usage: collector [-p port] [-n frames] [-v]
+ *
+ * -n exits after that many frames, -v prints every sample instead of one
+ * line per frame, and the window summaries (main/aht10_agg.h) that follow
+ * reported samples. Frames from a device with a synced clock
+ * (UPLOAD_FRAME_FLAG_UTC) show their start in UTC. */
+
+/* Toolchain headers */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* local headers */
+#include "aht10_agg.h"
+#include "aht10_convert.h"
+#include "upload_frame.h"
+
+static void print_sample(const aht10_sample_t *sample)
+{
+    static const char *const kinds[] = { "", "mean", "min", "max" };
+    uint32_t hum_code = aht10_sample_humidity_raw(sample);
+    uint32_t temp_code = aht10_sample_temperature_raw(sample);
+    uint32_t hum = aht10_convert_humidity(hum_code);
+    int32_t temp = aht10_convert_temperature(temp_code);
+
+    if (sample->status == AHT10_AGG_SUMMARY_WINDOW)
+    {
+        printf("    window: %u samples over %u s\n", hum_code, temp_code);
+    }
+    else if (AHT10_AGG_IS_SUMMARY(sample) && (sample->status & 0x0F) < 4)
+    {
+        printf("    %-4s    %lu." AHT10_CONVERT_FRAC_FMT " %%RH %s%lu." AHT10_CONVERT_FRAC_FMT " C\n",
+               kinds[sample->status & 0x0F], AHT10_FIX_WHOLE(hum), AHT10_FIX_FRAC(hum),
+               AHT10_FIX_SIGN(temp), AHT10_FIX_WHOLE(temp), AHT10_FIX_FRAC(temp));
+    }
+    else
+    {
+        printf("  t=%u ms sensor %u status 0x%02X %lu." AHT10_CONVERT_FRAC_FMT " %%RH %s%lu." AHT10_CONVERT_FRAC_FMT " C\n",
+               sample->timestamp_ms, sample->sensor, sample->status,
+               AHT10_FIX_WHOLE(hum), AHT10_FIX_FRAC(hum),
+               AHT10_FIX_SIGN(temp), AHT10_FIX_WHOLE(temp), AHT10_FIX_FRAC(temp));
+    }
+}
+
+/* "t=1234 ms" on the device clock, "2026-10-16 12:00:00.250 UTC" once synced */
+static void format_start(const upload_frame_header_t *header, char *out, size_t len)
+{
+    uint64_t utc_ms = (uint64_t)header->epoch_s * 1000 + header->base_ms;
+    time_t seconds = (time_t)(utc_ms / 1000);
+    struct tm tm;
+
+    if (!(header->flags & UPLOAD_FRAME_FLAG_UTC))
+    {
+        snprintf(out, len, "t=%u ms", header->base_ms);
+        return;
+    }
+    gmtime_r(&seconds, &tm);
+    snprintf(out, len, "%04d-%02d-%02d %02d:%02d:%02d.%03u UTC", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec, (unsigned)(utc_ms % 1000));
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t buf[2048];
+    aht10_sample_t samples[UPLOAD_FRAME_MAX_SAMPLES];
+    upload_frame_header_t header;
+    uint8_t ack[UPLOAD_ACK_LEN];
+    struct sockaddr_in addr, from;
+    socklen_t from_len;
+    unsigned long frames = 0, bad = 0, status = 0, total_samples = 0, total_bytes = 0, limit = 0;
+    int port = UPLOAD_FRAME_DEFAULT_PORT;
+    int verbose = 0;
+    int opt, sock, i;
+    ssize_t len;
+    char start[48];
+    esp_err_t ret;
+
+    while ((opt = getopt(argc, argv, "p:n:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p': port = atoi(optarg); break;
+            case 'n': limit = strtoul(optarg, NULL, 0); break;
+            case 'v': verbose = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-n frames] [-v]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("collector: bind");
+        return 1;
+    }
+    printf("collector: listening on udp port %d\n", port);
+    fflush(stdout);
+
+    while (limit == 0 || frames + bad < limit)
+    {
+        from_len = sizeof(from);
+        len = recvfrom(sock, buf, sizeof(buf) - 1, 0, (struct sockaddr *)&from, &from_len);
+        if (len < 0)
+        {
+            perror("collector: recv");
+            break;
+        }
+
+        if (len > 0 && buf[0] == '{')
+        {
+            buf[len] = '\0';
+            printf("status from %s: %s\n", inet_ntoa(from.sin_addr), (const char *)buf);
+            fflush(stdout);
+            status++;
+            continue;
+        }
+
+        ret = upload_frame_decode(buf, (size_t)len, &header, samples, UPLOAD_FRAME_MAX_SAMPLES);
+        if (ret != ESP_OK)
+        {
+            printf("collector: dropped %zd byte frame (error 0x%X)\n", len, ret);
+            bad++;
+            continue;
+        }
+        sendto(sock, ack, upload_frame_ack(header.seq, ack), 0, (struct sockaddr *)&from, from_len);
+        frames++;
+        total_samples += header.count;
+        total_bytes += (unsigned long)len;
+
+        format_start(&header, start, sizeof(start));
+        printf("%02x:%02x:%02x:%02x:%02x:%02x seq %u: %u samples in %zd bytes from %s\n",
+               header.device_id[0], header.device_id[1], header.device_id[2],
+               header.device_id[3], header.device_id[4], header.device_id[5],
+               header.seq, header.count, len, start);
+        for (i = 0; verbose && i < header.count; i++)
+        {
+            print_sample(&samples[i]);
+        }
+        fflush(stdout);
+    }
+
+    printf("collector: %lu frames, %lu samples, %lu bytes (%.2f bytes/sample), %lu bad, %lu status\n",
+           frames, total_samples, total_bytes,
+           total_samples ? (double)total_bytes / total_samples : 0.0, bad, status);
+    close(sock);
+    return 0;
+}
@@ -0,0 +1,350 @@
+/* associated header file */
+#include "delta_diff.h"
+
+/* others necessary headers */
+#include <stdlib.h>
+#include <string.h>
+#include "delta_patch.h"
+#include "sha256.h"
+
+typedef struct out_buf {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    int failed;
+} out_buf_t;
+
+typedef struct diff_index {
+    int32_t *head;
+    int32_t *prev;
+    uint32_t mask;
+} diff_index_t;
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static void put(out_buf_t *out, const void *data, size_t len)
+{
+    uint8_t *grown;
+    size_t cap;
+
+    if (out->failed)
+    {
+        return;
+    }
+    if (out->len + len > out->cap)
+    {
+        cap = out->cap ? out->cap : 4096;
+        while (cap < out->len + len)
+        {
+            cap *= 2;
+        }
+        if ((grown = realloc(out->data, cap)) == NULL)
+        {
+            out->failed = 1;
+            return;
+        }
+        out->data = grown;
+        out->cap = cap;
+    }
+    memcpy(&out->data[out->len], data, len);
+    out->len += len;
+}
+
+static void put_byte(out_buf_t *out, uint8_t b)
+{
+    put(out, &b, 1);
+}
+
+static void put_varint(out_buf_t *out, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        put_byte(out, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    put_byte(out, (uint8_t)v);
+}
+
+static void put_be32(out_buf_t *out, uint32_t v)
+{
+    uint8_t b[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+
+    put(out, b, sizeof(b));
+}
+
+static void put_hash(out_buf_t *out, const uint8_t *data, size_t len)
+{
+    uint8_t digest[SHA256_LEN];
+    sha256_t hash;
+
+    sha256_init(&hash);
+    sha256_update(&hash, data, len);
+    sha256_final(&hash, digest);
+    put(out, digest, sizeof(digest));
+}
+
+static uint32_t key_hash(const uint8_t *p, uint32_t mask)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+static esp_err_t index_build(diff_index_t *index, const uint8_t *old, size_t old_len)
+{
+    uint32_t size = 1024;
+    size_t i;
+
+    while (size < old_len)
+    {
+        size *= 2;
+    }
+    index->mask = size - 1;
+    index->head = malloc(size * sizeof(int32_t));
+    index->prev = malloc((old_len ? old_len : 1) * sizeof(int32_t));
+    if (index->head == NULL || index->prev == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(index->head, 0xFF, size * sizeof(int32_t));
+    for (i = 0; i + DELTA_DIFF_KEY_LEN <= old_len; i++)
+    {
+        uint32_t h = key_hash(&old[i], index->mask);
+
+        index->prev[i] = index->head[h];
+        index->head[h] = (int32_t)i;
+    }
+    return ESP_OK;
+}
+
+/* how far a COPY from (o, n) can go forward while it pays */
+static size_t extend_forward(const uint8_t *old, size_t old_len, const uint8_t *new_img, size_t new_len,
+                             size_t o, size_t n)
+{
+    long score = 0, best = 0;
+    size_t i, best_i = 0;
+
+    for (i = 0; o + i < old_len && n + i < new_len; i++)
+    {
+        score += (old[o + i] == new_img[n + i]) ? 1 : -1;
+        if (score > best)
+        {
+            best = score;
+            best_i = i + 1;
+        }
+        else if (score < best - DELTA_DIFF_GIVE_UP)
+        {
+            break;
+        }
+    }
+    return best_i;
+}
+
+/* ... and backward, at most limit bytes */
+static size_t extend_backward(const uint8_t *old, const uint8_t *new_img, size_t o, size_t n, size_t limit)
+{
+    long score = 0, best = 0;
+    size_t i, best_i = 0;
+
+    for (i = 1; i <= limit && i <= o && i <= n; i++)
+    {
+        score += (old[o - i] == new_img[n - i]) ? 1 : -1;
+        if (score > best)
+        {
+            best = score;
+            best_i = i;
+        }
+        else if (score < best - DELTA_DIFF_GIVE_UP)
+        {
+            break;
+        }
+    }
+    return best_i;
+}
+
+static void emit_insert(out_buf_t *out, const uint8_t *data, size_t len, delta_diff_stats_t *stats)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    put_byte(out, DELTA_OP_INSERT);
+    put_varint(out, (uint32_t)len);
+    put(out, data, len);
+    stats->inserts++;
+    stats->inserted += (uint32_t)len;
+}
+
+static void emit_copy(out_buf_t *out, const uint8_t *old, const uint8_t *new_img, size_t o, size_t len,
+                      uint32_t *last_old, delta_diff_stats_t *stats)
+{
+    int32_t delta = (int32_t)(o - *last_old);
+    size_t i = 0, start, zeros;
+
+    put_byte(out, DELTA_OP_COPY);
+    put_varint(out, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+    put_varint(out, (uint32_t)len);
+    while (1)
+    {
+        start = i;
+        while (i < len && new_img[i] == old[o + i])
+        {
+            i++;
+        }
+        put_varint(out, (uint32_t)(i - start));
+        if (i == len)
+        {
+            break;
+        }
+        /* literal run, until three equal bytes in a row make a zero run pay */
+        start = i;
+        zeros = 0;
+        while (i < len && zeros < 3)
+        {
+            zeros = (new_img[i] == old[o + i]) ? zeros + 1 : 0;
+            i++;
+        }
+        if (zeros == 3)
+        {
+            i -= 3;
+        }
+        put_varint(out, (uint32_t)(i - start));
+        while (start < i)
+        {
+            put_byte(out, (uint8_t)(new_img[start] - old[o + start]));
+            stats->literals += (new_img[start] != old[o + start]);
+            start++;
+        }
+        if (i == len)
+        {
+            break;
+        }
+    }
+    stats->copies++;
+    stats->copied += (uint32_t)len;
+    *last_old = (uint32_t)(o + len);
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+esp_err_t delta_diff(const uint8_t *old, size_t old_len, const uint8_t *new_img, size_t new_len,
+                     uint8_t **patch, size_t *patch_len, delta_diff_stats_t *stats)
+{
+    delta_diff_stats_t local_stats;
+    diff_index_t index = { 0 };
+    out_buf_t out = { 0 };
+    size_t p = 0, ins_start = 0, o, len, best_len, back, i, matches;
+    long align = 0;
+    int have_align = 0, seeded;
+    uint32_t last_old = 0;
+    int32_t cand;
+    int depth;
+    esp_err_t err;
+
+    if (stats == NULL)
+    {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (old_len > UINT32_MAX / 2 || new_len > UINT32_MAX / 2)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if ((err = index_build(&index, old, old_len)) != ESP_OK)
+    {
+        free(index.head);
+        free(index.prev);
+        return err;
+    }
+
+    put_be32(&out, DELTA_PATCH_MAGIC);
+    put_be32(&out, (uint32_t)old_len);
+    put_be32(&out, (uint32_t)new_len);
+    put_hash(&out, old, old_len);
+    put_hash(&out, new_img, new_len);
+
+    while (p + DELTA_DIFF_KEY_LEN <= new_len)
+    {
+        seeded = 0;
+        o = 0;
+
+        /* the last COPY's alignment first: code behind an insertion */
+        if (have_align && (long)p + align >= 0 && (size_t)((long)p + align) + DELTA_DIFF_ALIGN_PROBE <= old_len
+            && p + DELTA_DIFF_ALIGN_PROBE <= new_len)
+        {
+            o = (size_t)((long)p + align);
+            for (i = 0, matches = 0; i < DELTA_DIFF_ALIGN_PROBE; i++)
+            {
+                matches += (old[o + i] == new_img[p + i]);
+            }
+            seeded = (matches >= DELTA_DIFF_ALIGN_MATCHES);
+        }
+        if (!seeded && old_len >= DELTA_DIFF_KEY_LEN)
+        {
+            best_len = 0;
+            cand = index.head[key_hash(&new_img[p], index.mask)];
+            for (depth = 0; cand >= 0 && depth < DELTA_DIFF_CHAIN; depth++, cand = index.prev[cand])
+            {
+                for (len = 0; (size_t)cand + len < old_len && p + len < new_len && len < 256
+                              && old[cand + len] == new_img[p + len]; len++)
+                {
+                }
+                if (len > best_len)
+                {
+                    best_len = len;
+                    o = (size_t)cand;
+                }
+            }
+            seeded = (best_len >= DELTA_DIFF_MIN_MATCH);
+        }
+        if (!seeded)
+        {
+            p++;
+            continue;
+        }
+
+        back = extend_backward(old, new_img, o, p, p - ins_start);
+        len = back + extend_forward(old, old_len, new_img, new_len, o, p);
+        if (len == back)
+        {
+            p++;
+            continue;
+        }
+        emit_insert(&out, &new_img[ins_start], p - back - ins_start, stats);
+        emit_copy(&out, old, &new_img[p - back], o - back, len, &last_old, stats);
+        align = (long)o - (long)p;
+        have_align = 1;
+        p += len - back;
+        ins_start = p;
+    }
+    emit_insert(&out, &new_img[ins_start], new_len - ins_start, stats);
+    put_byte(&out, DELTA_OP_END);
+
+    /* nothing worth copying: the whole image as one INSERT is smaller */
+    for (len = new_len, i = 1; len >= 0x80; len >>= 7)
+    {
+        i++;
+    }
+    if (out.len > DELTA_PATCH_HEADER_LEN + 1 + i + new_len + 1)
+    {
+        out.len = DELTA_PATCH_HEADER_LEN;
+        memset(stats, 0, sizeof(*stats));
+        emit_insert(&out, new_img, new_len, stats);
+        put_byte(&out, DELTA_OP_END);
+    }
+
+    free(index.head);
+    free(index.prev);
+    if (out.failed)
+    {
+        free(out.data);
+        return ESP_ERR_NO_MEM;
+    }
+    *patch = out.data;
+    *patch_len = out.len;
+    return ESP_OK;
+}
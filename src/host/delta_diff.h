@@ -0,0 +1,42 @@
+#ifndef _DELTA_DIFF_H
+#define _DELTA_DIFF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "delta_patch.h"
+
+/* Patch generator for main/delta_patch.h, host side.
+ *
+ * Greedy, in the spirit of bsdiff without its suffix sort: the old image is
+ * indexed by hashes of DELTA_DIFF_KEY_LEN bytes, and the new one is scanned
+ * for a seed, either an exact match of at least DELTA_DIFF_MIN_MATCH bytes
+ * anywhere in the old image, or the alignment of the previous COPY still
+ * matching mostly (code after an insertion). A seed grows both ways as long
+ * as matches outweigh mismatches, so relocated call offsets and pointers
+ * stay inside the COPY as small adds instead of breaking it up; what no
+ * seed covers goes in as INSERT. A patch that comes out bigger than the new
+ * image as one INSERT (an unrelated image) is replaced by that, so no patch
+ * is more than DELTA_DIFF_MAX_OVERHEAD bytes bigger than the image. */
+
+#define DELTA_DIFF_KEY_LEN                  8
+#define DELTA_DIFF_MIN_MATCH                12
+#define DELTA_DIFF_CHAIN                    32                  /* candidates tried per position */
+#define DELTA_DIFF_ALIGN_PROBE              16                  /* bytes compared at the previous alignment ... */
+#define DELTA_DIFF_ALIGN_MATCHES            12                  /* ... and how many have to match */
+#define DELTA_DIFF_GIVE_UP                  32                  /* extension stops this far below its best score */
+#define DELTA_DIFF_MAX_OVERHEAD             (DELTA_PATCH_HEADER_LEN + 1 + 5 + 1)    /* header, INSERT and its length, END */
+
+typedef struct delta_diff_stats {
+    uint32_t copies;
+    uint32_t inserts;
+    uint32_t copied;                    /* new image bytes covered by COPY */
+    uint32_t literals;                  /* of those, not equal to the old byte */
+    uint32_t inserted;
+} delta_diff_stats_t;
+
+/* *patch is malloc()ed, free() it; stats may be NULL */
+esp_err_t delta_diff(const uint8_t *old, size_t old_len, const uint8_t *new_img, size_t new_len,
+                     uint8_t **patch, size_t *patch_len, delta_diff_stats_t *stats);
+
+#endif /* _DELTA_DIFF_H */
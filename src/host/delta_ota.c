@@ -0,0 +1,798 @@
+/* Delta OTA tool: makes patches (host/delta_diff.c), applies them the way
+ * the device does (main/delta_patch.c against simulated flash) and serves
+ * them to devices (main/ota_update.c).
+ *
+ * usage: delta_ota [-k image_kb] [-r link_kbps] [-c max_chunk] [-v]
+ *        delta_ota diff old.bin new.bin patch.bin
+ *        delta_ota apply old.bin patch.bin new.bin
+ *        delta_ota serve old.bin new.bin [port]
+ *
+ * Without a command it runs on synthetic firmware images: -k KB of
+ * functions with PC-relative calls and literal pools of absolute addresses,
+ * and versions of it with one function edited, one function grown (which
+ * shifts and relocates everything after it), a feature added, a quarter of
+ * the code rewritten, and an unrelated image. For each it prints the patch
+ * size against the full image, the time to send either over a -r kbit/s
+ * link, the diff and apply time on this host, the flash work (sectors
+ * erased, pages written, with typical SPI NOR timings) and the applier's
+ * RAM. The patch goes in as chunks of random size up to -c bytes, like TCP
+ * segments.
+ *
+ * An edit in place costs next to nothing. Anything that moves code costs
+ * a few bytes per call and pointer that crosses the move (every relocated
+ * reference is a short literal run), which is why "function grown" is
+ * around a seventh of the image: bsdiff would squeeze those adds with
+ * bzip2, the device has no room for the decompressor.
+ *
+ * Checks (non-zero exit on failure): SHA-256 test vectors; every patch
+ * rebuilds its image exactly, writes the target slot strictly in order and
+ * never touches the running one; the applier fits DELTA_OTA_RAM_MAX; patches
+ * stay under a bound per scenario and never more than DELTA_DIFF_MAX_OVERHEAD
+ * bytes over their image; a patch for another image is refused
+ * before anything is erased; a corrupted, truncated or overlong patch is
+ * refused; and the trial boot record (main/ota_trial.c) confirms a good
+ * image, rolls a crashing one back after OTA_TRIAL_BOOTS boots and refuses
+ * that image afterwards. */
+
+/* Toolchain headers */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* local headers */
+#include "delta_diff.h"
+#include "delta_patch.h"
+#include "ota_trial.h"
+#include "ota_update.h"
+#include "sha256.h"
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); s_failures++; } } while (0)
+
+#define DELTA_OTA_RAM_MAX                   (5 * 1024)          /* applier state, the device allocates it per update */
+#define FLASH_SLOT_SIZE                     0xF0000             /* partitions.csv */
+#define FLASH_PAGE_SIZE                     256
+#define FLASH_ERASE_MS                      45.0                /* 4 KB sector, typical 25Q16 */
+#define FLASH_PAGE_MS                       0.7                 /* 256 byte program */
+#define FW_BASE_ADDR                        0x40210000          /* where the ESP8266 maps the app */
+
+/* one app slot being written, next to the running one */
+typedef struct flash_sim {
+    uint8_t *running;                   /* the image, erased flash after it */
+    uint8_t *slot;
+    uint8_t *erased;                    /* per sector */
+    uint32_t next;                      /* writes have to come in order */
+    uint32_t erases;
+    uint32_t pages;
+    uint32_t reads;
+    uint32_t violations;
+} flash_sim_t;
+
+/* synthetic firmware: functions calling each other, strings */
+typedef struct fw_func {
+    uint32_t seed;
+    uint32_t len;
+    uint32_t variant;                   /* > 0: a few bytes edited */
+} fw_func_t;
+
+typedef struct fw_image {
+    fw_func_t *funcs;
+    size_t nfuncs;
+    uint32_t strings_seed;
+    uint32_t strings_len;
+    char build[32];
+} fw_image_t;
+
+static unsigned s_failures;
+static int s_verbose;
+
+/* ====================================
+ * ========= simulated flash ==========
+ * ==================================== */
+
+static void flash_init(flash_sim_t *flash, const uint8_t *running, size_t running_len)
+{
+    size_t i;
+
+    memset(flash, 0, sizeof(*flash));
+    flash->running = malloc(FLASH_SLOT_SIZE);
+    memset(flash->running, 0xFF, FLASH_SLOT_SIZE);
+    memcpy(flash->running, running, running_len);
+    flash->slot = malloc(FLASH_SLOT_SIZE);
+    flash->erased = calloc(FLASH_SLOT_SIZE / DELTA_PATCH_SECTOR_SIZE, 1);
+    /* whatever the slot held before */
+    for (i = 0; i < FLASH_SLOT_SIZE; i++)
+    {
+        flash->slot[i] = (uint8_t)(i * 131 + 7);
+    }
+}
+
+static void flash_free(flash_sim_t *flash)
+{
+    free(flash->running);
+    free(flash->slot);
+    free(flash->erased);
+}
+
+static esp_err_t flash_read_old(void *ctx, uint32_t offset, void *buf, size_t len)
+{
+    flash_sim_t *flash = (flash_sim_t *)ctx;
+
+    if (offset > FLASH_SLOT_SIZE || len > FLASH_SLOT_SIZE - offset)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(buf, &flash->running[offset], len);
+    flash->reads++;
+    return ESP_OK;
+}
+
+/* what esp_ota_write() does: erase a sector when the data reaches it, then program */
+static esp_err_t flash_write_new(void *ctx, uint32_t offset, const void *buf, size_t len)
+{
+    flash_sim_t *flash = (flash_sim_t *)ctx;
+    const uint8_t *data = (const uint8_t *)buf;
+    uint32_t sector, i;
+
+    if (offset != flash->next || len > FLASH_SLOT_SIZE - offset)
+    {
+        flash->violations++;
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (sector = offset / DELTA_PATCH_SECTOR_SIZE; sector <= (offset + len - 1) / DELTA_PATCH_SECTOR_SIZE; sector++)
+    {
+        if (!flash->erased[sector])
+        {
+            memset(&flash->slot[sector * DELTA_PATCH_SECTOR_SIZE], 0xFF, DELTA_PATCH_SECTOR_SIZE);
+            flash->erased[sector] = 1;
+            flash->erases++;
+        }
+    }
+    for (i = 0; i < len; i++)
+    {
+        /* NOR flash only clears bits */
+        if ((flash->slot[offset + i] & data[i]) != data[i])
+        {
+            flash->violations++;
+        }
+        flash->slot[offset + i] &= data[i];
+    }
+    flash->pages += (uint32_t)((len + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE);
+    flash->next += (uint32_t)len;
+    return ESP_OK;
+}
+
+static double flash_ms(const flash_sim_t *flash)
+{
+    return flash->erases * FLASH_ERASE_MS + flash->pages * FLASH_PAGE_MS;
+}
+
+/* the patch in chunks of 1..max_chunk bytes; the result of finish(), or
+ * of the first feed that failed */
+static esp_err_t apply(flash_sim_t *flash, const uint8_t *patch_data, size_t patch_len, size_t max_chunk,
+                       unsigned *seed, delta_patch_t *patch)
+{
+    const delta_patch_io_t io = { .ctx = flash, .read_old = flash_read_old, .write_new = flash_write_new };
+    size_t off = 0, n;
+    esp_err_t err;
+
+    delta_patch_init(patch, &io);
+    while (off < patch_len)
+    {
+        n = 1 + (size_t)rand_r(seed) % max_chunk;
+        if (n > patch_len - off)
+        {
+            n = patch_len - off;
+        }
+        if ((err = delta_patch_feed(patch, &patch_data[off], n)) != ESP_OK)
+        {
+            return err;
+        }
+        off += n;
+    }
+    return delta_patch_finish(patch);
+}
+
+/* ====================================
+ * ======== synthetic firmware ========
+ * ==================================== */
+
+static uint32_t fw_rand(uint32_t *state)
+{
+    *state = *state * 1664525 + 1013904223;
+    return *state >> 8;
+}
+
+static uint32_t fw_func_addr(const fw_image_t *fw, size_t k)
+{
+    uint32_t addr = 0;
+    size_t i;
+
+    for (i = 0; i < k; i++)
+    {
+        addr += (fw->funcs[i].len + 3) & ~3u;
+    }
+    return addr;
+}
+
+/* Function bodies are instruction-like bytes with a 3 byte call every
+ * ~20 bytes (offset to the callee, relative to the call) and a literal pool
+ * of absolute addresses at the end, into the strings and other functions.
+ * Moving anything changes those, like a relink does. */
+static size_t fw_render(const fw_image_t *fw, uint8_t *out, size_t cap)
+{
+    static const uint8_t opcodes[] = { 0x0c, 0x1c, 0x20, 0x22, 0x26, 0x29, 0x31, 0x38, 0x41, 0x42, 0x52, 0x62,
+                                       0x66, 0x76, 0x82, 0x88, 0x91, 0xa0, 0xa2, 0xc0, 0xc8, 0xd0, 0xe0, 0xf0 };
+    uint32_t strings_at = fw_func_addr(fw, fw->nfuncs);
+    uint32_t addr, rs, vs, target, pool, i, j, len;
+    size_t k, total = strings_at + fw->strings_len;
+    int32_t rel;
+
+    if (total > cap)
+    {
+        return 0;
+    }
+    for (k = 0, addr = 0; k < fw->nfuncs; k++)
+    {
+        rs = fw->funcs[k].seed;
+        len = fw->funcs[k].len;
+        pool = len / 8 & ~3u;
+        for (i = 0; i + pool < len; i++)
+        {
+            if (i % 20 == 17 && i + 3 + pool <= len)
+            {
+                /* call: opcode and an 18 bit word offset */
+                target = fw_func_addr(fw, fw_rand(&rs) % fw->nfuncs);
+                rel = ((int32_t)target - (int32_t)(addr + i)) >> 2;
+                out[addr + i] = (uint8_t)(0x05 | (rel & 3) << 6);
+                out[addr + i + 1] = (uint8_t)(rel >> 2);
+                out[addr + i + 2] = (uint8_t)(rel >> 10);
+                i += 2;
+                continue;
+            }
+            out[addr + i] = opcodes[fw_rand(&rs) % sizeof(opcodes)] ^ (uint8_t)(fw_rand(&rs) % 4 == 0 ? fw_rand(&rs) : 0);
+        }
+        for (j = 0; j < pool; j += 4)
+        {
+            target = (fw_rand(&rs) % 2) ? strings_at + fw_rand(&rs) % (fw->strings_len ? fw->strings_len : 1)
+                                        : fw_func_addr(fw, fw_rand(&rs) % fw->nfuncs);
+            target += FW_BASE_ADDR;
+            memcpy(&out[addr + len - pool + j], &target, 4);
+        }
+        if (fw->funcs[k].variant)
+        {
+            /* an edited function: a handful of instructions changed */
+            vs = fw->funcs[k].seed ^ (fw->funcs[k].variant * 0x9E3779B9);
+            for (j = 0; j < 8; j++)
+            {
+                out[addr + fw_rand(&vs) % (len - pool)] ^= (uint8_t)(1 + fw_rand(&vs) % 255);
+            }
+        }
+        for (i = len; i < ((len + 3) & ~3u); i++)
+        {
+            out[addr + i] = 0;
+        }
+        addr += (len + 3) & ~3u;
+    }
+    /* strings: text, with the build stamp first */
+    rs = fw->strings_seed;
+    for (i = 0; i < fw->strings_len; i++)
+    {
+        out[strings_at + i] = (fw_rand(&rs) % 12 == 0) ? 0 : (uint8_t)('a' + fw_rand(&rs) % 26);
+    }
+    memcpy(&out[strings_at], fw->build, strlen(fw->build));
+    return total;
+}
+
+static void fw_generate(fw_image_t *fw, size_t kb, uint32_t seed)
+{
+    uint32_t rs = seed, bytes = 0;
+
+    memset(fw, 0, sizeof(*fw));
+    fw->funcs = malloc(sizeof(fw_func_t) * (kb * 1024 / 64 + 16));
+    fw->strings_seed = fw_rand(&rs);
+    fw->strings_len = (uint32_t)(kb * 1024 / 8);
+    snprintf(fw->build, sizeof(fw->build), "v1.0.0 2026-10-01 08:00:00");
+    while (bytes + fw->strings_len < kb * 1024)
+    {
+        fw->funcs[fw->nfuncs].seed = fw_rand(&rs);
+        fw->funcs[fw->nfuncs].len = 40 + fw_rand(&rs) % 600;
+        fw->funcs[fw->nfuncs].variant = 0;
+        bytes += (fw->funcs[fw->nfuncs].len + 3) & ~3u;
+        fw->nfuncs++;
+    }
+}
+
+static void fw_copy(fw_image_t *dst, const fw_image_t *src, size_t extra)
+{
+    *dst = *src;
+    dst->funcs = malloc(sizeof(fw_func_t) * (src->nfuncs + extra));
+    memcpy(dst->funcs, src->funcs, sizeof(fw_func_t) * src->nfuncs);
+    snprintf(dst->build, sizeof(dst->build), "v1.0.1 2026-10-16 12:00:00");
+}
+
+static void fw_insert(fw_image_t *fw, size_t at, uint32_t seed, uint32_t len)
+{
+    memmove(&fw->funcs[at + 1], &fw->funcs[at], sizeof(fw_func_t) * (fw->nfuncs - at));
+    fw->funcs[at].seed = seed;
+    fw->funcs[at].len = len;
+    fw->funcs[at].variant = 0;
+    fw->nfuncs++;
+}
+
+/* ====================================
+ * ============= commands =============
+ * ==================================== */
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *data = NULL;
+    long size;
+
+    if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0
+        || (data = malloc(size ? (size_t)size : 1)) == NULL || fread(data, 1, (size_t)size, f) != (size_t)size)
+    {
+        fprintf(stderr, "delta_ota: can't read %s\n", path);
+        free(data);
+        data = NULL;
+    }
+    else
+    {
+        *len = (size_t)size;
+    }
+    if (f != NULL)
+    {
+        fclose(f);
+    }
+    return data;
+}
+
+static int write_file(const char *path, const uint8_t *data, size_t len)
+{
+    FILE *f = fopen(path, "wb");
+    int ok = f != NULL && fwrite(data, 1, len, f) == len;
+
+    if (f == NULL || fclose(f) != 0 || !ok)
+    {
+        fprintf(stderr, "delta_ota: can't write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int cmd_diff(const char *old_path, const char *new_path, const char *patch_path)
+{
+    uint8_t *old, *new_img, *patch = NULL;
+    size_t old_len, new_len, patch_len;
+    delta_diff_stats_t stats;
+    double t0;
+    int ret;
+
+    if ((old = read_file(old_path, &old_len)) == NULL || (new_img = read_file(new_path, &new_len)) == NULL)
+    {
+        return 1;
+    }
+    t0 = now_ms();
+    if (delta_diff(old, old_len, new_img, new_len, &patch, &patch_len, &stats) != ESP_OK)
+    {
+        fprintf(stderr, "delta_ota: diff failed\n");
+        return 1;
+    }
+    printf("%zu -> %zu bytes: patch %zu bytes (%.1f %%) in %.0f ms, %u copies (%u bytes, %u differing), "
+           "%u inserts (%u bytes)\n", old_len, new_len, patch_len, 100.0 * patch_len / (new_len ? new_len : 1),
+           now_ms() - t0, stats.copies, stats.copied, stats.literals, stats.inserts, stats.inserted);
+    ret = write_file(patch_path, patch, patch_len) ? 1 : 0;
+    free(old);
+    free(new_img);
+    free(patch);
+    return ret;
+}
+
+static int cmd_apply(const char *old_path, const char *patch_path, const char *new_path)
+{
+    static delta_patch_t patch;
+    uint8_t *old, *data;
+    size_t old_len, patch_len;
+    flash_sim_t flash;
+    unsigned seed = 1;
+    esp_err_t err;
+    double t0;
+    int ret = 1;
+
+    if ((old = read_file(old_path, &old_len)) == NULL || (data = read_file(patch_path, &patch_len)) == NULL)
+    {
+        return 1;
+    }
+    if (old_len > FLASH_SLOT_SIZE)
+    {
+        fprintf(stderr, "delta_ota: %s doesn't fit a %u byte slot\n", old_path, FLASH_SLOT_SIZE);
+        return 1;
+    }
+    flash_init(&flash, old, old_len);
+    t0 = now_ms();
+    err = apply(&flash, data, patch_len, OTA_RECV_CHUNK, &seed, &patch);
+    if (err != ESP_OK)
+    {
+        fprintf(stderr, "delta_ota: patch refused, error 0x%X\n", err);
+    }
+    else
+    {
+        printf("%zu byte patch -> %u byte image in %.1f ms, %u sectors erased, %u pages (%.0f ms of flash), "
+               "%zu bytes of RAM\n", patch_len, patch.new_len, now_ms() - t0, flash.erases, flash.pages,
+               flash_ms(&flash), sizeof(delta_patch_t));
+        ret = write_file(new_path, flash.slot, patch.new_len) ? 1 : 0;
+    }
+    flash_free(&flash);
+    free(old);
+    free(data);
+    return ret;
+}
+
+/* one patch for every device that asks, see main/ota_update.h */
+static int cmd_serve(const char *old_path, const char *new_path, int port)
+{
+    uint8_t *old, *new_img, *patch = NULL;
+    uint8_t request[OTA_REQUEST_LEN], len_be[4];
+    size_t old_len, new_len, patch_len;
+    struct sockaddr_in addr;
+    int sock, conn, one = 1;
+
+    if ((old = read_file(old_path, &old_len)) == NULL || (new_img = read_file(new_path, &new_len)) == NULL
+        || delta_diff(old, old_len, new_img, new_len, &patch, &patch_len, NULL) != ESP_OK)
+    {
+        return 1;
+    }
+    len_be[0] = (uint8_t)(patch_len >> 24);
+    len_be[1] = (uint8_t)(patch_len >> 16);
+    len_be[2] = (uint8_t)(patch_len >> 8);
+    len_be[3] = (uint8_t)patch_len;
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 8) < 0)
+    {
+        perror("delta_ota: listen");
+        return 1;
+    }
+    printf("delta_ota: serving a %zu byte patch (%zu -> %zu bytes) on tcp port %d\n", patch_len, old_len, new_len,
+           port);
+    fflush(stdout);
+
+    while ((conn = accept(sock, NULL, NULL)) >= 0)
+    {
+        if (recv(conn, request, sizeof(request), MSG_WAITALL) == sizeof(request)
+            && ((request[0] << 8) | request[1]) == OTA_REQUEST_MAGIC && request[2] == OTA_REQUEST_VERSION)
+        {
+            printf("%02x:%02x:%02x:%02x:%02x:%02x asked\n", request[3], request[4], request[5], request[6],
+                   request[7], request[8]);
+            fflush(stdout);
+            /* the device hangs up early if the patch isn't for its image */
+            send(conn, len_be, sizeof(len_be), MSG_NOSIGNAL);
+            send(conn, patch, patch_len, MSG_NOSIGNAL);
+        }
+        close(conn);
+    }
+    return 0;
+}
+
+/* ====================================
+ * ============ self test =============
+ * ==================================== */
+
+static void check_sha256(void)
+{
+    static const struct {
+        const char *msg;
+        const char *hex;
+    } vectors[] = {
+        { "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    };
+    uint8_t digest[SHA256_LEN];
+    char hex[2 * SHA256_LEN + 1];
+    sha256_t hash;
+    size_t k, i, len;
+
+    for (k = 0; k < sizeof(vectors) / sizeof(vectors[0]); k++)
+    {
+        /* fed unevenly, across block boundaries */
+        len = strlen(vectors[k].msg);
+        sha256_init(&hash);
+        for (i = 0; i < len; i += 7)
+        {
+            sha256_update(&hash, &vectors[k].msg[i], len - i < 7 ? len - i : 7);
+        }
+        sha256_final(&hash, digest);
+        for (i = 0; i < SHA256_LEN; i++)
+        {
+            sprintf(&hex[2 * i], "%02x", digest[i]);
+        }
+        CHECK(strcmp(hex, vectors[k].hex) == 0, "sha256(\"%s\") = %s", vectors[k].msg, hex);
+    }
+}
+
+static void check_trial(void)
+{
+    ota_trial_t trial;
+    uint8_t good_hash[SHA256_LEN], bad_hash[SHA256_LEN];
+    int boot;
+
+    memset(good_hash, 0x11, sizeof(good_hash));
+    memset(bad_hash, 0x22, sizeof(bad_hash));
+
+    /* nothing stored: run */
+    memset(&trial, 0xA5, sizeof(trial));
+    CHECK(ota_trial_boot(&trial, 0x10000) == OTA_TRIAL_RUN && trial.state == OTA_TRIAL_NONE, "garbage record acted on");
+
+    /* a good image: probation, confirmed, stays */
+    CHECK(!ota_trial_rejected(&trial, good_hash), "image rejected before any trial");
+    ota_trial_start(&trial, 0x10000, 0x110000, good_hash);
+    CHECK(ota_trial_boot(&trial, 0x110000) == OTA_TRIAL_RUN, "first trial boot rolled back");
+    CHECK(ota_trial_confirm(&trial) && !ota_trial_confirm(&trial), "confirm didn't change the record exactly once");
+    for (boot = 0; boot < 2 * OTA_TRIAL_BOOTS; boot++)
+    {
+        CHECK(ota_trial_boot(&trial, 0x110000) == OTA_TRIAL_RUN, "confirmed image rolled back");
+    }
+
+    /* a crashing image: OTA_TRIAL_BOOTS tries, then back, and the old one runs for good */
+    ota_trial_start(&trial, 0x110000, 0x10000, bad_hash);
+    for (boot = 1; boot <= OTA_TRIAL_BOOTS; boot++)
+    {
+        CHECK(ota_trial_boot(&trial, 0x10000) == OTA_TRIAL_RUN, "rolled back after %d boots", boot);
+    }
+    CHECK(ota_trial_boot(&trial, 0x10000) == OTA_TRIAL_ROLLBACK && trial.rollbacks == 1, "no rollback after %d boots",
+          OTA_TRIAL_BOOTS + 1);
+    CHECK(ota_trial_boot(&trial, 0x110000) == OTA_TRIAL_RUN && trial.state == OTA_TRIAL_NONE,
+          "old image on probation after the rollback");
+    /* and the same image isn't applied again, a fixed one is */
+    CHECK(ota_trial_rejected(&trial, bad_hash), "rolled back image offered again");
+    CHECK(!ota_trial_rejected(&trial, good_hash), "image that passed its trial rejected");
+
+    /* the switch to the new slot never happened */
+    ota_trial_start(&trial, 0x10000, 0x110000, good_hash);
+    CHECK(ota_trial_boot(&trial, 0x10000) == OTA_TRIAL_RUN && trial.state == OTA_TRIAL_NONE,
+          "trial kept on the old slot");
+}
+
+/* patches that must not produce a bootable image */
+static void check_refusals(const uint8_t *old, size_t old_len, const uint8_t *new_img, size_t new_len,
+                           const uint8_t *patch_data, size_t patch_len, size_t max_chunk)
+{
+    static delta_patch_t patch;
+    uint8_t *bad = malloc(patch_len + 16);
+    flash_sim_t flash;
+    unsigned seed = 7;
+    esp_err_t err;
+    size_t at;
+
+    /* for another image: refused on the header, nothing erased */
+    flash_init(&flash, new_img, new_len);
+    err = apply(&flash, patch_data, patch_len, max_chunk, &seed, &patch);
+    CHECK(err == ESP_ERR_INVALID_VERSION && flash.erases == 0, "patch on the wrong image: 0x%X, %u sectors erased",
+          err, flash.erases);
+    flash_free(&flash);
+
+    /* flipped bytes all over the op stream */
+    for (at = DELTA_PATCH_HEADER_LEN; at < patch_len; at += patch_len / 16 + 1)
+    {
+        memcpy(bad, patch_data, patch_len);
+        bad[at] ^= 0x5A;
+        flash_init(&flash, old, old_len);
+        err = apply(&flash, bad, patch_len, max_chunk, &seed, &patch);
+        CHECK(err != ESP_OK, "byte %zu of the patch corrupted and it still applied", at);
+        CHECK(flash.violations == 0, "corrupted patch wrote out of order");
+        flash_free(&flash);
+    }
+
+    /* truncated, and with something after END */
+    flash_init(&flash, old, old_len);
+    err = apply(&flash, patch_data, patch_len - 1, max_chunk, &seed, &patch);
+    CHECK(err == ESP_ERR_INVALID_SIZE, "truncated patch: 0x%X", err);
+    flash_free(&flash);
+    memcpy(bad, patch_data, patch_len);
+    bad[patch_len] = 0;
+    flash_init(&flash, old, old_len);
+    err = apply(&flash, bad, patch_len + 1, max_chunk, &seed, &patch);
+    CHECK(err == ESP_ERR_INVALID_SIZE, "patch with trailing bytes: 0x%X", err);
+    flash_free(&flash);
+    free(bad);
+}
+
+static void run_scenario(const char *name, const uint8_t *old, size_t old_len, const uint8_t *new_img,
+                         size_t new_len, double max_pct, double link_kbps, size_t max_chunk, int refusals)
+{
+    static delta_patch_t patch;
+    uint8_t *patch_data = NULL;
+    size_t patch_len = 0;
+    delta_diff_stats_t stats;
+    flash_sim_t flash;
+    unsigned seed = 1;
+    double t0, diff_ms, apply_ms;
+    uint8_t digest[SHA256_LEN];
+    sha256_t hash;
+    esp_err_t err;
+
+    t0 = now_ms();
+    err = delta_diff(old, old_len, new_img, new_len, &patch_data, &patch_len, &stats);
+    diff_ms = now_ms() - t0;
+    CHECK(err == ESP_OK, "%s: diff failed", name);
+    if (err != ESP_OK)
+    {
+        return;
+    }
+
+    flash_init(&flash, old, old_len);
+    t0 = now_ms();
+    err = apply(&flash, patch_data, patch_len, max_chunk, &seed, &patch);
+    apply_ms = now_ms() - t0;
+    CHECK(err == ESP_OK, "%s: apply failed, 0x%X", name, err);
+    CHECK(err != ESP_OK || memcmp(flash.slot, new_img, new_len) == 0, "%s: image differs after applying", name);
+    CHECK(flash.violations == 0, "%s: %u flash writes out of order or over unerased bytes", name, flash.violations);
+    /* what ota_update.c records for the trial and checks against a rolled back image */
+    sha256_init(&hash);
+    sha256_update(&hash, new_img, new_len);
+    sha256_final(&hash, digest);
+    CHECK(memcmp(delta_patch_new_hash(&patch), digest, SHA256_LEN) == 0, "%s: patch names the wrong new image", name);
+    CHECK(patch_len <= new_len + DELTA_DIFF_MAX_OVERHEAD, "%s: patch is %zu bytes over the image", name,
+          patch_len - new_len);
+    CHECK(100.0 * patch_len / new_len <= max_pct, "%s: patch is %.1f %% of the image, over %.0f %%", name,
+          100.0 * patch_len / new_len, max_pct);
+
+    printf("%-18s %7zu %7zu %5.1f %% %7.1f %7.1f %7.0f %7.1f %7u %7u %8.0f\n", name, new_len, patch_len,
+           100.0 * patch_len / new_len, new_len * 8.0 / link_kbps, patch_len * 8.0 / link_kbps, diff_ms, apply_ms,
+           flash.erases, flash.pages, flash_ms(&flash));
+    if (s_verbose)
+    {
+        printf("    %u copies (%u bytes, %u differing), %u inserts (%u bytes), %u ops, %u old reads\n", stats.copies,
+               stats.copied, stats.literals, stats.inserts, stats.inserted, patch.ops, flash.reads);
+    }
+    flash_free(&flash);
+
+    if (refusals)
+    {
+        check_refusals(old, old_len, new_img, new_len, patch_data, patch_len, max_chunk);
+    }
+    free(patch_data);
+}
+
+static int self_test(size_t kb, double link_kbps, size_t max_chunk)
+{
+    fw_image_t base, v;
+    uint8_t *old = malloc(FLASH_SLOT_SIZE), *new_img = malloc(FLASH_SLOT_SIZE);
+    size_t old_len, new_len, k;
+    uint32_t rs = 99;
+
+    check_sha256();
+    check_trial();
+    CHECK(sizeof(delta_patch_t) <= DELTA_OTA_RAM_MAX, "applier needs %zu bytes of RAM", sizeof(delta_patch_t));
+
+    fw_generate(&base, kb, 1);
+    old_len = fw_render(&base, old, FLASH_SLOT_SIZE);
+    CHECK(old_len > 0, "%zu KB image doesn't fit a %u byte slot", kb, FLASH_SLOT_SIZE);
+    if (old_len == 0)
+    {
+        return 1;
+    }
+    printf("image %zu bytes, %zu functions; applier RAM %zu bytes; link %.0f kbit/s, chunks up to %zu bytes\n",
+           old_len, base.nfuncs, sizeof(delta_patch_t), link_kbps, max_chunk);
+    printf("%-18s %7s %7s %7s %7s %7s %7s %7s %7s %7s %8s\n", "", "image", "patch", "", "full s", "patch s",
+           "diff ms", "appl ms", "erases", "pages", "flash ms");
+
+    fw_copy(&v, &base, 0);
+    new_len = fw_render(&v, new_img, FLASH_SLOT_SIZE);
+    run_scenario("rebuild", old, old_len, new_img, new_len, 1, link_kbps, max_chunk, 0);
+    free(v.funcs);
+
+    fw_copy(&v, &base, 0);
+    v.funcs[v.nfuncs / 2].variant = 1;
+    new_len = fw_render(&v, new_img, FLASH_SLOT_SIZE);
+    run_scenario("function edited", old, old_len, new_img, new_len, 1, link_kbps, max_chunk, 0);
+    free(v.funcs);
+
+    fw_copy(&v, &base, 0);
+    v.funcs[v.nfuncs / 3].len += 120;
+    new_len = fw_render(&v, new_img, FLASH_SLOT_SIZE);
+    run_scenario("function grown", old, old_len, new_img, new_len, 20, link_kbps, max_chunk, 0);
+    free(v.funcs);
+
+    fw_copy(&v, &base, 8);
+    for (k = 0; k < 8; k++)
+    {
+        fw_insert(&v, v.nfuncs / 2 + k, 1000 + (uint32_t)k, 300 + 50 * (uint32_t)k);
+    }
+    for (k = 0; k < 5; k++)
+    {
+        v.funcs[fw_rand(&rs) % v.nfuncs].variant = 1;
+    }
+    v.strings_len += 200;
+    new_len = fw_render(&v, new_img, FLASH_SLOT_SIZE);
+    run_scenario("feature added", old, old_len, new_img, new_len, 35, link_kbps, max_chunk, 1);
+    free(v.funcs);
+
+    fw_copy(&v, &base, 0);
+    for (k = 0; k < v.nfuncs / 4; k++)
+    {
+        v.funcs[fw_rand(&rs) % v.nfuncs].seed ^= 0xDEADBEEF;
+    }
+    new_len = fw_render(&v, new_img, FLASH_SLOT_SIZE);
+    run_scenario("quarter rewritten", old, old_len, new_img, new_len, 30, link_kbps, max_chunk, 0);
+    free(v.funcs);
+
+    fw_generate(&v, kb, 2);
+    new_len = fw_render(&v, new_img, FLASH_SLOT_SIZE);
+    run_scenario("unrelated", old, old_len, new_img, new_len, 101, link_kbps, max_chunk, 0);
+    free(v.funcs);
+
+    free(base.funcs);
+    free(old);
+    free(new_img);
+    if (s_failures)
+    {
+        printf("delta_ota: %u checks failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t kb = 400, max_chunk = OTA_RECV_CHUNK;
+    double link_kbps = 1000;
+    int opt;
+
+    if (argc >= 5 && strcmp(argv[1], "diff") == 0)
+    {
+        return cmd_diff(argv[2], argv[3], argv[4]);
+    }
+    if (argc >= 5 && strcmp(argv[1], "apply") == 0)
+    {
+        return cmd_apply(argv[2], argv[3], argv[4]);
+    }
+    if (argc >= 4 && strcmp(argv[1], "serve") == 0)
+    {
+        return cmd_serve(argv[2], argv[3], argc >= 5 ? atoi(argv[4]) : OTA_SERVER_PORT);
+    }
+
+    while ((opt = getopt(argc, argv, "k:r:c:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'k': kb = strtoul(optarg, NULL, 0); break;
+            case 'r': link_kbps = atof(optarg); break;
+            case 'c': max_chunk = strtoul(optarg, NULL, 0); break;
+            case 'v': s_verbose = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-k image_kb] [-r link_kbps] [-c max_chunk] [-v]\n"
+                                "       %s diff old.bin new.bin patch.bin\n"
+                                "       %s apply old.bin patch.bin new.bin\n"
+                                "       %s serve old.bin new.bin [port]\n", argv[0], argv[0], argv[0], argv[0]);
+                return 2;
+        }
+    }
+    if (max_chunk == 0 || link_kbps <= 0)
+    {
+        fprintf(stderr, "delta_ota: -c and -r have to be positive\n");
+        return 2;
+    }
+    return self_test(kb, link_kbps, max_chunk);
+}
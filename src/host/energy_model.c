@@ -0,0 +1,282 @@
+/* Energy model for the deep sleep mode (main/deep_sleep.c).
+ *
+ * usage: energy_model [-p period_s] [-c flush_count] [-a flush_age_s]
+ *                     [-d days] [-f fail_pct] [-B battery_mAh]
+ *                     [-S sleep_uA] [-M mcu_mA] [-R radio_mA]
+ *                     [-b boot_ms] [-w connect_ms] [-x tx_ms] [-A always_on_mA]
+ *
+ * Replays the wake/sleep timeline on a virtual clock: every wake boots,
+ * runs one conversion through the real measurement engine against the
+ * simulated AHT10, and hands the sample to the real rtc_store policy, which
+ * decides whether this wake brings up the radio. Charge is integrated per
+ * phase with the configured currents. Without -p/-c/-a it sweeps a grid of
+ * sampling periods and flush thresholds; with them it prints a breakdown of
+ * that one policy. Either way the always-on firmware is the reference.
+ *
+ * The store goes through its RTC word image between wakes, like on the
+ * device; a copy that comes back invalid stops the run with exit code 1. */
+
+/* Toolchain headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* local headers */
+#include "aht10_i2c.h"
+#include "aht10_meas.h"
+#include "aht10_sim.h"
+#include "deep_sleep.h"
+#include "rtc_store.h"
+#include "upload_frame.h"
+
+/* defaults, ESP8266 datasheet figures and what wifi_conn_sim measures */
+typedef struct energy_config {
+    double sleep_ua;                    /* deep sleep, RTC only */
+    double mcu_ma;                      /* CPU running, RF off */
+    double radio_ma;                    /* average with the radio up (RX mostly, TX bursts) */
+    double always_on_ma;                /* the always-on firmware, associated with modem sleep */
+    uint32_t boot_ms;                   /* ROM + bootloader + app start */
+    uint32_t rf_cal_ms;                 /* extra on wakes that power the RF up */
+    uint32_t connect_ms;                /* fast reconnect to link up */
+    uint32_t tx_ms;                     /* per frame, send and let it drain */
+    uint32_t fail_pct;                  /* share of flush attempts where the AP is unreachable */
+    double battery_mah;
+    uint32_t days;
+} energy_config_t;
+
+typedef struct energy_result {
+    double mcu_mas;                     /* charge per phase, mA*s */
+    double radio_mas;
+    double sleep_mas;
+    double seconds;
+    uint32_t wakes;
+    uint32_t flushes;
+    uint32_t failed_flushes;
+    uint32_t frames;
+    uint32_t dropped;
+    uint32_t max_age_ms;                /* oldest a sample got before it was uploaded */
+} energy_result_t;
+
+static double avg_ma(const energy_result_t *r)
+{
+    return (r->mcu_mas + r->radio_mas + r->sleep_mas) / r->seconds;
+}
+
+static void simulate(const energy_config_t *cfg, const rtc_store_policy_t *policy, energy_result_t *r)
+{
+    static rtc_store_t store;
+    static uint32_t rtc[RTC_STORE_WORDS];
+    aht10_sim_config_t sim_cfg;
+    aht10_sim_t sim;
+    const aht10_hal_t *hal;
+    aht10_meas_t meas;
+    aht10_reading_t reading;
+    aht10_sample_t sample;
+    uint64_t end_ms = (uint64_t)cfg->days * 24 * 60 * 60 * 1000;
+    uint64_t t_ms = 0;
+    uint32_t awake_ms, radio_ms, next_ms, meas_ms, frames, age;
+    unsigned seed = 1;
+    int rf_on = 1;                      /* the first boot always calibrates */
+    int ok;
+
+    aht10_sim_default_config(&sim_cfg);
+    aht10_sim_init(&sim, &sim_cfg);
+    hal = aht10_sim_hal(&sim);
+    rtc_store_init(&store);
+    rtc_store_save(&store, rtc);
+
+    *r = (energy_result_t){ 0 };
+    while (t_ms < end_ms)
+    {
+        rtc_store_load(&store, rtc);
+        if (!rtc_store_valid(&store))
+        {
+            fprintf(stderr, "store invalid after wake %u\n", r->wakes);
+            exit(1);
+        }
+        store.clock_ms = (uint32_t)t_ms;
+        store.wakes++;
+        r->wakes++;
+
+        /* one conversion, timed by the simulator (bus time + busy polling);
+         * like deep_sleep.c a wake only re-initialises the bus, not the sensor */
+        hal->init(hal->ctx);
+        aht10_meas_init(&meas, hal);
+        meas_ms = 0;
+        if (aht10_meas_start(&meas, &next_ms) == ESP_OK)
+        {
+            int64_t start_us = sim.now_us;
+            while (meas.state != AHT10_MEAS_CONVERTED && aht10_meas_step(&meas, &next_ms) == ESP_OK)
+            {
+                hal->delay_ms(hal->ctx, next_ms);
+            }
+            meas_ms = (uint32_t)((sim.now_us - start_us) / 1000);
+            aht10_meas_take(&meas, &reading);
+            aht10_sample_pack(&sample, store.clock_ms + cfg->boot_ms + meas_ms, &reading);
+            rtc_store_push(&store, &sample);
+        }
+        awake_ms = cfg->boot_ms + meas_ms;
+        radio_ms = rf_on ? cfg->rf_cal_ms : 0;
+
+        if (rtc_store_flush_due(&store, policy, store.clock_ms + awake_ms))
+        {
+            r->flushes++;
+            radio_ms += cfg->connect_ms;
+            ok = (uint32_t)(rand_r(&seed) % 100) >= cfg->fail_pct;
+            if (ok)
+            {
+                frames = (store.count + UPLOAD_FRAME_MAX_SAMPLES - 1) / UPLOAD_FRAME_MAX_SAMPLES;
+                radio_ms += frames * cfg->tx_ms;
+                r->frames += frames;
+                rtc_store_peek(&store, 0, &sample);
+                age = store.clock_ms + awake_ms + radio_ms - sample.timestamp_ms;
+                if (age > r->max_age_ms)
+                {
+                    r->max_age_ms = age;
+                }
+                rtc_store_consume(&store, store.count);
+            }
+            else
+            {
+                /* the link timeout is what a failed attempt costs */
+                radio_ms += DEEP_SLEEP_LINK_TIMEOUT_MS - cfg->connect_ms;
+                r->failed_flushes++;
+            }
+            rtc_store_flush_done(&store, ok, store.clock_ms + awake_ms + radio_ms);
+        }
+        awake_ms += radio_ms;
+        if (awake_ms > policy->period_ms)
+        {
+            /* a wake that overruns the period just delays the next one in
+             * the firmware, here it is cut short to keep the grid regular */
+            awake_ms = policy->period_ms;
+            radio_ms = (radio_ms < awake_ms) ? radio_ms : awake_ms;
+        }
+
+        r->mcu_mas += (awake_ms - radio_ms) / 1000.0 * cfg->mcu_ma;
+        r->radio_mas += radio_ms / 1000.0 * cfg->radio_ma;
+        r->sleep_mas += (policy->period_ms - awake_ms) / 1000.0 * cfg->sleep_ua / 1000.0;
+
+        rf_on = rtc_store_flush_due_next(&store, policy, store.clock_ms + awake_ms);
+        rtc_store_seal(&store);
+        rtc_store_save(&store, rtc);
+        t_ms += policy->period_ms;
+    }
+    r->seconds = t_ms / 1000.0;
+    r->dropped = store.dropped;
+}
+
+static void print_one(const energy_config_t *cfg, const rtc_store_policy_t *policy)
+{
+    energy_result_t r;
+    double ma;
+
+    simulate(cfg, policy, &r);
+    ma = avg_ma(&r);
+    printf("period %u s, flush at %u samples or %u s, %u days, %u%% of flushes fail\n",
+           policy->period_ms / 1000, policy->flush_count, policy->flush_age_ms / 1000, cfg->days, cfg->fail_pct);
+    printf("  %u wakes, %u flushes (%u failed), %u frames, %u samples dropped\n",
+           r.wakes, r.flushes, r.failed_flushes, r.frames, r.dropped);
+    printf("  charge: mcu %.1f mAh, radio %.1f mAh, sleep %.1f mAh\n",
+           r.mcu_mas / 3600.0, r.radio_mas / 3600.0, r.sleep_mas / 3600.0);
+    printf("  average %.3f mA -> %.0f days on %.0f mAh, data up to %u s old\n",
+           ma, cfg->battery_mah / ma / 24.0, cfg->battery_mah, r.max_age_ms / 1000);
+    printf("  always-on firmware: %.1f mA -> %.1f days (%.0fx)\n",
+           cfg->always_on_ma, cfg->battery_mah / cfg->always_on_ma / 24.0, cfg->always_on_ma / ma);
+}
+
+static void sweep(const energy_config_t *cfg, uint32_t flush_age_ms)
+{
+    static const uint32_t periods_s[] = { 5, 30, 60, 300, 900 };
+    static const uint16_t counts[] = { 1, 6, 12, 24, 36 };
+    rtc_store_policy_t policy;
+    energy_result_t r;
+    size_t i, j;
+
+    printf("average current in mA (battery days on %.0f mAh), flush age cap %u s, %u%% failed flushes\n",
+           cfg->battery_mah, flush_age_ms / 1000, cfg->fail_pct);
+    printf("period \\ flush at");
+    for (j = 0; j < sizeof(counts) / sizeof(counts[0]); j++)
+    {
+        printf(" %14u", counts[j]);
+    }
+    printf("\n");
+    for (i = 0; i < sizeof(periods_s) / sizeof(periods_s[0]); i++)
+    {
+        printf("%15u s", periods_s[i]);
+        for (j = 0; j < sizeof(counts) / sizeof(counts[0]); j++)
+        {
+            policy.period_ms = periods_s[i] * 1000;
+            policy.flush_count = counts[j];
+            policy.flush_age_ms = flush_age_ms;
+            simulate(cfg, &policy, &r);
+            printf(" %7.3f (%4.0f)", avg_ma(&r), cfg->battery_mah / avg_ma(&r) / 24.0);
+        }
+        printf("\n");
+    }
+    printf("always-on firmware: %.1f mA (%.1f days)\n", cfg->always_on_ma, cfg->battery_mah / cfg->always_on_ma / 24.0);
+}
+
+int main(int argc, char **argv)
+{
+    energy_config_t cfg = {
+        .sleep_ua = 20.0,
+        .mcu_ma = 15.0,
+        .radio_ma = 75.0,
+        .always_on_ma = 18.0,
+        .boot_ms = 60,
+        .rf_cal_ms = 100,
+        .connect_ms = 400,
+        .tx_ms = 20,
+        .fail_pct = 0,
+        .battery_mah = 2000.0,
+        .days = 30,
+    };
+    rtc_store_policy_t policy = {
+        .period_ms = DEEP_SLEEP_PERIOD_MS,
+        .flush_count = DEEP_SLEEP_FLUSH_COUNT,
+        .flush_age_ms = DEEP_SLEEP_FLUSH_AGE_MS,
+    };
+    int single = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:c:a:d:f:B:S:M:R:b:w:x:A:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p': policy.period_ms = (uint32_t)strtoul(optarg, NULL, 0) * 1000; single = 1; break;
+            case 'c': policy.flush_count = (uint16_t)strtoul(optarg, NULL, 0); single = 1; break;
+            case 'a': policy.flush_age_ms = (uint32_t)strtoul(optarg, NULL, 0) * 1000; single = 1; break;
+            case 'd': cfg.days = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'f': cfg.fail_pct = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'B': cfg.battery_mah = strtod(optarg, NULL); break;
+            case 'S': cfg.sleep_ua = strtod(optarg, NULL); break;
+            case 'M': cfg.mcu_ma = strtod(optarg, NULL); break;
+            case 'R': cfg.radio_ma = strtod(optarg, NULL); break;
+            case 'b': cfg.boot_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'w': cfg.connect_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'x': cfg.tx_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'A': cfg.always_on_ma = strtod(optarg, NULL); break;
+            default:
+                fprintf(stderr, "usage: %s [-p period_s] [-c flush_count] [-a flush_age_s] [-d days] [-f fail_pct]"
+                        " [-B battery_mAh] [-S sleep_uA] [-M mcu_mA] [-R radio_mA] [-b boot_ms] [-w connect_ms]"
+                        " [-x tx_ms] [-A always_on_mA]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (policy.period_ms == 0 || policy.flush_count == 0 || cfg.days == 0 || cfg.fail_pct > 100)
+    {
+        fprintf(stderr, "period, flush count and days must be non-zero, fail_pct at most 100\n");
+        return 2;
+    }
+
+    if (single)
+    {
+        print_one(&cfg, &policy);
+    }
+    else
+    {
+        sweep(&cfg, policy.flush_age_ms);
+    }
+    return 0;
+}
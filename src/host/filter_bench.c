@@ -0,0 +1,302 @@
+/* Burst mode (main/aht10_filter.c through main/aht10_sched.c) against a
+ * noisy simulated sensor: what each burst size and filter buys in noise and
+ * spike rejection, and what it costs in awake time and CPU.
+ *
+ * usage: filter_bench [-n cycles] [-t noise_c] [-r noise_rh] [-p spikes_per_mille]
+ *
+ * For each configuration it runs the scheduler for n cycles and compares
+ * the readings with the simulated environment: RMS and worst error,
+ * outliers (more than 1 C or 5 %RH off), cycles without a reading, and the
+ * simulated time awake per cycle. "noise x time" is the temperature
+ * variance times the awake time, the figure to minimise for noise per
+ * energy (plain averaging keeps it constant; spikes blow it up). "filter"
+ * is the host CPU time of one aht10_burst_reduce().
+ *
+ * Checks (non-zero exit on failure): the reducers on fixed inputs, the
+ * reading checks, rejection of uncalibrated results inside a burst, and
+ * that on the simulator a median of 3 removes the spikes a single reading
+ * lets through and a mean of 5 cuts the noise to well under 1/sqrt(2). */
+
+/* Toolchain headers */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* local headers */
+#include "aht10_filter.h"
+#include "aht10_sched.h"
+#include "aht10_sim.h"
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); s_failures++; } } while (0)
+
+typedef struct bench_config {
+    uint8_t burst;
+    aht10_filter_t filter;
+    uint8_t trim;
+} bench_config_t;
+
+typedef struct bench_result {
+    double rms_c, rms_rh;
+    double max_c, max_rh;
+    uint32_t outliers;
+    uint32_t missing;
+    uint32_t rejected;
+    double awake_ms;                    /* per cycle */
+    double filter_ns;
+} bench_result_t;
+
+static const bench_config_t s_configs[] = {
+    { 1, AHT10_FILTER_MEDIAN, 0 },
+    { 2, AHT10_FILTER_MEAN, 0 },
+    { 3, AHT10_FILTER_MEDIAN, 0 },
+    { 3, AHT10_FILTER_MEAN, 0 },
+    { 4, AHT10_FILTER_TRIMMED_MEAN, 1 },
+    { 5, AHT10_FILTER_MEDIAN, 0 },
+    { 5, AHT10_FILTER_TRIMMED_MEAN, 1 },
+    { 5, AHT10_FILTER_MEAN, 0 },
+    { 8, AHT10_FILTER_TRIMMED_MEAN, 2 },
+};
+
+static unsigned s_failures;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void run_cycle(aht10_sched_t *sched, const aht10_hal_t *hal)
+{
+    uint32_t next_ms;
+
+    if (aht10_sched_start(sched, &next_ms) != ESP_OK)
+    {
+        return;
+    }
+    while (aht10_sched_running(sched))
+    {
+        hal->delay_ms(hal->ctx, next_ms);
+        aht10_sched_step(sched, &next_ms);
+    }
+}
+
+/* CPU cost of one reduction, on bursts of codes around a room reading */
+static double time_filter(const bench_config_t *c)
+{
+    aht10_burst_t bursts[64];
+    aht10_reading_t reading;
+    volatile uint32_t sink = 0;
+    unsigned seed = 3;
+    const int rounds = 200000;
+    double t0;
+    int i, j;
+
+    for (i = 0; i < 64; i++)
+    {
+        bursts[i].count = c->burst;
+        bursts[i].status = 0x1C;
+        for (j = 0; j < c->burst; j++)
+        {
+            bursts[i].hum[j] = 400000 + (uint32_t)(rand_r(&seed) % 4000);
+            bursts[i].temp[j] = 380000 + (uint32_t)(rand_r(&seed) % 4000);
+        }
+    }
+    t0 = now_s();
+    for (i = 0; i < rounds; i++)
+    {
+        aht10_burst_reduce(&bursts[i & 63], c->filter, c->trim, &reading);
+        sink += reading.temperature_raw;
+    }
+    (void)sink;
+    return (now_s() - t0) / rounds * 1e9;
+}
+
+static void run_config(const aht10_sim_config_t *env, const bench_config_t *c, uint32_t cycles, bench_result_t *r)
+{
+    aht10_sim_t sim;
+    aht10_sched_t sched;
+    aht10_reading_t reading;
+    const aht10_hal_t *hal;
+    double err_c, err_rh, sum_c = 0, sum_rh = 0, awake_us = 0;
+    uint32_t i, good = 0;
+
+    memset(r, 0, sizeof(*r));
+    aht10_sim_init(&sim, env);
+    hal = aht10_sim_hal(&sim);
+    aht10_init(hal);
+    aht10_sched_init(&sched);
+    aht10_sched_add(&sched, hal, 0);
+    aht10_sched_set_burst(&sched, c->burst, c->filter, c->trim);
+
+    for (i = 0; i < cycles; i++)
+    {
+        run_cycle(&sched, hal);
+        awake_us += sched.cycle_us;
+        if (aht10_sched_take(&sched, 0, &reading) != ESP_OK)
+        {
+            r->missing++;
+            continue;
+        }
+        err_c = (double)reading.temperature / AHT10_CONVERT_SCALE - env->temperature_c;
+        err_rh = (double)reading.humidity / AHT10_CONVERT_SCALE - env->humidity_rh;
+        sum_c += err_c * err_c;
+        sum_rh += err_rh * err_rh;
+        r->max_c = fmax(r->max_c, fabs(err_c));
+        r->max_rh = fmax(r->max_rh, fabs(err_rh));
+        r->outliers += (fabs(err_c) > 1.0 || fabs(err_rh) > 5.0);
+        good++;
+        hal->delay_ms(hal->ctx, 5000);
+    }
+    r->rms_c = good ? sqrt(sum_c / good) : 0;
+    r->rms_rh = good ? sqrt(sum_rh / good) : 0;
+    r->rejected = sched.sensors[0].health.rejected;
+    r->awake_ms = awake_us / cycles / 1000.0;
+    r->filter_ns = time_filter(c);
+}
+
+static void check_reducers(void)
+{
+    aht10_burst_t burst = { 5, 0x1C, { 50, 10, 90, 30, 70 }, { 5, 1, 1000, 3, 4 } };
+    aht10_reading_t out;
+
+    aht10_burst_reduce(&burst, AHT10_FILTER_MEDIAN, 0, &out);
+    CHECK(out.humidity_raw == 50 && out.temperature_raw == 4, "median of 5: %u %u", out.humidity_raw, out.temperature_raw);
+    aht10_burst_reduce(&burst, AHT10_FILTER_TRIMMED_MEAN, 1, &out);
+    CHECK(out.humidity_raw == 50 && out.temperature_raw == 4, "trimmed mean of 5: %u %u", out.humidity_raw, out.temperature_raw);
+    aht10_burst_reduce(&burst, AHT10_FILTER_MEAN, 0, &out);
+    CHECK(out.humidity_raw == 50 && out.temperature_raw == 203, "mean of 5: %u %u", out.humidity_raw, out.temperature_raw);
+    /* more trim than values: falls back to the middle */
+    aht10_burst_reduce(&burst, AHT10_FILTER_TRIMMED_MEAN, 7, &out);
+    CHECK(out.humidity_raw == 50, "over-trimmed: %u", out.humidity_raw);
+
+    burst.count = 4;
+    aht10_burst_reduce(&burst, AHT10_FILTER_MEDIAN, 0, &out);
+    CHECK(out.humidity_raw == 40, "median of 4: %u", out.humidity_raw);
+    burst.count = 0;
+    CHECK(aht10_burst_reduce(&burst, AHT10_FILTER_MEDIAN, 0, &out) == ESP_ERR_NOT_FOUND, "empty burst reduced");
+}
+
+static void check_readings(void)
+{
+    aht10_reading_t r = { .status = 0x1C, .humidity_raw = 419430, .temperature_raw = 375000 };
+
+    CHECK(aht10_reading_check(&r) == AHT10_READING_OK, "good reading rejected");
+    r.status = 0x18;
+    CHECK(aht10_reading_check(&r) == AHT10_READING_UNCALIBRATED, "cal bit not checked");
+    r.status = 0x1C;
+    r.humidity_raw = AHT10_CODE_MAX;
+    CHECK(aht10_reading_check(&r) == AHT10_READING_IMPLAUSIBLE, "all ones accepted");
+    r.humidity_raw = 419430;
+    r.temperature_raw = aht10_sim_temperature_code(100.0);
+    CHECK(aht10_reading_check(&r) == AHT10_READING_IMPLAUSIBLE, "100 C accepted");
+    r.temperature_raw = aht10_sim_temperature_code(-45.0);
+    CHECK(aht10_reading_check(&r) == AHT10_READING_IMPLAUSIBLE, "-45 C accepted");
+}
+
+/* uncalibrated results in the middle of a burst are dropped, a burst with
+ * nothing left is a failed cycle */
+static void check_burst_rejection(void)
+{
+    aht10_sim_config_t cfg;
+    aht10_sim_t sim;
+    aht10_sched_t sched;
+    aht10_reading_t reading;
+    const aht10_hal_t *hal;
+
+    aht10_sim_default_config(&cfg);
+    aht10_sim_init(&sim, &cfg);
+    hal = aht10_sim_hal(&sim);
+    aht10_init(hal);
+    aht10_sched_init(&sched);
+    aht10_sched_add(&sched, hal, 0);
+    CHECK(aht10_sched_set_burst(&sched, 0, AHT10_FILTER_MEDIAN, 0) == ESP_ERR_INVALID_ARG, "burst of 0 taken");
+    aht10_sched_set_burst(&sched, 3, AHT10_FILTER_MEDIAN, 0);
+
+    sim.inject_uncal = 1;
+    run_cycle(&sched, hal);
+    CHECK(aht10_sched_take(&sched, 0, &reading) == ESP_OK && (reading.status & AHT10_STATUS_BITS_CAL),
+          "no calibrated reading from a burst with one bad result");
+    CHECK(sched.sensors[0].health.uncalibrated == 1 && sim.measurements == 3,
+          "%u uncalibrated in %u conversions", sched.sensors[0].health.uncalibrated, sim.measurements);
+
+    sim.inject_uncal = 3;
+    run_cycle(&sched, hal);
+    CHECK(aht10_sched_take(&sched, 0, &reading) == ESP_ERR_NOT_FOUND, "reading from an all uncalibrated burst");
+    CHECK(sched.sensors[0].health.state == AHT10_HEALTH_DEGRADED, "sensor still %s",
+          aht10_health_name(sched.sensors[0].health.state));
+}
+
+int main(int argc, char **argv)
+{
+    aht10_sim_config_t env;
+    bench_result_t results[sizeof(s_configs) / sizeof(s_configs[0])];
+    bench_result_t quiet_1, quiet_5;
+    bench_config_t mean_5 = { 5, AHT10_FILTER_MEAN, 0 };
+    uint32_t cycles = 2000;
+    size_t i;
+    int opt;
+
+    aht10_sim_default_config(&env);
+    env.noise_c = 0.1;
+    env.noise_rh = 0.15;
+    env.spike_per_mille = 10;
+    env.seed = 12345;
+    while ((opt = getopt(argc, argv, "n:t:r:p:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': cycles = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 't': env.noise_c = strtod(optarg, NULL); break;
+            case 'r': env.noise_rh = strtod(optarg, NULL); break;
+            case 'p': env.spike_per_mille = (uint32_t)strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-n cycles] [-t noise_c] [-r noise_rh] [-p spikes_per_mille]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (cycles == 0)
+    {
+        cycles = 1;
+    }
+
+    check_reducers();
+    check_readings();
+    check_burst_rejection();
+
+    printf("%u cycles, noise %.2f C / %.2f %%RH, %u spikes per 1000 readings\n",
+           cycles, env.noise_c, env.noise_rh, env.spike_per_mille);
+    printf("burst filter    rms C  rms %%RH  max C  max %%RH  outliers  missing  rejected  awake ms  noise x time  filter ns\n");
+    for (i = 0; i < sizeof(s_configs) / sizeof(s_configs[0]); i++)
+    {
+        run_config(&env, &s_configs[i], cycles, &results[i]);
+        printf("%5u %-8s %6.3f  %6.3f  %6.2f  %6.2f  %8u  %7u  %8u  %8.1f  %12.2f  %9.1f\n",
+               s_configs[i].burst, aht10_filter_name(s_configs[i].filter), results[i].rms_c, results[i].rms_rh,
+               results[i].max_c, results[i].max_rh, results[i].outliers, results[i].missing, results[i].rejected,
+               results[i].awake_ms, results[i].rms_c * results[i].rms_c * results[i].awake_ms, results[i].filter_ns);
+    }
+
+    /* s_configs[0] is a single reading, s_configs[2] the median of 3 */
+    CHECK(env.spike_per_mille == 0 || results[0].outliers > 0, "the single readings had no outliers to remove");
+    CHECK(results[2].outliers * 10 <= results[0].outliers, "median of 3 left %u of %u outliers",
+          results[2].outliers, results[0].outliers);
+
+    env.spike_per_mille = 0;
+    run_config(&env, &s_configs[0], cycles, &quiet_1);
+    run_config(&env, &mean_5, cycles, &quiet_5);
+    printf("without spikes: rms %.3f C single, %.3f C mean of 5\n", quiet_1.rms_c, quiet_5.rms_c);
+    CHECK(quiet_5.rms_c < quiet_1.rms_c * 0.6, "mean of 5 only got the noise from %.3f to %.3f C",
+          quiet_1.rms_c, quiet_5.rms_c);
+
+    if (s_failures)
+    {
+        printf("%u checks failed\n", s_failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
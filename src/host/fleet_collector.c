@@ -0,0 +1,945 @@
+/* Fleet collector: the server side for a building full of boards.
+ *
+ * usage: fleet_collector [-p port] [-r receivers] [-w workers] [-d seconds]
+ *                        [-n frames] [-q]
+ *
+ * Receivers each own a UDP socket on the same port (SO_REUSEPORT, so the
+ * kernel spreads the devices across them) and an epoll instance; the first
+ * one also owns the TCP listener and its connections. Datagrams come in with
+ * recvmmsg() in batches of RECV_BATCH, straight into pooled buffers and
+ * stamped with the kernel's receive time (SO_TIMESTAMPNS). A receiver only
+ * reads the device id out of each frame (upload_frame_device_id()) and hands
+ * the buffer to the worker that owns that device through a single-producer
+ * single-consumer ring per receiver/worker pair. The worker decodes it in
+ * place with upload_frame_reader_*(), updates the device's record, batches
+ * the acks into one sendmmsg() and hands the buffer back the same way. A
+ * device always lands on the same worker, so per-device state needs no
+ * locking and the frames of one device stay in order.
+ *
+ * TCP carries the same frames with a two byte big endian length in front,
+ * for sites that drop UDP. TCP frames aren't acked, the transport already is.
+ *
+ * Ingest latency is kernel receive to decoded, per frame. Prints a line per
+ * second unless -q, and a summary with p50/p99/p99.9 when -d seconds or -n
+ * frames are up (or on Ctrl-C). */
+
+/* recvmmsg(), sendmmsg(), accept4() */
+#define _GNU_SOURCE
+
+/* Toolchain headers */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* local headers */
+#include "upload_frame.h"
+
+#define MAX_RECEIVERS                       8
+#define MAX_WORKERS                         16
+#define RECV_BATCH                          64                  /* datagrams per recvmmsg() */
+#define ACK_BATCH                           64                  /* acks per sendmmsg() */
+#define POOL_BUFS                           8192                /* frame buffers per receiver, power of two */
+#define BUF_SIZE                            1024                /* one frame, UPLOAD_FRAME_MAX_LEN rounded up */
+#define TCP_CONN_BUF                        4096
+#define SOCK_RCVBUF                         (8 * 1024 * 1024)
+#define DEVICE_TABLE_SIZE                   (1U << 16)          /* per worker, power of two */
+#define LAT_SUB_BITS                        3                   /* 8 buckets per power of two, ~12 % wide */
+#define LAT_BUCKETS                         (64 << LAT_SUB_BITS)
+
+_Static_assert(UPLOAD_FRAME_MAX_LEN <= BUF_SIZE, "a frame must fit a pool buffer");
+
+/* Buffer indices travel in these. The ring is as large as the pool, so a
+ * push never finds it full. */
+typedef struct index_ring {
+    uint32_t head;                      /* written by the producer only */
+    uint8_t pad0[60];
+    uint32_t tail;                      /* written by the consumer only */
+    uint8_t pad1[60];
+    uint32_t slot[POOL_BUFS];
+} index_ring_t;
+
+typedef struct fleet_buf {
+    int64_t rx_ns;                      /* receive time, CLOCK_REALTIME */
+    struct sockaddr_in from;
+    uint16_t len;
+    uint8_t tcp;
+    uint8_t data[BUF_SIZE];
+} fleet_buf_t;
+
+typedef struct device {
+    uint64_t key;                       /* device id | DEVICE_KEY_USED, 0 when free */
+    uint16_t last_seq;
+    uint32_t frames;
+    uint32_t samples;
+    uint32_t lost;                      /* frames skipped in the seq */
+    uint32_t dups;                      /* same seq again, or older */
+    uint32_t last_ms;                   /* device timestamp of its newest sample */
+} device_t;
+
+#define DEVICE_KEY_USED                     (1ULL << 63)
+
+typedef struct tcp_conn {
+    int fd;
+    size_t have;
+    uint8_t buf[TCP_CONN_BUF];
+} tcp_conn_t;
+
+typedef struct receiver {
+    int id;
+    int udp;
+    int listen_fd;                      /* -1 except on receiver 0 */
+    int epfd;
+    fleet_buf_t *pool;
+    uint32_t free_stack[POOL_BUFS];
+    uint32_t free_count;
+    uint32_t touched;                   /* workers handed something since the last wake */
+    struct mmsghdr msgs[RECV_BATCH];
+    struct iovec iov[RECV_BATCH];
+    uint32_t batch_idx[RECV_BATCH];
+    uint8_t ctrl[RECV_BATCH][CMSG_SPACE(sizeof(struct timespec))];
+    pthread_t thread;
+
+    /* statistics */
+    uint64_t datagrams;
+    uint64_t batches;
+    uint64_t status;                    /* '{' status packets, not frames */
+    uint64_t junk;                      /* neither a frame nor a status packet */
+    uint64_t starved;                   /* times the pool ran dry */
+    uint64_t tcp_conns;
+} receiver_t;
+
+typedef struct worker {
+    int id;
+    int evfd;
+    device_t *devices;
+    pthread_t thread;
+    struct mmsghdr ack_msgs[MAX_RECEIVERS][ACK_BATCH];
+    struct iovec ack_iov[MAX_RECEIVERS][ACK_BATCH];
+    uint8_t ack_buf[MAX_RECEIVERS][ACK_BATCH][UPLOAD_ACK_LEN];
+    struct sockaddr_in ack_to[MAX_RECEIVERS][ACK_BATCH];
+    uint32_t ack_count[MAX_RECEIVERS];
+
+    /* statistics, read by the main thread while running */
+    uint64_t frames;
+    uint64_t samples;
+    uint64_t bytes;
+    uint64_t bad;
+    uint64_t acks;
+    uint64_t lost;
+    uint64_t dups;
+    uint64_t device_count;
+    uint64_t table_full;
+    uint64_t lat[LAT_BUCKETS];          /* ingest latency, ns */
+    uint64_t lat_max;
+} worker_t;
+
+static receiver_t s_receivers[MAX_RECEIVERS];
+static worker_t s_workers[MAX_WORKERS];
+static index_ring_t *s_to_worker[MAX_RECEIVERS][MAX_WORKERS];
+static index_ring_t *s_to_receiver[MAX_WORKERS][MAX_RECEIVERS];
+static int s_nreceivers = 2;
+static int s_nworkers = 4;
+static volatile sig_atomic_t s_stop;
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static int64_t now_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* single writer per counter, the main thread only reads them */
+static inline void stat_add(uint64_t *p, uint64_t v)
+{
+    __atomic_store_n(p, *p + v, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t stat_get(const uint64_t *p)
+{
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static int ring_push(index_ring_t *ring, uint32_t idx)
+{
+    uint32_t head = ring->head;
+
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= POOL_BUFS)
+    {
+        return 0;
+    }
+    ring->slot[head & (POOL_BUFS - 1)] = idx;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static int ring_pop(index_ring_t *ring, uint32_t *idx)
+{
+    uint32_t tail = ring->tail;
+
+    if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+    {
+        return 0;
+    }
+    *idx = ring->slot[tail & (POOL_BUFS - 1)];
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/* log-linear: exact below 2^LAT_SUB_BITS, then 2^LAT_SUB_BITS buckets per power of two */
+static uint32_t lat_bucket(uint64_t v)
+{
+    uint32_t msb;
+
+    if (v < (1U << LAT_SUB_BITS))
+    {
+        return (uint32_t)v;
+    }
+    msb = 63 - (uint32_t)__builtin_clzll(v);
+    return ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) + (uint32_t)((v >> (msb - LAT_SUB_BITS)) & ((1U << LAT_SUB_BITS) - 1));
+}
+
+/* largest value that lands in the bucket */
+static uint64_t lat_bucket_max(uint32_t b)
+{
+    uint32_t msb, sub;
+
+    if (b < (1U << LAT_SUB_BITS))
+    {
+        return b;
+    }
+    msb = (b >> LAT_SUB_BITS) + LAT_SUB_BITS - 1;
+    sub = b & ((1U << LAT_SUB_BITS) - 1);
+    return ((((uint64_t)1 << LAT_SUB_BITS) + sub + 1) << (msb - LAT_SUB_BITS)) - 1;
+}
+
+static uint64_t lat_quantile(const uint64_t *hist, uint64_t total, uint32_t per_mille_x10)
+{
+    uint64_t rank = (total * per_mille_x10 + 9999) / 10000, seen = 0;
+    uint32_t b;
+
+    for (b = 0; b < LAT_BUCKETS && total > 0; b++)
+    {
+        seen += hist[b];
+        if (seen >= rank)
+        {
+            return lat_bucket_max(b);
+        }
+    }
+    return 0;
+}
+
+/* FNV-1a over the station MAC; devices from one vendor share the first three bytes */
+static uint32_t device_hash(const uint8_t *id)
+{
+    uint32_t h = 2166136261U;
+    int i;
+
+    for (i = 0; i < UPLOAD_FRAME_DEVICE_ID_LEN; i++)
+    {
+        h = (h ^ id[i]) * 16777619U;
+    }
+    return h;
+}
+
+static device_t *device_lookup(worker_t *w, const uint8_t *id)
+{
+    uint64_t key = DEVICE_KEY_USED;
+    uint32_t i, n;
+    int k;
+
+    for (k = 0; k < UPLOAD_FRAME_DEVICE_ID_LEN; k++)
+    {
+        key |= (uint64_t)id[k] << (8 * k);
+    }
+    /* the low bits picked the worker, use the high ones here */
+    i = device_hash(id) >> 8;
+    for (n = 0; n < DEVICE_TABLE_SIZE; n++, i++)
+    {
+        device_t *d = &w->devices[i & (DEVICE_TABLE_SIZE - 1)];
+        if (d->key == key)
+        {
+            return d;
+        }
+        if (d->key == 0)
+        {
+            d->key = key;
+            stat_add(&w->device_count, 1);
+            return d;
+        }
+    }
+    stat_add(&w->table_full, 1);
+    return NULL;
+}
+
+static void flush_acks(worker_t *w, int r)
+{
+    uint32_t sent = 0;
+    int n;
+
+    while (sent < w->ack_count[r])
+    {
+        n = sendmmsg(s_receivers[r].udp, &w->ack_msgs[r][sent], w->ack_count[r] - sent, MSG_DONTWAIT);
+        if (n <= 0)
+        {
+            /* socket buffer full: the devices only count a missing ack */
+            break;
+        }
+        sent += (uint32_t)n;
+    }
+    stat_add(&w->acks, sent);
+    w->ack_count[r] = 0;
+}
+
+static void queue_ack(worker_t *w, int r, const fleet_buf_t *buf, uint16_t seq)
+{
+    uint32_t n = w->ack_count[r];
+
+    upload_frame_ack(seq, w->ack_buf[r][n]);
+    w->ack_to[r][n] = buf->from;
+    w->ack_iov[r][n].iov_base = w->ack_buf[r][n];
+    w->ack_iov[r][n].iov_len = UPLOAD_ACK_LEN;
+    memset(&w->ack_msgs[r][n], 0, sizeof(w->ack_msgs[r][n]));
+    w->ack_msgs[r][n].msg_hdr.msg_name = &w->ack_to[r][n];
+    w->ack_msgs[r][n].msg_hdr.msg_namelen = sizeof(w->ack_to[r][n]);
+    w->ack_msgs[r][n].msg_hdr.msg_iov = &w->ack_iov[r][n];
+    w->ack_msgs[r][n].msg_hdr.msg_iovlen = 1;
+    if (++w->ack_count[r] == ACK_BATCH)
+    {
+        flush_acks(w, r);
+    }
+}
+
+static void process_frame(worker_t *w, int r, const fleet_buf_t *buf)
+{
+    upload_frame_reader_t reader;
+    aht10_sample_t sample;
+    device_t *dev;
+    uint16_t diff;
+    uint32_t count = 0;
+    uint64_t lat;
+    esp_err_t ret;
+
+    if (upload_frame_reader_init(&reader, buf->data, buf->len) != ESP_OK)
+    {
+        stat_add(&w->bad, 1);
+        return;
+    }
+    while ((ret = upload_frame_reader_next(&reader, &sample)) == ESP_OK)
+    {
+        /* this is where a store would take the sample (sample.sensor, its
+         * codes and the device timestamp) */
+        count++;
+    }
+    if (ret != ESP_ERR_NOT_FOUND)
+    {
+        stat_add(&w->bad, 1);
+        return;
+    }
+
+    if ((dev = device_lookup(w, reader.header.device_id)) != NULL)
+    {
+        diff = (uint16_t)(reader.header.seq - dev->last_seq);
+        if (dev->frames > 0 && (diff == 0 || diff >= 0x8000))
+        {
+            dev->dups++;
+            stat_add(&w->dups, 1);
+        }
+        else
+        {
+            if (dev->frames > 0 && diff > 1)
+            {
+                dev->lost += diff - 1U;
+                stat_add(&w->lost, diff - 1U);
+            }
+            dev->last_seq = reader.header.seq;
+            dev->last_ms = sample.timestamp_ms;
+        }
+        dev->frames++;
+        dev->samples += count;
+    }
+    if (!buf->tcp)
+    {
+        queue_ack(w, r, buf, reader.header.seq);
+    }
+
+    lat = (uint64_t)(now_ns(CLOCK_REALTIME) - buf->rx_ns);
+    if ((int64_t)lat < 0)
+    {
+        lat = 0;
+    }
+    stat_add(&w->lat[lat_bucket(lat)], 1);
+    if (lat > w->lat_max)
+    {
+        __atomic_store_n(&w->lat_max, lat, __ATOMIC_RELAXED);
+    }
+    stat_add(&w->frames, 1);
+    stat_add(&w->samples, count);
+    stat_add(&w->bytes, buf->len);
+}
+
+static void *worker_main(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    uint64_t wake;
+    uint32_t idx, drained;
+    int r;
+
+    while (!s_stop)
+    {
+        drained = 0;
+        for (r = 0; r < s_nreceivers; r++)
+        {
+            while (ring_pop(s_to_worker[r][w->id], &idx))
+            {
+                process_frame(w, r, &s_receivers[r].pool[idx]);
+                ring_push(s_to_receiver[w->id][r], idx);
+                drained++;
+            }
+            if (w->ack_count[r] > 0)
+            {
+                flush_acks(w, r);
+            }
+        }
+        if (drained == 0)
+        {
+            /* the counter keeps any wake posted since the rings were checked */
+            if (read(w->evfd, &wake, sizeof(wake)) < 0 && errno != EINTR)
+            {
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void reclaim_buffers(receiver_t *rcv)
+{
+    uint32_t idx;
+    int w;
+
+    for (w = 0; w < s_nworkers; w++)
+    {
+        while (rcv->free_count < POOL_BUFS && ring_pop(s_to_receiver[w][rcv->id], &idx))
+        {
+            rcv->free_stack[rcv->free_count++] = idx;
+        }
+    }
+}
+
+static void wake_workers(receiver_t *rcv)
+{
+    uint64_t one = 1;
+    int w;
+
+    for (w = 0; w < s_nworkers; w++)
+    {
+        if ((rcv->touched & (1U << w)) && write(s_workers[w].evfd, &one, sizeof(one)) < 0)
+        {
+            perror("fleet_collector: eventfd");
+        }
+    }
+    rcv->touched = 0;
+}
+
+/* route a filled buffer to its device's worker, or take it back */
+static void dispatch(receiver_t *rcv, uint32_t idx)
+{
+    fleet_buf_t *buf = &rcv->pool[idx];
+    const uint8_t *id = upload_frame_device_id(buf->data, buf->len);
+    int w;
+
+    if (id == NULL)
+    {
+        if (buf->len > 0 && buf->data[0] == '{')
+        {
+            rcv->status++;
+        }
+        else
+        {
+            rcv->junk++;
+        }
+        rcv->free_stack[rcv->free_count++] = idx;
+        return;
+    }
+    w = (int)(device_hash(id) % (uint32_t)s_nworkers);
+    ring_push(s_to_worker[rcv->id][w], idx);
+    rcv->touched |= 1U << w;
+}
+
+static int64_t kernel_rx_ns(struct msghdr *hdr)
+{
+    struct cmsghdr *cmsg;
+    struct timespec ts;
+
+    for (cmsg = CMSG_FIRSTHDR(hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(hdr, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+        }
+    }
+    return now_ns(CLOCK_REALTIME);
+}
+
+static void receive_udp(receiver_t *rcv)
+{
+    fleet_buf_t *buf;
+    uint32_t n, i;
+    int got;
+
+    for (;;)
+    {
+        if (rcv->free_count < RECV_BATCH)
+        {
+            reclaim_buffers(rcv);
+        }
+        n = (rcv->free_count < RECV_BATCH) ? rcv->free_count : RECV_BATCH;
+        if (n == 0)
+        {
+            /* every buffer is queued at a worker; leave the rest in the socket */
+            rcv->starved++;
+            return;
+        }
+        for (i = 0; i < n; i++)
+        {
+            rcv->batch_idx[i] = rcv->free_stack[--rcv->free_count];
+            buf = &rcv->pool[rcv->batch_idx[i]];
+            rcv->iov[i].iov_base = buf->data;
+            rcv->iov[i].iov_len = BUF_SIZE;
+            memset(&rcv->msgs[i].msg_hdr, 0, sizeof(rcv->msgs[i].msg_hdr));
+            rcv->msgs[i].msg_hdr.msg_name = &buf->from;
+            rcv->msgs[i].msg_hdr.msg_namelen = sizeof(buf->from);
+            rcv->msgs[i].msg_hdr.msg_iov = &rcv->iov[i];
+            rcv->msgs[i].msg_hdr.msg_iovlen = 1;
+            rcv->msgs[i].msg_hdr.msg_control = rcv->ctrl[i];
+            rcv->msgs[i].msg_hdr.msg_controllen = sizeof(rcv->ctrl[i]);
+        }
+
+        got = recvmmsg(rcv->udp, rcv->msgs, n, MSG_DONTWAIT, NULL);
+        if (got < 0)
+        {
+            got = 0;
+        }
+        for (i = 0; i < (uint32_t)got; i++)
+        {
+            buf = &rcv->pool[rcv->batch_idx[i]];
+            buf->len = (uint16_t)rcv->msgs[i].msg_len;
+            buf->tcp = 0;
+            buf->rx_ns = kernel_rx_ns(&rcv->msgs[i].msg_hdr);
+            dispatch(rcv, rcv->batch_idx[i]);
+        }
+        /* give back what the batch didn't use */
+        for (i = (uint32_t)got; i < n; i++)
+        {
+            rcv->free_stack[rcv->free_count++] = rcv->batch_idx[i];
+        }
+        rcv->datagrams += (uint64_t)got;
+        rcv->batches++;
+        wake_workers(rcv);
+        if ((uint32_t)got < n)
+        {
+            return;
+        }
+    }
+}
+
+static void accept_tcp(receiver_t *rcv)
+{
+    struct epoll_event ev;
+    tcp_conn_t *conn;
+    int fd;
+
+    while ((fd = accept4(rcv->listen_fd, NULL, NULL, SOCK_NONBLOCK)) >= 0)
+    {
+        if ((conn = calloc(1, sizeof(*conn))) == NULL)
+        {
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        epoll_ctl(rcv->epfd, EPOLL_CTL_ADD, fd, &ev);
+        rcv->tcp_conns++;
+    }
+}
+
+/* length-prefixed frames; a frame is copied out of the stream into a pool
+ * buffer once it is complete, after that it is the same as a datagram */
+static void receive_tcp(receiver_t *rcv, tcp_conn_t *conn)
+{
+    fleet_buf_t *buf;
+    size_t off, flen;
+    ssize_t got;
+    uint32_t idx;
+
+    for (;;)
+    {
+        if (s_stop)
+        {
+            break;
+        }
+        got = read(conn->fd, conn->buf + conn->have, sizeof(conn->buf) - conn->have);
+        if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR))
+        {
+            break;
+        }
+        if (got < 0)
+        {
+            wake_workers(rcv);
+            return;
+        }
+        conn->have += (size_t)got;
+
+        off = 0;
+        while (conn->have - off >= 2)
+        {
+            flen = ((size_t)conn->buf[off] << 8) | conn->buf[off + 1];
+            if (flen == 0 || flen > BUF_SIZE)
+            {
+                rcv->junk++;
+                goto close_conn;
+            }
+            if (conn->have - off < 2 + flen)
+            {
+                break;
+            }
+            while (rcv->free_count == 0 && !s_stop)
+            {
+                /* workers are behind: wait for them, TCP pushes back on the sender */
+                wake_workers(rcv);
+                reclaim_buffers(rcv);
+                if (rcv->free_count == 0)
+                {
+                    rcv->starved++;
+                    usleep(50);
+                }
+            }
+            if (rcv->free_count == 0)
+            {
+                break;
+            }
+            idx = rcv->free_stack[--rcv->free_count];
+            buf = &rcv->pool[idx];
+            memcpy(buf->data, conn->buf + off + 2, flen);
+            buf->len = (uint16_t)flen;
+            buf->tcp = 1;
+            buf->rx_ns = now_ns(CLOCK_REALTIME);
+            dispatch(rcv, idx);
+            rcv->datagrams++;
+            off += 2 + flen;
+        }
+        memmove(conn->buf, conn->buf + off, conn->have - off);
+        conn->have -= off;
+    }
+
+close_conn:
+    wake_workers(rcv);
+    epoll_ctl(rcv->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    free(conn);
+}
+
+static void *receiver_main(void *arg)
+{
+    receiver_t *rcv = (receiver_t *)arg;
+    struct epoll_event events[32];
+    int n, i;
+
+    while (!s_stop)
+    {
+        n = epoll_wait(rcv->epfd, events, 32, 100);
+        for (i = 0; i < n; i++)
+        {
+            if (events[i].data.ptr == NULL)
+            {
+                receive_udp(rcv);
+            }
+            else if (events[i].data.ptr == &rcv->listen_fd)
+            {
+                accept_tcp(rcv);
+            }
+            else
+            {
+                receive_tcp(rcv, (tcp_conn_t *)events[i].data.ptr);
+            }
+        }
+        if (rcv->starved && rcv->free_count == 0)
+        {
+            /* nothing to receive into: give the workers a moment */
+            usleep(50);
+        }
+    }
+    return NULL;
+}
+
+static int open_udp(int port)
+{
+    struct sockaddr_in addr;
+    int one = 1, rcvbuf = SOCK_RCVBUF;
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (fd < 0
+        || setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0
+        || setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) < 0
+        || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("fleet_collector: udp");
+        return -1;
+    }
+    /* best effort, capped by net.core.rmem_max */
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    return fd;
+}
+
+static int open_tcp(int port)
+{
+    struct sockaddr_in addr;
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (fd < 0
+        || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0
+        || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || listen(fd, 128) < 0)
+    {
+        perror("fleet_collector: tcp");
+        return -1;
+    }
+    return fd;
+}
+
+static int setup_receiver(receiver_t *rcv, int id, int port)
+{
+    struct epoll_event ev;
+    uint32_t i;
+
+    rcv->id = id;
+    rcv->listen_fd = -1;
+    rcv->pool = calloc(POOL_BUFS, sizeof(fleet_buf_t));
+    if (rcv->pool == NULL || (rcv->udp = open_udp(port)) < 0 || (rcv->epfd = epoll_create1(0)) < 0)
+    {
+        return -1;
+    }
+    for (i = 0; i < POOL_BUFS; i++)
+    {
+        rcv->free_stack[i] = POOL_BUFS - 1 - i;
+    }
+    rcv->free_count = POOL_BUFS;
+
+    /* data.ptr tells the sources apart: NULL is the UDP socket */
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(rcv->epfd, EPOLL_CTL_ADD, rcv->udp, &ev);
+    if (id == 0)
+    {
+        if ((rcv->listen_fd = open_tcp(port)) < 0)
+        {
+            return -1;
+        }
+        ev.data.ptr = &rcv->listen_fd;
+        epoll_ctl(rcv->epfd, EPOLL_CTL_ADD, rcv->listen_fd, &ev);
+    }
+    return 0;
+}
+
+static void on_signal(int sig)
+{
+    s_stop = 1;
+}
+
+/* totals over every worker */
+static void sum_workers(worker_t *sum)
+{
+    int w;
+    uint32_t b;
+
+    memset(sum, 0, sizeof(*sum));
+    for (w = 0; w < s_nworkers; w++)
+    {
+        sum->frames += stat_get(&s_workers[w].frames);
+        sum->samples += stat_get(&s_workers[w].samples);
+        sum->bytes += stat_get(&s_workers[w].bytes);
+        sum->bad += stat_get(&s_workers[w].bad);
+        sum->acks += stat_get(&s_workers[w].acks);
+        sum->lost += stat_get(&s_workers[w].lost);
+        sum->dups += stat_get(&s_workers[w].dups);
+        sum->device_count += stat_get(&s_workers[w].device_count);
+        sum->table_full += stat_get(&s_workers[w].table_full);
+        for (b = 0; b < LAT_BUCKETS; b++)
+        {
+            sum->lat[b] += stat_get(&s_workers[w].lat[b]);
+        }
+        if (stat_get(&s_workers[w].lat_max) > sum->lat_max)
+        {
+            sum->lat_max = stat_get(&s_workers[w].lat_max);
+        }
+    }
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+int main(int argc, char **argv)
+{
+    static worker_t sum;
+    uint64_t last_frames = 0, last_samples = 0, last_bytes = 0, one = 1;
+    uint64_t datagrams = 0, status = 0, junk = 0, starved = 0, conns = 0;
+    unsigned long limit = 0;
+    int port = UPLOAD_FRAME_DEFAULT_PORT, seconds = 0, quiet = 0;
+    int opt, r, w, elapsed = 0;
+    int64_t start_ns;
+    double run_s;
+
+    while ((opt = getopt(argc, argv, "p:r:w:d:n:q")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p': port = atoi(optarg); break;
+            case 'r': s_nreceivers = atoi(optarg); break;
+            case 'w': s_nworkers = atoi(optarg); break;
+            case 'd': seconds = atoi(optarg); break;
+            case 'n': limit = strtoul(optarg, NULL, 0); break;
+            case 'q': quiet = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-r receivers] [-w workers] [-d seconds] [-n frames] [-q]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (s_nreceivers < 1 || s_nreceivers > MAX_RECEIVERS || s_nworkers < 1 || s_nworkers > MAX_WORKERS)
+    {
+        fprintf(stderr, "1..%d receivers, 1..%d workers\n", MAX_RECEIVERS, MAX_WORKERS);
+        return 2;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (r = 0; r < s_nreceivers; r++)
+    {
+        for (w = 0; w < s_nworkers; w++)
+        {
+            s_to_worker[r][w] = calloc(1, sizeof(index_ring_t));
+            s_to_receiver[w][r] = calloc(1, sizeof(index_ring_t));
+            if (s_to_worker[r][w] == NULL || s_to_receiver[w][r] == NULL)
+            {
+                fprintf(stderr, "fleet_collector: out of memory\n");
+                return 1;
+            }
+        }
+        if (setup_receiver(&s_receivers[r], r, port) < 0)
+        {
+            return 1;
+        }
+    }
+    for (w = 0; w < s_nworkers; w++)
+    {
+        s_workers[w].id = w;
+        s_workers[w].evfd = eventfd(0, 0);
+        s_workers[w].devices = calloc(DEVICE_TABLE_SIZE, sizeof(device_t));
+        if (s_workers[w].evfd < 0 || s_workers[w].devices == NULL)
+        {
+            fprintf(stderr, "fleet_collector: out of memory\n");
+            return 1;
+        }
+        pthread_create(&s_workers[w].thread, NULL, worker_main, &s_workers[w]);
+    }
+    for (r = 0; r < s_nreceivers; r++)
+    {
+        pthread_create(&s_receivers[r].thread, NULL, receiver_main, &s_receivers[r]);
+    }
+    printf("fleet_collector: udp and tcp port %d, %d receivers, %d workers\n", port, s_nreceivers, s_nworkers);
+    fflush(stdout);
+
+    start_ns = now_ns(CLOCK_MONOTONIC);
+    while (!s_stop && (seconds == 0 || elapsed < seconds))
+    {
+        sleep(1);
+        elapsed++;
+        sum_workers(&sum);
+        if (!quiet && sum.frames > 0)
+        {
+            printf("%4ds %8llu frames/s %9llu samples/s %7.2f MB/s  %6llu devices  p99 %llu us\n", elapsed,
+                   (unsigned long long)(sum.frames - last_frames), (unsigned long long)(sum.samples - last_samples),
+                   (double)(sum.bytes - last_bytes) / 1e6, (unsigned long long)sum.device_count,
+                   (unsigned long long)(lat_quantile(sum.lat, sum.frames, 9900) / 1000));
+            fflush(stdout);
+        }
+        last_frames = sum.frames;
+        last_samples = sum.samples;
+        last_bytes = sum.bytes;
+        if (limit > 0 && sum.frames + sum.bad >= limit)
+        {
+            break;
+        }
+    }
+    run_s = (double)(now_ns(CLOCK_MONOTONIC) - start_ns) / 1e9;
+
+    s_stop = 1;
+    for (w = 0; w < s_nworkers; w++)
+    {
+        if (write(s_workers[w].evfd, &one, sizeof(one)) < 0)
+        {
+            perror("fleet_collector: eventfd");
+        }
+    }
+    for (r = 0; r < s_nreceivers; r++)
+    {
+        pthread_join(s_receivers[r].thread, NULL);
+        datagrams += s_receivers[r].datagrams;
+        status += s_receivers[r].status;
+        junk += s_receivers[r].junk;
+        starved += s_receivers[r].starved;
+        conns += s_receivers[r].tcp_conns;
+    }
+    for (w = 0; w < s_nworkers; w++)
+    {
+        pthread_join(s_workers[w].thread, NULL);
+    }
+    sum_workers(&sum);
+
+    printf("fleet_collector: %llu frames, %llu samples, %llu bytes from %llu devices in %.1f s\n",
+           (unsigned long long)sum.frames, (unsigned long long)sum.samples, (unsigned long long)sum.bytes,
+           (unsigned long long)sum.device_count, run_s);
+    printf("  %.0f frames/s, %.0f samples/s average; %llu acks, %llu bad, %llu status, %llu junk\n",
+           sum.frames / run_s, sum.samples / run_s, (unsigned long long)sum.acks, (unsigned long long)sum.bad,
+           (unsigned long long)status, (unsigned long long)junk);
+    printf("  %llu lost and %llu duplicate frames by seq, %llu datagrams, %llu tcp connections, "
+           "%llu pool stalls, %llu devices over the table\n",
+           (unsigned long long)sum.lost, (unsigned long long)sum.dups, (unsigned long long)datagrams,
+           (unsigned long long)conns, (unsigned long long)starved, (unsigned long long)sum.table_full);
+    printf("  ingest latency p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+           lat_quantile(sum.lat, sum.frames, 5000) / 1e3, lat_quantile(sum.lat, sum.frames, 9900) / 1e3,
+           lat_quantile(sum.lat, sum.frames, 9990) / 1e3, sum.lat_max / 1e3);
+    for (w = 0; w < s_nworkers; w++)
+    {
+        printf("  worker %d: %llu frames, %llu devices\n", w, (unsigned long long)stat_get(&s_workers[w].frames),
+               (unsigned long long)stat_get(&s_workers[w].device_count));
+    }
+    return 0;
+}
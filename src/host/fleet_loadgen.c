@@ -0,0 +1,387 @@
+/* Load generator for host/fleet_collector: a fleet of simulated ESP-01S
+ * boards, each with its own station MAC, frame sequence and room trace,
+ * encoded with the firmware's own main/upload_frame.c.
+ *
+ * usage: fleet_loadgen [-H host] [-p port] [-N devices] [-b samples] [-r frames_per_s]
+ *                      [-d seconds] [-t threads] [-T] [-c]
+ *
+ * Every thread owns a slice of the devices and sends their frames round
+ * robin with sendmmsg(), SEND_BATCH at a time, paced to its share of -r
+ * (0 is as fast as the socket takes them). -b is the samples per frame, a
+ * board that sleeps between uploads (main/deep_sleep.h) sends a dozen, one
+ * that reports every sample sends one. Acks are counted as they come back,
+ * -c fails the run if less than 99 % of the frames were acked. -T sends over
+ * one TCP connection per thread instead, length-prefixed and not acked. */
+
+/* recvmmsg(), sendmmsg(), accept4() */
+#define _GNU_SOURCE
+
+/* Toolchain headers */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* local headers */
+#include "upload_frame.h"
+
+#define MAX_THREADS                         16
+#define SEND_BATCH                          64                  /* frames per sendmmsg() */
+#define ACK_DRAIN_MS                        500                 /* wait for stragglers at the end */
+#define ACK_RCVBUF                          (4 * 1024 * 1024)   /* acks pile up while a thread sends */
+#define ACKED_MIN_PERMILLE                  990                 /* -c */
+
+typedef struct device {
+    uint8_t id[UPLOAD_FRAME_DEVICE_ID_LEN];
+    uint16_t seq;
+    uint32_t t_ms;
+    int32_t hum;
+    int32_t temp;
+} device_t;
+
+typedef struct gen_thread {
+    int id;
+    int sock;
+    device_t *devices;
+    uint32_t count;
+    double rate;                        /* frames/s for this thread, 0 unpaced */
+    unsigned seed;
+    pthread_t thread;
+    upload_frame_t frames[SEND_BATCH];
+    uint8_t tcp_buf[SEND_BATCH * (UPLOAD_FRAME_MAX_LEN + 2)];
+
+    uint64_t sent;
+    uint64_t samples;
+    uint64_t bytes;
+    uint64_t acks;
+    uint64_t send_errors;
+} gen_thread_t;
+
+static struct sockaddr_in s_dest;
+static gen_thread_t s_threads[MAX_THREADS];
+static int s_tcp;
+static unsigned s_samples_per_frame = 12;
+static double s_seconds = 5;
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the next upload of one board: its samples since the last one */
+static void make_frame(gen_thread_t *th, device_t *dev, upload_frame_t *frame)
+{
+    aht10_reading_t reading;
+    aht10_sample_t sample;
+    unsigned i;
+
+    upload_frame_begin(frame, dev->id, dev->seq++);
+    for (i = 0; i < s_samples_per_frame; i++)
+    {
+        dev->hum += (int32_t)(rand_r(&th->seed) % 601) - 300;
+        dev->temp += (int32_t)(rand_r(&th->seed) % 201) - 100;
+        reading.status = 0x04;
+        reading.humidity_raw = (uint32_t)dev->hum & AHT10_CODE_MAX;
+        reading.temperature_raw = (uint32_t)dev->temp & AHT10_CODE_MAX;
+        aht10_sample_pack(&sample, dev->t_ms, &reading);
+        upload_frame_add(frame, &sample);
+        dev->t_ms += 5000 + (uint32_t)(rand_r(&th->seed) % 21) - 10;
+    }
+    upload_frame_finish(frame);
+}
+
+static void drain_acks(gen_thread_t *th, int flags)
+{
+    struct mmsghdr msgs[SEND_BATCH];
+    struct iovec iov[SEND_BATCH];
+    uint8_t buf[SEND_BATCH][16];
+    uint16_t seq;
+    int n, i;
+
+    for (;;)
+    {
+        for (i = 0; i < SEND_BATCH; i++)
+        {
+            iov[i].iov_base = buf[i];
+            iov[i].iov_len = sizeof(buf[i]);
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        n = recvmmsg(th->sock, msgs, SEND_BATCH, flags, NULL);
+        if (n <= 0)
+        {
+            return;
+        }
+        for (i = 0; i < n; i++)
+        {
+            if (upload_frame_parse_ack(buf[i], msgs[i].msg_len, &seq) == ESP_OK)
+            {
+                th->acks++;
+            }
+        }
+    }
+}
+
+static int send_udp(gen_thread_t *th, uint32_t n)
+{
+    struct mmsghdr msgs[SEND_BATCH];
+    struct iovec iov[SEND_BATCH];
+    uint32_t i, done = 0;
+    int got;
+
+    for (i = 0; i < n; i++)
+    {
+        iov[i].iov_base = th->frames[i].buf;
+        iov[i].iov_len = th->frames[i].len;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    while (done < n)
+    {
+        got = sendmmsg(th->sock, &msgs[done], n - done, 0);
+        if (got < 0)
+        {
+            if (errno == EINTR || errno == ENOBUFS)
+            {
+                continue;
+            }
+            th->send_errors++;
+            return -1;
+        }
+        done += (uint32_t)got;
+    }
+    return 0;
+}
+
+static int send_tcp(gen_thread_t *th, uint32_t n)
+{
+    size_t len = 0, off = 0;
+    ssize_t got;
+    uint32_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        th->tcp_buf[len++] = (uint8_t)(th->frames[i].len >> 8);
+        th->tcp_buf[len++] = (uint8_t)th->frames[i].len;
+        memcpy(&th->tcp_buf[len], th->frames[i].buf, th->frames[i].len);
+        len += th->frames[i].len;
+    }
+    while (off < len)
+    {
+        got = write(th->sock, th->tcp_buf + off, len - off);
+        if (got < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            th->send_errors++;
+            return -1;
+        }
+        off += (size_t)got;
+    }
+    return 0;
+}
+
+static void *gen_main(void *arg)
+{
+    gen_thread_t *th = (gen_thread_t *)arg;
+    double start = now_s(), due, now;
+    uint32_t next = 0, n, i;
+
+    while ((now = now_s()) - start < s_seconds)
+    {
+        n = SEND_BATCH;
+        if (th->rate > 0)
+        {
+            /* send what is due, at most a batch, sleep otherwise */
+            due = (now - start) * th->rate - (double)th->sent;
+            if (due < 1)
+            {
+                usleep((useconds_t)((1 - due) / th->rate * 1e6));
+                continue;
+            }
+            n = (due < SEND_BATCH) ? (uint32_t)due : SEND_BATCH;
+        }
+        for (i = 0; i < n; i++)
+        {
+            make_frame(th, &th->devices[next], &th->frames[i]);
+            next = (next + 1 == th->count) ? 0 : next + 1;
+            th->samples += th->frames[i].count;
+            th->bytes += th->frames[i].len;
+        }
+        if ((s_tcp ? send_tcp(th, n) : send_udp(th, n)) < 0)
+        {
+            perror("fleet_loadgen: send");
+            break;
+        }
+        th->sent += n;
+        if (!s_tcp)
+        {
+            drain_acks(th, MSG_DONTWAIT);
+        }
+    }
+    return NULL;
+}
+
+static int open_socket(gen_thread_t *th)
+{
+    struct timeval tv = { 0, ACK_DRAIN_MS * 1000 };
+    int rcvbuf = ACK_RCVBUF;
+
+    th->sock = socket(AF_INET, s_tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+    if (th->sock < 0)
+    {
+        return -1;
+    }
+    /* connected UDP: sendmmsg needs no address and only the collector's acks get in */
+    if (connect(th->sock, (struct sockaddr *)&s_dest, sizeof(s_dest)) < 0)
+    {
+        return -1;
+    }
+    setsockopt(th->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(th->sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    return 0;
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    int port = UPLOAD_FRAME_DEFAULT_PORT, nthreads = 2, check = 0;
+    uint32_t ndevices = 2000, d, first;
+    uint64_t sent = 0, samples = 0, bytes = 0, acks = 0, errors = 0;
+    double rate = 20000, start, elapsed;
+    device_t *devices;
+    int opt, t;
+
+    while ((opt = getopt(argc, argv, "H:p:N:b:r:d:t:Tc")) != -1)
+    {
+        switch (opt)
+        {
+            case 'H': host = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'N': ndevices = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'b': s_samples_per_frame = (unsigned)atoi(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'd': s_seconds = atof(optarg); break;
+            case 't': nthreads = atoi(optarg); break;
+            case 'T': s_tcp = 1; break;
+            case 'c': check = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-H host] [-p port] [-N devices] [-b samples] [-r frames_per_s] "
+                        "[-d seconds] [-t threads] [-T] [-c]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (nthreads < 1 || nthreads > MAX_THREADS || ndevices < (uint32_t)nthreads
+        || s_samples_per_frame < 1 || s_samples_per_frame > UPLOAD_FRAME_MAX_SAMPLES)
+    {
+        fprintf(stderr, "1..%d threads, at least one device per thread, 1..%d samples per frame\n",
+                MAX_THREADS, UPLOAD_FRAME_MAX_SAMPLES);
+        return 2;
+    }
+
+    memset(&s_dest, 0, sizeof(s_dest));
+    s_dest.sin_family = AF_INET;
+    s_dest.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, host, &s_dest.sin_addr) != 1)
+    {
+        fprintf(stderr, "fleet_loadgen: bad address %s\n", host);
+        return 2;
+    }
+
+    /* Espressif's OUI and a serial, rooms spread over a plausible range */
+    if ((devices = calloc(ndevices, sizeof(device_t))) == NULL)
+    {
+        return 1;
+    }
+    for (d = 0; d < ndevices; d++)
+    {
+        devices[d].id[0] = 0x5c;
+        devices[d].id[1] = 0xcf;
+        devices[d].id[2] = 0x7f;
+        devices[d].id[3] = (uint8_t)(d >> 16);
+        devices[d].id[4] = (uint8_t)(d >> 8);
+        devices[d].id[5] = (uint8_t)d;
+        devices[d].seq = (uint16_t)(d * 7919U);
+        devices[d].t_ms = d * 13U;
+        devices[d].hum = 300000 + (int32_t)(d % 97) * 3000;
+        devices[d].temp = 380000 + (int32_t)(d % 53) * 1000;
+    }
+
+    first = 0;
+    for (t = 0; t < nthreads; t++)
+    {
+        s_threads[t].id = t;
+        s_threads[t].devices = &devices[first];
+        s_threads[t].count = (uint32_t)(((uint64_t)ndevices * (t + 1)) / nthreads) - first;
+        s_threads[t].rate = rate / nthreads;
+        s_threads[t].seed = 1234U + (unsigned)t;
+        first += s_threads[t].count;
+        if (open_socket(&s_threads[t]) < 0)
+        {
+            perror("fleet_loadgen: connect");
+            return 1;
+        }
+    }
+
+    start = now_s();
+    for (t = 0; t < nthreads; t++)
+    {
+        pthread_create(&s_threads[t].thread, NULL, gen_main, &s_threads[t]);
+    }
+    for (t = 0; t < nthreads; t++)
+    {
+        pthread_join(s_threads[t].thread, NULL);
+    }
+    elapsed = now_s() - start;
+    for (t = 0; t < nthreads; t++)
+    {
+        if (!s_tcp)
+        {
+            /* blocking now, SO_RCVTIMEO ends it */
+            drain_acks(&s_threads[t], MSG_WAITFORONE);
+        }
+        close(s_threads[t].sock);
+        sent += s_threads[t].sent;
+        samples += s_threads[t].samples;
+        bytes += s_threads[t].bytes;
+        acks += s_threads[t].acks;
+        errors += s_threads[t].send_errors;
+    }
+
+    printf("fleet_loadgen: %u devices over %s, %llu frames (%llu samples, %llu bytes) in %.2f s\n",
+           ndevices, s_tcp ? "tcp" : "udp", (unsigned long long)sent, (unsigned long long)samples,
+           (unsigned long long)bytes, elapsed);
+    printf("  %.0f frames/s, %.0f samples/s sent", sent / elapsed, samples / elapsed);
+    if (!s_tcp)
+    {
+        printf(", %llu acked (%.2f %%)", (unsigned long long)acks, sent ? 100.0 * acks / sent : 0.0);
+    }
+    printf(", %llu send errors\n", (unsigned long long)errors);
+
+    free(devices);
+    if (errors > 0 || (check && !s_tcp && acks * 1000 < sent * ACKED_MIN_PERMILLE))
+    {
+        printf("FAIL\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,226 @@
+/* Round-trips synthetic sensor traces through the batch frame encoder and
+ * decoder in main/upload_frame.c.
+ *
+ * usage: frame_bench [-s samples] [-b batch] [-m sensors] [-u host[:port]]
+ *
+ * Every decoded sample is compared with what went in (non-zero exit on any
+ * difference), then it prints bytes per sample and encode/decode rates.
+ * With -m the trace interleaves that many probes, as the multi-sensor
+ * scheduler produces them.
+ * With -u the encoded frames are also sent over UDP, e.g. to a local
+ * collector, to exercise the whole path end to end; each frame then waits
+ * for the collector's ack like the uploader does and the round trips go
+ * into the upload_rtt_us histogram. */
+
+/* Toolchain headers */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+/* local headers */
+#include "aht10_stats.h"
+#include "upload_frame.h"
+
+#define UPLOAD_ACK_TIMEOUT_US               250000              /* the uploader's UPLOAD_ACK_TIMEOUT_MS */
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* a room per sensor: slow random walk with sensor noise, 5 s cadence with
+ * some jitter, the probes sampled back to back within a cycle */
+static void make_trace(aht10_sample_t *samples, size_t count, unsigned sensors)
+{
+    aht10_reading_t reading;
+    uint32_t t = 12345;
+    int32_t hum[UPLOAD_FRAME_MAX_SENSORS], temp[UPLOAD_FRAME_MAX_SENSORS];
+    unsigned seed = 7;
+    unsigned k;
+    size_t i;
+
+    for (k = 0; k < sensors; k++)
+    {
+        hum[k] = 420000 + (int32_t)k * 30000;
+        temp[k] = 390000 - (int32_t)k * 10000;
+    }
+    for (i = 0; i < count; i++)
+    {
+        k = (unsigned)(i % sensors);
+        hum[k] += (int32_t)(rand_r(&seed) % 601) - 300;
+        temp[k] += (int32_t)(rand_r(&seed) % 201) - 100;
+        reading.status = 0x04 | ((rand_r(&seed) % 500) == 0 ? 0x40 : 0x00);
+        reading.humidity_raw = (uint32_t)hum[k] & AHT10_CODE_MAX;
+        reading.temperature_raw = (uint32_t)temp[k] & AHT10_CODE_MAX;
+        aht10_sample_pack(&samples[i], t, &reading);
+        samples[i].sensor = (uint8_t)k;
+        t += (k + 1 == sensors) ? 5000 + (uint32_t)(rand_r(&seed) % 21) - 10 : 1;
+    }
+}
+
+/* send a frame and wait for its ack, returns 0 once one doesn't come */
+static int send_acked(int sock, const struct sockaddr_in *dest, const upload_frame_t *frame)
+{
+    uint8_t buf[16];
+    uint16_t seq;
+    double t0 = now_s();
+    ssize_t len;
+
+    sendto(sock, frame->buf, frame->len, 0, (const struct sockaddr *)dest, sizeof(*dest));
+    while ((len = recv(sock, buf, sizeof(buf), 0)) >= 0)
+    {
+        if (upload_frame_parse_ack(buf, (size_t)len, &seq) == ESP_OK && seq == frame->seq)
+        {
+            aht10_stats_record(AHT10_STAT_UPLOAD_RTT_US, (uint32_t)((now_s() - t0) * 1e6));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void print_rtt(size_t acked, size_t frames)
+{
+    const aht10_hist_t *hist = aht10_stats_hist(AHT10_STAT_UPLOAD_RTT_US);
+
+    printf("%zu of %zu frames acked", acked, frames);
+    if (hist->count > 0)
+    {
+        printf(", rtt mean %llu us, p50 <= %u us, p99 <= %u us, max %u us",
+               (unsigned long long)(hist->sum / hist->count), aht10_hist_quantile(hist, 500),
+               aht10_hist_quantile(hist, 990), hist->max);
+    }
+    printf("\n");
+}
+
+static int same_sample(const aht10_sample_t *a, const aht10_sample_t *b)
+{
+    return a->timestamp_ms == b->timestamp_ms && a->status == b->status && a->sensor == b->sensor
+           && memcmp(a->data, b->data, sizeof(a->data)) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const uint8_t device_id[UPLOAD_FRAME_DEVICE_ID_LEN] = { 0x5c, 0xcf, 0x7f, 0x00, 0x00, 0x01 };
+    size_t count = 1000000, batch = 24;
+    unsigned sensors = 1;
+    aht10_sample_t *samples, *decoded;
+    upload_frame_t frame;
+    upload_frame_header_t header;
+    struct sockaddr_in dest;
+    struct timeval timeout = { 0, UPLOAD_ACK_TIMEOUT_US };
+    char *host = NULL, *colon;
+    size_t i, j, n, frames = 0, bytes = 0, mismatches = 0, acked = 0;
+    int acking = 1;
+    double t0, encode_s = 0, decode_s = 0;
+    int opt, sock = -1;
+
+    while ((opt = getopt(argc, argv, "s:b:m:u:")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': count = strtoul(optarg, NULL, 0); break;
+            case 'b': batch = strtoul(optarg, NULL, 0); break;
+            case 'm': sensors = (unsigned)strtoul(optarg, NULL, 0); break;
+            case 'u': host = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-s samples] [-b batch] [-m sensors] [-u host[:port]]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (batch == 0 || batch > UPLOAD_FRAME_MAX_SAMPLES)
+    {
+        fprintf(stderr, "batch must be 1..%d\n", UPLOAD_FRAME_MAX_SAMPLES);
+        return 2;
+    }
+    if (sensors == 0 || sensors > UPLOAD_FRAME_MAX_SENSORS)
+    {
+        fprintf(stderr, "sensors must be 1..%d\n", UPLOAD_FRAME_MAX_SENSORS);
+        return 2;
+    }
+
+    if (host != NULL)
+    {
+        memset(&dest, 0, sizeof(dest));
+        dest.sin_family = AF_INET;
+        dest.sin_port = htons(UPLOAD_FRAME_DEFAULT_PORT);
+        if ((colon = strchr(host, ':')) != NULL)
+        {
+            *colon = '\0';
+            dest.sin_port = htons((uint16_t)atoi(colon + 1));
+        }
+        inet_pton(AF_INET, host, &dest.sin_addr);
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    samples = malloc(count * sizeof(*samples));
+    decoded = malloc(UPLOAD_FRAME_MAX_SAMPLES * sizeof(*decoded));
+    make_trace(samples, count, sensors);
+
+    for (i = 0; i < count; i += n)
+    {
+        n = (count - i < batch) ? count - i : batch;
+
+        t0 = now_s();
+        upload_frame_begin(&frame, device_id, (uint16_t)frames);
+        for (j = 0; j < n; j++)
+        {
+            upload_frame_add(&frame, &samples[i + j]);
+        }
+        upload_frame_finish(&frame);
+        encode_s += now_s() - t0;
+
+        t0 = now_s();
+        if (upload_frame_decode(frame.buf, frame.len, &header, decoded, UPLOAD_FRAME_MAX_SAMPLES) != ESP_OK
+            || header.count != n)
+        {
+            mismatches += n;
+        }
+        else
+        {
+            decode_s += now_s() - t0;
+            for (j = 0; j < n; j++)
+            {
+                if (!same_sample(&decoded[j], &samples[i + j]))
+                {
+                    mismatches++;
+                }
+            }
+        }
+
+        if (sock >= 0 && acking)
+        {
+            /* without a collector every frame would sit out the timeout */
+            acking = send_acked(sock, &dest, &frame);
+            acked += (size_t)acking;
+        }
+        else if (sock >= 0)
+        {
+            sendto(sock, frame.buf, frame.len, 0, (struct sockaddr *)&dest, sizeof(dest));
+        }
+        frames++;
+        bytes += frame.len;
+    }
+
+    printf("%zu samples in %zu frames of %zu: %zu bytes, %.2f bytes/sample (%zu in the ring), %zu mismatches\n",
+           count, frames, batch, bytes, (double)bytes / count, sizeof(aht10_sample_t), mismatches);
+    printf("encode %.1f Msamples/s, decode %.1f Msamples/s\n",
+           count / encode_s / 1e6, count / decode_s / 1e6);
+
+    free(samples);
+    free(decoded);
+    if (sock >= 0)
+    {
+        print_rtt(acked, frames);
+        close(sock);
+    }
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+/* associated header file */
+#include "i2c_bus_sim.h"
+
+/* others necessary headers */
+#include <string.h>
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+/* start + (address + payload) * 9 bits + stop, same as aht10_sim charges */
+static void bus_charge(i2c_bus_sim_t *bus, size_t data_len)
+{
+    uint64_t bits = 2 + (1 + (uint64_t)data_len) * 9;
+    *bus->now_us += (int64_t)((bits * 1000000ULL) / bus->bus_hz);
+}
+
+/* the one device that answers addr with the current mux setting, NULL if none */
+static aht10_sim_t *bus_route(i2c_bus_sim_t *bus, uint8_t addr)
+{
+    aht10_sim_t *found = NULL;
+    uint8_t i, channel;
+
+    for (i = 0; i < bus->device_count; i++)
+    {
+        channel = bus->devices[i].channel;
+        if (bus->devices[i].dev->cfg.addr != addr)
+        {
+            continue;
+        }
+        if (channel != I2C_BUS_SIM_ROOT && !(bus->mux_mask & (1U << channel)))
+        {
+            continue;
+        }
+        if (found != NULL)
+        {
+            /* both drive SDA, the master sees the AND of the two */
+            bus->conflicts++;
+            continue;
+        }
+        found = bus->devices[i].dev;
+    }
+    return found;
+}
+
+static esp_err_t bus_init(void *ctx)
+{
+    return ESP_OK;
+}
+
+static esp_err_t bus_write(void *ctx, uint8_t addr, const uint8_t *data, size_t data_len)
+{
+    i2c_bus_sim_t *bus = (i2c_bus_sim_t *)ctx;
+    aht10_sim_t *dev;
+    esp_err_t ret;
+
+    bus->transactions++;
+    if (bus->mux_addr != 0 && addr == bus->mux_addr)
+    {
+        bus_charge(bus, data_len);
+        bus->mux_writes++;
+        if (data_len > 0)
+        {
+            bus->mux_mask = data[data_len - 1];
+        }
+        return ESP_OK;
+    }
+
+    if ((dev = bus_route(bus, addr)) == NULL)
+    {
+        bus_charge(bus, 0);
+        bus->nacks++;
+        return ESP_FAIL;
+    }
+    dev->now_us = *bus->now_us;
+    ret = dev->hal.write(dev->hal.ctx, addr, data, data_len);
+    *bus->now_us = dev->now_us;
+    return ret;
+}
+
+static esp_err_t bus_read(void *ctx, uint8_t addr, uint8_t *data, size_t data_len)
+{
+    i2c_bus_sim_t *bus = (i2c_bus_sim_t *)ctx;
+    aht10_sim_t *dev;
+    esp_err_t ret;
+
+    bus->transactions++;
+    if (bus->mux_addr != 0 && addr == bus->mux_addr)
+    {
+        bus_charge(bus, data_len);
+        memset(data, bus->mux_mask, data_len);
+        return ESP_OK;
+    }
+
+    if ((dev = bus_route(bus, addr)) == NULL)
+    {
+        bus_charge(bus, 0);
+        bus->nacks++;
+        return ESP_FAIL;
+    }
+    dev->now_us = *bus->now_us;
+    ret = dev->hal.read(dev->hal.ctx, addr, data, data_len);
+    *bus->now_us = dev->now_us;
+    return ret;
+}
+
+static void bus_delay_ms(void *ctx, uint32_t ms)
+{
+    i2c_bus_sim_t *bus = (i2c_bus_sim_t *)ctx;
+    *bus->now_us += (int64_t)ms * 1000;
+}
+
+static int64_t bus_time_us(void *ctx)
+{
+    return *((i2c_bus_sim_t *)ctx)->now_us;
+}
+
+static void bus_deinit(void *ctx)
+{
+}
+
+/* clocks reach every device connected right now */
+static esp_err_t bus_recover(void *ctx)
+{
+    i2c_bus_sim_t *bus = (i2c_bus_sim_t *)ctx;
+    aht10_sim_t *dev;
+    uint8_t i;
+
+    bus_charge(bus, 1);
+    for (i = 0; i < bus->device_count; i++)
+    {
+        dev = bus->devices[i].dev;
+        if (bus->devices[i].channel != I2C_BUS_SIM_ROOT && !(bus->mux_mask & (1U << bus->devices[i].channel)))
+        {
+            continue;
+        }
+        /* the bus charged the clocks already, the device's clock catches up
+         * on its next transaction */
+        dev->hal.recover(dev->hal.ctx);
+    }
+    return ESP_OK;
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void i2c_bus_sim_init(i2c_bus_sim_t *bus, uint8_t mux_addr)
+{
+    memset(bus, 0, sizeof(*bus));
+    bus->now_us = &bus->clock_us;
+    bus->bus_hz = AHT10_SIM_BUS_HZ;
+    bus->mux_addr = mux_addr;
+
+    bus->hal.ctx = bus;
+    bus->hal.init = bus_init;
+    bus->hal.write = bus_write;
+    bus->hal.read = bus_read;
+    bus->hal.delay_ms = bus_delay_ms;
+    bus->hal.time_us = bus_time_us;
+    bus->hal.deinit = bus_deinit;
+    bus->hal.recover = bus_recover;
+}
+
+void i2c_bus_sim_share_clock(i2c_bus_sim_t *bus, i2c_bus_sim_t *clock_owner)
+{
+    bus->now_us = clock_owner->now_us;
+}
+
+void i2c_bus_sim_attach(i2c_bus_sim_t *bus, aht10_sim_t *dev, uint8_t channel)
+{
+    if (bus->device_count < I2C_BUS_SIM_MAX_DEVICES)
+    {
+        bus->devices[bus->device_count].dev = dev;
+        bus->devices[bus->device_count].channel = channel;
+        bus->device_count++;
+    }
+}
+
+const aht10_hal_t *i2c_bus_sim_hal(i2c_bus_sim_t *bus)
+{
+    return &bus->hal;
+}
@@ -0,0 +1,50 @@
+#ifndef _I2C_BUS_SIM_H
+#define _I2C_BUS_SIM_H
+
+#include <stdint.h>
+#include "aht10_hal.h"
+#include "aht10_sim.h"
+
+/* Simulated I2C bus with several simulated AHT10s and an optional
+ * TCA9548A-style mux, for host builds.
+ *
+ * The bus owns the virtual clock; each device's own clock is synced to it
+ * around every transaction it sees, so conversions on different devices
+ * run in parallel in virtual time the way they do on real hardware. Devices
+ * sit either directly on the bus or behind one mux channel. Writing the mux
+ * address sets its channel mask, reading it returns the mask. A transaction
+ * nobody answers is NACKed; two devices answering the same address (e.g. two
+ * mux channels enabled at once) count as a conflict.
+ *
+ * Several buses (pin pairs) can share one clock with i2c_bus_sim_share_clock. */
+
+#define I2C_BUS_SIM_MAX_DEVICES     8
+#define I2C_BUS_SIM_ROOT            0xFF        /* device channel: not behind the mux */
+
+typedef struct i2c_bus_sim {
+    int64_t clock_us;
+    int64_t *now_us;                    /* &clock_us, or another bus's */
+    uint32_t bus_hz;
+    uint8_t mux_addr;                   /* 0 = no mux on this bus */
+    uint8_t mux_mask;
+    struct {
+        aht10_sim_t *dev;
+        uint8_t channel;
+    } devices[I2C_BUS_SIM_MAX_DEVICES];
+    uint8_t device_count;
+    aht10_hal_t hal;
+
+    /* statistics */
+    uint32_t transactions;
+    uint32_t mux_writes;
+    uint32_t nacks;
+    uint32_t conflicts;
+} i2c_bus_sim_t;
+
+void i2c_bus_sim_init(i2c_bus_sim_t *bus, uint8_t mux_addr);
+void i2c_bus_sim_share_clock(i2c_bus_sim_t *bus, i2c_bus_sim_t *clock_owner);
+/* channel is a mux channel or I2C_BUS_SIM_ROOT */
+void i2c_bus_sim_attach(i2c_bus_sim_t *bus, aht10_sim_t *dev, uint8_t channel);
+const aht10_hal_t *i2c_bus_sim_hal(i2c_bus_sim_t *bus);
+
+#endif /* _I2C_BUS_SIM_H */
@@ -0,0 +1,439 @@
+/* Decoder for the binary log frames main/aht10_log_esp.c writes to the
+ * console with AHT10_LOG_BINARY set.
+ *
+ * usage: log_decode [file]        decode a capture (or stdin), e.g.
+ *                                 log_decode < /dev/ttyUSB0
+ *        log_decode -t [records]  self test and timing
+ *
+ * Anything between frames (ROM boot messages, panics) is passed through as
+ * text. The format table comes from main/aht10_log.h, so decode with the
+ * same tree the firmware was built from.
+ *
+ * The self test checks that every format only uses conversions that take a
+ * 32-bit argument, hammers the log ring with several writer threads against
+ * a reader (ordering, payloads, written = read + dropped), round-trips the
+ * records through the binary framing including a corrupted stream, and
+ * times a deferred log statement against formatting the same message.
+ * Exits non-zero if a check fails. */
+
+/* Toolchain headers */
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* local headers */
+#include "aht10_log.h"
+
+#define WRITERS                 3
+#define UART_BAUD               115200
+
+static int s_failures;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            s_failures++; \
+        } \
+    } while (0)
+
+typedef struct {
+    uint32_t records;
+    int writers_done;
+    uint32_t seen[WRITERS];             /* last sequence number read per writer */
+    uint32_t read;
+    uint32_t bad;
+} stress_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t test_now_ms(void)
+{
+    return (uint32_t)(now_ns() / 1000000);
+}
+
+/* ====================================
+ * ============= DECODING =============
+ * ==================================== */
+
+static void decode_fd(int fd)
+{
+    static uint8_t buf[4096];
+    aht10_log_record_t rec;
+    char line[AHT10_LOG_LINE_MAX];
+    size_t len = 0, pos, used;
+    ssize_t got;
+    uint32_t frames = 0, bad = 0;
+    esp_err_t err;
+    int eof = 0;
+
+    while (!eof || len > 0)
+    {
+        if (!eof)
+        {
+            got = read(fd, buf + len, sizeof(buf) - len);
+            if (got <= 0)
+            {
+                eof = 1;
+            }
+            else
+            {
+                len += (size_t)got;
+            }
+        }
+
+        pos = 0;
+        while (pos < len)
+        {
+            if (buf[pos] != AHT10_LOG_SYNC)
+            {
+                putchar(buf[pos++]);
+                continue;
+            }
+            err = aht10_log_decode(&buf[pos], len - pos, &rec, &used);
+            if (err == ESP_OK)
+            {
+                aht10_log_format(&rec, line, sizeof(line));
+                puts(line);
+                frames++;
+                pos += used;
+            }
+            else if (err == ESP_ERR_INVALID_SIZE && !eof)
+            {
+                /* partial frame at the end, wait for the rest */
+                break;
+            }
+            else
+            {
+                /* not a frame after all, resync on the next byte */
+                putchar(buf[pos++]);
+                bad++;
+            }
+        }
+        memmove(buf, buf + pos, len - pos);
+        len -= pos;
+        fflush(stdout);
+    }
+    fprintf(stderr, "%u records, %u bytes that weren't a valid frame\n", frames, bad);
+}
+
+/* ====================================
+ * ============ SELF TEST =============
+ * ==================================== */
+
+/* conversions that consume one uint32_t argument */
+static int count_conversions(const char *fmt, int *ok)
+{
+    int n = 0;
+
+    *ok = 1;
+    while (*fmt)
+    {
+        if (*fmt++ != '%')
+        {
+            continue;
+        }
+        while (*fmt && strchr("0-+ #", *fmt))
+        {
+            fmt++;
+        }
+        while (*fmt >= '0' && *fmt <= '9')
+        {
+            fmt++;
+        }
+        if (*fmt == '%')
+        {
+            fmt++;
+        }
+        else if (*fmt && strchr("udxXc", *fmt))
+        {
+            fmt++;
+            n++;
+        }
+        else
+        {
+            *ok = 0;
+            return n;
+        }
+    }
+    return n;
+}
+
+static void check_formats(void)
+{
+    const char *fmt;
+    int ok, n;
+    uint8_t id;
+
+    for (id = 0; id < AHT10_LOG_ID_COUNT; id++)
+    {
+        fmt = aht10_log_fmt(id);
+        CHECK(fmt != NULL, "record %u has no format", id);
+        if (fmt == NULL)
+        {
+            continue;
+        }
+        n = count_conversions(fmt, &ok);
+        CHECK(ok, "record %u: \"%s\" uses a conversion that doesn't take a uint32_t", id, fmt);
+        CHECK(n <= AHT10_LOG_MAX_ARGS, "record %u: \"%s\" has %d conversions", id, fmt, n);
+        CHECK(aht10_log_level_of(id) >= AHT10_LOG_ERROR && aht10_log_level_of(id) <= AHT10_LOG_VERBOSE,
+              "record %u has level %d", id, aht10_log_level_of(id));
+    }
+    printf("%u formats checked\n", AHT10_LOG_ID_COUNT);
+}
+
+/* args derived from writer and sequence number so torn records show up */
+static void fill_args(uint32_t *args, uint32_t writer, uint32_t seq)
+{
+    uint8_t i;
+
+    args[0] = writer;
+    args[1] = seq;
+    for (i = 2; i < AHT10_LOG_MAX_ARGS; i++)
+    {
+        args[i] = seq * 2654435761U + i;
+    }
+}
+
+static stress_t s_stress;
+
+static void *writer(void *arg)
+{
+    uint32_t w = (uint32_t)(uintptr_t)arg;
+    uint32_t args[AHT10_LOG_MAX_ARGS];
+    uint32_t seq;
+
+    for (seq = 1; seq <= s_stress.records; seq++)
+    {
+        fill_args(args, w, seq);
+        aht10_log_put((uint8_t)(seq % AHT10_LOG_ID_COUNT), args, (uint8_t)(2 + seq % (AHT10_LOG_MAX_ARGS - 1)));
+        if ((seq & 7) == 0)
+        {
+            /* give the reader a look in, also on a single core */
+            sched_yield();
+        }
+    }
+    __atomic_fetch_add(&s_stress.writers_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void check_record(stress_t *st, const aht10_log_record_t *rec)
+{
+    uint32_t expect[AHT10_LOG_MAX_ARGS];
+    uint8_t frame[AHT10_LOG_WIRE_MAX];
+    aht10_log_record_t back;
+    uint32_t w = rec->args[0], seq = rec->args[1];
+    size_t used = 0;
+    int ok;
+
+    ok = w < WRITERS && seq > st->seen[w] && rec->id == seq % AHT10_LOG_ID_COUNT
+         && rec->nargs == 2 + seq % (AHT10_LOG_MAX_ARGS - 1);
+    if (ok)
+    {
+        fill_args(expect, w, seq);
+        ok = memcmp(rec->args, expect, rec->nargs * sizeof(uint32_t)) == 0;
+        st->seen[w] = seq;
+    }
+    if (ok)
+    {
+        ok = aht10_log_decode(frame, aht10_log_encode(rec, frame), &back, &used) == ESP_OK
+             && back.id == rec->id && back.nargs == rec->nargs && back.timestamp_ms == rec->timestamp_ms
+             && memcmp(back.args, rec->args, rec->nargs * sizeof(uint32_t)) == 0;
+    }
+    if (!ok)
+    {
+        st->bad++;
+    }
+    st->read++;
+}
+
+static void stress(uint32_t records)
+{
+    pthread_t threads[WRITERS];
+    aht10_log_record_t rec;
+    aht10_log_stats_t stats;
+    uint32_t i;
+
+    memset(&s_stress, 0, sizeof(s_stress));
+    s_stress.records = records;
+    aht10_log_init(test_now_ms);
+
+    for (i = 0; i < WRITERS; i++)
+    {
+        pthread_create(&threads[i], NULL, writer, (void *)(uintptr_t)i);
+    }
+    while (__atomic_load_n(&s_stress.writers_done, __ATOMIC_ACQUIRE) < WRITERS)
+    {
+        if (aht10_log_get(&rec) == ESP_OK)
+        {
+            check_record(&s_stress, &rec);
+        }
+    }
+    for (i = 0; i < WRITERS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    while (aht10_log_get(&rec) == ESP_OK)
+    {
+        check_record(&s_stress, &rec);
+    }
+
+    aht10_log_get_stats(&stats);
+    CHECK(s_stress.bad == 0, "%u torn, reordered or mangled records", s_stress.bad);
+    CHECK(stats.written + stats.dropped == records * WRITERS, "written %u + dropped %u != %u",
+          stats.written, stats.dropped, records * WRITERS);
+    CHECK(stats.read == stats.written && s_stress.read == stats.read, "read %u (counted %u), written %u",
+          s_stress.read, stats.read, stats.written);
+    printf("%d writers x %u records: %u read, %u dropped (ring of %d)\n",
+           WRITERS, records, stats.read, stats.dropped, AHT10_LOG_CAPACITY);
+}
+
+static void check_stream(void)
+{
+    static const char text[] = "ets Jan  8 2013,rst cause:2, boot mode:(3,6)\n";
+    uint8_t stream[1024];
+    aht10_log_record_t rec = { 0 }, back;
+    size_t len = 0, pos = 0, used, n;
+    uint32_t frames = 0, text_bytes = 0;
+    esp_err_t err;
+    int i;
+
+    memcpy(stream, text, sizeof(text) - 1);
+    len = sizeof(text) - 1;
+    for (i = 0; i < 10; i++)
+    {
+        rec.id = (uint8_t)(i % AHT10_LOG_ID_COUNT);
+        rec.nargs = (uint8_t)(i % (AHT10_LOG_MAX_ARGS + 1));
+        rec.timestamp_ms = 1000u * (uint32_t)i + 7;
+        rec.args[0] = 0xFFFFFFFFu;
+        n = aht10_log_encode(&rec, &stream[len]);
+        if (i == 4)
+        {
+            /* line noise in the middle of one frame */
+            stream[len + n / 2] ^= 0x10;
+        }
+        len += n;
+    }
+
+    while (pos < len)
+    {
+        if (stream[pos] != AHT10_LOG_SYNC)
+        {
+            pos++;
+            text_bytes++;
+            continue;
+        }
+        err = aht10_log_decode(&stream[pos], len - pos, &back, &used);
+        if (err == ESP_OK)
+        {
+            frames++;
+            pos += used;
+        }
+        else
+        {
+            pos++;
+        }
+    }
+    CHECK(frames == 9, "%u of 9 intact frames decoded around a corrupt one", frames);
+    CHECK(text_bytes >= sizeof(text) - 1, "text between frames lost");
+
+    /* a frame cut short asks for more bytes rather than failing */
+    n = aht10_log_encode(&rec, stream);
+    CHECK(aht10_log_decode(stream, n - 1, &back, &used) == ESP_ERR_INVALID_SIZE, "truncated frame not reported as such");
+    printf("binary stream: %u frames recovered around a corrupt one\n", frames);
+}
+
+static void timing(void)
+{
+    const uint32_t loops = 200000;
+    aht10_log_record_t rec;
+    char line[AHT10_LOG_LINE_MAX];
+    uint8_t frame[AHT10_LOG_WIRE_MAX];
+    uint32_t hum = 4012, i;
+    int32_t temp = 2150;
+    uint64_t start, deferred_ns, format_ns;
+    size_t text_len = 0, bin_len = 0;
+
+    aht10_log_init(NULL);
+    start = now_ns();
+    for (i = 0; i < loops; i++)
+    {
+        AHT10_LOG(TASK_SAMPLE, i & 7, AHT10_FIX_WHOLE(hum), AHT10_FIX_FRAC(hum),
+                  AHT10_LOG_FIX_SIGN(temp), AHT10_FIX_WHOLE(temp), AHT10_FIX_FRAC(temp));
+        if ((i & 15) == 15)
+        {
+            /* a reader keeps up, otherwise this only measures dropping */
+            while (aht10_log_get(&rec) == ESP_OK)
+            {
+            }
+        }
+    }
+    deferred_ns = now_ns() - start;
+
+    aht10_log_get(&rec);
+    start = now_ns();
+    for (i = 0; i < loops; i++)
+    {
+        text_len = (size_t)snprintf(line, sizeof(line), "sensor %u: hum %lu." AHT10_CONVERT_FRAC_FMT " temp %s%lu."
+                                    AHT10_CONVERT_FRAC_FMT "\n", i & 7, AHT10_FIX_WHOLE(hum), AHT10_FIX_FRAC(hum),
+                                    AHT10_FIX_SIGN(temp), AHT10_FIX_WHOLE(temp), AHT10_FIX_FRAC(temp));
+    }
+    format_ns = now_ns() - start;
+
+    rec.timestamp_ms = 3600000;
+    bin_len = aht10_log_encode(&rec, frame);
+    printf("per sample record: deferred %.1f ns (incl. reader), snprintf %.1f ns on this host\n",
+           (double)deferred_ns / loops, (double)format_ns / loops);
+    printf("on the wire: %zu bytes of text (%.2f ms at %d baud) vs a %zu byte frame (%.2f ms)\n",
+           text_len, text_len * 10.0 * 1000 / UART_BAUD, UART_BAUD, bin_len, bin_len * 10.0 * 1000 / UART_BAUD);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t records = 200000;
+    int fd = STDIN_FILENO;
+
+    if (argc > 1 && strcmp(argv[1], "-t") == 0)
+    {
+        if (argc > 2)
+        {
+            records = (uint32_t)strtoul(argv[2], NULL, 0);
+        }
+        check_formats();
+        stress(records);
+        check_stream();
+        timing();
+        if (s_failures)
+        {
+            printf("%d check(s) failed\n", s_failures);
+            return 1;
+        }
+        printf("all checks passed\n");
+        return 0;
+    }
+
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-'))
+    {
+        fprintf(stderr, "usage: %s [file] | -t [records]\n", argv[0]);
+        return 2;
+    }
+    if (argc == 2 && (fd = open(argv[1], O_RDONLY)) < 0)
+    {
+        perror(argv[1]);
+        return 2;
+    }
+    decode_fd(fd);
+    return 0;
+}
@@ -0,0 +1,337 @@
+/* Runs the multi-sensor scheduler (main/aht10_sched.c) against several
+ * simulated AHT10s behind a simulated TCA9548A, plus optionally one more on
+ * a second bus, all on one virtual clock.
+ *
+ * usage: multi_sensor [-n muxed_sensors] [-a] [-c cycles] [-f sensor]
+ *                     [-k stuck|wedge|sda|nack|timeout] [-v]
+ *
+ * -a adds a sensor on a second bus (pin pair), -f injects a fault into that
+ * sensor, -k says which:
+ *     stuck     busy forever for a stretch of cycles, a dead part (default)
+ *     wedge     busy forever until a soft reset
+ *     sda       holds SDA low until the bus is clocked free
+ *     nack      NACKs as often as the driver retries, absorbed by the retries
+ *     timeout   times out every attempt of one transaction
+ * All but stuck are one-shot and must cost at most one sample, and no fault
+ * may make a cycle longer than the deadline plus timed out retries.
+ *
+ * Compares the time for one round of sequential measurements with one
+ * scheduled cycle, checks every reading against the environment its
+ * simulated sensor sits in, checks that a faulty sensor goes offline without
+ * holding the others up and comes back afterwards (or, for one-shot
+ * faults, recovers by the next cycle), and prints per-sensor health. Exits non-zero if a check fails. */
+
+/* Toolchain headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* local headers */
+#include "aht10_i2c.h"
+#include "aht10_meas.h"
+#include "aht10_mux.h"
+#include "aht10_sched.h"
+#include "aht10_sim.h"
+#include "i2c_bus_sim.h"
+
+#define MAX_SENSORS     AHT10_SCHED_MAX_SENSORS
+
+/* what a fault may cost a cycle: the deadline, one more poll, a transaction
+ * timing out on every attempt and the wait for a soft reset to finish */
+#define FAULT_CYCLE_BOUND_US \
+    ((AHT10_SCHED_DEADLINE_MS + AHT10_MEAS_POLL_MS + (AHT10_I2C_RETRIES + 1) * I2C_AHT10_CMD_TIMEOUT_MS \
+      + AHT10_DELAY_SOFT_RESET) * 1000)
+
+typedef enum {
+    FAULT_STUCK = 0,
+    FAULT_WEDGE,
+    FAULT_SDA,
+    FAULT_NACK,
+    FAULT_TIMEOUT,
+    FAULT_KIND_COUNT,
+} fault_kind_t;
+
+static const char *const s_fault_names[FAULT_KIND_COUNT] = { "stuck", "wedge", "sda", "nack", "timeout" };
+
+static int s_failures;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            s_failures++; \
+        } \
+    } while (0)
+
+/* one round the old way: each sensor's full cycle before the next one starts */
+static int64_t sequential_round(aht10_sched_t *sched, const aht10_hal_t *clock)
+{
+    int64_t start_us = clock->time_us(clock->ctx);
+    aht10_reading_t reading;
+    aht10_meas_t meas;
+    uint32_t next_ms;
+    uint8_t i;
+
+    for (i = 0; i < sched->count; i++)
+    {
+        aht10_meas_init(&meas, sched->sensors[i].hal);
+        if (aht10_meas_start(&meas, &next_ms) != ESP_OK)
+        {
+            continue;
+        }
+        while (meas.state != AHT10_MEAS_CONVERTED)
+        {
+            clock->delay_ms(clock->ctx, next_ms);
+            aht10_meas_step(&meas, &next_ms);
+        }
+        aht10_meas_take(&meas, &reading);
+    }
+    return clock->time_us(clock->ctx) - start_us;
+}
+
+static int parse_fault_kind(const char *name)
+{
+    int kind;
+
+    for (kind = 0; kind < FAULT_KIND_COUNT; kind++)
+    {
+        if (strcmp(name, s_fault_names[kind]) == 0)
+        {
+            return kind;
+        }
+    }
+    return -1;
+}
+
+/* the one-shot faults go in once, at the start of cycle `from` */
+static void inject_fault(aht10_sim_t *dev, int kind, int c, int from, int to)
+{
+    switch (kind)
+    {
+        case FAULT_STUCK:
+            dev->stuck_busy = (c >= from && c < to);
+            break;
+        case FAULT_WEDGE:
+            dev->wedged |= (c == from);
+            break;
+        case FAULT_SDA:
+            dev->stuck_sda |= (c == from);
+            break;
+        case FAULT_NACK:
+            dev->inject_nack = (c == from) ? AHT10_I2C_RETRIES : dev->inject_nack;
+            break;
+        case FAULT_TIMEOUT:
+            dev->inject_timeout = (c == from) ? AHT10_I2C_RETRIES + 1 : dev->inject_timeout;
+            break;
+        default:
+            break;
+    }
+}
+
+static void scheduled_cycle(aht10_sched_t *sched, const aht10_hal_t *clock)
+{
+    uint32_t next_ms;
+
+    if (aht10_sched_start(sched, &next_ms) != ESP_OK)
+    {
+        return;
+    }
+    while (aht10_sched_running(sched))
+    {
+        clock->delay_ms(clock->ctx, next_ms);
+        aht10_sched_step(sched, &next_ms);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static aht10_sim_t devs[MAX_SENSORS];
+    aht10_sim_config_t cfg;
+    i2c_bus_sim_t bus, alt_bus;
+    aht10_mux_t mux;
+    aht10_mux_port_t ports[AHT10_MUX_CHANNELS];
+    aht10_sched_t sched;
+    aht10_reading_t reading;
+    const aht10_hal_t *clock, *hal;
+    const aht10_sensor_t *sensor;
+    int muxed = 4, alt = 0, cycles = 60, fault = -1, kind = FAULT_STUCK, verbose = 0;
+    int fault_from = 3, fault_to, total, opt, c, i, faulty;
+    uint32_t cycle_max_ok = 0, fault_cycle_max = 0, bound_us, tx_before, lost;
+    int64_t sequential_us;
+    int went_offline = 0;
+
+    while ((opt = getopt(argc, argv, "n:ac:f:k:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': muxed = atoi(optarg); break;
+            case 'a': alt = 1; break;
+            case 'c': cycles = atoi(optarg); break;
+            case 'f': fault = atoi(optarg); break;
+            case 'k':
+                if ((kind = parse_fault_kind(optarg)) < 0)
+                {
+                    fprintf(stderr, "unknown fault %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'v': verbose = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-n muxed_sensors] [-a] [-c cycles] [-f sensor] [-k stuck|wedge|sda|nack|timeout] [-v]\n", argv[0]);
+                return 2;
+        }
+    }
+    total = muxed + alt;
+    if (muxed < 0 || muxed > AHT10_MUX_CHANNELS || total < 1 || total > MAX_SENSORS || fault >= total)
+    {
+        fprintf(stderr, "1..%d sensors in total, at most %d behind the mux\n", MAX_SENSORS, AHT10_MUX_CHANNELS);
+        return 2;
+    }
+    /* a one-shot fault may still cost the cycle after it, for the reset */
+    fault_to = (kind == FAULT_STUCK) ? fault_from + AHT10_SCHED_OFFLINE_AFTER + 2 * AHT10_SCHED_PROBE_EVERY
+                                     : fault_from + 2;
+    if (fault >= 0 && cycles < fault_to + AHT10_SCHED_PROBE_EVERY + 2)
+    {
+        cycles = fault_to + AHT10_SCHED_PROBE_EVERY + 2;
+    }
+
+    /* every probe in a different room */
+    i2c_bus_sim_init(&bus, AHT10_MUX_ADDR_DEFAULT);
+    i2c_bus_sim_init(&alt_bus, 0);
+    i2c_bus_sim_share_clock(&alt_bus, &bus);
+    for (i = 0; i < total; i++)
+    {
+        aht10_sim_default_config(&cfg);
+        cfg.temperature_c = 18.0 + 1.5 * i;
+        cfg.humidity_rh = 35.0 + 4.0 * i;
+        cfg.meas_latency_us = AHT10_SIM_MEAS_LATENCY_US - 2000 * (uint32_t)i;
+        aht10_sim_init(&devs[i], &cfg);
+        if (i < muxed)
+        {
+            i2c_bus_sim_attach(&bus, &devs[i], (uint8_t)i);
+        }
+        else
+        {
+            i2c_bus_sim_attach(&alt_bus, &devs[i], I2C_BUS_SIM_ROOT);
+        }
+    }
+    clock = i2c_bus_sim_hal(&bus);
+
+    aht10_sched_init(&sched);
+    aht10_mux_init(&mux, i2c_bus_sim_hal(&bus), AHT10_MUX_ADDR_DEFAULT);
+    for (i = 0; i < total; i++)
+    {
+        hal = (i < muxed) ? aht10_mux_port_init(&ports[i], &mux, (uint8_t)i) : i2c_bus_sim_hal(&alt_bus);
+        aht10_init(hal);
+        aht10_sched_add(&sched, hal, (uint8_t)i);
+    }
+    printf("\n%d sensors behind the mux, %d on a second bus\n", muxed, alt);
+
+    sequential_us = sequential_round(&sched, clock);
+
+    for (c = 1; c <= cycles; c++)
+    {
+        faulty = (fault >= 0 && c >= fault_from && c < fault_to);
+        if (fault >= 0)
+        {
+            inject_fault(&devs[fault], kind, c, fault_from, fault_to);
+        }
+        tx_before = bus.transactions + alt_bus.transactions;
+        scheduled_cycle(&sched, clock);
+
+        for (i = 0; i < total; i++)
+        {
+            sensor = &sched.sensors[i];
+            if (aht10_sched_take(&sched, (uint8_t)i, &reading) != ESP_OK)
+            {
+                /* a recovered sensor stays skipped until its next probe */
+                CHECK(i == fault && (faulty || sensor->health.state == AHT10_HEALTH_OFFLINE),
+                      "cycle %d: no reading from healthy sensor %d", c, i);
+                continue;
+            }
+            CHECK(reading.humidity_raw == aht10_sim_humidity_code(devs[i].cfg.humidity_rh)
+                  && reading.temperature_raw == aht10_sim_temperature_code(devs[i].cfg.temperature_c),
+                  "cycle %d: sensor %d read another sensor's values", c, i);
+            if (verbose)
+            {
+                printf("  cycle %d sensor %u: hum %lu." AHT10_CONVERT_FRAC_FMT " temp %s%lu." AHT10_CONVERT_FRAC_FMT " C\n",
+                       c, sensor->id, AHT10_FIX_WHOLE(reading.humidity), AHT10_FIX_FRAC(reading.humidity),
+                       AHT10_FIX_SIGN(reading.temperature), AHT10_FIX_WHOLE(reading.temperature),
+                       AHT10_FIX_FRAC(reading.temperature));
+            }
+        }
+        if (fault >= 0 && sched.sensors[fault].health.state == AHT10_HEALTH_OFFLINE)
+        {
+            went_offline = 1;
+        }
+
+        if (faulty)
+        {
+            if (sched.cycle_us > fault_cycle_max)
+            {
+                fault_cycle_max = sched.cycle_us;
+            }
+        }
+        else if (sched.cycle_us > cycle_max_ok)
+        {
+            cycle_max_ok = sched.cycle_us;
+        }
+        if (verbose)
+        {
+            printf("  cycle %d: %u us, %u transactions\n", c, sched.cycle_us,
+                   bus.transactions + alt_bus.transactions - tx_before);
+        }
+        /* idle until the next sample period */
+        clock->delay_ms(clock->ctx, 5000);
+    }
+
+    /* one conversion window plus a few transactions (trigger, read, mux
+     * select) per sensor, not one window per sensor */
+    bound_us = AHT10_MEAS_EXPECTED_MS * 1000 + AHT10_MEAS_POLL_MS * 1000 + (uint32_t)total * 2000;
+    CHECK(cycle_max_ok <= bound_us, "cycle took %u us, expected under %u", cycle_max_ok, bound_us);
+    CHECK(bus.conflicts == 0, "%u bus conflicts", bus.conflicts);
+    printf("sequential round %lld us, scheduled cycle %u us worst (%.1fx), %u mux selects\n",
+           (long long)sequential_us, cycle_max_ok, (double)sequential_us / cycle_max_ok, mux.selects);
+
+    if (fault >= 0)
+    {
+        sensor = &sched.sensors[fault];
+        lost = (uint32_t)cycles - sensor->health.samples - sensor->health.skipped;
+        if (kind == FAULT_STUCK)
+        {
+            CHECK(went_offline, "sensor %d never went offline while stuck", fault);
+        }
+        else
+        {
+            CHECK(!went_offline, "sensor %d went offline over a one-shot fault", fault);
+            CHECK(lost <= ((kind == FAULT_NACK) ? 0U : 1U), "sensor %d lost %u samples to a one-shot fault", fault, lost);
+        }
+        CHECK(sensor->health.state == AHT10_HEALTH_OK, "sensor %d didn't recover", fault);
+        CHECK(fault_cycle_max <= FAULT_CYCLE_BOUND_US, "a %s fault held the cycle up for %u us (bound %u)",
+              s_fault_names[kind], fault_cycle_max, FAULT_CYCLE_BOUND_US);
+        printf("sensor %d %s fault over cycles %d..%d: worst cycle %u us (bound %u), %u samples lost, "
+               "%u skipped while offline, %u recoveries, %u i2c retries\n",
+               fault, s_fault_names[kind], fault_from, fault_to - 1, fault_cycle_max, FAULT_CYCLE_BOUND_US, lost,
+               sensor->health.skipped, sensor->health.recoveries, aht10_i2c_retries());
+    }
+
+    printf("sensor  state     samples  missed  trig_err  skipped  latency_us  max_us\n");
+    for (i = 0; i < total; i++)
+    {
+        sensor = &sched.sensors[i];
+        printf("%6u  %-8s  %7u  %6u  %8u  %7u  %10u  %6u\n", sensor->id, aht10_health_name(sensor->health.state),
+               sensor->health.samples, sensor->health.missed, sensor->health.trigger_errors,
+               sensor->health.skipped, sensor->health.latency_us, sensor->health.latency_max_us);
+    }
+
+    if (s_failures)
+    {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,162 @@
+/* Two-thread stress run of the sample ring in main/sample_ring.c.
+ *
+ * usage: stress_ring [samples] [consumer_stall_us] [producer_pace_ns]
+ *
+ * The producer pushes sequence numbers (in timestamp_ms) at a steady pace,
+ * the consumer pops them and every so often stalls like a dead network link.
+ * For both overflow policies it checks that the consumer only ever sees
+ * increasing sequence numbers with intact payloads, that every sample is
+ * accounted for as either popped or dropped, and reports the worst push time
+ * to show the producer never waited on the consumer. Exits non-zero on any
+ * inconsistency. */
+
+/* Toolchain headers */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/* local headers */
+#include "sample_ring.h"
+
+typedef struct {
+    sample_ring_t ring;
+    uint32_t samples;
+    uint32_t stall_us;
+    uint32_t pace_ns;
+    volatile int producer_done;
+    uint64_t push_max_ns;
+    uint64_t push_total_ns;
+    uint32_t errors;
+    uint32_t seen;
+} stress_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* payload derived from the sequence number so torn copies show up */
+static void fill(aht10_sample_t *sample, uint32_t seq)
+{
+    aht10_reading_t reading;
+
+    reading.status = (uint8_t)seq;
+    reading.humidity_raw = (seq * 2654435761U) & AHT10_CODE_MAX;
+    reading.temperature_raw = (seq ^ 0x5A5A5) & AHT10_CODE_MAX;
+    aht10_sample_pack(sample, seq, &reading);
+}
+
+static void *producer(void *arg)
+{
+    stress_t *st = (stress_t *)arg;
+    aht10_sample_t sample;
+    uint32_t seq;
+    uint64_t start, elapsed, next;
+
+    next = now_ns();
+    for (seq = 1; seq <= st->samples; seq++)
+    {
+        /* spin rather than sleep so the cadence stays tight */
+        next += st->pace_ns;
+        while (now_ns() < next)
+        {
+        }
+
+        fill(&sample, seq);
+        start = now_ns();
+        sample_ring_push(&st->ring, &sample);
+        elapsed = now_ns() - start;
+        st->push_total_ns += elapsed;
+        if (elapsed > st->push_max_ns)
+        {
+            st->push_max_ns = elapsed;
+        }
+    }
+    __atomic_store_n(&st->producer_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    stress_t *st = (stress_t *)arg;
+    aht10_sample_t sample, expect;
+    uint32_t last = 0;
+    unsigned seed = 1;
+
+    while (1)
+    {
+        if (sample_ring_pop(&st->ring, &sample) != ESP_OK)
+        {
+            if (__atomic_load_n(&st->producer_done, __ATOMIC_ACQUIRE) && sample_ring_occupancy(&st->ring) == 0)
+            {
+                break;
+            }
+            continue;
+        }
+
+        fill(&expect, sample.timestamp_ms);
+        if (sample.timestamp_ms <= last || sample.status != expect.status
+            || aht10_sample_humidity_raw(&sample) != aht10_sample_humidity_raw(&expect)
+            || aht10_sample_temperature_raw(&sample) != aht10_sample_temperature_raw(&expect))
+        {
+            if (st->errors < 10)
+            {
+                printf("  bad sample: seq %u after %u\n", sample.timestamp_ms, last);
+            }
+            st->errors++;
+        }
+        last = sample.timestamp_ms;
+        st->seen++;
+
+        /* every so often the "network" goes away for a while */
+        if (st->stall_us && (rand_r(&seed) % 1024) == 0)
+        {
+            usleep(st->stall_us);
+        }
+    }
+    return NULL;
+}
+
+static int run(sample_ring_policy_t policy, const char *name, uint32_t samples, uint32_t stall_us, uint32_t pace_ns)
+{
+    stress_t *st = calloc(1, sizeof(*st));
+    pthread_t prod, cons;
+    int ok;
+
+    sample_ring_init(&st->ring, policy);
+    st->samples = samples;
+    st->stall_us = stall_us;
+    st->pace_ns = pace_ns;
+
+    pthread_create(&cons, NULL, consumer, st);
+    pthread_create(&prod, NULL, producer, st);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+
+    ok = st->errors == 0
+         && st->ring.pushed == samples
+         && st->ring.popped == st->seen
+         && st->ring.popped + st->ring.dropped == samples;
+
+    printf("%-11s pushed %u popped %u dropped %u high water %u/%u, push avg %.1f ns worst %llu ns, %u bad -> %s\n",
+           name, st->ring.pushed, st->ring.popped, st->ring.dropped, st->ring.high_water, SAMPLE_RING_CAPACITY,
+           (double)st->push_total_ns / samples, (unsigned long long)st->push_max_ns, st->errors, ok ? "ok" : "FAIL");
+    free(st);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t samples = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 2000000;
+    uint32_t stall_us = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 200;
+    uint32_t pace_ns = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 0) : 250;
+    int ret = 0;
+
+    ret |= run(SAMPLE_RING_DROP_OLDEST, "drop-oldest", samples, stall_us, pace_ns);
+    ret |= run(SAMPLE_RING_DOWNSAMPLE, "downsample", samples, stall_us, pace_ns);
+    return ret;
+}
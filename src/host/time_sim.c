@@ -0,0 +1,513 @@
+/* Time base simulation (main/time_base.c): a device with a skewed clock
+ * syncing to an SNTP server over a jittery network, and how far the UTC
+ * times its frames carry are from the truth.
+ *
+ * usage: time_sim [-d days] [-s sleep_skew_ppm] [-j jitter_ms] [-f fail_pct] [-v]
+ *
+ * Two devices are simulated on a virtual clock, each running the real time
+ * base and the real SNTP request/parse code against a server here:
+ *  - deep sleep: the RTC clock runs -s ppm (default 3 %) fast with a daily
+ *    swing of a sixth of that (temperature), samples every 5 minutes are
+ *    buffered and converted right after the sync of the flush every 2 hours,
+ *    like main/deep_sleep.c does
+ *  - always on: the crystal is 25 ppm off with a 5 ppm swing, samples are
+ *    converted as they are taken and the clock resyncs every
+ *    TIME_SYNC_RESYNC_MS, like main/uploader.c does
+ * Each sync makes TIME_SYNC_TRIES exchanges and keeps the fastest, with
+ * independent random delay each way (-j on top of 20 ms); -f of them fail
+ * outright. The device clock starts 2 days before its 32-bit wrap. Every
+ * converted sample goes through the frame encoder and reader, and its UTC is
+ * compared with the true time, next to what a time base that only tracks
+ * the offset would give and what stamping on arrival at the collector
+ * would. -v prints every sync.
+ *
+ * Checks (non-zero exit on failure): SNTP replies that aren't for this
+ * request, or from an unsynchronized server, are rejected; timestamps past
+ * the 2036 NTP era wrap convert; frames from an unsynced device stay on the
+ * device clock; a resync that steps the clock back mid-frame gets the
+ * later samples refused instead of wrapping their deltas; once the skew is
+ * known the corrected error stays under the scenario's bound and a given
+ * factor under the offset-only one. What is
+ * left is the skew wandering within an interval: with the deep sleep
+ * defaults about dS * T / 8, 2.6 s for the dS = 2600 ppm the swing moves in
+ * 2 hours. */
+
+/* Toolchain headers */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* local headers */
+#include "rtc_store.h"
+#include "time_base.h"
+#include "time_sync.h"
+#include "upload_frame.h"
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); s_failures++; } } while (0)
+
+#define SIM_T0_UTC_MS                       1792108800000LL     /* 2026-10-16 00:00 UTC */
+#define SIM_DAY_MS                          (24.0 * 60 * 60 * 1000)
+#define SIM_LOCAL_START_MS                  (UINT32_MAX - 2 * 24 * 60 * 60 * 1000U)
+#define SIM_ONE_WAY_MS                      20.0
+#define SIM_HOLD_MS                         1.0                 /* server receive to transmit */
+#define SIM_PENDING_MAX                     (RTC_STORE_CAPACITY * 8)
+
+typedef struct sim_scenario {
+    const char *name;
+    double skew_ppm;                    /* device clock slow by this: true time runs faster */
+    double swing_ppm;                   /* daily sinusoid on top */
+    uint32_t period_ms;                 /* one sample per period */
+    uint32_t sync_ms;                   /* deep sleep: flush interval, always on: resync */
+    int at_flush;                       /* convert buffered samples after the sync, not when taken */
+    double bound_ms;                    /* worst corrected error the check allows */
+    double min_gain;                    /* ... and how much better than offset only it has to be */
+} sim_scenario_t;
+
+typedef struct sim_error {
+    double max_ms;
+    double sum_ms;
+    unsigned long n;
+} sim_error_t;
+
+typedef struct sim_device {
+    const sim_scenario_t *sc;
+    double true_ms;                     /* UTC, what the device should stamp */
+    uint32_t local_ms;                  /* its clock */
+    time_base_t tb;
+    time_base_t flat;                   /* same syncs, skew left at 0 */
+    double pending_true[SIM_PENDING_MAX];
+    uint32_t pending_local[SIM_PENDING_MAX];
+    size_t pending;
+    unsigned seed;
+
+    /* results */
+    sim_error_t corrected;
+    sim_error_t offset_only;
+    sim_error_t arrival;
+    unsigned long unsynced_samples;
+    unsigned long syncs;
+    unsigned long failed_syncs;
+    double max_sync_error_ms;
+} sim_device_t;
+
+static unsigned s_failures;
+static double s_jitter_ms = 40.0;
+static unsigned s_fail_pct = 10;
+static int s_verbose;
+
+static double uniform(unsigned *seed)
+{
+    return (double)rand_r(seed) / RAND_MAX;
+}
+
+static uint64_t unix_ms_to_ntp(double unix_ms)
+{
+    double seconds = unix_ms / 1000.0 + (double)TIME_BASE_NTP_UNIX_OFFSET_S;
+    double whole = floor(seconds);
+
+    /* past 2036 the seconds field wraps, the parser has to bring it back */
+    return ((uint64_t)(whole - (whole >= 4294967296.0 ? 4294967296.0 : 0.0)) << 32)
+           | (uint64_t)((seconds - whole) * 4294967296.0);
+}
+
+static void put_be64(uint8_t *p, uint64_t v)
+{
+    int i;
+
+    for (i = 7; i >= 0; i--)
+    {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+/* answers a request in place the way a stratum 2 server does */
+static void server_reply(uint8_t *buf, double rx_utc_ms, double tx_utc_ms)
+{
+    uint8_t originate[8];
+
+    memcpy(originate, &buf[40], 8);
+    memset(buf, 0, TIME_BASE_SNTP_PACKET_LEN);
+    buf[0] = (0 << 6) | (4 << 3) | 4;   /* no leap warning, version 4, server */
+    buf[1] = 2;
+    memcpy(&buf[24], originate, 8);
+    put_be64(&buf[32], unix_ms_to_ntp(rx_utc_ms));
+    put_be64(&buf[40], unix_ms_to_ntp(tx_utc_ms));
+}
+
+static double skew_at(const sim_scenario_t *sc, double true_ms)
+{
+    return sc->skew_ppm + sc->swing_ppm * sin(2 * M_PI * true_ms / SIM_DAY_MS);
+}
+
+/* device time for a true interval starting now */
+static uint32_t local_span(const sim_device_t *dev, double true_span_ms)
+{
+    return (uint32_t)llround(true_span_ms / (1.0 + skew_at(dev->sc, dev->true_ms) / 1e6));
+}
+
+/* what time_sync_run() does, against the simulated server and network */
+static esp_err_t sim_sync(sim_device_t *dev)
+{
+    uint8_t buf[TIME_BASE_SNTP_PACKET_LEN];
+    uint32_t recv_ms, rtt_ms, best_rtt_ms = UINT32_MAX, best_local_ms = 0;
+    double up_ms, down_ms, sent_true_ms;
+    int64_t utc_ms, best_utc_ms = 0;
+    uint64_t nonce;
+    int32_t error;
+    int i;
+
+    if (uniform(&dev->seed) * 100 < s_fail_pct)
+    {
+        dev->failed_syncs++;
+        return ESP_ERR_TIMEOUT;
+    }
+    for (i = 0; i < TIME_SYNC_TRIES; i++)
+    {
+        nonce = ((uint64_t)rand_r(&dev->seed) << 32) | (uint32_t)rand_r(&dev->seed);
+        time_base_sntp_request(buf, nonce);
+        up_ms = SIM_ONE_WAY_MS + uniform(&dev->seed) * s_jitter_ms;
+        down_ms = SIM_ONE_WAY_MS + uniform(&dev->seed) * s_jitter_ms;
+        sent_true_ms = dev->true_ms + i * TIME_SYNC_TIMEOUT_MS;
+        server_reply(buf, sent_true_ms + up_ms, sent_true_ms + up_ms + SIM_HOLD_MS);
+        recv_ms = dev->local_ms + local_span(dev, i * TIME_SYNC_TIMEOUT_MS + up_ms + SIM_HOLD_MS + down_ms);
+        if (time_base_sntp_parse(buf, sizeof(buf), nonce, dev->local_ms + local_span(dev, i * TIME_SYNC_TIMEOUT_MS),
+                                 recv_ms, &utc_ms, &rtt_ms) == ESP_OK
+            && rtt_ms < best_rtt_ms)
+        {
+            best_rtt_ms = rtt_ms;
+            best_local_ms = recv_ms;
+            best_utc_ms = utc_ms;
+        }
+    }
+    CHECK(best_rtt_ms != UINT32_MAX, "%s: no SNTP reply parsed", dev->sc->name);
+    if (best_rtt_ms == UINT32_MAX)
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    error = time_base_sync(&dev->tb, best_local_ms, best_utc_ms);
+    time_base_sync(&dev->flat, best_local_ms, best_utc_ms);
+    dev->flat.skew_ppm = 0;
+    dev->flat.interval_ppm = 0;
+    dev->syncs++;
+    if (dev->tb.skew_estimates >= 2 && fabs((double)error) > dev->max_sync_error_ms)
+    {
+        dev->max_sync_error_ms = fabs((double)error);
+    }
+    if (s_verbose)
+    {
+        printf("  %s: sync %lu at day %.2f, rtt %u ms, error %d ms, skew %d ppm (true %.0f)\n",
+               dev->sc->name, dev->syncs, (dev->true_ms - SIM_T0_UTC_MS) / SIM_DAY_MS, best_rtt_ms, error,
+               dev->tb.skew_ppm, skew_at(dev->sc, dev->true_ms));
+    }
+    return ESP_OK;
+}
+
+static void record(sim_error_t *e, double error_ms)
+{
+    error_ms = fabs(error_ms);
+    if (error_ms > e->max_ms)
+    {
+        e->max_ms = error_ms;
+    }
+    e->sum_ms += error_ms;
+    e->n++;
+}
+
+/* n pending samples through time_base_frame_add(), the encoder and the
+ * reader, and against the truth */
+static void convert(sim_device_t *dev, const time_base_t *tb, size_t first, size_t n, sim_error_t *e)
+{
+    static upload_frame_t frame;
+    static const uint8_t device_id[UPLOAD_FRAME_DEVICE_ID_LEN] = { 0x5c, 0xcf, 0x7f, 0, 0, 1 };
+    upload_frame_reader_t reader;
+    aht10_sample_t sample;
+    size_t i;
+
+    memset(&sample, 0, sizeof(sample));
+    upload_frame_begin(&frame, device_id, 0);
+    for (i = 0; i < n; i++)
+    {
+        sample.timestamp_ms = dev->pending_local[first + i];
+        CHECK(time_base_frame_add(tb, &frame, &sample) == ESP_OK, "%s: frame_add failed", dev->sc->name);
+    }
+    upload_frame_finish(&frame);
+    CHECK(upload_frame_reader_init(&reader, frame.buf, frame.len) == ESP_OK, "%s: frame doesn't decode", dev->sc->name);
+
+    if (!(reader.header.flags & UPLOAD_FRAME_FLAG_UTC))
+    {
+        CHECK(!time_base_valid(tb), "%s: synced device sent a frame on the device clock", dev->sc->name);
+        dev->unsynced_samples += n;
+        return;
+    }
+    for (i = 0; i < n && upload_frame_reader_next(&reader, &sample) == ESP_OK; i++)
+    {
+        if (e != NULL)
+        {
+            record(e, (double)reader.header.epoch_s * 1000 + sample.timestamp_ms - dev->pending_true[first + i]);
+        }
+    }
+    CHECK(i == n, "%s: %zu of %zu samples came back", dev->sc->name, i, n);
+}
+
+static void emit(sim_device_t *dev)
+{
+    size_t i, n;
+    int skew_known = dev->tb.skew_estimates >= 2;
+
+    for (i = 0; i < dev->pending; i += n)
+    {
+        n = dev->pending - i;
+        if (n > UPLOAD_FRAME_MAX_SAMPLES)
+        {
+            n = UPLOAD_FRAME_MAX_SAMPLES;
+        }
+        convert(dev, &dev->tb, i, n, skew_known ? &dev->corrected : NULL);
+        if (time_base_valid(&dev->tb))
+        {
+            convert(dev, &dev->flat, i, n, skew_known ? &dev->offset_only : NULL);
+        }
+    }
+    for (i = 0; skew_known && i < dev->pending; i++)
+    {
+        record(&dev->arrival, dev->true_ms - dev->pending_true[i]);
+    }
+    dev->pending = 0;
+}
+
+static void run(sim_device_t *dev, const sim_scenario_t *sc, uint32_t days, unsigned seed)
+{
+    double end_ms = SIM_T0_UTC_MS + days * SIM_DAY_MS;
+    double next_sync_ms = SIM_T0_UTC_MS + sc->sync_ms;
+    uint32_t step;
+    int ok;
+
+    memset(dev, 0, sizeof(*dev));
+    dev->sc = sc;
+    dev->seed = seed;
+    dev->true_ms = SIM_T0_UTC_MS;
+    dev->local_ms = SIM_LOCAL_START_MS;
+    time_base_init(&dev->tb);
+    time_base_init(&dev->flat);
+
+    /* the always-on firmware syncs as soon as the link comes up */
+    if (!sc->at_flush)
+    {
+        sim_sync(dev);
+    }
+    while (dev->true_ms < end_ms)
+    {
+        /* the device sleeps (or waits) period_ms on its own clock */
+        step = sc->period_ms;
+        dev->true_ms += step * (1.0 + skew_at(sc, dev->true_ms) / 1e6);
+        dev->local_ms += step;
+
+        dev->pending_true[dev->pending] = dev->true_ms;
+        dev->pending_local[dev->pending] = dev->local_ms;
+        dev->pending++;
+        if (!sc->at_flush)
+        {
+            emit(dev);
+        }
+
+        if (dev->true_ms >= next_sync_ms)
+        {
+            /* a failed flush keeps the samples and retries on a later wake, like rtc_store */
+            ok = (sim_sync(dev) == ESP_OK);
+            if (sc->at_flush && (ok || dev->pending == SIM_PENDING_MAX))
+            {
+                emit(dev);
+            }
+            next_sync_ms = dev->true_ms + (ok ? sc->sync_ms : TIME_SYNC_RETRY_MS);
+        }
+    }
+}
+
+static void report(const sim_device_t *dev)
+{
+    const sim_scenario_t *sc = dev->sc;
+
+    printf("%s: clock %+.0f ppm (swing %.0f), sample every %u s, sync every %.1f h\n", sc->name, sc->skew_ppm,
+           sc->swing_ppm, sc->period_ms / 1000, sc->sync_ms / 3600000.0);
+    printf("  %lu syncs (%lu failed), %lu samples before the first, skew estimate %d ppm, worst sync step %.0f ms\n",
+           dev->syncs, dev->failed_syncs, dev->unsynced_samples, dev->tb.skew_ppm, dev->max_sync_error_ms);
+    printf("  error over %lu samples   mean      max\n", dev->corrected.n);
+    printf("    skew corrected       %8.1f %8.1f ms\n", dev->corrected.sum_ms / dev->corrected.n, dev->corrected.max_ms);
+    printf("    offset only          %8.1f %8.1f ms\n", dev->offset_only.sum_ms / dev->offset_only.n,
+           dev->offset_only.max_ms);
+    if (sc->at_flush)
+    {
+        printf("    stamped on arrival   %8.1f %8.1f ms\n", dev->arrival.sum_ms / dev->arrival.n, dev->arrival.max_ms);
+    }
+
+    CHECK(dev->corrected.n > 0, "%s: no samples after the skew was known", sc->name);
+    CHECK(dev->corrected.max_ms <= sc->bound_ms, "%s: corrected error %.1f ms over the %.0f ms bound", sc->name,
+          dev->corrected.max_ms, sc->bound_ms);
+    CHECK(dev->corrected.max_ms * sc->min_gain <= dev->offset_only.max_ms,
+          "%s: skew correction only got the error from %.1f to %.1f ms", sc->name, dev->offset_only.max_ms,
+          dev->corrected.max_ms);
+}
+
+static void check_sntp(void)
+{
+    uint8_t buf[TIME_BASE_SNTP_PACKET_LEN], good[TIME_BASE_SNTP_PACKET_LEN];
+    const uint64_t nonce = 0x0123456789abcdefULL;
+    const double t_ms = (double)SIM_T0_UTC_MS;
+    int64_t utc_ms;
+    uint32_t rtt_ms;
+
+    time_base_sntp_request(good, nonce);
+    CHECK((good[0] & 0x07) == 3 && ((good[0] >> 3) & 0x07) == 4, "request isn't a version 4 client packet");
+    server_reply(good, t_ms + 30, t_ms + 32);
+    CHECK(time_base_sntp_parse(good, sizeof(good), nonce, 1000, 1100, &utc_ms, &rtt_ms) == ESP_OK,
+          "good reply rejected");
+    /* 100 ms round trip, 2 of it at the server: 49 ms back */
+    CHECK(rtt_ms == 100 && llabs(utc_ms - (int64_t)(t_ms + 32 + 49)) <= 1, "reply gave %lld ms, rtt %u",
+          (long long)(utc_ms - (int64_t)t_ms), rtt_ms);
+
+    CHECK(time_base_sntp_parse(good, sizeof(good), nonce + 1, 1000, 1100, &utc_ms, &rtt_ms) == ESP_ERR_INVALID_RESPONSE,
+          "reply to another request accepted");
+    CHECK(time_base_sntp_parse(good, sizeof(good) - 1, nonce, 1000, 1100, &utc_ms, &rtt_ms) == ESP_ERR_INVALID_SIZE,
+          "short reply accepted");
+    memcpy(buf, good, sizeof(buf));
+    buf[0] |= 3 << 6;
+    CHECK(time_base_sntp_parse(buf, sizeof(buf), nonce, 1000, 1100, &utc_ms, &rtt_ms) == ESP_ERR_INVALID_RESPONSE,
+          "unsynchronized server accepted");
+    memcpy(buf, good, sizeof(buf));
+    buf[1] = 0;
+    CHECK(time_base_sntp_parse(buf, sizeof(buf), nonce, 1000, 1100, &utc_ms, &rtt_ms) == ESP_ERR_INVALID_RESPONSE,
+          "kiss-o'-death accepted");
+    memcpy(buf, good, sizeof(buf));
+    buf[0] = (buf[0] & ~0x07) | 3;
+    CHECK(time_base_sntp_parse(buf, sizeof(buf), nonce, 1000, 1100, &utc_ms, &rtt_ms) == ESP_ERR_INVALID_RESPONSE,
+          "client packet taken for a reply");
+
+    /* 2040-01-01, after the NTP seconds wrapped in 2036 */
+    time_base_sntp_request(buf, nonce);
+    server_reply(buf, 2208988800000.0, 2208988800000.0);
+    CHECK(time_base_sntp_parse(buf, sizeof(buf), nonce, 0, 0, &utc_ms, &rtt_ms) == ESP_OK
+          && utc_ms == 2208988800000LL, "2040 came back as %lld", (long long)utc_ms);
+}
+
+static void check_frames(void)
+{
+    static upload_frame_t frame;
+    static const uint8_t device_id[UPLOAD_FRAME_DEVICE_ID_LEN] = { 0 };
+    upload_frame_header_t header;
+    aht10_sample_t sample, out[2];
+    time_base_t tb;
+
+    memset(&sample, 0, sizeof(sample));
+    time_base_init(&tb);
+    CHECK(time_base_to_utc(&tb, 1234) == 0, "unsynced time base converted");
+
+    /* unsynced: plain device clock frame */
+    upload_frame_begin(&frame, device_id, 1);
+    sample.timestamp_ms = 5000;
+    time_base_frame_add(&tb, &frame, &sample);
+    upload_frame_finish(&frame);
+    CHECK(upload_frame_decode(frame.buf, frame.len, &header, out, 2) == ESP_OK
+          && !(header.flags & UPLOAD_FRAME_FLAG_UTC) && out[0].timestamp_ms == 5000,
+          "unsynced frame isn't on the device clock");
+
+    /* synced: the epoch is the first sample's UTC second, the rest offsets from it */
+    time_base_sync(&tb, 1000, SIM_T0_UTC_MS + 750);
+    upload_frame_begin(&frame, device_id, 2);
+    sample.timestamp_ms = 2000;
+    time_base_frame_add(&tb, &frame, &sample);
+    CHECK(upload_frame_set_epoch(&frame, 0) == ESP_ERR_INVALID_STATE, "epoch moved after the first sample");
+    sample.timestamp_ms = 7000;
+    time_base_frame_add(&tb, &frame, &sample);
+    upload_frame_finish(&frame);
+    CHECK(upload_frame_decode(frame.buf, frame.len, &header, out, 2) == ESP_OK
+          && (header.flags & UPLOAD_FRAME_FLAG_UTC) && header.epoch_s == SIM_T0_UTC_MS / 1000 + 1
+          && out[0].timestamp_ms == 750 && out[1].timestamp_ms == 5750,
+          "synced frame: epoch %u, times %u %u", header.epoch_s, out[0].timestamp_ms, out[1].timestamp_ms);
+    CHECK(frame.len <= UPLOAD_FRAME_MAX_LEN, "frame over UPLOAD_FRAME_MAX_LEN");
+
+    /* a resync that steps the clock back in the middle of a frame: the
+     * samples after it are refused, the frame stays decodable as it was */
+    time_base_init(&tb);
+    time_base_sync(&tb, 1000, SIM_T0_UTC_MS + 750);
+    upload_frame_begin(&frame, device_id, 3);
+    sample.timestamp_ms = 2000;
+    time_base_frame_add(&tb, &frame, &sample);
+    sample.timestamp_ms = 7000;
+    time_base_frame_add(&tb, &frame, &sample);
+    time_base_sync(&tb, 8000, SIM_T0_UTC_MS + 750 + 7000 - 3000);
+    sample.timestamp_ms = 9000;
+    CHECK(time_base_frame_add(&tb, &frame, &sample) == ESP_ERR_INVALID_ARG, "sample before the previous one taken");
+    time_base_sync(&tb, 10000, SIM_T0_UTC_MS - 5000);
+    sample.timestamp_ms = 10000;
+    CHECK(time_base_frame_add(&tb, &frame, &sample) == ESP_ERR_INVALID_ARG, "sample before the epoch taken");
+    upload_frame_finish(&frame);
+    CHECK(upload_frame_decode(frame.buf, frame.len, &header, out, 2) == ESP_OK && header.count == 2
+          && out[0].timestamp_ms == 750 && out[1].timestamp_ms == 5750,
+          "frame damaged by refused samples: %u samples, times %u %u", header.count, out[0].timestamp_ms,
+          out[1].timestamp_ms);
+
+    /* what the uploader does instead: finish, resync, next frame */
+    upload_frame_begin(&frame, device_id, 4);
+    sample.timestamp_ms = 11000;
+    CHECK(time_base_frame_add(&tb, &frame, &sample) == ESP_OK, "frame after the resync refused its first sample");
+    sample.timestamp_ms = frame.prev.timestamp_ms - 1;
+    CHECK(upload_frame_add(&frame, &sample) == ESP_ERR_INVALID_ARG && frame.count == 1,
+          "time going back taken by the encoder");
+}
+
+int main(int argc, char **argv)
+{
+    static sim_scenario_t scenarios[] = {
+        {
+            .name = "deep sleep", .skew_ppm = 30000, .swing_ppm = 5000,
+            .period_ms = 5 * 60 * 1000, .sync_ms = 2 * 60 * 60 * 1000, .at_flush = 1,
+            .bound_ms = 5000, .min_gain = 50,
+        },
+        {
+            .name = "always on", .skew_ppm = 25, .swing_ppm = 5,
+            .period_ms = 60 * 1000, .sync_ms = TIME_SYNC_RESYNC_MS, .at_flush = 0,
+            .bound_ms = 250, .min_gain = 3,
+        },
+    };
+    static sim_device_t dev;
+    uint32_t days = 30;
+    unsigned k;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:s:j:f:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd': days = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's':
+                scenarios[0].skew_ppm = atof(optarg);
+                scenarios[0].swing_ppm = scenarios[0].skew_ppm / 6;
+                break;
+            case 'j': s_jitter_ms = atof(optarg); break;
+            case 'f': s_fail_pct = (unsigned)strtoul(optarg, NULL, 0); break;
+            case 'v': s_verbose = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-d days] [-s sleep_skew_ppm] [-j jitter_ms] [-f fail_pct] [-v]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    check_sntp();
+    check_frames();
+    for (k = 0; k < sizeof(scenarios) / sizeof(scenarios[0]); k++)
+    {
+        run(&dev, &scenarios[k], days, k + 1);
+        report(&dev);
+    }
+
+    if (s_failures)
+    {
+        printf("time_sim: %u checks failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,379 @@
+/* Benchmark and self-check for the compressed time-series store
+ * (host/ts_store.c): months of a simulated fleet go in, then the queries a
+ * dashboard makes come out.
+ *
+ * usage: ts_bench [-D devices] [-m months] [-p period_s] [-q queries] [-o dir] [-k]
+ *
+ * Every device reports one sample per -p seconds (with a few ms of jitter,
+ * a daily swing, sensor noise and the odd outage of a few hours), all
+ * devices interleaved the way the collector receives them. Prints
+ *  - ingest rate, bytes per sample and the ratio to an uncompressed
+ *    time/humidity/temperature/status row
+ *  - the time to map and index every series
+ *  - p50/p99 latency over -q random queries: an hour and a day of raw
+ *    samples, a day in 5 minute buckets (decodes), the whole span in
+ *    hourly buckets (chunk headers only), and a fleet-wide dashboard: every
+ *    device's last day in hourly buckets
+ * The files go to a fresh directory under /tmp (or -o), removed at the end
+ * unless -k.
+ *
+ * Checks (non-zero exit on failure): every 16th device reads back exactly
+ * the samples that went in, downsampled buckets match the ones computed
+ * from those samples directly, and every chunk's CRC holds. */
+
+/* Toolchain headers */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* local headers */
+#include "aht10_i2c.h"
+#include "ts_store.h"
+
+#define BENCH_T0_MS                         1700000000000ULL    /* Nov 2023 */
+#define BENCH_DAY_MS                        (24ULL * 3600 * 1000)
+#define BENCH_MONTH_MS                      (30 * BENCH_DAY_MS)
+#define BENCH_OUTAGE_ODDS                   20000               /* one in this many samples starts an outage */
+#define BENCH_VERIFY_EVERY                  16                  /* devices */
+#define BENCH_RAW_ROW_BYTES                 17                  /* u64 time, two u32 codes, status */
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); s_failures++; } } while (0)
+
+typedef struct device_trace {
+    uint8_t id[UPLOAD_FRAME_DEVICE_ID_LEN];
+    unsigned seed;
+    uint64_t t_ms;
+    double hum_walk;                    /* %RH */
+    double temp_walk;                   /* C */
+    double hum_base;
+    double temp_base;
+} device_trace_t;
+
+static unsigned s_failures;
+static uint64_t s_period_ms = 30000;
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double quantile(double *v, size_t n, double q)
+{
+    qsort(v, n, sizeof(*v), cmp_double);
+    return v[(size_t)(q * (double)(n - 1) + 0.5)];
+}
+
+static double noise(unsigned *seed)
+{
+    return (double)(rand_r(seed) % 2001) / 1000.0 - 1.0;
+}
+
+static void trace_init(device_trace_t *dev, uint32_t index)
+{
+    memset(dev, 0, sizeof(*dev));
+    dev->id[0] = 0x5c;
+    dev->id[1] = 0xcf;
+    dev->id[2] = 0x7f;
+    dev->id[3] = (uint8_t)(index >> 16);
+    dev->id[4] = (uint8_t)(index >> 8);
+    dev->id[5] = (uint8_t)index;
+    dev->seed = 1000 + index;
+    dev->t_ms = BENCH_T0_MS + (index * 7919ULL) % s_period_ms;
+    dev->hum_base = 35.0 + (index % 30);
+    dev->temp_base = 19.0 + (index % 7);
+}
+
+/* the device's next sample, and when the one after it is due */
+static void trace_next(device_trace_t *dev, ts_point_t *point)
+{
+    double day = (double)(dev->t_ms % BENCH_DAY_MS) / BENCH_DAY_MS;
+    double rh, temp_c;
+
+    dev->hum_walk += 0.02 * noise(&dev->seed);
+    dev->temp_walk += 0.005 * noise(&dev->seed);
+    rh = dev->hum_base + dev->hum_walk + 4.0 * sin(2 * M_PI * day) + 0.03 * noise(&dev->seed);
+    temp_c = dev->temp_base + dev->temp_walk - 1.5 * cos(2 * M_PI * day) + 0.01 * noise(&dev->seed);
+    rh = (rh < 0) ? 0 : (rh > 100) ? 100 : rh;
+
+    point->t_ms = dev->t_ms;
+    point->hum = (uint32_t)(rh / 100.0 * AHT10_CODE_MAX);
+    point->temp = (uint32_t)((temp_c + 50.0) / 200.0 * AHT10_CODE_MAX);
+    point->status = 0x08 | AHT10_STATUS_BITS_CAL;
+
+    dev->t_ms += s_period_ms + (uint64_t)(rand_r(&dev->seed) % 21) - 10;
+    if (rand_r(&dev->seed) % BENCH_OUTAGE_ODDS == 0)
+    {
+        /* power cut or AP down: nothing for one to six hours */
+        dev->t_ms += (1 + rand_r(&dev->seed) % 6) * 3600000ULL;
+    }
+}
+
+static void ref_add(ts_bucket_t *b, const ts_point_t *p)
+{
+    if (b->count == 0)
+    {
+        b->hum_min = b->hum_max = p->hum;
+        b->temp_min = b->temp_max = p->temp;
+    }
+    b->hum_min = (p->hum < b->hum_min) ? p->hum : b->hum_min;
+    b->hum_max = (p->hum > b->hum_max) ? p->hum : b->hum_max;
+    b->temp_min = (p->temp < b->temp_min) ? p->temp : b->temp_min;
+    b->temp_max = (p->temp > b->temp_max) ? p->temp : b->temp_max;
+    b->hum_sum += p->hum;
+    b->temp_sum += p->temp;
+    b->count++;
+}
+
+/* read a device back and compare with its regenerated trace */
+static void verify_device(const char *dir, uint32_t index, uint64_t end_ms, ts_point_t *points, size_t max)
+{
+    device_trace_t dev;
+    ts_series_t series;
+    ts_point_t want;
+    ts_bucket_t buckets[288], ref[288];
+    uint64_t day0;
+    size_t count, i, b, bad = 0;
+    esp_err_t err;
+
+    trace_init(&dev, index);
+    if (ts_series_open(&series, dir, dev.id, 0) != ESP_OK)
+    {
+        CHECK(0, "device %u: no series", index);
+        return;
+    }
+    CHECK(ts_series_check(&series) == ESP_OK, "device %u: chunk CRC mismatch", index);
+    err = ts_series_range(&series, 0, UINT64_MAX, points, max, &count);
+    CHECK(err == ESP_OK, "device %u: range query failed (0x%X)", index, (unsigned)err);
+
+    for (i = 0; i < count; i++)
+    {
+        trace_next(&dev, &want);
+        if (points[i].t_ms != want.t_ms || points[i].hum != want.hum || points[i].temp != want.temp
+            || points[i].status != want.status)
+        {
+            bad++;
+        }
+    }
+    trace_next(&dev, &want);
+    CHECK(bad == 0, "device %u: %zu of %zu samples changed in the store", index, bad, count);
+    CHECK(want.t_ms >= end_ms, "device %u: only %zu samples came back", index, count);
+
+    /* the second day in 5 minute buckets, recomputed from the raw points */
+    day0 = (BENCH_T0_MS / BENCH_DAY_MS + 1) * BENCH_DAY_MS;
+    ts_series_downsample(&series, day0, 300000, buckets, 288);
+    memset(ref, 0, sizeof(ref));
+    for (i = 0; i < count; i++)
+    {
+        if (points[i].t_ms < day0 || points[i].t_ms >= day0 + BENCH_DAY_MS)
+        {
+            continue;
+        }
+        b = (size_t)((points[i].t_ms - day0) / 300000);
+        ref_add(&ref[b], &points[i]);
+    }
+    for (b = 0, bad = 0; b < 288; b++)
+    {
+        if (buckets[b].count != ref[b].count || buckets[b].hum_sum != ref[b].hum_sum
+            || buckets[b].temp_sum != ref[b].temp_sum || (ref[b].count > 0
+            && (buckets[b].hum_min != ref[b].hum_min || buckets[b].hum_max != ref[b].hum_max
+                || buckets[b].temp_min != ref[b].temp_min || buckets[b].temp_max != ref[b].temp_max)))
+        {
+            bad++;
+        }
+    }
+    CHECK(bad == 0, "device %u: %zu of 288 buckets differ from the raw samples", index, bad);
+    ts_series_close(&series);
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+int main(int argc, char **argv)
+{
+    static char dir_template[] = "/tmp/ts_bench.XXXXXX";
+    const char *dir = NULL;
+    uint32_t ndevices = 100, d, nqueries = 200, q;
+    double months = 3, t, ingest_s, open_s;
+    int keep = 0, opt;
+    device_trace_t *devs;
+    ts_series_t *series;
+    ts_store_t store;
+    ts_point_t point, *points;
+    ts_bucket_t *buckets;
+    uint64_t end_ms, span_ms, start_ms, hour0, samples = 0, chunks = 0, bytes = 0;
+    size_t max_points, count, nb;
+    double *lat;
+    char path[TS_PATH_MAX];
+    esp_err_t err;
+
+    while ((opt = getopt(argc, argv, "D:m:p:q:o:k")) != -1)
+    {
+        switch (opt)
+        {
+            case 'D': ndevices = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'm': months = atof(optarg); break;
+            case 'p': s_period_ms = (uint64_t)(atof(optarg) * 1000); break;
+            case 'q': nqueries = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'o': dir = optarg; break;
+            case 'k': keep = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-D devices] [-m months] [-p period_s] [-q queries] [-o dir] [-k]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (ndevices == 0 || months <= 0 || s_period_ms < 100 || nqueries == 0)
+    {
+        fprintf(stderr, "need devices, months, a period of at least 0.1 s and queries\n");
+        return 2;
+    }
+    if (dir == NULL && (dir = mkdtemp(dir_template)) == NULL)
+    {
+        perror("ts_bench: mkdtemp");
+        return 1;
+    }
+    span_ms = (uint64_t)(months * BENCH_MONTH_MS);
+    end_ms = BENCH_T0_MS + span_ms;
+    max_points = (size_t)(span_ms / (s_period_ms - 10)) + 16;
+
+    devs = calloc(ndevices, sizeof(*devs));
+    series = calloc(ndevices, sizeof(*series));
+    points = malloc(max_points * sizeof(*points));
+    nb = (size_t)(span_ms / 3600000) + 2;
+    buckets = malloc((nb > 288 ? nb : 288) * sizeof(*buckets));
+    lat = malloc((nqueries > ndevices ? nqueries : ndevices) * sizeof(*lat));
+    if (devs == NULL || series == NULL || points == NULL || buckets == NULL || lat == NULL
+        || ts_store_open(&store, dir) != ESP_OK)
+    {
+        fprintf(stderr, "ts_bench: setup failed\n");
+        return 1;
+    }
+    printf("ts_bench: %u devices, %.1f months at %.0f s into %s\n", ndevices, months, s_period_ms / 1000.0, dir);
+
+    /* ingest, the whole fleet interleaved in time */
+    for (d = 0; d < ndevices; d++)
+    {
+        trace_init(&devs[d], d);
+    }
+    t = now_s();
+    for (start_ms = BENCH_T0_MS; start_ms < end_ms; start_ms += s_period_ms)
+    {
+        for (d = 0; d < ndevices; d++)
+        {
+            while (devs[d].t_ms < start_ms + s_period_ms && devs[d].t_ms < end_ms)
+            {
+                trace_next(&devs[d], &point);
+                if ((err = ts_store_append(&store, devs[d].id, 0, &point)) != ESP_OK)
+                {
+                    CHECK(0, "append failed (0x%X)", (unsigned)err);
+                    return 1;
+                }
+            }
+        }
+    }
+    CHECK(ts_store_flush(&store) == ESP_OK, "flush failed");
+    ingest_s = now_s() - t;
+    samples = store.samples;
+    chunks = store.chunks;
+    bytes = store.bytes;
+    ts_store_close(&store);
+    printf("ingest: %llu samples in %llu chunks, %.2f s, %.1f Msamples/s (trace generation included)\n",
+           (unsigned long long)samples, (unsigned long long)chunks, ingest_s, samples / ingest_s / 1e6);
+    printf("size: %llu bytes, %.2f bytes/sample, %.1fx smaller than %d-byte rows\n", (unsigned long long)bytes,
+           (double)bytes / samples, (double)BENCH_RAW_ROW_BYTES * samples / bytes, BENCH_RAW_ROW_BYTES);
+
+    /* every series mapped and indexed once, the way a query server would */
+    t = now_s();
+    for (d = 0; d < ndevices; d++)
+    {
+        if (ts_series_open(&series[d], dir, devs[d].id, 0) != ESP_OK)
+        {
+            CHECK(0, "device %u: open failed", d);
+            return 1;
+        }
+    }
+    open_s = now_s() - t;
+    printf("open: %u series mapped and indexed in %.2f ms (%.1f us each)\n", ndevices, open_s * 1e3,
+           open_s * 1e6 / ndevices);
+
+#define BENCH_QUERIES(label, body) \
+    do { \
+        for (q = 0; q < nqueries; q++) \
+        { \
+            const ts_series_t *s = &series[(uint32_t)rand() % ndevices]; \
+            uint64_t at = BENCH_T0_MS + (uint64_t)rand() % (span_ms - BENCH_DAY_MS); \
+            (void)at; \
+            t = now_s(); \
+            body; \
+            lat[q] = now_s() - t; \
+        } \
+        printf("%-34s p50 %8.1f us  p99 %8.1f us\n", label, quantile(lat, nqueries, 0.5) * 1e6, \
+               quantile(lat, nqueries, 0.99) * 1e6); \
+    } while (0)
+
+    srand(1);
+    BENCH_QUERIES("range, 1 hour of raw samples", ts_series_range(s, at, at + 3600000, points, max_points, &count));
+    BENCH_QUERIES("range, 1 day of raw samples", ts_series_range(s, at, at + BENCH_DAY_MS, points, max_points, &count));
+    BENCH_QUERIES("downsample, 1 day in 5 min", ts_series_downsample(s, at, 300000, buckets, 288));
+    hour0 = (BENCH_T0_MS / 3600000) * 3600000;
+    BENCH_QUERIES("downsample, everything in 1 h", ts_series_downsample(s, hour0, 3600000, buckets, nb));
+
+    /* the dashboard: every device's last day */
+    for (q = 0; q < 10 && q < nqueries; q++)
+    {
+        t = now_s();
+        for (d = 0; d < ndevices; d++)
+        {
+            ts_series_downsample(&series[d], (end_ms / 3600000) * 3600000 - BENCH_DAY_MS, 3600000, buckets, 24);
+        }
+        lat[q] = now_s() - t;
+    }
+    printf("%-34s p50 %8.1f us  (%u devices)\n", "fleet, last day in 1 h", quantile(lat, q, 0.5) * 1e6, ndevices);
+
+    for (d = 0; d < ndevices; d++)
+    {
+        ts_series_close(&series[d]);
+    }
+    for (d = 0; d < ndevices; d += BENCH_VERIFY_EVERY)
+    {
+        verify_device(dir, d, end_ms, points, max_points);
+    }
+
+    if (!keep)
+    {
+        for (d = 0; d < ndevices; d++)
+        {
+            ts_store_path(dir, devs[d].id, 0, path, sizeof(path));
+            unlink(path);
+        }
+        rmdir(dir);
+    }
+    free(devs);
+    free(series);
+    free(points);
+    free(buckets);
+    free(lat);
+
+    if (s_failures > 0)
+    {
+        printf("%u check(s) failed\n", s_failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,769 @@
+/* associated header file */
+#include "ts_store.h"
+
+/* others necessary headers */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TS_KEY_USED                         (1ULL << 63)
+#define TS_SCRATCH_LEN                      (TS_CHUNK_MAX_SAMPLES * 20 + 64)   /* worst case is ~18 bytes a sample */
+
+_Static_assert(sizeof(ts_chunk_header_t) % 8 == 0, "chunk headers must stay 8-byte aligned");
+
+struct ts_open_series {
+    uint64_t key;                       /* device id | sensor << 48 | TS_KEY_USED, 0 when free */
+    uint8_t device_id[UPLOAD_FRAME_DEVICE_ID_LEN];
+    uint8_t sensor;
+    uint8_t has_last;
+    uint32_t count;
+    uint64_t last_t;                    /* newest sample appended, across chunks */
+    ts_point_t *points;                 /* the open chunk, TS_CHUNK_MAX_SAMPLES */
+};
+
+/* MSB-first bit packing through a 64-bit accumulator */
+typedef struct bit_writer {
+    uint8_t *buf;
+    size_t len;
+    uint64_t acc;
+    unsigned bits;
+} bit_writer_t;
+
+typedef struct bit_reader {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint64_t cache;
+    unsigned bits;
+} bit_reader_t;
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+/* n <= 32 */
+static inline void bw_put(bit_writer_t *bw, uint64_t v, unsigned n)
+{
+    if (n == 0)
+    {
+        return;
+    }
+    bw->acc = (bw->acc << n) | (v & ((1ULL << n) - 1));
+    bw->bits += n;
+    while (bw->bits >= 8)
+    {
+        bw->bits -= 8;
+        bw->buf[bw->len++] = (uint8_t)(bw->acc >> bw->bits);
+    }
+}
+
+/* pad to the next byte, columns start on byte boundaries */
+static void bw_align(bit_writer_t *bw)
+{
+    if (bw->bits > 0)
+    {
+        bw->buf[bw->len++] = (uint8_t)(bw->acc << (8 - bw->bits));
+        bw->bits = 0;
+    }
+}
+
+static inline void br_init(bit_reader_t *br, const uint8_t *p, const uint8_t *end)
+{
+    br->p = p;
+    br->end = end;
+    br->cache = 0;
+    br->bits = 0;
+}
+
+/* n <= 32; reads past the end return zeros */
+static inline uint32_t br_get(bit_reader_t *br, unsigned n)
+{
+    uint32_t v;
+
+    if (n == 0)
+    {
+        return 0;
+    }
+    if (br->bits < n)
+    {
+        while (br->bits <= 56)
+        {
+            br->cache |= (uint64_t)(br->p < br->end ? *br->p++ : 0) << (56 - br->bits);
+            br->bits += 8;
+        }
+    }
+    v = (uint32_t)(br->cache >> (64 - n));
+    br->cache <<= n;
+    br->bits -= n;
+    return v;
+}
+
+static inline int64_t sign_extend(uint64_t v, unsigned n)
+{
+    return (int64_t)(v << (64 - n)) >> (64 - n);
+}
+
+static inline uint32_t zigzag(int32_t d)
+{
+    return ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/* '0' same delta, '10' 7 bits, '110' 12 bits, '1110' 20 bits, '1111' 64 bits */
+static void put_time(bit_writer_t *bw, const ts_point_t *points, uint32_t n)
+{
+    uint64_t prev_delta = 0, delta;
+    int64_t dod;
+    uint32_t i;
+
+    for (i = 1; i < n; i++)
+    {
+        delta = points[i].t_ms - points[i - 1].t_ms;
+        dod = (int64_t)(delta - prev_delta);
+        prev_delta = delta;
+        if (dod == 0)
+        {
+            bw_put(bw, 0x0, 1);
+        }
+        else if (dod >= -64 && dod < 64)
+        {
+            bw_put(bw, 0x2, 2);
+            bw_put(bw, (uint64_t)dod, 7);
+        }
+        else if (dod >= -2048 && dod < 2048)
+        {
+            bw_put(bw, 0x6, 3);
+            bw_put(bw, (uint64_t)dod, 12);
+        }
+        else if (dod >= -(1 << 19) && dod < (1 << 19))
+        {
+            bw_put(bw, 0xE, 4);
+            bw_put(bw, (uint64_t)dod, 20);
+        }
+        else
+        {
+            bw_put(bw, 0xF, 4);
+            bw_put(bw, (uint64_t)dod >> 32, 32);
+            bw_put(bw, (uint64_t)dod, 32);
+        }
+    }
+}
+
+static void get_time(bit_reader_t *br, uint64_t t_first, uint64_t *t, uint32_t n)
+{
+    uint64_t delta = 0, raw;
+    uint32_t i;
+
+    t[0] = t_first;
+    for (i = 1; i < n; i++)
+    {
+        if (br_get(br, 1) == 0)
+        {
+            /* same delta */
+        }
+        else if (br_get(br, 1) == 0)
+        {
+            delta += (uint64_t)sign_extend(br_get(br, 7), 7);
+        }
+        else if (br_get(br, 1) == 0)
+        {
+            delta += (uint64_t)sign_extend(br_get(br, 12), 12);
+        }
+        else if (br_get(br, 1) == 0)
+        {
+            delta += (uint64_t)sign_extend(br_get(br, 20), 20);
+        }
+        else
+        {
+            raw = (uint64_t)br_get(br, 32) << 32;
+            raw |= br_get(br, 32);
+            delta += raw;
+        }
+        t[i] = t[i - 1] + delta;
+    }
+}
+
+/* deltas after the first value, TS_BLOCK_SAMPLES at a time behind a 5-bit width */
+static void put_values(bit_writer_t *bw, const ts_point_t *points, uint32_t n, int temp)
+{
+    uint32_t zz[TS_BLOCK_SAMPLES], max, prev, v;
+    uint32_t i, k, len;
+    unsigned width;
+
+    prev = temp ? points[0].temp : points[0].hum;
+    for (i = 1; i < n; i += TS_BLOCK_SAMPLES)
+    {
+        len = (n - i < TS_BLOCK_SAMPLES) ? n - i : TS_BLOCK_SAMPLES;
+        max = 0;
+        for (k = 0; k < len; k++)
+        {
+            v = temp ? points[i + k].temp : points[i + k].hum;
+            zz[k] = zigzag((int32_t)(v - prev));
+            max |= zz[k];
+            prev = v;
+        }
+        width = max ? 32 - (unsigned)__builtin_clz(max) : 0;
+        bw_put(bw, width, 5);
+        for (k = 0; k < len; k++)
+        {
+            bw_put(bw, zz[k], width);
+        }
+    }
+}
+
+static void get_values(bit_reader_t *br, uint32_t first, uint32_t *out, uint32_t n)
+{
+    uint32_t i, k, len;
+    unsigned width;
+
+    out[0] = first;
+    for (i = 1; i < n; i += TS_BLOCK_SAMPLES)
+    {
+        len = (n - i < TS_BLOCK_SAMPLES) ? n - i : TS_BLOCK_SAMPLES;
+        width = br_get(br, 5);
+        for (k = 0; k < len; k++)
+        {
+            out[i + k] = out[i + k - 1] + (uint32_t)unzigzag(br_get(br, width));
+        }
+    }
+}
+
+/* '0' unchanged, '1' and the new byte */
+static void put_status(bit_writer_t *bw, const ts_point_t *points, uint32_t n)
+{
+    uint32_t i;
+
+    for (i = 1; i < n; i++)
+    {
+        if (points[i].status == points[i - 1].status)
+        {
+            bw_put(bw, 0, 1);
+        }
+        else
+        {
+            bw_put(bw, 0x100 | points[i].status, 9);
+        }
+    }
+}
+
+static void get_status(bit_reader_t *br, uint8_t first, uint8_t *out, uint32_t n)
+{
+    uint32_t i;
+
+    out[0] = first;
+    for (i = 1; i < n; i++)
+    {
+        out[i] = br_get(br, 1) ? (uint8_t)br_get(br, 8) : out[i - 1];
+    }
+}
+
+/* header and payload of one chunk into buf, returns the total length */
+static size_t encode_chunk(const ts_point_t *points, uint32_t n, uint8_t *buf)
+{
+    ts_chunk_header_t *hdr = (ts_chunk_header_t *)buf;
+    bit_writer_t bw = { .buf = buf + sizeof(*hdr) };
+    uint32_t i;
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = TS_CHUNK_MAGIC;
+    hdr->count = (uint16_t)n;
+    hdr->status_first = points[0].status;
+    hdr->t_first = points[0].t_ms;
+    hdr->t_last = points[n - 1].t_ms;
+    hdr->hum_first = hdr->hum_min = hdr->hum_max = points[0].hum;
+    hdr->temp_first = hdr->temp_min = hdr->temp_max = points[0].temp;
+    for (i = 0; i < n; i++)
+    {
+        hdr->hum_min = (points[i].hum < hdr->hum_min) ? points[i].hum : hdr->hum_min;
+        hdr->hum_max = (points[i].hum > hdr->hum_max) ? points[i].hum : hdr->hum_max;
+        hdr->temp_min = (points[i].temp < hdr->temp_min) ? points[i].temp : hdr->temp_min;
+        hdr->temp_max = (points[i].temp > hdr->temp_max) ? points[i].temp : hdr->temp_max;
+        hdr->hum_sum += points[i].hum;
+        hdr->temp_sum += points[i].temp;
+    }
+
+    put_time(&bw, points, n);
+    bw_align(&bw);
+    hdr->col_off[0] = (uint32_t)bw.len;
+    put_values(&bw, points, n, 0);
+    bw_align(&bw);
+    hdr->col_off[1] = (uint32_t)bw.len;
+    put_values(&bw, points, n, 1);
+    bw_align(&bw);
+    hdr->col_off[2] = (uint32_t)bw.len;
+    put_status(&bw, points, n);
+    bw_align(&bw);
+    while (bw.len % 8 != 0)
+    {
+        bw.buf[bw.len++] = 0;
+    }
+    hdr->payload_len = (uint32_t)bw.len;
+    hdr->crc = upload_frame_crc32(bw.buf, bw.len);
+    return sizeof(*hdr) + bw.len;
+}
+
+typedef struct chunk_columns {
+    uint64_t t[TS_CHUNK_MAX_SAMPLES];
+    uint32_t hum[TS_CHUNK_MAX_SAMPLES];
+    uint32_t temp[TS_CHUNK_MAX_SAMPLES];
+    uint8_t status[TS_CHUNK_MAX_SAMPLES];
+} chunk_columns_t;
+
+static void decode_chunk(const ts_chunk_header_t *hdr, chunk_columns_t *cols)
+{
+    const uint8_t *payload = (const uint8_t *)(hdr + 1);
+    const uint8_t *end = payload + hdr->payload_len;
+    bit_reader_t br;
+
+    br_init(&br, payload, payload + hdr->col_off[0]);
+    get_time(&br, hdr->t_first, cols->t, hdr->count);
+    br_init(&br, payload + hdr->col_off[0], payload + hdr->col_off[1]);
+    get_values(&br, hdr->hum_first, cols->hum, hdr->count);
+    br_init(&br, payload + hdr->col_off[1], payload + hdr->col_off[2]);
+    get_values(&br, hdr->temp_first, cols->temp, hdr->count);
+    br_init(&br, payload + hdr->col_off[2], end);
+    get_status(&br, hdr->status_first, cols->status, hdr->count);
+}
+
+static uint64_t series_key(const uint8_t *device_id, uint8_t sensor)
+{
+    uint64_t key = TS_KEY_USED | ((uint64_t)sensor << 48);
+    int i;
+
+    for (i = 0; i < UPLOAD_FRAME_DEVICE_ID_LEN; i++)
+    {
+        key |= (uint64_t)device_id[i] << (8 * i);
+    }
+    return key;
+}
+
+static size_t key_slot(uint64_t key, size_t capacity)
+{
+    key ^= key >> 29;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 32;
+    return (size_t)key & (capacity - 1);
+}
+
+static esp_err_t grow(ts_store_t *store)
+{
+    size_t capacity = store->capacity ? store->capacity * 2 : 64;
+    ts_open_series_t *table = calloc(capacity, sizeof(*table));
+    size_t i, slot;
+
+    if (table == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    for (i = 0; i < store->capacity; i++)
+    {
+        if (store->series[i].key == 0)
+        {
+            continue;
+        }
+        slot = key_slot(store->series[i].key, capacity);
+        while (table[slot].key != 0)
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        table[slot] = store->series[i];
+    }
+    free(store->series);
+    store->series = table;
+    store->capacity = capacity;
+    return ESP_OK;
+}
+
+static ts_open_series_t *find_series(ts_store_t *store, const uint8_t *device_id, uint8_t sensor)
+{
+    uint64_t key = series_key(device_id, sensor);
+    ts_open_series_t *s;
+    size_t slot;
+
+    /* keep the load under 3/4 */
+    if ((store->count + 1) * 4 > store->capacity * 3 && grow(store) != ESP_OK)
+    {
+        return NULL;
+    }
+    slot = key_slot(key, store->capacity);
+    for (;;)
+    {
+        s = &store->series[slot];
+        if (s->key == key)
+        {
+            return s;
+        }
+        if (s->key == 0)
+        {
+            break;
+        }
+        slot = (slot + 1) & (store->capacity - 1);
+    }
+    if ((s->points = malloc(TS_CHUNK_MAX_SAMPLES * sizeof(ts_point_t))) == NULL)
+    {
+        return NULL;
+    }
+    s->key = key;
+    memcpy(s->device_id, device_id, UPLOAD_FRAME_DEVICE_ID_LEN);
+    s->sensor = sensor;
+    store->count++;
+    return s;
+}
+
+static esp_err_t flush_series(ts_store_t *store, ts_open_series_t *s)
+{
+    char path[TS_PATH_MAX];
+    size_t len, off = 0;
+    ssize_t n;
+    int fd;
+
+    if (s->count == 0)
+    {
+        return ESP_OK;
+    }
+    len = encode_chunk(s->points, s->count, store->scratch);
+    ts_store_path(store->dir, s->device_id, s->sensor, path, sizeof(path));
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644)) < 0)
+    {
+        return ESP_FAIL;
+    }
+    while (off < len)
+    {
+        if ((n = write(fd, store->scratch + off, len - off)) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            close(fd);
+            return ESP_FAIL;
+        }
+        off += (size_t)n;
+    }
+    close(fd);
+    store->chunks++;
+    store->bytes += len;
+    s->count = 0;
+    return ESP_OK;
+}
+
+/* first chunk that may hold t_ms or anything after it */
+static size_t first_chunk(const ts_series_t *series, uint64_t t_ms)
+{
+    size_t lo = 0, hi = series->nchunks, mid;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (series->chunks[mid]->t_last < t_ms)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void bucket_add(ts_bucket_t *b, uint32_t count, uint32_t hum_min, uint32_t hum_max, uint64_t hum_sum,
+                       uint32_t temp_min, uint32_t temp_max, uint64_t temp_sum)
+{
+    if (b->count == 0 || hum_min < b->hum_min)
+    {
+        b->hum_min = hum_min;
+    }
+    if (b->count == 0 || hum_max > b->hum_max)
+    {
+        b->hum_max = hum_max;
+    }
+    if (b->count == 0 || temp_min < b->temp_min)
+    {
+        b->temp_min = temp_min;
+    }
+    if (b->count == 0 || temp_max > b->temp_max)
+    {
+        b->temp_max = temp_max;
+    }
+    b->count += count;
+    b->hum_sum += hum_sum;
+    b->temp_sum += temp_sum;
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void ts_store_path(const char *dir, const uint8_t *device_id, uint8_t sensor, char *path, size_t len)
+{
+    snprintf(path, len, "%s/%02x%02x%02x%02x%02x%02x-%u.ts", dir, device_id[0], device_id[1], device_id[2],
+             device_id[3], device_id[4], device_id[5], sensor);
+}
+
+esp_err_t ts_store_open(ts_store_t *store, const char *dir)
+{
+    struct stat st;
+
+    memset(store, 0, sizeof(*store));
+    if (strlen(dir) >= sizeof(store->dir) || stat(dir, &st) != 0 || !S_ISDIR(st.st_mode))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    strcpy(store->dir, dir);
+    if ((store->scratch = malloc(sizeof(ts_chunk_header_t) + TS_SCRATCH_LEN)) == NULL || grow(store) != ESP_OK)
+    {
+        free(store->scratch);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ts_store_append(ts_store_t *store, const uint8_t *device_id, uint8_t sensor, const ts_point_t *point)
+{
+    ts_open_series_t *s = find_series(store, device_id, sensor);
+    esp_err_t err;
+
+    if (s == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    if (s->has_last && point->t_ms < s->last_t)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s->count == TS_CHUNK_MAX_SAMPLES
+        || (s->count > 0 && point->t_ms / TS_CHUNK_SPAN_MS != s->points[0].t_ms / TS_CHUNK_SPAN_MS))
+    {
+        if ((err = flush_series(store, s)) != ESP_OK)
+        {
+            return err;
+        }
+    }
+    s->points[s->count++] = *point;
+    s->last_t = point->t_ms;
+    s->has_last = 1;
+    store->samples++;
+    return ESP_OK;
+}
+
+esp_err_t ts_store_flush(ts_store_t *store)
+{
+    esp_err_t err, ret = ESP_OK;
+    size_t i;
+
+    for (i = 0; i < store->capacity; i++)
+    {
+        if (store->series[i].key != 0 && (err = flush_series(store, &store->series[i])) != ESP_OK)
+        {
+            ret = err;
+        }
+    }
+    return ret;
+}
+
+esp_err_t ts_store_close(ts_store_t *store)
+{
+    esp_err_t ret = ts_store_flush(store);
+    size_t i;
+
+    for (i = 0; i < store->capacity; i++)
+    {
+        free(store->series[i].points);
+    }
+    free(store->series);
+    free(store->scratch);
+    store->series = NULL;
+    store->scratch = NULL;
+    store->capacity = 0;
+    store->count = 0;
+    return ret;
+}
+
+esp_err_t ts_series_open(ts_series_t *series, const char *dir, const uint8_t *device_id, uint8_t sensor)
+{
+    const ts_chunk_header_t *hdr;
+    char path[TS_PATH_MAX];
+    struct stat st;
+    const ts_chunk_header_t **chunks;
+    size_t off, n, cap = 0;
+    void *map;
+
+    memset(series, 0, sizeof(*series));
+    series->fd = -1;
+    ts_store_path(dir, device_id, sensor, path, sizeof(path));
+    if ((series->fd = open(path, O_RDONLY)) < 0)
+    {
+        return (errno == ENOENT) ? ESP_ERR_NOT_FOUND : ESP_FAIL;
+    }
+    if (fstat(series->fd, &st) != 0)
+    {
+        ts_series_close(series);
+        return ESP_FAIL;
+    }
+    series->len = (size_t)st.st_size;
+    if (series->len == 0)
+    {
+        return ESP_OK;
+    }
+    map = mmap(NULL, series->len, PROT_READ, MAP_SHARED, series->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        series->len = 0;
+        ts_series_close(series);
+        return ESP_FAIL;
+    }
+    series->map = map;
+
+    /* index the headers; stop at anything that isn't a whole chunk */
+    for (off = 0; off + sizeof(*hdr) <= series->len; off += sizeof(*hdr) + hdr->payload_len)
+    {
+        hdr = (const ts_chunk_header_t *)(series->map + off);
+        if (hdr->magic != TS_CHUNK_MAGIC || hdr->count == 0 || hdr->count > TS_CHUNK_MAX_SAMPLES
+            || hdr->payload_len > series->len - off - sizeof(*hdr))
+        {
+            break;
+        }
+        if (series->nchunks == cap)
+        {
+            n = cap ? cap * 2 : 256;
+            chunks = realloc(series->chunks, n * sizeof(*chunks));
+            if (chunks == NULL)
+            {
+                ts_series_close(series);
+                return ESP_ERR_NO_MEM;
+            }
+            series->chunks = chunks;
+            cap = n;
+        }
+        series->chunks[series->nchunks++] = hdr;
+        series->samples += hdr->count;
+    }
+    return ESP_OK;
+}
+
+void ts_series_close(ts_series_t *series)
+{
+    if (series->map != NULL)
+    {
+        munmap((void *)series->map, series->len);
+    }
+    if (series->fd >= 0)
+    {
+        close(series->fd);
+    }
+    free(series->chunks);
+    memset(series, 0, sizeof(*series));
+    series->fd = -1;
+}
+
+esp_err_t ts_series_check(const ts_series_t *series)
+{
+    size_t i;
+
+    for (i = 0; i < series->nchunks; i++)
+    {
+        const ts_chunk_header_t *hdr = series->chunks[i];
+        if (upload_frame_crc32((const uint8_t *)(hdr + 1), hdr->payload_len) != hdr->crc)
+        {
+            return ESP_ERR_INVALID_CRC;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t ts_series_range(const ts_series_t *series, uint64_t t0, uint64_t t1,
+                          ts_point_t *out, size_t max, size_t *count)
+{
+    static __thread chunk_columns_t cols;
+    const ts_chunk_header_t *hdr;
+    size_t c, n = 0;
+    uint32_t i;
+
+    *count = 0;
+    for (c = first_chunk(series, t0); c < series->nchunks && series->chunks[c]->t_first < t1; c++)
+    {
+        hdr = series->chunks[c];
+        decode_chunk(hdr, &cols);
+        for (i = 0; i < hdr->count; i++)
+        {
+            if (cols.t[i] < t0 || cols.t[i] >= t1)
+            {
+                continue;
+            }
+            if (n == max)
+            {
+                *count = n;
+                return ESP_ERR_INVALID_SIZE;
+            }
+            out[n].t_ms = cols.t[i];
+            out[n].hum = cols.hum[i];
+            out[n].temp = cols.temp[i];
+            out[n].status = cols.status[i];
+            n++;
+        }
+    }
+    *count = n;
+    return ESP_OK;
+}
+
+esp_err_t ts_series_downsample(const ts_series_t *series, uint64_t t0, uint64_t bucket_ms,
+                               ts_bucket_t *out, size_t nbuckets)
+{
+    static __thread chunk_columns_t cols;
+    const ts_chunk_header_t *hdr;
+    uint64_t t1, b;
+    size_t c;
+    uint32_t i;
+
+    if (bucket_ms == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(out, 0, nbuckets * sizeof(*out));
+    for (b = 0; b < nbuckets; b++)
+    {
+        out[b].t_ms = t0 + b * bucket_ms;
+    }
+    t1 = t0 + nbuckets * bucket_ms;
+
+    for (c = first_chunk(series, t0); c < series->nchunks && series->chunks[c]->t_first < t1; c++)
+    {
+        hdr = series->chunks[c];
+        if (hdr->t_first >= t0 && hdr->t_last < t1
+            && (hdr->t_first - t0) / bucket_ms == (hdr->t_last - t0) / bucket_ms)
+        {
+            /* the whole chunk is in one bucket: its header is enough */
+            bucket_add(&out[(hdr->t_first - t0) / bucket_ms], hdr->count, hdr->hum_min, hdr->hum_max,
+                       hdr->hum_sum, hdr->temp_min, hdr->temp_max, hdr->temp_sum);
+            continue;
+        }
+        decode_chunk(hdr, &cols);
+        for (i = 0; i < hdr->count; i++)
+        {
+            if (cols.t[i] < t0 || cols.t[i] >= t1)
+            {
+                continue;
+            }
+            bucket_add(&out[(cols.t[i] - t0) / bucket_ms], 1, cols.hum[i], cols.hum[i], cols.hum[i],
+                       cols.temp[i], cols.temp[i], cols.temp[i]);
+        }
+    }
+
+    for (b = 0; b < nbuckets; b++)
+    {
+        if (out[b].count > 0)
+        {
+            out[b].hum_mean = (uint32_t)((out[b].hum_sum + out[b].count / 2) / out[b].count);
+            out[b].temp_mean = (uint32_t)((out[b].temp_sum + out[b].count / 2) / out[b].count);
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,132 @@
+#ifndef _TS_STORE_H
+#define _TS_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "upload_frame.h"
+
+/* Compressed time-series store for the collector side.
+ *
+ * One append-only file per series (device id and sensor), <dir>/<mac>-<sensor>.ts,
+ * made of self-contained chunks. A chunk holds up to TS_CHUNK_MAX_SAMPLES
+ * samples of one TS_CHUNK_SPAN_MS slot of wall-clock time (aligned to the
+ * epoch), stored as columns:
+ *     time        delta-of-delta, prefix coded: a steady cadence costs one
+ *                 bit per sample, a few ms of jitter nine
+ *     humidity    20-bit codes as deltas, zigzagged and bit-packed in
+ *     temperature blocks of TS_BLOCK_SAMPLES at the block's widest delta
+ *     status      one bit while it doesn't change
+ * The chunk header carries the time range, first values, min/max/sum of
+ * both codes and the column offsets, so a query skips chunks outside its
+ * range and a downsample whose buckets cover whole chunks never decodes
+ * them at all (buckets that are a multiple of TS_CHUNK_SPAN_MS).
+ *
+ * Writing keeps the open chunk of every series in memory and appends it
+ * when it fills, when a sample falls into the next slot, or on
+ * ts_store_flush(). Samples of a series have to come in time order.
+ * Reading maps the file and indexes the chunk headers once; a chunk cut off
+ * by a crash halfway through its append is ignored. Files are in host byte
+ * order, they don't leave the machine that wrote them. */
+
+#define TS_CHUNK_MAGIC                      0x31435354          /* "TSC1" */
+#define TS_CHUNK_MAX_SAMPLES                1024
+#define TS_CHUNK_SPAN_MS                    3600000ULL          /* one hour per chunk at most */
+#define TS_BLOCK_SAMPLES                    16                  /* values per bit width */
+#define TS_PATH_MAX                         256
+#define TS_DIR_MAX                          (TS_PATH_MAX - 24)  /* room for the file name */
+
+typedef struct ts_point {
+    uint64_t t_ms;                      /* collector time, ms since the epoch */
+    uint32_t hum;                       /* raw 20-bit codes, aht10_convert_*() for units */
+    uint32_t temp;
+    uint8_t status;
+} ts_point_t;
+
+typedef struct ts_bucket {
+    uint64_t t_ms;                      /* start of the bucket */
+    uint32_t count;
+    uint32_t hum_min;
+    uint32_t hum_max;
+    uint32_t hum_mean;
+    uint32_t temp_min;
+    uint32_t temp_max;
+    uint32_t temp_mean;
+    uint64_t hum_sum;
+    uint64_t temp_sum;
+} ts_bucket_t;
+
+/* on-disk chunk header, followed by payload_len bytes of columns */
+typedef struct ts_chunk_header {
+    uint32_t magic;
+    uint16_t count;
+    uint8_t status_first;
+    uint8_t reserved;
+    uint32_t payload_len;               /* multiple of 8, keeps the next header aligned */
+    uint32_t crc;                       /* upload_frame_crc32() of the payload */
+    uint64_t t_first;
+    uint64_t t_last;
+    uint32_t hum_first;
+    uint32_t temp_first;
+    uint32_t hum_min;
+    uint32_t hum_max;
+    uint32_t temp_min;
+    uint32_t temp_max;
+    uint64_t hum_sum;
+    uint64_t temp_sum;
+    uint32_t col_off[3];                /* humidity, temperature, status; time starts at 0 */
+    uint32_t reserved2;
+} ts_chunk_header_t;
+
+/* writer side */
+typedef struct ts_open_series ts_open_series_t;
+
+typedef struct ts_store {
+    char dir[TS_DIR_MAX];
+    ts_open_series_t *series;           /* open addressing, capacity a power of two */
+    size_t capacity;
+    size_t count;
+    uint8_t *scratch;                   /* one encoded chunk */
+
+    /* statistics */
+    uint64_t samples;
+    uint64_t chunks;
+    uint64_t bytes;                     /* appended to the files, headers included */
+} ts_store_t;
+
+/* reader side, one mapped series */
+typedef struct ts_series {
+    int fd;
+    const uint8_t *map;
+    size_t len;
+    const ts_chunk_header_t **chunks;   /* in file order, which is time order */
+    size_t nchunks;
+    uint64_t samples;
+} ts_series_t;
+
+/* dir has to exist */
+esp_err_t ts_store_open(ts_store_t *store, const char *dir);
+/* ESP_ERR_INVALID_ARG if t_ms is older than the series' last sample */
+esp_err_t ts_store_append(ts_store_t *store, const uint8_t *device_id, uint8_t sensor, const ts_point_t *point);
+/* append every open chunk, e.g. before another process reads the files */
+esp_err_t ts_store_flush(ts_store_t *store);
+/* flushes and frees */
+esp_err_t ts_store_close(ts_store_t *store);
+
+/* "<dir>/5ccf7f000001-0.ts" */
+void ts_store_path(const char *dir, const uint8_t *device_id, uint8_t sensor, char *path, size_t len);
+
+/* ESP_ERR_NOT_FOUND if the series has no file */
+esp_err_t ts_series_open(ts_series_t *series, const char *dir, const uint8_t *device_id, uint8_t sensor);
+void ts_series_close(ts_series_t *series);
+/* ESP_ERR_INVALID_CRC if any chunk's payload doesn't match its CRC */
+esp_err_t ts_series_check(const ts_series_t *series);
+/* points with t0 <= t_ms < t1 in time order; ESP_ERR_INVALID_SIZE if more
+ * than max matched (the first max are in out) */
+esp_err_t ts_series_range(const ts_series_t *series, uint64_t t0, uint64_t t1,
+                          ts_point_t *out, size_t max, size_t *count);
+/* nbuckets buckets of bucket_ms from t0 on; empty buckets have count 0 */
+esp_err_t ts_series_downsample(const ts_series_t *series, uint64_t t0, uint64_t bucket_ms,
+                               ts_bucket_t *out, size_t nbuckets);
+
+#endif /* _TS_STORE_H */
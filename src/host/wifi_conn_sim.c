@@ -0,0 +1,523 @@
+/* Drives the WiFi connection manager in main/wifi_conn.c with a fake
+ * access point and station driver on a virtual clock.
+ *
+ * usage: wifi_conn_sim [-s seed] [-v]
+ *
+ * Runs a handful of scripted scenarios (cold boot, fast reconnect with and
+ * without the cached lease, AP outage, AP moving channel, an outage much
+ * longer than the backoff cap, a building full of devices losing the same AP)
+ * and checks the state machine's invariants along the way. Prints connect
+ * times and the backoff schedule; exits non-zero if any check fails. */
+
+/* Toolchain headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* local headers */
+#include "wifi_conn.h"
+
+/* how long the fake driver takes for each step, roughly what an ESP8266 does */
+#define SIM_SCAN_MS                 2200        /* full scan of all channels */
+#define SIM_FAST_PROBE_MS           120         /* single channel, known BSSID */
+#define SIM_ASSOC_MS                150         /* auth + assoc + 4-way handshake */
+#define SIM_DHCP_MS                 1200
+#define SIM_STATIC_IP_MS            5
+#define SIM_MAX_PENDING             4
+
+typedef struct sim_ap {
+    int up;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+} sim_ap_t;
+
+typedef struct sim_pending {
+    uint64_t at_ms;
+    wifi_conn_event_t event;
+} sim_pending_t;
+
+typedef struct sim {
+    uint64_t now_ms;
+    sim_ap_t ap;
+    wifi_conn_t conn;
+    unsigned seed;
+
+    int timer_armed;
+    uint64_t timer_at_ms;
+    sim_pending_t pending[SIM_MAX_PENDING];
+    int pending_count;
+    int static_ip_applied;
+
+    /* what the ops saw */
+    wifi_conn_cache_t saved;
+    int saves;
+    int link_up;
+    int link_ups;
+    int link_downs;
+    int attempts;
+    int fast_attempts;
+    uint64_t last_up_ms;
+    uint32_t max_backoff_ms;
+    uint32_t backoffs[16];              /* the first few waits, for the printout */
+    int backoff_count;
+} sim_t;
+
+static int s_verbose;
+static int s_failures;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            s_failures++; \
+        } \
+    } while (0)
+
+/* ====================================
+ * ========= FAKE DRIVER ==============
+ * ==================================== */
+
+static void sim_post(sim_t *sim, uint32_t delay_ms, const wifi_conn_event_t *event)
+{
+    if (sim->pending_count >= SIM_MAX_PENDING)
+    {
+        CHECK(0, "driver event queue overflow");
+        return;
+    }
+    sim->pending[sim->pending_count].at_ms = sim->now_ms + delay_ms;
+    sim->pending[sim->pending_count].event = *event;
+    sim->pending_count++;
+}
+
+static void sim_post_id(sim_t *sim, uint32_t delay_ms, wifi_conn_event_id_t id)
+{
+    wifi_conn_event_t event;
+
+    memset(&event, 0, sizeof(event));
+    event.id = id;
+    sim_post(sim, delay_ms, &event);
+}
+
+static void op_connect(void *ctx, const wifi_conn_cache_t *cache)
+{
+    sim_t *sim = ctx;
+    wifi_conn_event_t event;
+    uint32_t t;
+
+    CHECK(sim->pending_count == 0, "connect with %d driver events still pending", sim->pending_count);
+    sim->attempts++;
+    if (cache != NULL)
+    {
+        sim->fast_attempts++;
+    }
+
+    /* a directed probe on the cached channel only finds the AP if it is
+     * still there; a miss is reported quickly, a full scan takes a while */
+    t = (cache != NULL) ? SIM_FAST_PROBE_MS : SIM_SCAN_MS;
+    if (!sim->ap.up
+        || (cache != NULL && (cache->channel != sim->ap.channel || memcmp(cache->bssid, sim->ap.bssid, 6) != 0)))
+    {
+        memset(&event, 0, sizeof(event));
+        event.id = WIFI_CONN_EVT_DISCONNECTED;
+        event.reason = 201;             /* NO_AP_FOUND */
+        sim_post(sim, t, &event);
+        return;
+    }
+
+    t += SIM_ASSOC_MS;
+    memset(&event, 0, sizeof(event));
+    event.id = WIFI_CONN_EVT_ASSOCIATED;
+    memcpy(event.bssid, sim->ap.bssid, 6);
+    event.channel = sim->ap.channel;
+    sim_post(sim, t, &event);
+
+    memset(&event, 0, sizeof(event));
+    event.id = WIFI_CONN_EVT_GOT_IP;
+    event.ip = sim->static_ip_applied ? sim->conn.cache.ip : sim->ap.ip;
+    event.gw = 0x0101A8C0;
+    event.netmask = 0x00FFFFFF;
+    sim_post(sim, t + (sim->static_ip_applied ? SIM_STATIC_IP_MS : SIM_DHCP_MS), &event);
+}
+
+static void op_disconnect(void *ctx)
+{
+    sim_t *sim = ctx;
+
+    /* the driver drops whatever it was doing and confirms with an event */
+    sim->pending_count = 0;
+    sim_post_id(sim, 1, WIFI_CONN_EVT_DISCONNECTED);
+}
+
+static void op_configure_ip(void *ctx, const wifi_conn_cache_t *cache)
+{
+    sim_t *sim = ctx;
+    sim->static_ip_applied = (cache != NULL);
+}
+
+static void op_set_timer(void *ctx, uint32_t ms)
+{
+    sim_t *sim = ctx;
+
+    sim->timer_armed = (ms != 0);
+    sim->timer_at_ms = sim->now_ms + ms;
+}
+
+static void op_save_cache(void *ctx, const wifi_conn_cache_t *cache)
+{
+    sim_t *sim = ctx;
+    sim->saved = *cache;
+    sim->saves++;
+}
+
+static void op_link_changed(void *ctx, int up)
+{
+    sim_t *sim = ctx;
+
+    CHECK(up != sim->link_up, "link_changed(%d) twice in a row", up);
+    sim->link_up = up;
+    if (up)
+    {
+        sim->link_ups++;
+        sim->last_up_ms = sim->now_ms;
+    }
+    else
+    {
+        sim->link_downs++;
+    }
+    if (s_verbose)
+    {
+        printf("    %8llu ms link %s\n", (unsigned long long)sim->now_ms, up ? "up" : "down");
+    }
+}
+
+static uint32_t op_random(void *ctx)
+{
+    sim_t *sim = ctx;
+    return (uint32_t)rand_r(&sim->seed);
+}
+
+static uint32_t op_now_ms(void *ctx)
+{
+    sim_t *sim = ctx;
+    return (uint32_t)sim->now_ms;
+}
+
+/* ====================================
+ * ========= SIMULATION ===============
+ * ==================================== */
+
+static void sim_boot(sim_t *sim, const sim_ap_t *ap, const wifi_conn_cache_t *cache, uint8_t use_static_ip,
+                     unsigned seed)
+{
+    wifi_conn_ops_t ops = {
+        .ctx = sim,
+        .connect = op_connect,
+        .disconnect = op_disconnect,
+        .configure_ip = op_configure_ip,
+        .set_timer = op_set_timer,
+        .save_cache = op_save_cache,
+        .link_changed = op_link_changed,
+        .random = op_random,
+        .now_ms = op_now_ms,
+    };
+    wifi_conn_event_t start = { .id = WIFI_CONN_EVT_START };
+
+    memset(sim, 0, sizeof(*sim));
+    sim->ap = *ap;
+    sim->seed = seed;
+    wifi_conn_init(&sim->conn, &ops, cache, use_static_ip);
+    wifi_conn_handle(&sim->conn, &start);
+}
+
+static void sim_check_invariants(sim_t *sim)
+{
+    switch (sim->conn.state)
+    {
+        case WIFI_CONN_CONNECTED:
+            CHECK(!sim->timer_armed, "timer armed while connected");
+            CHECK(sim->link_up, "connected but link not reported up");
+            break;
+        case WIFI_CONN_CONNECTING:
+        case WIFI_CONN_WAIT_IP:
+        case WIFI_CONN_BACKOFF:
+            /* something must always be coming, otherwise we are stuck */
+            CHECK(sim->timer_armed, "state %d without a timer", sim->conn.state);
+            CHECK(!sim->link_up, "link reported up in state %d", sim->conn.state);
+            break;
+        default:
+            CHECK(0, "state %d after start", sim->conn.state);
+            break;
+    }
+}
+
+/* run until the given virtual time, delivering timer and driver events in order */
+static void sim_run_until(sim_t *sim, uint64_t until_ms)
+{
+    wifi_conn_event_t event;
+    wifi_conn_state_t before;
+    uint64_t next;
+    int i, which;
+
+    while (1)
+    {
+        next = until_ms;
+        which = -2;
+        if (sim->timer_armed && sim->timer_at_ms <= next)
+        {
+            next = sim->timer_at_ms;
+            which = -1;
+        }
+        for (i = 0; i < sim->pending_count; i++)
+        {
+            if (sim->pending[i].at_ms < next || (sim->pending[i].at_ms == next && which == -2))
+            {
+                next = sim->pending[i].at_ms;
+                which = i;
+            }
+        }
+        sim->now_ms = next;
+        if (which == -2)
+        {
+            return;
+        }
+
+        if (which == -1)
+        {
+            sim->timer_armed = 0;
+            event.id = WIFI_CONN_EVT_TIMER;
+            if (s_verbose)
+            {
+                printf("    %8llu ms timer (state %d)\n", (unsigned long long)sim->now_ms, sim->conn.state);
+            }
+        }
+        else
+        {
+            event = sim->pending[which].event;
+            sim->pending[which] = sim->pending[--sim->pending_count];
+            if (s_verbose)
+            {
+                printf("    %8llu ms driver event %d\n", (unsigned long long)sim->now_ms, event.id);
+            }
+        }
+
+        before = sim->conn.state;
+        wifi_conn_handle(&sim->conn, &event);
+        if (sim->conn.state == WIFI_CONN_BACKOFF && before != WIFI_CONN_BACKOFF)
+        {
+            if (sim->backoff_count < (int)(sizeof(sim->backoffs) / sizeof(sim->backoffs[0])))
+            {
+                sim->backoffs[sim->backoff_count++] = sim->conn.last_backoff_ms;
+            }
+            if (sim->conn.last_backoff_ms > sim->max_backoff_ms)
+            {
+                sim->max_backoff_ms = sim->conn.last_backoff_ms;
+            }
+        }
+        sim_check_invariants(sim);
+    }
+}
+
+/* the AP goes away: an associated station hears about it */
+static void sim_ap_down(sim_t *sim)
+{
+    sim->ap.up = 0;
+    if (sim->conn.state == WIFI_CONN_CONNECTED || sim->conn.state == WIFI_CONN_WAIT_IP)
+    {
+        sim->pending_count = 0;
+        sim_post_id(sim, 0, WIFI_CONN_EVT_DISCONNECTED);
+    }
+}
+
+/* ====================================
+ * ========= SCENARIOS ================
+ * ==================================== */
+
+static const sim_ap_t s_home_ap = {
+    .up = 1,
+    .bssid = { 0x24, 0xa4, 0x3c, 0x11, 0x22, 0x33 },
+    .channel = 6,
+    .ip = 0x2A01A8C0,                   /* 192.168.1.42 */
+};
+
+static wifi_conn_cache_t scenario_cold(unsigned seed)
+{
+    sim_t sim;
+
+    printf("cold boot, nothing cached\n");
+    sim_boot(&sim, &s_home_ap, NULL, 0, seed);
+    sim_run_until(&sim, 30000);
+    CHECK(sim.conn.state == WIFI_CONN_CONNECTED, "not connected");
+    CHECK(sim.fast_attempts == 0, "fast attempt without a cache");
+    CHECK(sim.saves == 1, "%d cache saves, expected 1", sim.saves);
+    CHECK(sim.saved.valid && sim.saved.channel == s_home_ap.channel, "AP not cached");
+    CHECK(sim.saved.ip_valid && sim.saved.ip == s_home_ap.ip, "lease not cached");
+    printf("  connected in %u ms (full scan + DHCP)\n", sim.conn.last_connect_ms);
+    return sim.saved;
+}
+
+static void scenario_fast(const wifi_conn_cache_t *cache, unsigned seed)
+{
+    sim_t sim;
+    uint32_t dhcp_ms;
+
+    printf("reboot with the cache\n");
+    sim_boot(&sim, &s_home_ap, cache, 0, seed);
+    sim_run_until(&sim, 30000);
+    CHECK(sim.conn.state == WIFI_CONN_CONNECTED && sim.conn.fast, "fast connect failed");
+    CHECK(sim.saves == 0, "cache rewritten although nothing changed");
+    dhcp_ms = sim.conn.last_connect_ms;
+    printf("  connected in %u ms (known BSSID/channel + DHCP)\n", dhcp_ms);
+
+    sim_boot(&sim, &s_home_ap, cache, 1, seed);
+    sim_run_until(&sim, 30000);
+    CHECK(sim.conn.state == WIFI_CONN_CONNECTED && sim.conn.fast, "fast connect with static IP failed");
+    CHECK(sim.saves == 0, "cache rewritten although nothing changed");
+    CHECK(sim.conn.last_connect_ms < dhcp_ms, "cached lease didn't help");
+    printf("  connected in %u ms (known BSSID/channel + cached lease)\n", sim.conn.last_connect_ms);
+}
+
+static void scenario_outage(const wifi_conn_cache_t *cache, unsigned seed)
+{
+    sim_t sim;
+    int i;
+
+    printf("AP off for 20 s while connected\n");
+    sim_boot(&sim, &s_home_ap, cache, 1, seed);
+    sim_run_until(&sim, 10000);
+    sim_ap_down(&sim);
+    sim_run_until(&sim, 30000);
+    printf("  backoff:");
+    for (i = 0; i < sim.backoff_count; i++)
+    {
+        printf(" %u", sim.backoffs[i]);
+    }
+    printf(" ms\n");
+    sim.ap.up = 1;
+    sim_run_until(&sim, 30000 + WIFI_CONN_BACKOFF_MAX_MS + WIFI_CONN_ATTEMPT_TIMEOUT_MS);
+    CHECK(sim.conn.state == WIFI_CONN_CONNECTED, "no reconnect after the AP came back");
+    CHECK(sim.link_downs == 1 && sim.link_ups == 2, "%d downs / %d ups", sim.link_downs, sim.link_ups);
+    printf("  %d attempts, back %llu ms after the AP\n", sim.attempts,
+           (unsigned long long)(sim.last_up_ms - 30000));
+}
+
+static void scenario_channel_change(const wifi_conn_cache_t *cache, unsigned seed)
+{
+    sim_ap_t moved = s_home_ap;
+    sim_t sim;
+
+    printf("AP moved to another channel while the device was off\n");
+    moved.channel = 11;
+    sim_boot(&sim, &moved, cache, 1, seed);
+    sim_run_until(&sim, 60000);
+    CHECK(sim.conn.state == WIFI_CONN_CONNECTED, "not connected");
+    CHECK(sim.fast_attempts == 1, "%d fast attempts, expected 1", sim.fast_attempts);
+    CHECK(sim.attempts == 2, "%d attempts, expected fast + full scan", sim.attempts);
+    CHECK(sim.saves == 1 && sim.saved.channel == 11, "new channel not cached");
+    printf("  fast attempt missed, full scan connected %llu ms after boot\n",
+           (unsigned long long)sim.last_up_ms);
+}
+
+static void scenario_long_outage(const wifi_conn_cache_t *cache, unsigned seed)
+{
+    sim_ap_t off = s_home_ap;
+    sim_t sim;
+    uint64_t outage_ms = 2ULL * 60 * 60 * 1000;
+    int expected;
+
+    printf("AP off for 2 hours from boot\n");
+    off.up = 0;
+    sim_boot(&sim, &off, cache, 0, seed);
+    sim_run_until(&sim, outage_ms);
+    /* the backoff has to saturate, not stop: at least one attempt per cap
+     * (plus the probe time) for the whole outage */
+    expected = (int)(outage_ms / (WIFI_CONN_BACKOFF_MAX_MS + SIM_SCAN_MS));
+    CHECK(sim.attempts >= expected, "gave up? %d attempts, expected at least %d", sim.attempts, expected);
+    CHECK(sim.max_backoff_ms <= WIFI_CONN_BACKOFF_MAX_MS, "backoff %u above the cap", sim.max_backoff_ms);
+    CHECK(sim.max_backoff_ms >= WIFI_CONN_BACKOFF_MAX_MS / 2, "backoff never reached the cap");
+    sim.ap.up = 1;
+    sim_run_until(&sim, outage_ms + WIFI_CONN_BACKOFF_MAX_MS + WIFI_CONN_ATTEMPT_TIMEOUT_MS);
+    CHECK(sim.conn.state == WIFI_CONN_CONNECTED, "no reconnect after the outage");
+    printf("  %d attempts, longest backoff %u ms, back %llu ms after the AP\n", sim.attempts,
+           sim.max_backoff_ms, (unsigned long long)(sim.last_up_ms - outage_ms));
+}
+
+static void scenario_fleet(const wifi_conn_cache_t *cache, unsigned seed)
+{
+    enum { FLEET = 100 };
+    static sim_t fleet[FLEET];
+    uint64_t back_ms = 5 * 60 * 1000;
+    uint64_t first = UINT64_MAX, last = 0;
+    uint32_t slots[10] = { 0 };
+    int i, slot, busiest = 0;
+
+    printf("%d devices, AP off for 5 minutes\n", FLEET);
+    for (i = 0; i < FLEET; i++)
+    {
+        sim_boot(&fleet[i], &s_home_ap, cache, 1, seed + (unsigned)i * 7919);
+        sim_run_until(&fleet[i], 5000);
+        sim_ap_down(&fleet[i]);
+        sim_run_until(&fleet[i], back_ms);
+        fleet[i].ap.up = 1;
+        sim_run_until(&fleet[i], back_ms + WIFI_CONN_BACKOFF_MAX_MS + WIFI_CONN_ATTEMPT_TIMEOUT_MS);
+        CHECK(fleet[i].conn.state == WIFI_CONN_CONNECTED, "device %d not back", i);
+        if (fleet[i].last_up_ms < first)
+        {
+            first = fleet[i].last_up_ms;
+        }
+        if (fleet[i].last_up_ms > last)
+        {
+            last = fleet[i].last_up_ms;
+        }
+        slot = (int)(((fleet[i].last_up_ms - back_ms) * 10) / WIFI_CONN_BACKOFF_MAX_MS);
+        slots[slot < 10 ? slot : 9]++;
+    }
+    for (i = 0; i < 10; i++)
+    {
+        if (slots[i] > slots[busiest])
+        {
+            busiest = i;
+        }
+    }
+    /* without jitter they would all land in one slot */
+    CHECK(slots[busiest] < FLEET / 2, "%u of %d devices reconnected in the same 6 s window", slots[busiest], FLEET);
+    printf("  reconnects spread over %llu..%llu ms after the AP, busiest 6 s window: %u devices\n",
+           (unsigned long long)(first - back_ms), (unsigned long long)(last - back_ms), slots[busiest]);
+}
+
+int main(int argc, char **argv)
+{
+    wifi_conn_cache_t cache;
+    unsigned seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': seed = (unsigned)strtoul(optarg, NULL, 0); break;
+            case 'v': s_verbose = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-s seed] [-v]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    cache = scenario_cold(seed);
+    scenario_fast(&cache, seed);
+    scenario_outage(&cache, seed);
+    scenario_channel_change(&cache, seed);
+    scenario_long_outage(&cache, seed);
+    scenario_fleet(&cache, seed);
+
+    if (s_failures)
+    {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
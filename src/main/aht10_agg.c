@@ -0,0 +1,194 @@
+/* associated header file */
+#include "aht10_agg.h"
+
+/* others necessary headers */
+#include <string.h>
+#include "aht10_convert.h"
+
+/* full scale of each code in 1/100 units: 100 %RH and 200 C */
+#define AGG_HUM_SPAN_CENTI                  10000U
+#define AGG_TEMP_SPAN_CENTI                 20000U
+#define AGG_CODE_BITS                       20
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+/* 1/100 units to codes << AHT10_AGG_EWMA_FRAC */
+static uint32_t band_to_ewma(uint32_t centi, uint32_t span_centi)
+{
+    return (uint32_t)(((uint64_t)centi << (AGG_CODE_BITS + AHT10_AGG_EWMA_FRAC)) / span_centi);
+}
+
+static uint32_t ewma_step(uint32_t ewma, uint32_t code, uint8_t shift)
+{
+    int32_t diff = (int32_t)(code << AHT10_AGG_EWMA_FRAC) - (int32_t)ewma;
+    return (uint32_t)((int32_t)ewma + (diff >> shift));
+}
+
+static uint32_t distance(uint32_t a, uint32_t b)
+{
+    return (a > b) ? a - b : b - a;
+}
+
+static void window_reset(aht10_agg_window_t *window, uint32_t now_ms)
+{
+    memset(window, 0, sizeof(*window));
+    window->start_ms = now_ms;
+    window->hum_min = AHT10_CODE_MAX;
+    window->temp_min = AHT10_CODE_MAX;
+}
+
+static void window_add(aht10_agg_window_t *window, uint32_t hum, uint32_t temp)
+{
+    window->count++;
+    window->hum_sum += hum;
+    window->temp_sum += temp;
+    if (hum < window->hum_min)
+    {
+        window->hum_min = hum;
+    }
+    if (hum > window->hum_max)
+    {
+        window->hum_max = hum;
+    }
+    if (temp < window->temp_min)
+    {
+        window->temp_min = temp;
+    }
+    if (temp > window->temp_max)
+    {
+        window->temp_max = temp;
+    }
+}
+
+static void summary_record(aht10_sample_t *out, const aht10_sample_t *sample, uint8_t kind,
+                           uint32_t hum, uint32_t temp)
+{
+    aht10_reading_t reading = { .status = kind, .humidity_raw = hum, .temperature_raw = temp };
+
+    aht10_sample_pack(out, sample->timestamp_ms, &reading);
+    out->sensor = sample->sensor;
+}
+
+static uint8_t summarise(const aht10_agg_window_t *window, const aht10_sample_t *sample, aht10_sample_t *out)
+{
+    uint32_t seconds = (sample->timestamp_ms - window->start_ms) / 1000;
+
+    summary_record(&out[0], sample, AHT10_AGG_SUMMARY_MEAN,
+                   (uint32_t)((window->hum_sum + window->count / 2) / window->count),
+                   (uint32_t)((window->temp_sum + window->count / 2) / window->count));
+    summary_record(&out[1], sample, AHT10_AGG_SUMMARY_MIN, window->hum_min, window->temp_min);
+    summary_record(&out[2], sample, AHT10_AGG_SUMMARY_MAX, window->hum_max, window->temp_max);
+    summary_record(&out[3], sample, AHT10_AGG_SUMMARY_WINDOW,
+                   (window->count < AHT10_CODE_MAX) ? window->count : AHT10_CODE_MAX,
+                   (seconds < AHT10_CODE_MAX) ? seconds : AHT10_CODE_MAX);
+    return 4;
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void aht10_agg_default_config(aht10_agg_config_t *cfg)
+{
+    cfg->heartbeat_ms = AHT10_AGG_HEARTBEAT_MS;
+    cfg->hum_deadband = AHT10_AGG_HUM_DEADBAND;
+    cfg->temp_deadband = AHT10_AGG_TEMP_DEADBAND;
+    cfg->hysteresis_pct = AHT10_AGG_HYSTERESIS_PCT;
+    cfg->confirm = AHT10_AGG_CONFIRM;
+    cfg->ewma_shift = AHT10_AGG_EWMA_SHIFT;
+    cfg->summary = 1;
+}
+
+void aht10_agg_init(aht10_agg_t *agg, const aht10_agg_config_t *cfg)
+{
+    memset(agg, 0, sizeof(*agg));
+    if (cfg != NULL)
+    {
+        agg->cfg = *cfg;
+    }
+    else
+    {
+        aht10_agg_default_config(&agg->cfg);
+    }
+    if (agg->cfg.confirm == 0)
+    {
+        agg->cfg.confirm = 1;
+    }
+
+    agg->hum_band = band_to_ewma(agg->cfg.hum_deadband, AGG_HUM_SPAN_CENTI);
+    agg->temp_band = band_to_ewma(agg->cfg.temp_deadband, AGG_TEMP_SPAN_CENTI);
+    agg->hum_release = (uint32_t)((uint64_t)agg->hum_band * agg->cfg.hysteresis_pct / 100);
+    agg->temp_release = (uint32_t)((uint64_t)agg->temp_band * agg->cfg.hysteresis_pct / 100);
+}
+
+uint8_t aht10_agg_feed(aht10_agg_t *agg, const aht10_sample_t *sample, aht10_sample_t *out)
+{
+    aht10_agg_sensor_t *s;
+    uint32_t hum = aht10_sample_humidity_raw(sample);
+    uint32_t temp = aht10_sample_temperature_raw(sample);
+    uint32_t dh, dt;
+    uint8_t n = 0;
+    int report;
+
+    if (sample->sensor >= AHT10_AGG_MAX_SENSORS)
+    {
+        out[0] = *sample;
+        return 1;
+    }
+    s = &agg->sensors[sample->sensor];
+    agg->fed++;
+
+    if (!s->primed)
+    {
+        s->primed = 1;
+        s->ewma_hum = hum << AHT10_AGG_EWMA_FRAC;
+        s->ewma_temp = temp << AHT10_AGG_EWMA_FRAC;
+        window_reset(&s->window, sample->timestamp_ms);
+        report = 1;
+    }
+    else
+    {
+        s->ewma_hum = ewma_step(s->ewma_hum, hum, agg->cfg.ewma_shift);
+        s->ewma_temp = ewma_step(s->ewma_temp, temp, agg->cfg.ewma_shift);
+
+        dh = distance(s->ewma_hum, s->ref_hum);
+        dt = distance(s->ewma_temp, s->ref_temp);
+        if (dh > agg->hum_band || dt > agg->temp_band)
+        {
+            s->pending++;
+        }
+        else if (dh <= agg->hum_release && dt <= agg->temp_release)
+        {
+            s->pending = 0;
+        }
+
+        report = (sample->status != s->status) || (s->pending >= agg->cfg.confirm);
+        if (!report && (sample->timestamp_ms - s->last_report_ms) >= agg->cfg.heartbeat_ms)
+        {
+            report = 1;
+            agg->heartbeats++;
+        }
+    }
+    window_add(&s->window, hum, temp);
+
+    if (!report)
+    {
+        agg->suppressed++;
+        return 0;
+    }
+
+    agg->reports++;
+    out[n++] = *sample;
+    if (agg->cfg.summary && s->window.count > 1)
+    {
+        n += summarise(&s->window, sample, &out[n]);
+    }
+    s->status = sample->status;
+    s->pending = 0;
+    s->ref_hum = s->ewma_hum;
+    s->ref_temp = s->ewma_temp;
+    s->last_report_ms = sample->timestamp_ms;
+    window_reset(&s->window, sample->timestamp_ms);
+    return n;
+}
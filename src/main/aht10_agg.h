@@ -0,0 +1,104 @@
+#ifndef _AHT10_AGG_H
+#define _AHT10_AGG_H
+
+#include <stdint.h>
+#include "sample_ring.h"
+#include "upload_frame.h"
+
+/* Streaming aggregation and report-on-change, between the conversion and the
+ * sample ring.
+ *
+ * Most rooms change by less than the sensor resolution for hours, so not
+ * every 5 s sample is worth a radio wake. Per sensor, every sample updates
+ * an EWMA of both codes and the min/max/sum of the current window (the
+ * samples since the last report). A sample is forwarded (reported) when
+ *   - it is the sensor's first one, or its status byte changed,
+ *   - the EWMA has been further than the deadband from its value at the
+ *     last report for `confirm` samples in a row; a sample back inside the
+ *     release band (hysteresis_pct of the deadband) starts the count over,
+ *     one in between leaves it alone, so noise sitting on the edge of the
+ *     deadband doesn't report every other sample,
+ *   - or heartbeat_ms passed since the last report.
+ * Everything else is only counted into the window.
+ *
+ * A report is the actual sample followed by the summary of the window it
+ * closes: four more records in the same stream, marked with status bit 7
+ * (unused in AHT10_STATUS_BITS_*), low nibble the kind:
+ *     MEAN, MIN, MAX      the window's mean/min/max codes, packed as usual
+ *     WINDOW              humidity field: samples in the window,
+ *                         temperature field: window length in seconds
+ * They carry the report's timestamp and sensor id, so the frame encoder
+ * and the ring treat them like any other sample. A window of one sample
+ * gets no summary.
+ *
+ * The bands are in 1/100 %RH and 1/100 C whatever AHT10_CONVERT_DIGITS is,
+ * the comparisons happen on the raw codes. */
+
+#define AHT10_AGG_MAX_SENSORS               UPLOAD_FRAME_MAX_SENSORS
+#define AHT10_AGG_HEARTBEAT_MS              (15 * 60 * 1000)    /* report at least this often */
+#define AHT10_AGG_HUM_DEADBAND              50                  /* 0.50 %RH */
+#define AHT10_AGG_TEMP_DEADBAND             20                  /* 0.20 C */
+#define AHT10_AGG_HYSTERESIS_PCT            50                  /* release band, share of the deadband */
+#define AHT10_AGG_CONFIRM                   2                   /* samples past the deadband before reporting */
+#define AHT10_AGG_EWMA_SHIFT                2                   /* alpha = 1 / 2^shift */
+#define AHT10_AGG_EWMA_FRAC                 8                   /* fraction bits kept in the EWMA */
+#define AHT10_AGG_MAX_OUT                   5                   /* records per fed sample: the sample + summary */
+
+/* summary records */
+#define AHT10_AGG_SUMMARY_FLAG              0x80
+#define AHT10_AGG_SUMMARY_MEAN              (AHT10_AGG_SUMMARY_FLAG | 0x01)
+#define AHT10_AGG_SUMMARY_MIN               (AHT10_AGG_SUMMARY_FLAG | 0x02)
+#define AHT10_AGG_SUMMARY_MAX               (AHT10_AGG_SUMMARY_FLAG | 0x03)
+#define AHT10_AGG_SUMMARY_WINDOW            (AHT10_AGG_SUMMARY_FLAG | 0x04)
+#define AHT10_AGG_IS_SUMMARY(sample)        (((sample)->status & AHT10_AGG_SUMMARY_FLAG) != 0)
+
+typedef struct aht10_agg_config {
+    uint32_t heartbeat_ms;
+    uint16_t hum_deadband;              /* 1/100 %RH */
+    uint16_t temp_deadband;             /* 1/100 C */
+    uint8_t hysteresis_pct;
+    uint8_t confirm;
+    uint8_t ewma_shift;
+    uint8_t summary;                    /* 0 reports bare samples */
+} aht10_agg_config_t;
+
+typedef struct aht10_agg_window {
+    uint32_t start_ms;
+    uint32_t count;
+    uint32_t hum_min, hum_max;
+    uint32_t temp_min, temp_max;
+    uint64_t hum_sum, temp_sum;
+} aht10_agg_window_t;
+
+typedef struct aht10_agg_sensor {
+    uint8_t primed;                     /* has seen a sample */
+    uint8_t status;                     /* of the last report */
+    uint8_t pending;                    /* samples in a row past the deadband */
+    uint32_t ewma_hum, ewma_temp;       /* codes << AHT10_AGG_EWMA_FRAC */
+    uint32_t ref_hum, ref_temp;         /* the EWMAs at the last report */
+    uint32_t last_report_ms;
+    aht10_agg_window_t window;
+} aht10_agg_sensor_t;
+
+typedef struct aht10_agg {
+    aht10_agg_config_t cfg;
+    /* the bands in EWMA units, from cfg */
+    uint32_t hum_band, temp_band;
+    uint32_t hum_release, temp_release;
+    aht10_agg_sensor_t sensors[AHT10_AGG_MAX_SENSORS];
+
+    /* statistics */
+    uint32_t fed;
+    uint32_t reports;                   /* change reports + heartbeats */
+    uint32_t heartbeats;
+    uint32_t suppressed;
+} aht10_agg_t;
+
+void aht10_agg_default_config(aht10_agg_config_t *cfg);
+void aht10_agg_init(aht10_agg_t *agg, const aht10_agg_config_t *cfg);
+/* feeds one sample, writes what should go on to out (room for
+ * AHT10_AGG_MAX_OUT) and returns how many records that is, 0 if the sample
+ * was only aggregated. Sensor ids past AHT10_AGG_MAX_SENSORS pass through. */
+uint8_t aht10_agg_feed(aht10_agg_t *agg, const aht10_sample_t *sample, aht10_sample_t *out);
+
+#endif /* _AHT10_AGG_H */
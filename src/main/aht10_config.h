@@ -0,0 +1,129 @@
+#ifndef _AHT10_CONFIG_H
+#define _AHT10_CONFIG_H
+
+/* Build configuration from menuconfig (Kconfig.projbuild).
+ *
+ * The settings stay plain macros, each defaulted under #ifndef in the header
+ * that owns it; this only turns the CONFIG_ symbols of an SDK build into
+ * those macros. Host builds have no sdkconfig and get the defaults, or what
+ * they pass with -D (make -C host size). Everything is a compile-time
+ * constant, so a disabled feature or mode folds out of the code that tests
+ * for it instead of being skipped at runtime. */
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+/* disabled bools are missing from sdkconfig.h, an int that is always there
+ * tells a configured build from one whose sdkconfig predates the menu */
+#ifdef CONFIG_AHT10_SAMPLE_PERIOD_MS
+
+/* aht10_i2c.h */
+#define I2C_AHT10_MASTER_SDA_IO             CONFIG_AHT10_SDA_GPIO
+#define I2C_AHT10_MASTER_SCL_IO             CONFIG_AHT10_SCL_GPIO
+#define AHT10_I2C_RETRIES                   CONFIG_AHT10_I2C_RETRIES
+#define AHT10_MEAS_DELAY                    CONFIG_AHT10_MEAS_DELAY_MS
+#ifdef CONFIG_AHT10_INIT_SETTLE
+#define DELAY_AFTER_CMD                     1
+#else
+#define DELAY_AFTER_CMD                     0
+#endif
+#ifdef CONFIG_AHT10_CYCLE_MODE
+#define AHT10_CYCLE_MODE_ENABLE             1
+#else
+#define AHT10_CYCLE_MODE_ENABLE             0
+#endif
+
+/* aht10_mux.h */
+#define AHT10_MUX_CHANNEL_MASK              CONFIG_AHT10_MUX_CHANNEL_MASK
+#define AHT10_MUX_ADDR                      CONFIG_AHT10_MUX_ADDR
+
+/* aht10_convert.h */
+#if defined(CONFIG_AHT10_CONVERT_DECI)
+#define AHT10_CONVERT_DIGITS                1
+#elif defined(CONFIG_AHT10_CONVERT_MILLI)
+#define AHT10_CONVERT_DIGITS                3
+#else
+#define AHT10_CONVERT_DIGITS                2
+#endif
+
+/* aht10_task.h */
+#define AHT10_SAMPLE_PERIOD_MS              CONFIG_AHT10_SAMPLE_PERIOD_MS
+#ifdef CONFIG_AHT10_SAMPLE_PERIOD_CYCLE_MS
+#define AHT10_SAMPLE_PERIOD_CYCLE_MS        CONFIG_AHT10_SAMPLE_PERIOD_CYCLE_MS
+#endif
+#ifdef CONFIG_AHT10_ACQ_MODE_CYCLE
+#define AHT10_ACQ_MODE                      AHT10_MODE_CYCLE
+#else
+#define AHT10_ACQ_MODE                      AHT10_MODE_NORMAL
+#endif
+#define AHT10_BURST_COUNT                   CONFIG_AHT10_BURST_COUNT
+#ifdef CONFIG_AHT10_REPORT_ON_CHANGE
+#define AHT10_AGG_ENABLE                    1
+#else
+#define AHT10_AGG_ENABLE                    0
+#endif
+#ifdef CONFIG_AHT10_TASK_STATIC_ALLOC
+#define AHT10_TASK_STATIC_ALLOC             1
+#else
+#define AHT10_TASK_STATIC_ALLOC             0
+#endif
+
+/* sample_ring.h, uploader.h */
+#if defined(CONFIG_AHT10_SAMPLE_RING_16)
+#define SAMPLE_RING_CAPACITY                16
+#elif defined(CONFIG_AHT10_SAMPLE_RING_32)
+#define SAMPLE_RING_CAPACITY                32
+#elif defined(CONFIG_AHT10_SAMPLE_RING_128)
+#define SAMPLE_RING_CAPACITY                128
+#elif defined(CONFIG_AHT10_SAMPLE_RING_256)
+#define SAMPLE_RING_CAPACITY                256
+#else
+#define SAMPLE_RING_CAPACITY                64
+#endif
+#define UPLOAD_FLUSH_FILL                   CONFIG_AHT10_UPLOAD_FLUSH_FILL
+#define UPLOAD_COLLECTOR_ADDR               CONFIG_AHT10_COLLECTOR_ADDR
+
+/* aht10_log.h; "same as the default log level" leaves it to CONFIG_LOG_DEFAULT_LEVEL */
+#if defined(CONFIG_AHT10_LOG_LEVEL_NONE)
+#define AHT10_LOG_LEVEL                     0
+#elif defined(CONFIG_AHT10_LOG_LEVEL_ERROR)
+#define AHT10_LOG_LEVEL                     1
+#elif defined(CONFIG_AHT10_LOG_LEVEL_WARN)
+#define AHT10_LOG_LEVEL                     2
+#elif defined(CONFIG_AHT10_LOG_LEVEL_INFO)
+#define AHT10_LOG_LEVEL                     3
+#elif defined(CONFIG_AHT10_LOG_LEVEL_DEBUG)
+#define AHT10_LOG_LEVEL                     4
+#elif defined(CONFIG_AHT10_LOG_LEVEL_VERBOSE)
+#define AHT10_LOG_LEVEL                     5
+#endif
+#if defined(CONFIG_AHT10_LOG_RING_16)
+#define AHT10_LOG_CAPACITY                  16
+#elif defined(CONFIG_AHT10_LOG_RING_64)
+#define AHT10_LOG_CAPACITY                  64
+#else
+#define AHT10_LOG_CAPACITY                  32
+#endif
+
+/* deep_sleep.h, ota_update.h, wifi_logging.h */
+#ifdef CONFIG_AHT10_DEEP_SLEEP
+#define AHT10_DEEP_SLEEP_MODE               1
+#define DEEP_SLEEP_PERIOD_MS                CONFIG_AHT10_DEEP_SLEEP_PERIOD_MS
+#else
+#define AHT10_DEEP_SLEEP_MODE               0
+#endif
+#ifdef CONFIG_AHT10_OTA_UPDATES
+#define OTA_UPDATE_ENABLE                   1
+#else
+#define OTA_UPDATE_ENABLE                   0
+#endif
+#ifdef CONFIG_AHT10_WIFI_STATIC_IP
+#define ESP_WIFI_USE_STATIC_IP              1
+#else
+#define ESP_WIFI_USE_STATIC_IP              0
+#endif
+
+#endif /* CONFIG_AHT10_SAMPLE_PERIOD_MS */
+
+#endif /* _AHT10_CONFIG_H */
@@ -0,0 +1,76 @@
+#ifndef _AHT10_CONVERT_H
+#define _AHT10_CONVERT_H
+
+#include <stdint.h>
+#include "aht10_config.h"
+
+/* Fixed-point transfer functions for the AHT10's 20-bit codes.
+ *
+ * The L106 has no FPU, so the datasheet formulas
+ *     RH = code / 2^20 * 100%
+ *     T  = code / 2^20 * 200 - 50 C
+ * are evaluated as a single 32-bit multiply and shift instead:
+ *     value = (code * K + 2^(shift-1)) >> shift
+ * where K / 2^shift is the exact reduced form of SCALE * range / 2^20, so the
+ * result is the correctly rounded (half up) value in 1/SCALE units.
+ * The largest K is 3125 so code * K always fits in 32 bits.
+ *
+ * AHT10_CONVERT_DIGITS picks the output resolution at compile time:
+ *     1 -> deci  (0.1 C / 0.1 %RH)
+ *     2 -> centi (0.01 C / 0.01 %RH), default
+ *     3 -> milli (0.001 C / 0.001 %RH), about the sensor's code step */
+#ifndef AHT10_CONVERT_DIGITS
+#define AHT10_CONVERT_DIGITS                2
+#endif
+
+#if AHT10_CONVERT_DIGITS == 1
+#define AHT10_CONVERT_SCALE                 10
+#define AHT10_CONVERT_HUM_MUL               125U
+#define AHT10_CONVERT_HUM_SHIFT             17
+#define AHT10_CONVERT_TEMP_MUL              125U
+#define AHT10_CONVERT_TEMP_SHIFT            16
+#elif AHT10_CONVERT_DIGITS == 2
+#define AHT10_CONVERT_SCALE                 100
+#define AHT10_CONVERT_HUM_MUL               625U
+#define AHT10_CONVERT_HUM_SHIFT             16
+#define AHT10_CONVERT_TEMP_MUL              625U
+#define AHT10_CONVERT_TEMP_SHIFT            15
+#elif AHT10_CONVERT_DIGITS == 3
+#define AHT10_CONVERT_SCALE                 1000
+#define AHT10_CONVERT_HUM_MUL               3125U
+#define AHT10_CONVERT_HUM_SHIFT             15
+#define AHT10_CONVERT_TEMP_MUL              3125U
+#define AHT10_CONVERT_TEMP_SHIFT            14
+#else
+#error "AHT10_CONVERT_DIGITS must be 1, 2 or 3"
+#endif
+
+#define AHT10_CONVERT_TEMP_OFFSET           (50 * AHT10_CONVERT_SCALE)      /* the -50 C in the transfer function */
+#define AHT10_CODE_MAX                      0xFFFFFU                        /* 20-bit codes */
+
+/* printf helpers so callers don't need floats to print a fixed-point value:
+ *     printf("%s%lu." AHT10_CONVERT_FRAC_FMT, AHT10_FIX_SIGN(v), AHT10_FIX_WHOLE(v), AHT10_FIX_FRAC(v)); */
+#define AHT10_STR_(x)                       #x
+#define AHT10_STR(x)                        AHT10_STR_(x)
+#define AHT10_CONVERT_FRAC_FMT              "%0" AHT10_STR(AHT10_CONVERT_DIGITS) "lu"
+#define AHT10_FIX_ABS(v)                    ((int32_t)(v) < 0 ? -(int32_t)(v) : (int32_t)(v))
+#define AHT10_FIX_SIGN(v)                   ((int32_t)(v) < 0 ? "-" : "")
+#define AHT10_FIX_WHOLE(v)                  ((unsigned long)(AHT10_FIX_ABS(v) / AHT10_CONVERT_SCALE))
+#define AHT10_FIX_FRAC(v)                   ((unsigned long)(AHT10_FIX_ABS(v) % AHT10_CONVERT_SCALE))
+
+/* relative humidity in 1/AHT10_CONVERT_SCALE %RH (0 .. 100 * SCALE) */
+static inline uint32_t aht10_convert_humidity(uint32_t code)
+{
+    code &= AHT10_CODE_MAX;
+    return (code * AHT10_CONVERT_HUM_MUL + (1U << (AHT10_CONVERT_HUM_SHIFT - 1))) >> AHT10_CONVERT_HUM_SHIFT;
+}
+
+/* temperature in 1/AHT10_CONVERT_SCALE degrees C (-50 * SCALE .. 150 * SCALE) */
+static inline int32_t aht10_convert_temperature(uint32_t code)
+{
+    code &= AHT10_CODE_MAX;
+    return (int32_t)((code * AHT10_CONVERT_TEMP_MUL + (1U << (AHT10_CONVERT_TEMP_SHIFT - 1))) >> AHT10_CONVERT_TEMP_SHIFT)
+           - AHT10_CONVERT_TEMP_OFFSET;
+}
+
+#endif /* _AHT10_CONVERT_H */
@@ -0,0 +1,139 @@
+/* associated header file */
+#include "aht10_filter.h"
+
+/* others necessary headers */
+#include <string.h>
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+/* K is tiny, an insertion sort beats anything cleverer here */
+static void sort_codes(uint32_t *v, uint8_t n)
+{
+    uint32_t x;
+    uint8_t i, j;
+
+    for (i = 1; i < n; i++)
+    {
+        x = v[i];
+        for (j = i; j > 0 && v[j - 1] > x; j--)
+        {
+            v[j] = v[j - 1];
+        }
+        v[j] = x;
+    }
+}
+
+static uint32_t reduce_codes(const uint32_t *codes, uint8_t n, aht10_filter_t filter, uint8_t trim)
+{
+    uint32_t v[AHT10_FILTER_MAX_BURST];
+    uint32_t sum = 0;
+    uint8_t i;
+
+    if (n == 1)
+    {
+        return codes[0];
+    }
+    memcpy(v, codes, n * sizeof(v[0]));
+    switch (filter)
+    {
+        case AHT10_FILTER_MEDIAN:
+            sort_codes(v, n);
+            return (n & 1) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2] + 1) / 2;
+
+        case AHT10_FILTER_TRIMMED_MEAN:
+            sort_codes(v, n);
+            /* always keep at least one value */
+            if (trim > (n - 1) / 2)
+            {
+                trim = (uint8_t)((n - 1) / 2);
+            }
+            for (i = trim; i < n - trim; i++)
+            {
+                sum += v[i];
+            }
+            n = (uint8_t)(n - 2 * trim);
+            return (sum + n / 2) / n;
+
+        case AHT10_FILTER_MEAN:
+        default:
+            /* 8 x 20-bit codes can't overflow */
+            for (i = 0; i < n; i++)
+            {
+                sum += v[i];
+            }
+            return (sum + n / 2) / n;
+    }
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+aht10_reading_check_t aht10_reading_check(const aht10_reading_t *reading)
+{
+    int32_t temperature;
+
+    if (!(reading->status & AHT10_STATUS_BITS_CAL))
+    {
+        return AHT10_READING_UNCALIBRATED;
+    }
+    if (reading->humidity_raw == 0 || reading->humidity_raw >= AHT10_CODE_MAX
+        || reading->temperature_raw == 0 || reading->temperature_raw >= AHT10_CODE_MAX)
+    {
+        return AHT10_READING_IMPLAUSIBLE;
+    }
+    temperature = aht10_convert_temperature(reading->temperature_raw);
+    if (temperature < AHT10_FILTER_TEMP_MIN_C * AHT10_CONVERT_SCALE
+        || temperature > AHT10_FILTER_TEMP_MAX_C * AHT10_CONVERT_SCALE)
+    {
+        return AHT10_READING_IMPLAUSIBLE;
+    }
+    return AHT10_READING_OK;
+}
+
+void aht10_burst_reset(aht10_burst_t *burst)
+{
+    burst->count = 0;
+    burst->status = 0;
+}
+
+aht10_reading_check_t aht10_burst_add(aht10_burst_t *burst, const aht10_reading_t *reading)
+{
+    aht10_reading_check_t check = aht10_reading_check(reading);
+
+    if (check == AHT10_READING_OK && burst->count < AHT10_FILTER_MAX_BURST)
+    {
+        burst->hum[burst->count] = reading->humidity_raw;
+        burst->temp[burst->count] = reading->temperature_raw;
+        burst->status = reading->status;
+        burst->count++;
+    }
+    return check;
+}
+
+esp_err_t aht10_burst_reduce(const aht10_burst_t *burst, aht10_filter_t filter, uint8_t trim,
+                             aht10_reading_t *reading)
+{
+    if (burst->count == 0)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    reading->status = burst->status;
+    reading->humidity_raw = reduce_codes(burst->hum, burst->count, filter, trim);
+    reading->temperature_raw = reduce_codes(burst->temp, burst->count, filter, trim);
+    reading->humidity = aht10_convert_humidity(reading->humidity_raw);
+    reading->temperature = aht10_convert_temperature(reading->temperature_raw);
+    return ESP_OK;
+}
+
+const char *aht10_filter_name(aht10_filter_t filter)
+{
+    switch (filter)
+    {
+        case AHT10_FILTER_MEDIAN:       return "median";
+        case AHT10_FILTER_TRIMMED_MEAN: return "trimmed";
+        case AHT10_FILTER_MEAN:         return "mean";
+        default:                        return "?";
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef _AHT10_FILTER_H
+#define _AHT10_FILTER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "aht10_i2c.h"
+
+/* Reading checks and burst reduction.
+ *
+ * A reading is only used if the status byte says the part is calibrated
+ * (AHT10_STATUS_BITS_CAL) and the values are physically possible: neither
+ * code stuck at all zeros or all ones (what a dead or shorted bus clocks
+ * out) and the temperature inside the AHT10's operating range.
+ *
+ * In burst mode the scheduler takes K conversions back to back per cycle
+ * and reduces the ones that passed the checks to one reading, humidity and
+ * temperature independently:
+ *     MEDIAN          middle value (mean of the two middle ones for even K),
+ *                     ignores up to (K-1)/2 spikes
+ *     TRIMMED_MEAN    mean without the `trim` lowest and highest values,
+ *                     closer to the plain mean's noise with some robustness
+ *     MEAN            plain mean, the lowest noise when nothing spikes
+ * Every conversion is ~80 ms of sensor and CPU awake time, so K trades
+ * energy for noise; host/filter_bench shows the trade on the simulator. */
+
+#define AHT10_FILTER_MAX_BURST              8
+#define AHT10_FILTER_TEMP_MIN_C             (-40)               /* datasheet operating range */
+#define AHT10_FILTER_TEMP_MAX_C             85
+
+typedef enum {
+    AHT10_FILTER_MEDIAN = 0,
+    AHT10_FILTER_TRIMMED_MEAN,
+    AHT10_FILTER_MEAN,
+} aht10_filter_t;
+
+typedef enum {
+    AHT10_READING_OK = 0,
+    AHT10_READING_UNCALIBRATED,
+    AHT10_READING_IMPLAUSIBLE,
+} aht10_reading_check_t;
+
+/* the accepted readings of one burst */
+typedef struct aht10_burst {
+    uint8_t count;
+    uint8_t status;                     /* of the last accepted reading */
+    uint32_t hum[AHT10_FILTER_MAX_BURST];
+    uint32_t temp[AHT10_FILTER_MAX_BURST];
+} aht10_burst_t;
+
+aht10_reading_check_t aht10_reading_check(const aht10_reading_t *reading);
+
+void aht10_burst_reset(aht10_burst_t *burst);
+/* checks the reading and keeps it if it passes (and the burst has room) */
+aht10_reading_check_t aht10_burst_add(aht10_burst_t *burst, const aht10_reading_t *reading);
+/* one reading out of the burst, converted values included;
+ * ESP_ERR_NOT_FOUND if nothing in it passed the checks */
+esp_err_t aht10_burst_reduce(const aht10_burst_t *burst, aht10_filter_t filter, uint8_t trim,
+                             aht10_reading_t *reading);
+
+const char *aht10_filter_name(aht10_filter_t filter);
+
+#endif /* _AHT10_FILTER_H */
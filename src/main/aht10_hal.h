@@ -0,0 +1,51 @@
+#ifndef _AHT10_HAL_H
+#define _AHT10_HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Thin bus/timer abstraction that sits underneath the AHT10 driver.
+ *
+ * The driver in aht10_i2c.c only ever talks to the sensor through one of
+ * these, so the same measurement code can run against the real I2C
+ * peripheral on the ESP8266 (aht10_hal_esp.c) or against the simulated AHT10
+ * in host/aht10_sim.c on Linux.
+ *
+ * - write/read move whole I2C transactions (start, 7-bit address, payload, stop)
+ *   and return the same esp_err_t values as i2c_master_cmd_begin()
+ * - delay_ms blocks the calling task, time_us is a free running microsecond
+ *   clock used for latency bookkeeping
+ * - recover frees a bus some slave is holding SDA low on (a transfer cut off
+ *   mid byte, e.g. by a reset of the master): up to nine SCL pulses until SDA
+ *   goes high, then a STOP. Optional, NULL if the bus can't do it */
+typedef struct aht10_hal {
+    void *ctx;
+    esp_err_t (*init)(void *ctx);
+    esp_err_t (*write)(void *ctx, uint8_t addr, const uint8_t *data, size_t data_len);
+    esp_err_t (*read)(void *ctx, uint8_t addr, uint8_t *data, size_t data_len);
+    void (*delay_ms)(void *ctx, uint32_t ms);
+    int64_t (*time_us)(void *ctx);
+    void (*deinit)(void *ctx);
+    esp_err_t (*recover)(void *ctx);
+} aht10_hal_t;
+
+/* HAL backed by the ESP8266 I2C master driver (see aht10_hal_esp.c), on the
+ * default I2C_AHT10_MASTER_SDA_IO/SCL_IO pins */
+const aht10_hal_t *aht10_hal_esp(void);
+
+/* The ESP8266 has one (bit-banged) I2C master, but it can be pointed at a
+ * different pin pair between transactions. Each pin pair gets one of these
+ * and the driver switches pins whenever a transaction comes in on a
+ * different bus than the last one. */
+typedef struct aht10_esp_bus {
+    int sda_io;
+    int scl_io;
+    aht10_hal_t hal;
+} aht10_esp_bus_t;
+
+const aht10_hal_t *aht10_hal_esp_pins(aht10_esp_bus_t *bus, int sda_io, int scl_io);
+/* transactions that had to build a command link on the heap (0 in steady state) */
+uint32_t aht10_hal_esp_dynamic_allocs(void);
+
+#endif /* _AHT10_HAL_H */
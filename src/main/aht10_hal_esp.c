@@ -0,0 +1,359 @@
+/* associated header file */
+#include "aht10_hal.h"
+
+/* others necessary headers */
+#include <string.h>
+#include "aht10_i2c.h"
+#include "aht10_mux.h"
+#include "driver/gpio.h"
+#include "driver/i2c.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "rom/ets_sys.h"
+
+/* a transaction that takes longer than this is stuck, not slow: fail it
+ * instead of blocking the sensor task for the old second (at least a tick) */
+#define ESP_CMD_TIMEOUT_TICKS \
+    ((I2C_AHT10_CMD_TIMEOUT_MS / portTICK_RATE_MS) > 0 ? (I2C_AHT10_CMD_TIMEOUT_MS / portTICK_RATE_MS) : 1)
+#define ESP_RECOVER_HALF_PERIOD_US          5                   /* 100 kHz */
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+/* Prebuilt command links for the fixed AHT10 transactions.
+ *
+ * i2c_cmd_link_create() and every i2c_master_*() call on a link allocate from
+ * the heap, which used to happen (and be freed again) on every read and write.
+ * The AHT10 only ever sees a handful of distinct transactions, so those links
+ * are built once in i2c_master_init() around static buffers and then replayed
+ * with i2c_master_cmd_begin(), which walks the link without consuming it.
+ * Writes are matched on address and payload, so the select byte of each
+ * configured mux channel (AHT10_MUX_CHANNEL_MASK) gets a link too. Anything
+ * that doesn't match a prebuilt transaction still goes through a temporary
+ * link and is counted in s_dynamic_allocs. */
+typedef struct {
+    i2c_cmd_handle_t cmd;
+    uint8_t addr;
+    uint8_t data[1 + AHT10_CMD_MAX_PARAMS];
+    size_t data_len;
+} prebuilt_write_t;
+
+typedef struct {
+    i2c_cmd_handle_t cmd;
+    size_t data_len;
+} prebuilt_read_t;
+
+/* the plain init only goes out once at boot, the mode switches
+ * (aht10_set_mode) send init with the calibration bit */
+enum {
+    PREBUILT_WRITE_INIT_NORMAL = 0,
+#if AHT10_CYCLE_MODE_ENABLE
+    PREBUILT_WRITE_INIT_CYCLE,
+#endif
+    PREBUILT_WRITE_MEASURE,
+    PREBUILT_WRITE_SOFTRESET,
+    PREBUILT_WRITE_MUX_SELECT,          /* one per mux channel, built if it's configured */
+    PREBUILT_WRITE_COUNT = PREBUILT_WRITE_MUX_SELECT + AHT10_MUX_CHANNELS,
+};
+
+enum {
+    PREBUILT_READ_STATUS = 0,
+    PREBUILT_READ_RESULT,
+    PREBUILT_READ_COUNT,
+};
+
+static prebuilt_write_t s_prebuilt_write[PREBUILT_WRITE_COUNT] = {
+    [PREBUILT_WRITE_INIT_NORMAL] = { NULL, AHT10_SENSOR_ADDR,
+                                     { AHT10_CMD_INIT, AHT10_INIT_REG_NORMAL | AHT10_INIT_REG_CAL }, 2 },
+#if AHT10_CYCLE_MODE_ENABLE
+    [PREBUILT_WRITE_INIT_CYCLE] = { NULL, AHT10_SENSOR_ADDR,
+                                    { AHT10_CMD_INIT, AHT10_INIT_REG_CYCLE | AHT10_INIT_REG_CAL }, 2 },
+#endif
+    [PREBUILT_WRITE_MEASURE] = { NULL, AHT10_SENSOR_ADDR,
+                                 { AHT10_CMD_MEASURE, AHT10_BYTE_MEASURE, AHT10_BYTE_ZEROS }, 3 },
+    [PREBUILT_WRITE_SOFTRESET] = { NULL, AHT10_SENSOR_ADDR, { AHT10_CMD_SOFTRESET }, 1 },
+};
+static prebuilt_read_t s_prebuilt_read[PREBUILT_READ_COUNT] = {
+    [PREBUILT_READ_STATUS] = { NULL, 1 },
+    [PREBUILT_READ_RESULT] = { NULL, AHT10_RESULT_LEN },
+};
+/* every prebuilt read lands here, then gets copied out to the caller */
+static uint8_t s_rx_buf[AHT10_RESULT_LEN];
+static uint32_t s_dynamic_allocs;
+
+/* pin pair the master is currently driving, and how many buses use the driver */
+static const aht10_esp_bus_t *s_active_bus;
+static uint32_t s_bus_users;
+
+/* ___________________________________________________________________
+ * | start | slave_addr + wr_bit + ack | write data_len byte + ack  | stop |
+ * --------|---------------------------|----------------------------|------|
+ */
+static i2c_cmd_handle_t build_write(uint8_t addr, const uint8_t *data, size_t data_len)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, addr << 1 | WRITE_BIT, ACK_CHECK_EN);
+    i2c_master_write(cmd, (uint8_t *)data, data_len, ACK_CHECK_EN);
+    i2c_master_stop(cmd);
+    return cmd;
+}
+
+/* ___________________________________________________________________________________
+ * | start | slave_addr + rd_bit + ack | read data_len byte + ack(last nack)  | stop |
+ * --------|---------------------------|--------------------------------------|------|
+ */
+static i2c_cmd_handle_t build_read(uint8_t addr, uint8_t *data, size_t data_len)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, addr << 1 | READ_BIT, ACK_CHECK_EN);
+    i2c_master_read(cmd, data, data_len, LAST_NACK_VAL);
+    i2c_master_stop(cmd);
+    return cmd;
+}
+
+static void prebuild_links(void)
+{
+    prebuilt_write_t *select;
+    int i;
+
+    for (i = 0; i < AHT10_MUX_CHANNELS; i++)
+    {
+        if (AHT10_MUX_CHANNEL_MASK & (1U << i))
+        {
+            select = &s_prebuilt_write[PREBUILT_WRITE_MUX_SELECT + i];
+            select->addr = AHT10_MUX_ADDR;
+            select->data[0] = (uint8_t)(1U << i);
+            select->data_len = 1;
+        }
+    }
+    for (i = 0; i < PREBUILT_WRITE_COUNT; i++)
+    {
+        if (s_prebuilt_write[i].cmd == NULL && s_prebuilt_write[i].data_len > 0)
+        {
+            s_prebuilt_write[i].cmd = build_write(s_prebuilt_write[i].addr, s_prebuilt_write[i].data,
+                                                  s_prebuilt_write[i].data_len);
+        }
+    }
+    for (i = 0; i < PREBUILT_READ_COUNT; i++)
+    {
+        if (s_prebuilt_read[i].cmd == NULL)
+        {
+            s_prebuilt_read[i].cmd = build_read(AHT10_SENSOR_ADDR, s_rx_buf, s_prebuilt_read[i].data_len);
+        }
+    }
+}
+
+/* point the one I2C master at this bus's pins if it isn't already */
+static esp_err_t select_bus(const aht10_esp_bus_t *bus)
+{
+    i2c_config_t conf;
+    esp_err_t ret;
+
+    if (bus == s_active_bus)
+    {
+        return ESP_OK;
+    }
+    conf.mode = I2C_MODE_MASTER;
+    conf.sda_io_num = bus->sda_io;
+    conf.sda_pullup_en = 1;
+    conf.scl_io_num = bus->scl_io;
+    conf.scl_pullup_en = 1;
+    /* 300 ticks, a clock stretch of about 210 us; change it to suit the
+     * actual situation */
+    conf.clk_stretch_tick = 300;
+    ret = i2c_param_config(I2C_AHT10_MASTER_NUM, &conf);
+    s_active_bus = (ret == ESP_OK) ? bus : NULL;
+    return ret;
+}
+
+/* Configure I2C communication according to what I see on the datasheet */
+static esp_err_t i2c_master_init(void *ctx)
+{
+    int i2c_master_port = I2C_AHT10_MASTER_NUM;
+
+    /* one driver for every pin pair, each bus only adds its pins */
+    if (s_bus_users++ == 0)
+    {
+        i2c_driver_install(i2c_master_port, I2C_MODE_MASTER);
+        prebuild_links();
+    }
+    return select_bus((const aht10_esp_bus_t *)ctx);
+}
+
+static esp_err_t i2c_master_write_slave(void *ctx, uint8_t addr, const uint8_t *data, size_t data_len)
+{
+    int ret;
+    int i;
+    i2c_cmd_handle_t cmd;
+
+    if ((ret = select_bus((const aht10_esp_bus_t *)ctx)) != ESP_OK)
+    {
+        return ret;
+    }
+
+    for (i = 0; i < PREBUILT_WRITE_COUNT; i++)
+    {
+        if (s_prebuilt_write[i].cmd != NULL && s_prebuilt_write[i].addr == addr
+            && s_prebuilt_write[i].data_len == data_len && memcmp(s_prebuilt_write[i].data, data, data_len) == 0)
+        {
+            return i2c_master_cmd_begin(I2C_AHT10_MASTER_NUM, s_prebuilt_write[i].cmd, ESP_CMD_TIMEOUT_TICKS);
+        }
+    }
+
+    s_dynamic_allocs++;
+    cmd = build_write(addr, data, data_len);
+    ret = i2c_master_cmd_begin(I2C_AHT10_MASTER_NUM, cmd, ESP_CMD_TIMEOUT_TICKS);
+    i2c_cmd_link_delete(cmd);
+
+    return ret;
+}
+
+static esp_err_t i2c_master_read_slave(void *ctx, uint8_t addr, uint8_t *data, size_t data_len)
+{
+    int ret;
+    int i;
+    i2c_cmd_handle_t cmd;
+
+    if ((ret = select_bus((const aht10_esp_bus_t *)ctx)) != ESP_OK)
+    {
+        return ret;
+    }
+
+    if (addr == AHT10_SENSOR_ADDR)
+    {
+        for (i = 0; i < PREBUILT_READ_COUNT; i++)
+        {
+            if (s_prebuilt_read[i].cmd != NULL && s_prebuilt_read[i].data_len == data_len)
+            {
+                ret = i2c_master_cmd_begin(I2C_AHT10_MASTER_NUM, s_prebuilt_read[i].cmd, ESP_CMD_TIMEOUT_TICKS);
+                memcpy(data, s_rx_buf, data_len);
+                return ret;
+            }
+        }
+    }
+
+    s_dynamic_allocs++;
+    cmd = build_read(addr, data, data_len);
+    ret = i2c_master_cmd_begin(I2C_AHT10_MASTER_NUM, cmd, ESP_CMD_TIMEOUT_TICKS);
+    i2c_cmd_link_delete(cmd);
+
+    return ret;
+}
+
+/* The master bit-bangs both pins as open-drain GPIOs, so they can be driven
+ * directly here; the config is reapplied afterwards to hand them back. */
+static esp_err_t i2c_master_recover(void *ctx)
+{
+    const aht10_esp_bus_t *bus = (const aht10_esp_bus_t *)ctx;
+    esp_err_t ret;
+    int i;
+
+    if ((ret = select_bus(bus)) != ESP_OK)
+    {
+        return ret;
+    }
+
+    gpio_set_level(bus->sda_io, 1);
+    for (i = 0; i < I2C_AHT10_RECOVER_CLOCKS && gpio_get_level(bus->sda_io) == 0; i++)
+    {
+        gpio_set_level(bus->scl_io, 0);
+        ets_delay_us(ESP_RECOVER_HALF_PERIOD_US);
+        gpio_set_level(bus->scl_io, 1);
+        ets_delay_us(ESP_RECOVER_HALF_PERIOD_US);
+    }
+
+    /* STOP: SDA low to high while SCL is high */
+    gpio_set_level(bus->scl_io, 0);
+    gpio_set_level(bus->sda_io, 0);
+    ets_delay_us(ESP_RECOVER_HALF_PERIOD_US);
+    gpio_set_level(bus->scl_io, 1);
+    ets_delay_us(ESP_RECOVER_HALF_PERIOD_US);
+    gpio_set_level(bus->sda_io, 1);
+    ets_delay_us(ESP_RECOVER_HALF_PERIOD_US);
+
+    ret = (gpio_get_level(bus->sda_io) != 0) ? ESP_OK : ESP_FAIL;
+    s_active_bus = NULL;
+    select_bus(bus);
+    return ret;
+}
+
+static void esp_delay_ms(void *ctx, uint32_t ms)
+{
+    vTaskDelay(ms / portTICK_RATE_MS);
+}
+
+static int64_t esp_time_us(void *ctx)
+{
+    return esp_timer_get_time();
+}
+
+static void i2c_master_deinit(void *ctx)
+{
+    int i;
+
+    /* the last bus out takes the driver down */
+    if (s_bus_users == 0 || --s_bus_users > 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < PREBUILT_WRITE_COUNT; i++)
+    {
+        if (s_prebuilt_write[i].cmd != NULL)
+        {
+            i2c_cmd_link_delete(s_prebuilt_write[i].cmd);
+            s_prebuilt_write[i].cmd = NULL;
+        }
+    }
+    for (i = 0; i < PREBUILT_READ_COUNT; i++)
+    {
+        if (s_prebuilt_read[i].cmd != NULL)
+        {
+            i2c_cmd_link_delete(s_prebuilt_read[i].cmd);
+            s_prebuilt_read[i].cmd = NULL;
+        }
+    }
+    i2c_driver_delete(I2C_AHT10_MASTER_NUM);
+    s_active_bus = NULL;
+}
+
+static aht10_esp_bus_t s_default_bus = {
+    .sda_io = I2C_AHT10_MASTER_SDA_IO,
+    .scl_io = I2C_AHT10_MASTER_SCL_IO,
+    .hal = {
+        .ctx = &s_default_bus,
+        .init = i2c_master_init,
+        .write = i2c_master_write_slave,
+        .read = i2c_master_read_slave,
+        .delay_ms = esp_delay_ms,
+        .time_us = esp_time_us,
+        .deinit = i2c_master_deinit,
+        .recover = i2c_master_recover,
+    },
+};
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+const aht10_hal_t *aht10_hal_esp(void)
+{
+    return &s_default_bus.hal;
+}
+
+const aht10_hal_t *aht10_hal_esp_pins(aht10_esp_bus_t *bus, int sda_io, int scl_io)
+{
+    bus->sda_io = sda_io;
+    bus->scl_io = scl_io;
+    bus->hal = s_default_bus.hal;
+    bus->hal.ctx = bus;
+    return &bus->hal;
+}
+
+uint32_t aht10_hal_esp_dynamic_allocs(void)
+{
+    return s_dynamic_allocs;
+}
@@ -1,6 +1,11 @@
 #ifndef _AHT10_I2C_H
 #define _AHT10_I2C_H
 
+#include <stdint.h>
+#include "aht10_config.h"
+#include "aht10_convert.h"
+#include "aht10_hal.h"
+
 /* Not sure if TRUE is already defined as a macro or not */
 #ifndef TRUE
 #define TRUE                              1
@@ -8,13 +13,21 @@
 #ifndef FALSE
 #define FALSE                             0
 #endif
+#ifndef DELAY_AFTER_CMD
 #define DELAY_AFTER_CMD                   TRUE                /* 1 means that it'll delay after CMD issuing, otherwise  */
+#endif
 
+#ifndef I2C_AHT10_MASTER_SCL_IO
 #define I2C_AHT10_MASTER_SCL_IO           2                   /*  gpio number for I2C master clock */
+#endif
+#ifndef I2C_AHT10_MASTER_SDA_IO
 #define I2C_AHT10_MASTER_SDA_IO           0                   /*  gpio number for I2C master data  */
+#endif
 #define I2C_AHT10_MASTER_NUM              I2C_NUM_0           /* I2C port number for master dev */
 #define I2C_AHT10_MASTER_TX_BUF_DISABLE   0                   /* I2C master do not need buffer */
 #define I2C_AHT10_MASTER_RX_BUF_DISABLE   0                   /* I2C master do not need buffer */
+#define I2C_AHT10_CMD_TIMEOUT_MS          20                  /* per transaction; the longest one is under 1 ms on the wire */
+#define I2C_AHT10_RECOVER_CLOCKS          9                   /* SCL pulses to get a slave to let go of SDA */
 
 /* The AHT10 Datasheet shows the following workflow:
  * - send a 7-bit address with a write bit (0)
@@ -25,7 +38,9 @@
  * - Read the data? */
 #define AHT10_BYTE_ZEROS                    (uint8_t)0x00       /* dummy zero data byte */
 #define AHT10_BYTE_MEASURE                  (uint8_t)0x33       /* measure data byte shown in datasheet */
+#ifndef AHT10_MEAS_DELAY
 #define AHT10_MEAS_DELAY                    80                  /* check every N milliseconds for measurement complete */
+#endif
 #define AHT10_DELAY_PWR_ON                  50                  /* milliseconds to wait after power on */
 #define AHT10_DELAY_CMD                     350                 /* even though this isn't in the datasheet this seems important */
 #define AHT10_DELAY_SOFT_RESET              20                  /* should we need to soft reset, it takes less than 20ms */
@@ -40,6 +55,12 @@
 #define AHT10_STATUS_BITS_BUSY              0x40                /* Status bit indicating busy (measuring) status */
 #define AHT10_STATUS_BITS_MODE              0x30                /* Mode meanings: 00 is NOR, 01 is CYC, 1X is CMD */
 #define AHT10_STATUS_BITS_CAL               0x04                /* Cal bit (set if calibrated) */
+#define AHT10_CMD_MAX_PARAMS                2                   /* no command takes more than two parameter bytes */
+#define AHT10_RESULT_LEN                    6                   /* status byte + 20 bits humidity + 20 bits temperature */
+#ifndef AHT10_I2C_RETRIES
+#define AHT10_I2C_RETRIES                   2                   /* extra attempts for a NACKed or timed out transaction */
+#endif
+#define AHT10_SAMPLE_MAX_POLLS              4                   /* aht10_sample() gives up after this many busy reads */
 #define WRITE_BIT                           I2C_MASTER_WRITE    /* I2C master write */
 #define READ_BIT                            I2C_MASTER_READ     /* I2C master read */
 #define ACK_CHECK_EN                        0x1                 /* I2C master will check ack from slave*/
@@ -48,6 +69,53 @@
 #define NACK_VAL                            0x1                 /* I2C nack value */
 #define LAST_NACK_VAL                       0x2                 /* I2C last_nack value */
 
-void i2c_task_aht10(void *arg);
+/* One completed measurement as read back from the sensor */
+typedef struct aht10_reading {
+    uint8_t status;                     /* status byte (busy, mode and cal bits) */
+    uint32_t humidity_raw;              /* 20-bit relative humidity code */
+    uint32_t temperature_raw;           /* 20-bit temperature code */
+    uint32_t humidity;                  /* %RH in 1/AHT10_CONVERT_SCALE units */
+    int32_t temperature;                /* degrees C in 1/AHT10_CONVERT_SCALE units */
+} aht10_reading_t;
+
+/* Acquisition mode. NORMAL converts once per AHT10_CMD_MEASURE and sleeps in
+ * between; CYCLE keeps converting on its own, so the latest result is one
+ * read away without a trigger or the conversion wait. */
+typedef enum {
+    AHT10_MODE_NORMAL = 0,
+    AHT10_MODE_CYCLE,
+} aht10_mode_t;
+
+/* Builds without cycle mode only ever run NORMAL. Test for CYCLE through
+ * AHT10_MODE_IS_CYCLE() so the cycle branches fold away in those. */
+#ifndef AHT10_CYCLE_MODE_ENABLE
+#define AHT10_CYCLE_MODE_ENABLE             1
+#endif
+#define AHT10_MODE_IS_CYCLE(mode)           (AHT10_CYCLE_MODE_ENABLE && (mode) == AHT10_MODE_CYCLE)
+
+/* global functions */
+esp_err_t aht10_init(const aht10_hal_t *hal);
+/* one init command with the mode (calibration enabled), no settling delay;
+ * in CYCLE the first result is there a conversion time later */
+esp_err_t aht10_set_mode(const aht10_hal_t *hal, aht10_mode_t mode);
+esp_err_t aht10_trigger(const aht10_hal_t *hal);
+esp_err_t aht10_read_status(const aht10_hal_t *hal, uint8_t *status);
+esp_err_t aht10_read_result(const aht10_hal_t *hal, uint8_t *rx_data);
+
+/* Recovery, in escalating order. aht10_bus_recover() clocks a stuck SDA free
+ * (ESP_ERR_NOT_SUPPORTED if the HAL has no recover op). aht10_soft_reset()
+ * sends AHT10_CMD_SOFTRESET; the part then ignores the bus for
+ * AHT10_DELAY_SOFT_RESET and comes back in normal mode, so it needs
+ * aht10_set_mode() before the next trigger. */
+esp_err_t aht10_bus_recover(const aht10_hal_t *hal);
+esp_err_t aht10_soft_reset(const aht10_hal_t *hal);
+/* retried transactions (each retry counts once) since boot */
+uint32_t aht10_i2c_retries(void);
+
+void aht10_parse(const uint8_t *rx_data, aht10_reading_t *reading);
+
+/* blocking trigger + poll + read, kept as the reference path for host runs;
+ * ESP_ERR_TIMEOUT if still busy after AHT10_SAMPLE_MAX_POLLS reads */
+esp_err_t aht10_sample(const aht10_hal_t *hal, aht10_reading_t *reading);
 
 #endif /* _AHT10_I2C_H */ 
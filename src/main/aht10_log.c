@@ -0,0 +1,339 @@
+/* associated header file */
+#include "aht10_log.h"
+
+/* others necessary headers */
+#include <string.h>
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+/* the tinyprintf component (EXTRA_COMPONENT_DIRS in src/Makefile) formats
+ * with a fraction of newlib's stack and code size; without it fall back to
+ * the C library */
+#if !defined(AHT10_LOG_TINYPRINTF) && defined(ESP_PLATFORM) && defined(__has_include)
+#if __has_include("tinyprintf.h")
+#define AHT10_LOG_TINYPRINTF                1
+#endif
+#endif
+
+#if AHT10_LOG_TINYPRINTF
+#include "tinyprintf.h"
+#define log_snprintf                        tfp_snprintf
+#else
+#define log_snprintf                        snprintf
+#endif
+
+/* formats kept in this build, the host decoder keeps all of them */
+#ifndef AHT10_LOG_FORMAT_LEVEL
+#define AHT10_LOG_FORMAT_LEVEL              AHT10_LOG_LEVEL
+#endif
+
+/* A slot is free for lap L when its turn is 2L and holds a record of lap L
+ * when it is 2L + 1, where a lap is index / capacity; all-zero is an empty
+ * ring, so records put before aht10_log_init() aren't lost. */
+typedef struct log_slot {
+    uint32_t turn;
+    aht10_log_record_t rec;
+} log_slot_t;
+
+typedef struct log_format {
+    uint8_t level;
+    const char *fmt;
+} log_format_t;
+
+#define LOG_X_FORMAT(name, level, fmt)      { (level), ((level) <= AHT10_LOG_FORMAT_LEVEL) ? (fmt) : NULL },
+static const log_format_t s_formats[AHT10_LOG_ID_COUNT] = { AHT10_LOG_FORMATS(LOG_X_FORMAT) };
+
+static const char s_level_chars[] = "NEWIDV";
+
+static log_slot_t s_slots[AHT10_LOG_CAPACITY];
+static uint32_t s_head;                 /* next index to claim, all writers */
+static uint32_t s_tail;                 /* next index to read */
+static uint32_t s_written;
+static uint32_t s_dropped;
+static uint32_t s_read;
+static uint32_t (*s_now_ms)(void);
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+/* same pattern as sample_ring.c: plain aligned loads and stores, the CAS
+ * with interrupts masked on the L106 since it has no such instruction */
+static inline uint32_t log_load(const uint32_t *p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void log_store(uint32_t *p, uint32_t v)
+{
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static inline int log_cas(uint32_t *p, uint32_t expected, uint32_t desired)
+{
+#ifdef ESP_PLATFORM
+    int swapped = 0;
+
+    portENTER_CRITICAL();
+    if (*p == expected)
+    {
+        *p = desired;
+        swapped = 1;
+    }
+    portEXIT_CRITICAL();
+    return swapped;
+#else
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void log_count(uint32_t *counter)
+{
+    uint32_t v;
+
+    do
+    {
+        v = log_load(counter);
+    } while (!log_cas(counter, v, v + 1));
+}
+
+static inline uint32_t lap_turn(uint32_t index)
+{
+    return (index / AHT10_LOG_CAPACITY) * 2;
+}
+
+static size_t put_varint(uint8_t *p, uint32_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+/* returns bytes consumed, 0 if the varint runs off the end or is too long */
+static size_t get_varint(const uint8_t *p, size_t avail, uint32_t *v)
+{
+    uint32_t result = 0;
+    size_t n;
+
+    for (n = 0; n < avail && n < 5; n++)
+    {
+        result |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+        if ((p[n] & 0x80) == 0)
+        {
+            *v = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static uint8_t checksum(const uint8_t *p, size_t len)
+{
+    uint8_t sum = 0;
+
+    while (len--)
+    {
+        sum += *p++;
+    }
+    return (uint8_t)~sum;
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void aht10_log_init(uint32_t (*now_ms)(void))
+{
+    memset(s_slots, 0, sizeof(s_slots));
+    s_head = s_tail = 0;
+    s_written = s_dropped = s_read = 0;
+    s_now_ms = now_ms;
+}
+
+esp_err_t aht10_log_put(uint8_t id, const uint32_t *args, uint8_t nargs)
+{
+    log_slot_t *slot;
+    uint32_t pos;
+
+    for (;;)
+    {
+        pos = log_load(&s_head);
+        slot = &s_slots[pos & AHT10_LOG_MASK];
+        if (log_load(&slot->turn) == lap_turn(pos))
+        {
+            if (log_cas(&s_head, pos, pos + 1))
+            {
+                break;
+            }
+        }
+        else if (log_load(&s_head) == pos)
+        {
+            /* the slot still holds last lap's record: full, never wait */
+            log_count(&s_dropped);
+            return ESP_FAIL;
+        }
+    }
+
+    if (nargs > AHT10_LOG_MAX_ARGS)
+    {
+        nargs = AHT10_LOG_MAX_ARGS;
+    }
+    slot->rec.timestamp_ms = s_now_ms ? s_now_ms() : 0;
+    slot->rec.id = id;
+    slot->rec.nargs = nargs;
+    memcpy(slot->rec.args, args, nargs * sizeof(uint32_t));
+    log_store(&slot->turn, lap_turn(pos) + 1);
+    log_count(&s_written);
+    return ESP_OK;
+}
+
+esp_err_t aht10_log_get(aht10_log_record_t *rec)
+{
+    log_slot_t *slot;
+    uint32_t pos;
+
+    for (;;)
+    {
+        pos = log_load(&s_tail);
+        slot = &s_slots[pos & AHT10_LOG_MASK];
+        if (log_load(&slot->turn) == lap_turn(pos) + 1)
+        {
+            if (log_cas(&s_tail, pos, pos + 1))
+            {
+                break;
+            }
+        }
+        else if (log_load(&s_tail) == pos)
+        {
+            /* empty, or the writer of this slot hasn't finished yet */
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+
+    *rec = slot->rec;
+    log_store(&slot->turn, lap_turn(pos) + 2);
+    log_count(&s_read);
+    return ESP_OK;
+}
+
+void aht10_log_get_stats(aht10_log_stats_t *stats)
+{
+    stats->written = log_load(&s_written);
+    stats->dropped = log_load(&s_dropped);
+    stats->read = log_load(&s_read);
+}
+
+const char *aht10_log_fmt(uint8_t id)
+{
+    return (id < AHT10_LOG_ID_COUNT) ? s_formats[id].fmt : NULL;
+}
+
+int aht10_log_level_of(uint8_t id)
+{
+    return (id < AHT10_LOG_ID_COUNT) ? s_formats[id].level : AHT10_LOG_NONE;
+}
+
+size_t aht10_log_format(const aht10_log_record_t *rec, char *buf, size_t len)
+{
+    const char *fmt = aht10_log_fmt(rec->id);
+    const uint32_t *a = rec->args;
+    uint32_t unused[AHT10_LOG_MAX_ARGS] = { 0 };
+    int n, m;
+
+    if (len == 0)
+    {
+        return 0;
+    }
+    n = log_snprintf(buf, len, "%c (%u) ", s_level_chars[aht10_log_level_of(rec->id)], rec->timestamp_ms);
+    if (n < 0 || (size_t)n >= len)
+    {
+        return strlen(buf);
+    }
+    if (fmt == NULL)
+    {
+        m = log_snprintf(buf + n, len - n, "record %u (%u args)", rec->id, rec->nargs);
+    }
+    else
+    {
+        /* the format only consumes as many as it has conversions, the rest
+         * are ignored; arguments a record didn't carry read as 0 */
+        if (rec->nargs < AHT10_LOG_MAX_ARGS)
+        {
+            memcpy(unused, rec->args, rec->nargs * sizeof(uint32_t));
+            a = unused;
+        }
+        m = log_snprintf(buf + n, len - n, fmt, a[0], a[1], a[2], a[3], a[4], a[5]);
+    }
+    return (m < 0) ? (size_t)n : strlen(buf);
+}
+
+size_t aht10_log_encode(const aht10_log_record_t *rec, uint8_t *buf)
+{
+    uint8_t nargs = (rec->nargs > AHT10_LOG_MAX_ARGS) ? AHT10_LOG_MAX_ARGS : rec->nargs;
+    size_t n = 0;
+    uint8_t i;
+
+    buf[n++] = AHT10_LOG_SYNC;
+    buf[n++] = rec->id;
+    buf[n++] = nargs;
+    n += put_varint(&buf[n], rec->timestamp_ms);
+    for (i = 0; i < nargs; i++)
+    {
+        n += put_varint(&buf[n], rec->args[i]);
+    }
+    buf[n] = checksum(&buf[1], n - 1);
+    return n + 1;
+}
+
+esp_err_t aht10_log_decode(const uint8_t *buf, size_t len, aht10_log_record_t *rec, size_t *used)
+{
+    size_t n = 3, k;
+    uint8_t i;
+
+    if (len == 0)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (buf[0] != AHT10_LOG_SYNC)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (len < 3)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (buf[2] > AHT10_LOG_MAX_ARGS)
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    memset(rec, 0, sizeof(*rec));
+    rec->id = buf[1];
+    rec->nargs = buf[2];
+
+    for (i = 0; i <= rec->nargs; i++)
+    {
+        k = get_varint(&buf[n], len - n, (i == 0) ? &rec->timestamp_ms : &rec->args[i - 1]);
+        if (k == 0)
+        {
+            /* either more bytes are on the way or this was never a frame */
+            return (len - n < 5) ? ESP_ERR_INVALID_SIZE : ESP_ERR_INVALID_RESPONSE;
+        }
+        n += k;
+    }
+    if (n >= len)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (buf[n] != checksum(&buf[1], n - 1))
+    {
+        return ESP_ERR_INVALID_CRC;
+    }
+    *used = n + 1;
+    return ESP_OK;
+}
@@ -0,0 +1,178 @@
+#ifndef _AHT10_LOG_H
+#define _AHT10_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "aht10_config.h"
+#include "aht10_convert.h"
+
+/* Deferred binary logging.
+ *
+ * Formatting text and pushing it out of the UART costs far more than
+ * anything else the sample loop does, so the hot paths don't do it. A log
+ * statement only copies a format id, a timestamp and up to
+ * AHT10_LOG_MAX_ARGS 32-bit arguments into a RAM ring; a low-priority task
+ * (aht10_log_esp.c) formats the records later, or writes them out as binary
+ * frames for host/log_decode to format on the PC.
+ *
+ * Every message lives in the AHT10_LOG_FORMATS table below, the same table
+ * the host decoder is built from, so record ids only mean something to a
+ * decoder built from the same tree. Arguments are always uint32_t, so the
+ * formats may only use %u, %d, %x, %X and %c (with flags and width), no
+ * %s, no %l, no floats; host/log_decode -t checks that.
+ *
+ * Statements above AHT10_LOG_LEVEL compile to nothing, arguments included,
+ * and their format strings don't make it into the image either.
+ *
+ * The ring never blocks: writers (any task, not ISRs) claim a slot with a
+ * compare-and-swap, and when the ring is full the record is dropped and
+ * counted instead. */
+
+#define AHT10_LOG_NONE                      0
+#define AHT10_LOG_ERROR                     1
+#define AHT10_LOG_WARN                      2
+#define AHT10_LOG_INFO                      3
+#define AHT10_LOG_DEBUG                     4
+#define AHT10_LOG_VERBOSE                   5
+
+/* same scale as the SDK's menuconfig log level */
+#ifndef AHT10_LOG_LEVEL
+#ifdef CONFIG_LOG_DEFAULT_LEVEL
+#define AHT10_LOG_LEVEL                     CONFIG_LOG_DEFAULT_LEVEL
+#else
+#define AHT10_LOG_LEVEL                     AHT10_LOG_INFO
+#endif
+#endif
+
+#define AHT10_LOG_MAX_ARGS                  6
+#ifndef AHT10_LOG_CAPACITY
+#define AHT10_LOG_CAPACITY                  32                  /* records, a few cycles' worth at DEBUG */
+#endif
+#define AHT10_LOG_MASK                      (AHT10_LOG_CAPACITY - 1)
+#define AHT10_LOG_LINE_MAX                  128                 /* one formatted record, prefix included */
+
+#if (AHT10_LOG_CAPACITY & AHT10_LOG_MASK) != 0
+#error "AHT10_LOG_CAPACITY must be a power of two"
+#endif
+
+/* device side (aht10_log_esp.c) */
+#define AHT10_LOG_TASK_STACK_DEPTH          1536
+#define AHT10_LOG_TASK_PRIORITY             1                   /* only runs when everything else is idle */
+#define AHT10_LOG_DRAIN_PERIOD_MS           100
+#define AHT10_LOG_BINARY                    0                   /* 1 writes binary frames to the console for host/log_decode */
+
+/* binary frame: sync, id, nargs, varint timestamp, varint args, checksum */
+#define AHT10_LOG_SYNC                      0xA5
+#define AHT10_LOG_WIRE_MAX                  (3 + 5 * (1 + AHT10_LOG_MAX_ARGS) + 1)
+
+/* fixed-point values as log arguments: sign character, whole part, fraction */
+#define AHT10_LOG_FRAC_FMT                  "%0" AHT10_STR(AHT10_CONVERT_DIGITS) "u"
+#define AHT10_LOG_FIX_SIGN(v)               ((int32_t)(v) < 0 ? '-' : '+')
+
+/* X(name, level, format) */
+#define AHT10_LOG_FORMATS(X) \
+    X(LOG_DROPPED,      AHT10_LOG_WARN,     "log: %u records dropped") \
+    X(I2C_INIT,         AHT10_LOG_DEBUG,    "aht10: init, status 0x%02X") \
+    X(I2C_TRIGGER,      AHT10_LOG_VERBOSE,  "aht10: measure command sent") \
+    X(I2C_BUSY,         AHT10_LOG_VERBOSE,  "aht10: still busy after %u ms") \
+    X(I2C_RESULT,       AHT10_LOG_DEBUG,    "aht10: status 0x%02X data %02X%02X%02X%02X%02X") \
+    X(I2C_RAW,          AHT10_LOG_DEBUG,    "aht10: humidity raw 0x%05X, temperature raw 0x%05X") \
+    X(I2C_CONVERTED,    AHT10_LOG_DEBUG,    "aht10: %u." AHT10_LOG_FRAC_FMT " %%RH, %c%u." AHT10_LOG_FRAC_FMT " C") \
+    X(TASK_TOO_MANY,    AHT10_LOG_WARN,     "aht10: more than %u sensors configured, ignoring the rest") \
+    X(TASK_NO_READING,  AHT10_LOG_WARN,     "sensor %u: no reading (%u missed, %u trig err, %u rejected, %u in a row, %u resets)") \
+    X(TASK_SAMPLE,      AHT10_LOG_INFO,     "sensor %u: hum %u." AHT10_LOG_FRAC_FMT " temp %c%u." AHT10_LOG_FRAC_FMT) \
+    X(TASK_SAMPLE_META, AHT10_LOG_DEBUG,    "sensor %u: status 0x%02X latency %u us (max %u)") \
+    X(TASK_CYCLE,       AHT10_LOG_DEBUG,    "cycle %u us for %u sensors (max %u)") \
+    X(TASK_HEAP,        AHT10_LOG_DEBUG,    "heap free %u (min %u), sampling allocs %u since steady state") \
+    X(TASK_RING,        AHT10_LOG_DEBUG,    "ring %u/%u queued (high water %u), %u dropped") \
+    X(TASK_MODE,        AHT10_LOG_INFO,     "aht10: acquisition mode %u (1 is cycle), sampling every %u ms, err 0x%X") \
+    X(UPLOAD_FRAME,     AHT10_LOG_INFO,     "upload: frame %u, %u samples in %u bytes") \
+    X(SLEEP_NO_LINK,    AHT10_LOG_WARN,     "deep sleep: no link, keeping %u samples") \
+    X(SLEEP_FRAME,      AHT10_LOG_INFO,     "deep sleep: frame %u, %u samples in %u bytes") \
+    X(SLEEP_WAKE,       AHT10_LOG_INFO,     "deep sleep: wake %u, %u buffered, awake %u ms, sleeping %u ms") \
+    X(WIFI_UP_FAST,     AHT10_LOG_INFO,     "wifi: link up after %u ms (fast)") \
+    X(WIFI_UP_SCAN,     AHT10_LOG_INFO,     "wifi: link up after %u ms (full scan)") \
+    X(WIFI_DOWN,        AHT10_LOG_WARN,     "wifi: link down") \
+    X(WIFI_GOT_IP,      AHT10_LOG_INFO,     "wifi: got ip %u.%u.%u.%u") \
+    X(WIFI_TIMER_RETRY, AHT10_LOG_WARN,     "wifi: timer command queue full, retrying") \
+    X(TIME_SYNC,        AHT10_LOG_INFO,     "time: synced, rtt %u ms, error %d ms, skew %d ppm, sync %u") \
+    X(TIME_SYNC_FAIL,   AHT10_LOG_WARN,     "time: sync failed, err 0x%X") \
+    X(OTA_TRIAL,        AHT10_LOG_WARN,     "ota: trial boot %u of %u of the image at 0x%X") \
+    X(OTA_ROLLBACK,     AHT10_LOG_ERROR,    "ota: image failed %u boots, rolling back to 0x%X") \
+    X(OTA_CONFIRMED,    AHT10_LOG_INFO,     "ota: image at 0x%X confirmed") \
+    X(OTA_APPLIED,      AHT10_LOG_INFO,     "ota: %u byte patch to a %u byte image in %u ms, rebooting into 0x%X") \
+    X(OTA_FAILED,       AHT10_LOG_WARN,     "ota: update failed, err 0x%X after %u patch bytes") \
+    X(OTA_REJECTED,     AHT10_LOG_WARN,     "ota: skipping the %u byte image that was rolled back")
+
+#define AHT10_LOG_X_ID(name, level, fmt)    AHT10_LOG_ID_##name,
+#define AHT10_LOG_X_LVL(name, level, fmt)   AHT10_LOG_LVL_##name = (level),
+enum { AHT10_LOG_FORMATS(AHT10_LOG_X_ID) AHT10_LOG_ID_COUNT };
+enum { AHT10_LOG_FORMATS(AHT10_LOG_X_LVL) };
+
+typedef struct aht10_log_record {
+    uint32_t timestamp_ms;
+    uint8_t id;                         /* AHT10_LOG_ID_* */
+    uint8_t nargs;
+    uint32_t args[AHT10_LOG_MAX_ARGS];
+} aht10_log_record_t;
+
+typedef struct aht10_log_stats {
+    uint32_t written;                   /* records that made it into the ring */
+    uint32_t dropped;                   /* records lost to a full ring */
+    uint32_t read;                      /* records taken out again */
+} aht10_log_stats_t;
+
+/* Deferred log statement, e.g. AHT10_LOG(UPLOAD_FRAME, seq, count, len).
+ * Every argument is converted to uint32_t. */
+#define AHT10_LOG(name, ...) \
+    do { \
+        if (AHT10_LOG_LVL_##name <= AHT10_LOG_LEVEL) \
+        { \
+            const uint32_t aht10_log_args_[] = { 0, ##__VA_ARGS__ }; \
+            _Static_assert(sizeof(aht10_log_args_) / sizeof(uint32_t) - 1 <= AHT10_LOG_MAX_ARGS, \
+                           "too many log arguments"); \
+            aht10_log_put(AHT10_LOG_ID_##name, &aht10_log_args_[1], \
+                          sizeof(aht10_log_args_) / sizeof(uint32_t) - 1); \
+        } \
+    } while (0)
+
+/* Immediate text output for cold paths that need strings (boot messages),
+ * still stripped at compile time */
+#define AHT10_LOG_NOW(level, ...) \
+    do { \
+        if ((level) <= AHT10_LOG_LEVEL) \
+        { \
+            printf(__VA_ARGS__); \
+        } \
+    } while (0)
+
+/* now_ms timestamps the records, NULL leaves them at 0. Resets the ring. */
+void aht10_log_init(uint32_t (*now_ms)(void));
+/* what AHT10_LOG expands to; ESP_FAIL if the record was dropped */
+esp_err_t aht10_log_put(uint8_t id, const uint32_t *args, uint8_t nargs);
+/* oldest record, ESP_ERR_NOT_FOUND if the ring is empty */
+esp_err_t aht10_log_get(aht10_log_record_t *rec);
+void aht10_log_get_stats(aht10_log_stats_t *stats);
+
+/* "I (1234) text" into buf, always terminated; returns the length */
+size_t aht10_log_format(const aht10_log_record_t *rec, char *buf, size_t len);
+/* format string of a record id, NULL if unknown or stripped from this build */
+const char *aht10_log_fmt(uint8_t id);
+int aht10_log_level_of(uint8_t id);
+
+/* binary frames for the host decoder. encode needs AHT10_LOG_WIRE_MAX bytes.
+ * decode returns ESP_ERR_NOT_FOUND if buf doesn't start with the sync byte,
+ * ESP_ERR_INVALID_SIZE if the frame isn't complete yet and
+ * ESP_ERR_INVALID_CRC / ESP_ERR_INVALID_RESPONSE on a corrupt frame */
+size_t aht10_log_encode(const aht10_log_record_t *rec, uint8_t *buf);
+esp_err_t aht10_log_decode(const uint8_t *buf, size_t len, aht10_log_record_t *rec, size_t *used);
+
+/* device only: set up the ring and start the drain task */
+void aht10_log_start(void);
+/* device only: write out everything queued from the calling task, for the
+ * moments the drain task won't get to run again (deep sleep, restart) */
+void aht10_log_flush(void);
+
+#endif /* _AHT10_LOG_H */
@@ -0,0 +1,82 @@
+/* associated header file */
+#include "aht10_log.h"
+
+/* others necessary headers */
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "status.h"
+
+static uint32_t s_dropped_reported;
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static uint32_t log_now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void write_record(const aht10_log_record_t *rec)
+{
+#if AHT10_LOG_BINARY
+    uint8_t frame[AHT10_LOG_WIRE_MAX];
+
+    fwrite(frame, 1, aht10_log_encode(rec, frame), stdout);
+#else
+    char line[AHT10_LOG_LINE_MAX];
+
+    aht10_log_format(rec, line, sizeof(line));
+    puts(line);
+#endif
+}
+
+static void drain(void)
+{
+    aht10_log_record_t rec;
+    aht10_log_stats_t stats;
+
+    while (aht10_log_get(&rec) == ESP_OK)
+    {
+        write_record(&rec);
+    }
+
+    /* losses show up in the output itself, at the point they happened */
+    aht10_log_get_stats(&stats);
+    if (stats.dropped != s_dropped_reported)
+    {
+        rec.timestamp_ms = log_now_ms();
+        rec.id = AHT10_LOG_ID_LOG_DROPPED;
+        rec.nargs = 1;
+        rec.args[0] = stats.dropped - s_dropped_reported;
+        s_dropped_reported = stats.dropped;
+        write_record(&rec);
+    }
+    fflush(stdout);
+}
+
+static void log_task(void *arg)
+{
+    status_register_task("log");
+    while (1)
+    {
+        vTaskDelay(AHT10_LOG_DRAIN_PERIOD_MS / portTICK_RATE_MS);
+        drain();
+    }
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void aht10_log_start(void)
+{
+    aht10_log_init(log_now_ms);
+    xTaskCreate(log_task, "aht10_log", AHT10_LOG_TASK_STACK_DEPTH, NULL, AHT10_LOG_TASK_PRIORITY, NULL);
+}
+
+void aht10_log_flush(void)
+{
+    drain();
+}
@@ -0,0 +1,220 @@
+/* associated header file */
+#include "aht10_meas.h"
+
+/* others necessary headers */
+#include <string.h>
+#include "aht10_stats.h"
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static int64_t meas_now(const aht10_meas_t *meas)
+{
+    return meas->hal->time_us(meas->hal->ctx);
+}
+
+static uint32_t meas_remaining_ms(const aht10_meas_t *meas)
+{
+    int64_t remaining_us = meas->due_us - meas_now(meas);
+    if (remaining_us <= 0)
+    {
+        return 0;
+    }
+    /* round up so the owner never wakes before the deadline */
+    return (uint32_t)((remaining_us + 999) / 1000);
+}
+
+static void meas_converted(aht10_meas_t *meas)
+{
+    aht10_parse(meas->rx_data, &meas->reading);
+
+    meas->latency_us = (uint32_t)(meas_now(meas) - meas->trigger_us);
+    if (meas->latency_us > meas->latency_max_us)
+    {
+        meas->latency_max_us = meas->latency_us;
+    }
+    meas->latency_sum_us += meas->latency_us;
+    meas->cycles++;
+    if (!AHT10_MODE_IS_CYCLE(meas->mode))
+    {
+        aht10_stats_record(AHT10_STAT_CONV_US, meas->latency_us);
+    }
+    aht10_stats_record(AHT10_STAT_SAMPLE_US, meas->latency_us);
+    aht10_stats_record(AHT10_STAT_BUSY_POLLS, meas->cycle_busy_polls);
+    meas->state = AHT10_MEAS_CONVERTED;
+}
+
+/* look again in AHT10_MEAS_POLL_MS, after a bus error */
+static void meas_retry_later(aht10_meas_t *meas, uint32_t *next_ms)
+{
+    meas->due_us = meas_now(meas) + (int64_t)AHT10_MEAS_POLL_MS * 1000;
+    *next_ms = AHT10_MEAS_POLL_MS;
+}
+
+/* ... or because the sensor said busy, which is what the poll counters count */
+static void meas_poll_later(aht10_meas_t *meas, uint32_t *next_ms)
+{
+    meas->busy_polls++;
+    meas->cycle_busy_polls++;
+    meas_retry_later(meas, next_ms);
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void aht10_meas_init(aht10_meas_t *meas, const aht10_hal_t *hal)
+{
+    memset(meas, 0, sizeof(*meas));
+    meas->hal = hal;
+    meas->state = AHT10_MEAS_IDLE;
+}
+
+esp_err_t aht10_meas_set_mode(aht10_meas_t *meas, aht10_mode_t mode)
+{
+    esp_err_t ret;
+
+    aht10_meas_abort(meas);
+    meas->transactions++;
+    ret = aht10_set_mode(meas->hal, mode);
+    if (ret != ESP_OK)
+    {
+        meas->errors++;
+        return ret;
+    }
+    meas->mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t aht10_meas_start(aht10_meas_t *meas, uint32_t *next_ms)
+{
+    esp_err_t ret;
+
+    if (meas->state == AHT10_MEAS_TRIGGERED || meas->state == AHT10_MEAS_READY)
+    {
+        /* a conversion is already in flight */
+        *next_ms = meas_remaining_ms(meas);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (AHT10_MODE_IS_CYCLE(meas->mode))
+    {
+        /* the sensor is converting on its own, just go and read */
+        meas->trigger_us = meas_now(meas);
+        meas->due_us = meas->trigger_us;
+        meas->first_read = 1;
+        meas->cycle_busy_polls = 0;
+        meas->state = AHT10_MEAS_TRIGGERED;
+        *next_ms = 0;
+        return ESP_OK;
+    }
+
+    meas->transactions++;
+    ret = aht10_trigger(meas->hal);
+    if (ret != ESP_OK)
+    {
+        meas->errors++;
+        meas->state = AHT10_MEAS_IDLE;
+        *next_ms = 0;
+        return ret;
+    }
+
+    meas->trigger_us = meas_now(meas);
+    meas->due_us = meas->trigger_us + (int64_t)AHT10_MEAS_EXPECTED_MS * 1000;
+    meas->first_read = 1;
+    meas->cycle_busy_polls = 0;
+    meas->state = AHT10_MEAS_TRIGGERED;
+    *next_ms = AHT10_MEAS_EXPECTED_MS;
+    return ESP_OK;
+}
+
+esp_err_t aht10_meas_step(aht10_meas_t *meas, uint32_t *next_ms)
+{
+    esp_err_t ret = ESP_OK;
+    uint8_t status;
+
+    *next_ms = 0;
+    switch (meas->state)
+    {
+        case AHT10_MEAS_TRIGGERED:
+            *next_ms = meas_remaining_ms(meas);
+            if (*next_ms > 0)
+            {
+                break;
+            }
+
+            meas->transactions++;
+            if (meas->first_read)
+            {
+                /* the result is expected by now, fetch all of it in one go */
+                meas->first_read = 0;
+                ret = aht10_read_result(meas->hal, meas->rx_data);
+                if (ret != ESP_OK)
+                {
+                    meas->errors++;
+                    meas_retry_later(meas, next_ms);
+                }
+                else if (meas->rx_data[0] & AHT10_STATUS_BITS_BUSY)
+                {
+                    meas_poll_later(meas, next_ms);
+                }
+                else
+                {
+                    meas_converted(meas);
+                }
+                break;
+            }
+
+            /* we were early, only look at the busy bit until it clears */
+            ret = aht10_read_status(meas->hal, &status);
+            if (ret != ESP_OK)
+            {
+                meas->errors++;
+                meas_retry_later(meas, next_ms);
+            }
+            else if (status & AHT10_STATUS_BITS_BUSY)
+            {
+                meas_poll_later(meas, next_ms);
+            }
+            else
+            {
+                meas->state = AHT10_MEAS_READY;
+            }
+            break;
+
+        case AHT10_MEAS_READY:
+            meas->transactions++;
+            ret = aht10_read_result(meas->hal, meas->rx_data);
+            if (ret != ESP_OK)
+            {
+                meas->errors++;
+                *next_ms = AHT10_MEAS_POLL_MS;
+                break;
+            }
+            meas_converted(meas);
+            break;
+
+        case AHT10_MEAS_IDLE:
+        case AHT10_MEAS_CONVERTED:
+        default:
+            break;
+    }
+    return ret;
+}
+
+esp_err_t aht10_meas_take(aht10_meas_t *meas, aht10_reading_t *reading)
+{
+    if (meas->state != AHT10_MEAS_CONVERTED)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    *reading = meas->reading;
+    meas->state = AHT10_MEAS_IDLE;
+    return ESP_OK;
+}
+
+void aht10_meas_abort(aht10_meas_t *meas)
+{
+    meas->state = AHT10_MEAS_IDLE;
+    meas->first_read = 0;
+}
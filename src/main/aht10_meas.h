@@ -0,0 +1,80 @@
+#ifndef _AHT10_MEAS_H
+#define _AHT10_MEAS_H
+
+#include <stdint.h>
+#include "aht10_hal.h"
+#include "aht10_i2c.h"
+
+/* Non-blocking measurement engine
+ *
+ * Instead of sitting in a poll loop, the owner calls aht10_meas_start() to
+ * trigger a conversion and then aht10_meas_step() whenever the delay it
+ * asked for has passed. Each step does at most one bus transaction and
+ * never sleeps, so the calling task is free to do other work in between.
+ *
+ *     IDLE --start--> TRIGGERED --not busy--> READY --read--> CONVERTED
+ *                        |  ^                                     |
+ *                        +--+ busy: status-only poll              +--take--> IDLE
+ *
+ * The first read is scheduled for when the conversion is expected to be done
+ * and fetches the whole result, so a normal cycle is one write plus one read.
+ * Only if the sensor is still busy at that point does the engine fall back to
+ * one byte status polls until the busy bit clears.
+ *
+ * In AHT10_MODE_CYCLE the sensor converts continuously, so start doesn't
+ * trigger anything and the first read is due right away: a cycle is a single
+ * read transaction (latency_us says how long it took). Reads faster than the
+ * sensor converts return the same result again. */
+
+#define AHT10_MEAS_EXPECTED_MS              AHT10_MEAS_DELAY    /* first read this long after the trigger */
+#define AHT10_MEAS_POLL_MS                  10                  /* status poll period when the first read was early */
+
+typedef enum {
+    AHT10_MEAS_IDLE = 0,
+    AHT10_MEAS_TRIGGERED,
+    AHT10_MEAS_READY,
+    AHT10_MEAS_CONVERTED,
+} aht10_meas_state_t;
+
+typedef struct aht10_meas {
+    const aht10_hal_t *hal;
+    aht10_meas_state_t state;
+    aht10_mode_t mode;
+    uint8_t first_read;                 /* next read in TRIGGERED fetches the full result */
+    int64_t trigger_us;                 /* when the current cycle was triggered */
+    int64_t due_us;                     /* earliest time for the next step */
+    uint8_t rx_data[AHT10_RESULT_LEN];
+    aht10_reading_t reading;            /* valid in CONVERTED */
+
+    /* per-cycle and running statistics */
+    uint32_t latency_us;                /* trigger to converted for the last cycle */
+    uint32_t latency_max_us;
+    uint64_t latency_sum_us;
+    uint32_t busy_polls;                /* status polls that saw the busy bit, all cycles */
+    uint32_t cycle_busy_polls;          /* the same, current cycle only */
+    uint32_t transactions;              /* bus transactions issued, all cycles */
+    uint32_t cycles;                    /* completed conversions */
+    uint32_t errors;                    /* bus errors seen by the engine */
+} aht10_meas_t;
+
+void aht10_meas_init(aht10_meas_t *meas, const aht10_hal_t *hal);
+
+/* puts the sensor in the mode (aht10_set_mode) and gives up on a cycle in
+ * flight; the mode only changes if the command went through */
+esp_err_t aht10_meas_set_mode(aht10_meas_t *meas, aht10_mode_t mode);
+
+/* IDLE/CONVERTED -> TRIGGERED, *next_ms is how long until the next step */
+esp_err_t aht10_meas_start(aht10_meas_t *meas, uint32_t *next_ms);
+
+/* Advance the state machine by at most one bus transaction.
+ * *next_ms is set to the delay before the next step is useful
+ * (0 means step again right away, nothing to do once CONVERTED/IDLE). */
+esp_err_t aht10_meas_step(aht10_meas_t *meas, uint32_t *next_ms);
+
+/* CONVERTED -> IDLE, copies the result out */
+esp_err_t aht10_meas_take(aht10_meas_t *meas, aht10_reading_t *reading);
+
+/* give up on the cycle in flight (whatever the state), back to IDLE */
+void aht10_meas_abort(aht10_meas_t *meas);
+
+#endif /* _AHT10_MEAS_H */
@@ -0,0 +1,130 @@
+/* associated header file */
+#include "aht10_mux.h"
+
+/* others necessary headers */
+#include <string.h>
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static esp_err_t mux_select(aht10_mux_t *mux, uint8_t channel)
+{
+    uint8_t control = (uint8_t)(1U << channel);
+    esp_err_t ret;
+
+    if (mux->selected == channel)
+    {
+        return ESP_OK;
+    }
+    mux->selects++;
+    ret = mux->bus->write(mux->bus->ctx, mux->addr, &control, 1);
+    if (ret != ESP_OK)
+    {
+        /* no idea what the mux did with it, select again next time */
+        mux->select_errors++;
+        mux->selected = AHT10_MUX_NONE;
+        return ret;
+    }
+    mux->selected = channel;
+    return ESP_OK;
+}
+
+static esp_err_t port_init(void *ctx)
+{
+    aht10_mux_port_t *port = (aht10_mux_port_t *)ctx;
+    aht10_mux_t *mux = port->mux;
+
+    /* all ports share the upstream bus, bring it up once */
+    if (!mux->initialized)
+    {
+        mux->initialized = 1;
+        return mux->bus->init(mux->bus->ctx);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t port_write(void *ctx, uint8_t addr, const uint8_t *data, size_t data_len)
+{
+    aht10_mux_port_t *port = (aht10_mux_port_t *)ctx;
+    esp_err_t ret = mux_select(port->mux, port->channel);
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    return port->mux->bus->write(port->mux->bus->ctx, addr, data, data_len);
+}
+
+static esp_err_t port_read(void *ctx, uint8_t addr, uint8_t *data, size_t data_len)
+{
+    aht10_mux_port_t *port = (aht10_mux_port_t *)ctx;
+    esp_err_t ret = mux_select(port->mux, port->channel);
+
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    return port->mux->bus->read(port->mux->bus->ctx, addr, data, data_len);
+}
+
+static void port_delay_ms(void *ctx, uint32_t ms)
+{
+    aht10_mux_port_t *port = (aht10_mux_port_t *)ctx;
+    port->mux->bus->delay_ms(port->mux->bus->ctx, ms);
+}
+
+static int64_t port_time_us(void *ctx)
+{
+    aht10_mux_port_t *port = (aht10_mux_port_t *)ctx;
+    return port->mux->bus->time_us(port->mux->bus->ctx);
+}
+
+/* the stuck slave is behind this channel, so clock the bus with it connected */
+static esp_err_t port_recover(void *ctx)
+{
+    aht10_mux_port_t *port = (aht10_mux_port_t *)ctx;
+    const aht10_hal_t *bus = port->mux->bus;
+    esp_err_t ret;
+
+    if (bus->recover == NULL)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    /* a held SDA may also NACK the select, clock anyway */
+    mux_select(port->mux, port->channel);
+    ret = bus->recover(bus->ctx);
+    port->mux->selected = AHT10_MUX_NONE;
+    return ret;
+}
+
+static void port_deinit(void *ctx)
+{
+    /* the upstream bus belongs to whoever set up the mux */
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void aht10_mux_init(aht10_mux_t *mux, const aht10_hal_t *bus, uint8_t addr)
+{
+    memset(mux, 0, sizeof(*mux));
+    mux->bus = bus;
+    mux->addr = addr;
+    mux->selected = AHT10_MUX_NONE;
+}
+
+const aht10_hal_t *aht10_mux_port_init(aht10_mux_port_t *port, aht10_mux_t *mux, uint8_t channel)
+{
+    port->mux = mux;
+    port->channel = channel;
+    port->hal.ctx = port;
+    port->hal.init = port_init;
+    port->hal.write = port_write;
+    port->hal.read = port_read;
+    port->hal.delay_ms = port_delay_ms;
+    port->hal.time_us = port_time_us;
+    port->hal.deinit = port_deinit;
+    port->hal.recover = port_recover;
+    return &port->hal;
+}
@@ -0,0 +1,52 @@
+#ifndef _AHT10_MUX_H
+#define _AHT10_MUX_H
+
+#include <stdint.h>
+#include "aht10_config.h"
+#include "aht10_hal.h"
+
+/* TCA9548A-style I2C multiplexer in front of several AHT10s.
+ *
+ * Every AHT10 answers at AHT10_SENSOR_ADDR, so more than one per bus needs a
+ * mux: one control byte selects which downstream channel(s) are connected.
+ * Each channel is exposed as its own aht10_hal_t (an aht10_mux_port_t) that
+ * selects its channel before every transaction and otherwise passes through
+ * to the upstream bus, so the driver and the measurement engine don't know
+ * the mux exists. The mux remembers the selected channel and only writes the
+ * control byte when it changes. */
+
+#define AHT10_MUX_ADDR_DEFAULT              0x70                /* A2..A0 low, up to 0x77 */
+#define AHT10_MUX_CHANNELS                  8
+#define AHT10_MUX_NONE                      0xFF                /* nothing selected (or unknown after an error) */
+
+/* the mux in the sensor layout (aht10_task.h): one AHT10 on each channel in
+ * the mask, behind the mux at AHT10_MUX_ADDR on the default pins */
+#ifndef AHT10_MUX_CHANNEL_MASK
+#define AHT10_MUX_CHANNEL_MASK              0x00                /* 0 means no mux */
+#endif
+#ifndef AHT10_MUX_ADDR
+#define AHT10_MUX_ADDR                      AHT10_MUX_ADDR_DEFAULT
+#endif
+
+typedef struct aht10_mux {
+    const aht10_hal_t *bus;             /* upstream bus the mux sits on */
+    uint8_t addr;
+    uint8_t selected;                   /* channel currently connected, AHT10_MUX_NONE if unknown */
+    uint8_t initialized;
+
+    /* statistics */
+    uint32_t selects;                   /* control byte writes */
+    uint32_t select_errors;
+} aht10_mux_t;
+
+typedef struct aht10_mux_port {
+    aht10_mux_t *mux;
+    uint8_t channel;
+    aht10_hal_t hal;
+} aht10_mux_port_t;
+
+void aht10_mux_init(aht10_mux_t *mux, const aht10_hal_t *bus, uint8_t addr);
+/* returns the HAL for one downstream channel */
+const aht10_hal_t *aht10_mux_port_init(aht10_mux_port_t *port, aht10_mux_t *mux, uint8_t channel);
+
+#endif /* _AHT10_MUX_H */
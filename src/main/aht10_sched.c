@@ -0,0 +1,377 @@
+/* associated header file */
+#include "aht10_sched.h"
+
+/* others necessary headers */
+#include <string.h>
+#include "aht10_stats.h"
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static int64_t sched_now(const aht10_sched_t *sched)
+{
+    const aht10_hal_t *hal = sched->sensors[0].hal;
+    return hal->time_us(hal->ctx);
+}
+
+/* whatever went wrong, start the sensor over: free the bus in case a
+ * transfer was cut off mid byte, then soft reset the part */
+static void sensor_recover(aht10_sensor_t *sensor)
+{
+    aht10_meas_abort(&sensor->meas);
+    aht10_bus_recover(sensor->hal);
+    aht10_soft_reset(sensor->hal);
+    sensor->reinit = 1;
+    sensor->reset_us = sensor->hal->time_us(sensor->hal->ctx);
+    sensor->health.recoveries++;
+}
+
+/* time until the part listens again after its soft reset, 0 once it does */
+static uint32_t sensor_reset_left_ms(const aht10_sensor_t *sensor)
+{
+    const aht10_hal_t *hal = sensor->hal;
+    int64_t left_us = sensor->reset_us + (int64_t)AHT10_DELAY_SOFT_RESET * 1000 - hal->time_us(hal->ctx);
+
+    if (left_us <= 0)
+    {
+        return 0;
+    }
+    /* round up so the owner never wakes before the deadline */
+    return (uint32_t)((left_us + 999) / 1000);
+}
+
+/* mode and calibration back after the reset */
+static esp_err_t sensor_reinit(aht10_sched_t *sched, aht10_sensor_t *sensor)
+{
+    if (aht10_meas_set_mode(&sensor->meas, sched->mode) != ESP_OK)
+    {
+        sensor->health.reinit_errors++;
+        return ESP_FAIL;
+    }
+    sensor->reinit = 0;
+    return ESP_OK;
+}
+
+static void sensor_failed(aht10_sensor_t *sensor)
+{
+    sensor_recover(sensor);
+    sensor->active = 0;
+    sensor->health.consecutive_failures++;
+    sensor->health.state = (sensor->health.consecutive_failures >= AHT10_SCHED_OFFLINE_AFTER)
+                           ? AHT10_HEALTH_OFFLINE : AHT10_HEALTH_DEGRADED;
+}
+
+/* the reinit if one is owed, then the measure command; *wait_ms is how long
+ * until the sensor wants stepping. A sensor still inside its reset delay
+ * stays idle and is triggered by the step after *wait_ms instead. A failure
+ * takes it out of the cycle. */
+static esp_err_t sensor_trigger(aht10_sched_t *sched, aht10_sensor_t *sensor, uint32_t *wait_ms)
+{
+    if (sensor->reinit)
+    {
+        if ((*wait_ms = sensor_reset_left_ms(sensor)) > 0)
+        {
+            return ESP_OK;
+        }
+        if (sensor_reinit(sched, sensor) != ESP_OK)
+        {
+            sensor_failed(sensor);
+            return ESP_FAIL;
+        }
+    }
+    if (aht10_meas_start(&sensor->meas, wait_ms) != ESP_OK)
+    {
+        sensor->health.trigger_errors++;
+        sensor_failed(sensor);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void sensor_converted(aht10_sensor_t *sensor)
+{
+    sensor->active = 0;
+    sensor->fresh = 1;
+    sensor->health.state = AHT10_HEALTH_OK;
+    sensor->health.consecutive_failures = 0;
+    sensor->health.samples++;
+    sensor->health.latency_us = sensor->meas.latency_us;
+    if (sensor->meas.latency_us > sensor->health.latency_max_us)
+    {
+        sensor->health.latency_max_us = sensor->meas.latency_us;
+    }
+}
+
+/* whatever part of the burst passed the checks becomes the reading */
+static void sensor_burst_done(aht10_sched_t *sched, aht10_sensor_t *sensor)
+{
+    if (aht10_burst_reduce(&sensor->burst, sched->filter, sched->trim, &sensor->reading) == ESP_OK)
+    {
+        sensor_converted(sensor);
+    }
+    else
+    {
+        sensor_failed(sensor);
+    }
+}
+
+/* one conversion of the burst is in: keep it if it passes the checks, start
+ * the next one or, once the burst is complete, reduce it to the reading */
+static void sensor_conversion_done(aht10_sched_t *sched, aht10_sensor_t *sensor)
+{
+    aht10_reading_t reading;
+    aht10_reading_check_t check;
+    uint32_t wait_ms;
+
+    aht10_meas_take(&sensor->meas, &reading);
+    sensor->conversions++;
+    check = aht10_burst_add(&sensor->burst, &reading);
+    if (check != AHT10_READING_OK)
+    {
+        sensor->health.rejected++;
+        if (check == AHT10_READING_UNCALIBRATED)
+        {
+            sensor->health.uncalibrated++;
+        }
+    }
+
+    if (sensor->conversions < sched->burst)
+    {
+        if (aht10_meas_start(&sensor->meas, &wait_ms) == ESP_OK)
+        {
+            return;
+        }
+        sensor->health.trigger_errors++;
+    }
+    sensor_burst_done(sched, sensor);
+}
+
+static void end_cycle(aht10_sched_t *sched)
+{
+    sched->running = 0;
+    sched->cycle_us = (uint32_t)(sched_now(sched) - sched->cycle_start_us);
+    if (sched->cycle_us > sched->cycle_max_us)
+    {
+        sched->cycle_max_us = sched->cycle_us;
+    }
+    aht10_stats_record(AHT10_STAT_CYCLE_US, sched->cycle_us);
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void aht10_sched_init(aht10_sched_t *sched)
+{
+    memset(sched, 0, sizeof(*sched));
+    sched->burst = 1;
+    sched->filter = AHT10_FILTER_MEDIAN;
+}
+
+esp_err_t aht10_sched_set_burst(aht10_sched_t *sched, uint8_t burst, aht10_filter_t filter, uint8_t trim)
+{
+    if (burst == 0 || burst > AHT10_FILTER_MAX_BURST)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sched->burst = burst;
+    sched->filter = filter;
+    sched->trim = trim;
+    return ESP_OK;
+}
+
+esp_err_t aht10_sched_add(aht10_sched_t *sched, const aht10_hal_t *hal, uint8_t id)
+{
+    aht10_sensor_t *sensor;
+
+    if (sched->count >= AHT10_SCHED_MAX_SENSORS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    sensor = &sched->sensors[sched->count++];
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->id = id;
+    sensor->hal = hal;
+    aht10_meas_init(&sensor->meas, hal);
+    return ESP_OK;
+}
+
+esp_err_t aht10_sched_set_mode(aht10_sched_t *sched, aht10_mode_t mode)
+{
+    esp_err_t ret, first = ESP_OK;
+    uint8_t i;
+
+    if (sched->running)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (i = 0; i < sched->count; i++)
+    {
+        ret = aht10_meas_set_mode(&sched->sensors[i].meas, mode);
+        if (ret != ESP_OK && first == ESP_OK)
+        {
+            first = ret;
+        }
+    }
+    sched->mode = mode;
+    return first;
+}
+
+esp_err_t aht10_sched_start(aht10_sched_t *sched, uint32_t *next_ms)
+{
+    aht10_sensor_t *sensor;
+    uint32_t wait_ms;
+    uint8_t i, triggered = 0;
+
+    *next_ms = 0;
+    if (sched->running)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (sched->count == 0)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    sched->cycles++;
+    sched->cycle_start_us = sched_now(sched);
+    for (i = 0; i < sched->count; i++)
+    {
+        sensor = &sched->sensors[i];
+        sensor->fresh = 0;
+        sensor->conversions = 0;
+        aht10_burst_reset(&sensor->burst);
+        if (sensor->health.state == AHT10_HEALTH_OFFLINE && (sched->cycles % AHT10_SCHED_PROBE_EVERY) != 0)
+        {
+            sensor->health.skipped++;
+            continue;
+        }
+
+        /* just the measure command, a few hundred microseconds each; the
+         * conversions then run in parallel */
+        aht10_meas_abort(&sensor->meas);
+        sensor->active = 1;
+        if (sensor_trigger(sched, sensor, &wait_ms) != ESP_OK)
+        {
+            continue;
+        }
+        if (triggered == 0 || wait_ms < *next_ms)
+        {
+            *next_ms = wait_ms;
+        }
+        triggered++;
+    }
+
+    if (triggered == 0)
+    {
+        end_cycle(sched);
+        return ESP_ERR_NOT_FOUND;
+    }
+    sched->running = 1;
+    return ESP_OK;
+}
+
+esp_err_t aht10_sched_step(aht10_sched_t *sched, uint32_t *next_ms)
+{
+    aht10_sensor_t *sensor;
+    int64_t deadline_us = sched->cycle_start_us + (int64_t)AHT10_SCHED_DEADLINE_MS * 1000 * sched->burst;
+    int64_t now_us;
+    uint32_t wait_ms, left_ms;
+    uint8_t i, pending = 0;
+
+    *next_ms = 0;
+    if (!sched->running)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (i = 0; i < sched->count; i++)
+    {
+        sensor = &sched->sensors[i];
+        if (!sensor->active)
+        {
+            continue;
+        }
+
+        if (sensor->meas.state == AHT10_MEAS_IDLE)
+        {
+            /* waiting out its soft reset, trigger it once that is over */
+            if (sensor_trigger(sched, sensor, &wait_ms) != ESP_OK)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            /* the engine itself knows whether this sensor is due yet */
+            aht10_meas_step(&sensor->meas, &wait_ms);
+        }
+        if (sensor->meas.state == AHT10_MEAS_CONVERTED)
+        {
+            sensor_conversion_done(sched, sensor);
+            if (!sensor->active)
+            {
+                continue;
+            }
+            /* the next conversion of the burst is running */
+            wait_ms = AHT10_MEAS_EXPECTED_MS;
+        }
+
+        now_us = sched_now(sched);
+        if (now_us >= deadline_us)
+        {
+            /* stuck busy, gone from the bus...: don't hold the others up */
+            aht10_meas_abort(&sensor->meas);
+            sensor->health.missed++;
+            sensor_burst_done(sched, sensor);
+            continue;
+        }
+
+        left_ms = (uint32_t)((deadline_us - now_us + 999) / 1000);
+        if (wait_ms > left_ms)
+        {
+            wait_ms = left_ms;
+        }
+        if (pending == 0 || wait_ms < *next_ms)
+        {
+            *next_ms = wait_ms;
+        }
+        pending++;
+    }
+
+    if (pending == 0)
+    {
+        end_cycle(sched);
+    }
+    return ESP_OK;
+}
+
+int aht10_sched_running(const aht10_sched_t *sched)
+{
+    return sched->running;
+}
+
+esp_err_t aht10_sched_take(aht10_sched_t *sched, uint8_t idx, aht10_reading_t *reading)
+{
+    aht10_sensor_t *sensor;
+
+    if (idx >= sched->count || !sched->sensors[idx].fresh)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    sensor = &sched->sensors[idx];
+    sensor->fresh = 0;
+    *reading = sensor->reading;
+    return ESP_OK;
+}
+
+const char *aht10_health_name(aht10_health_state_t state)
+{
+    switch (state)
+    {
+        case AHT10_HEALTH_OK:       return "ok";
+        case AHT10_HEALTH_DEGRADED: return "degraded";
+        case AHT10_HEALTH_OFFLINE:  return "offline";
+        default:                    return "?";
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef _AHT10_SCHED_H
+#define _AHT10_SCHED_H
+
+#include <stdint.h>
+#include "aht10_hal.h"
+#include "aht10_filter.h"
+#include "aht10_i2c.h"
+#include "aht10_meas.h"
+
+/* Measurement scheduler for several AHT10s.
+ *
+ * A conversion takes ~75 ms during which the sensor needs nothing from the
+ * bus, so instead of running the sensors one after the other the scheduler
+ * triggers every sensor back to back and then harvests them as they finish:
+ * N sensors cost about one conversion window plus a few transactions each,
+ * not N windows. Each sensor has its own measurement engine (aht10_meas.h)
+ * and its own HAL, typically a mux port (aht10_mux.h) or a second pin pair.
+ *
+ * Per-sensor health: a sensor that fails (bus error on the trigger, or no
+ * result by AHT10_SCHED_DEADLINE_MS) is DEGRADED; after
+ * AHT10_SCHED_OFFLINE_AFTER failures in a row it is OFFLINE and only probed
+ * every AHT10_SCHED_PROBE_EVERY cycles so a dead probe doesn't cost every
+ * cycle a timeout. One good sample brings it back to OK.
+ *
+ * Recovery: every transaction is already retried AHT10_I2C_RETRIES times
+ * under a short timeout, so a failure here means the sensor or its bus is in
+ * a bad state. Right away the scheduler clocks the bus free (if the HAL can)
+ * and soft resets the sensor; at its next cycle, no sooner than
+ * AHT10_DELAY_SOFT_RESET later, the sensor gets its mode and calibration
+ * back before the trigger. If the delay isn't over when the cycle starts,
+ * the sensor waits idle and is triggered by a later step, so nothing
+ * sleeps through it. A flaky sensor costs one sample slot and a few
+ * transactions, never more than the cycle deadline.
+ *
+ * Burst mode: with a burst of K each sensor converts K times back to back
+ * within the cycle (they still run in parallel across sensors), readings
+ * failing the checks in aht10_filter.h are dropped and the rest are reduced
+ * to the cycle's reading. A cycle where every reading was rejected counts
+ * as a failure. The deadline scales with K. */
+
+#define AHT10_SCHED_MAX_SENSORS             8
+#define AHT10_SCHED_DEADLINE_MS             250                 /* trigger to result, then the sensor counts as missed */
+#define AHT10_SCHED_OFFLINE_AFTER           5                   /* consecutive failures */
+#define AHT10_SCHED_PROBE_EVERY             12                  /* cycles between attempts on an offline sensor */
+
+typedef enum {
+    AHT10_HEALTH_OK = 0,
+    AHT10_HEALTH_DEGRADED,              /* the last cycle(s) failed */
+    AHT10_HEALTH_OFFLINE,               /* failed too often, only probed now and then */
+} aht10_health_state_t;
+
+typedef struct aht10_sensor_health {
+    aht10_health_state_t state;
+    uint32_t samples;                   /* good readings */
+    uint32_t trigger_errors;            /* the measure command didn't go through */
+    uint32_t missed;                    /* triggered but no result by the deadline */
+    uint32_t skipped;                   /* cycles left out while offline */
+    uint32_t rejected;                  /* readings that failed the checks */
+    uint32_t uncalibrated;              /* of those, because the cal bit was clear */
+    uint32_t recoveries;                /* bus clear + soft reset after a failure */
+    uint32_t reinit_errors;             /* the init command after a reset didn't go through */
+    uint32_t consecutive_failures;
+    uint32_t latency_us;                /* trigger to result, last good reading */
+    uint32_t latency_max_us;
+} aht10_sensor_health_t;
+
+typedef struct aht10_sensor {
+    uint8_t id;                         /* goes into the samples, e.g. the mux channel */
+    const aht10_hal_t *hal;
+    aht10_meas_t meas;
+    aht10_sensor_health_t health;
+    uint8_t active;                     /* taking part in the current cycle */
+    uint8_t fresh;                      /* reading holds an untaken result */
+    uint8_t conversions;                /* done in the current burst */
+    uint8_t reinit;                     /* soft reset, mode and calibration are gone */
+    int64_t reset_us;                   /* when it was reset */
+    aht10_burst_t burst;
+    aht10_reading_t reading;
+} aht10_sensor_t;
+
+typedef struct aht10_sched {
+    aht10_sensor_t sensors[AHT10_SCHED_MAX_SENSORS];
+    uint8_t count;
+    uint8_t running;                    /* a cycle is in flight */
+    uint8_t burst;                      /* conversions per sensor per cycle */
+    uint8_t trim;                       /* for AHT10_FILTER_TRIMMED_MEAN */
+    aht10_filter_t filter;
+    aht10_mode_t mode;
+    int64_t cycle_start_us;
+
+    /* statistics */
+    uint32_t cycles;
+    uint32_t cycle_us;                  /* first trigger to last result (or deadline), last cycle */
+    uint32_t cycle_max_us;
+} aht10_sched_t;
+
+void aht10_sched_init(aht10_sched_t *sched);
+/* register a sensor, ESP_ERR_NO_MEM past AHT10_SCHED_MAX_SENSORS. The
+ * scheduler doesn't touch the bus here, aht10_init() each HAL first. */
+esp_err_t aht10_sched_add(aht10_sched_t *sched, const aht10_hal_t *hal, uint8_t id);
+
+/* conversions per cycle and how to reduce them, takes effect from the next
+ * cycle; ESP_ERR_INVALID_ARG for a burst of 0 or past AHT10_FILTER_MAX_BURST.
+ * aht10_sched_init() sets a burst of 1 (median, which is a no-op then). */
+esp_err_t aht10_sched_set_burst(aht10_sched_t *sched, uint8_t burst, aht10_filter_t filter, uint8_t trim);
+
+/* aht10_meas_set_mode() on every sensor, between cycles only
+ * (ESP_ERR_INVALID_STATE while one runs); the first error is returned but
+ * the others are still switched */
+esp_err_t aht10_sched_set_mode(aht10_sched_t *sched, aht10_mode_t mode);
+
+/* trigger every sensor that is due, back to back. *next_ms is how long until
+ * aht10_sched_step() has something to do. ESP_ERR_INVALID_STATE if a cycle is
+ * still running, ESP_ERR_NOT_FOUND if no sensor could be triggered. */
+esp_err_t aht10_sched_start(aht10_sched_t *sched, uint32_t *next_ms);
+/* step every sensor still converting; once all are done (or past the
+ * deadline) the cycle ends and *next_ms is 0 */
+esp_err_t aht10_sched_step(aht10_sched_t *sched, uint32_t *next_ms);
+int aht10_sched_running(const aht10_sched_t *sched);
+/* reading from the last cycle for sensor idx, ESP_ERR_NOT_FOUND if it has none */
+esp_err_t aht10_sched_take(aht10_sched_t *sched, uint8_t idx, aht10_reading_t *reading);
+
+const char *aht10_health_name(aht10_health_state_t state);
+
+#endif /* _AHT10_SCHED_H */
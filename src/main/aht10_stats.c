@@ -0,0 +1,131 @@
+/* associated header file */
+#include "aht10_stats.h"
+
+/* others necessary headers */
+#include <stdio.h>
+#include <string.h>
+
+#define STATS_X_BOUNDS(name, key, ...)      static const uint32_t s_le_##name[] = { __VA_ARGS__ };
+AHT10_STATS_HISTS(STATS_X_BOUNDS)
+
+#define STATS_X_HIST(name, key, ...) \
+    [AHT10_STAT_##name] = { key, s_le_##name, sizeof(s_le_##name) / sizeof(uint32_t), 0, 0, 0, { 0 } },
+static aht10_hist_t s_hists[AHT10_STAT_COUNT] = { AHT10_STATS_HISTS(STATS_X_HIST) };
+
+#define STATS_X_CHECK(name, key, ...) \
+    _Static_assert(sizeof(s_le_##name) / sizeof(uint32_t) < AHT10_HIST_MAX_BUCKETS, "too many buckets: " key);
+AHT10_STATS_HISTS(STATS_X_CHECK)
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void aht10_stats_record(aht10_stat_id_t id, uint32_t value)
+{
+    aht10_hist_t *hist;
+    uint8_t i;
+
+    if (id >= AHT10_STAT_COUNT)
+    {
+        return;
+    }
+    hist = &s_hists[id];
+    for (i = 0; i < hist->nle && value > hist->le[i]; i++)
+    {
+    }
+    hist->buckets[i]++;
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max)
+    {
+        hist->max = value;
+    }
+}
+
+const aht10_hist_t *aht10_stats_hist(aht10_stat_id_t id)
+{
+    return (id < AHT10_STAT_COUNT) ? &s_hists[id] : NULL;
+}
+
+void aht10_stats_reset(void)
+{
+    aht10_stat_id_t id;
+
+    for (id = 0; id < AHT10_STAT_COUNT; id++)
+    {
+        s_hists[id].count = 0;
+        s_hists[id].sum = 0;
+        s_hists[id].max = 0;
+        memset(s_hists[id].buckets, 0, sizeof(s_hists[id].buckets));
+    }
+}
+
+uint32_t aht10_hist_quantile(const aht10_hist_t *hist, uint32_t per_mille)
+{
+    uint64_t target = ((uint64_t)hist->count * per_mille + 999) / 1000;
+    uint64_t seen = 0;
+    uint8_t i;
+
+    if (hist->count == 0)
+    {
+        return 0;
+    }
+    for (i = 0; i < hist->nle; i++)
+    {
+        seen += hist->buckets[i];
+        if (seen >= target)
+        {
+            /* never report more than was actually seen */
+            return (hist->le[i] < hist->max) ? hist->le[i] : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+void aht10_stats_appendf(char *buf, size_t len, size_t *pos, const char *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    if (len == 0 || *pos >= len - 1)
+    {
+        return;
+    }
+    va_start(args, fmt);
+    n = vsnprintf(buf + *pos, len - *pos, fmt, args);
+    va_end(args);
+    if (n < 0)
+    {
+        return;
+    }
+    if ((size_t)n >= len - *pos)
+    {
+        /* truncated: say so rather than sending half a number */
+        *pos = len - 1;
+        if (len > 4)
+        {
+            memcpy(buf + len - 4, "...", 4);
+        }
+        return;
+    }
+    *pos += (size_t)n;
+}
+
+void aht10_stats_json_hists(char *buf, size_t len, size_t *pos)
+{
+    const aht10_hist_t *hist;
+    aht10_stat_id_t id;
+    uint8_t i;
+
+    for (id = 0; id < AHT10_STAT_COUNT; id++)
+    {
+        hist = &s_hists[id];
+        aht10_stats_appendf(buf, len, pos, "%s\"%s\":{\"n\":%u,\"sum\":%llu,\"max\":%u,\"c\":[",
+                            (id > 0) ? "," : "", hist->key, (unsigned)hist->count,
+                            (unsigned long long)hist->sum, (unsigned)hist->max);
+        for (i = 0; i <= hist->nle; i++)
+        {
+            aht10_stats_appendf(buf, len, pos, "%s%u", i ? "," : "", (unsigned)hist->buckets[i]);
+        }
+        aht10_stats_appendf(buf, len, pos, "]}");
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef _AHT10_STATS_H
+#define _AHT10_STATS_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Fixed-bucket latency histograms for the stages of a sample's life.
+ *
+ * Each histogram has a fixed list of upper bucket bounds (value <= le[i]
+ * lands in bucket i, anything larger in the last bucket), plus a count,
+ * sum and max, so recording is a short scan and a few adds with no
+ * allocation and no locks. Every histogram has a single writer (the task
+ * that owns that stage); readers take the numbers as they are, a snapshot
+ * that is off by the one value being recorded doesn't matter here.
+ *
+ * The status packet (status.c) sends them as JSON together with the heap,
+ * stack and per-subsystem counters. */
+
+#define AHT10_HIST_MAX_BUCKETS              12
+
+/* X(name, json key, bucket bounds...) */
+#define AHT10_STATS_HISTS(X) \
+    X(I2C_US,       "i2c_us",       100, 200, 300, 400, 500, 750, 1000, 2000, 5000, 10000, 50000) \
+    X(BUSY_POLLS,   "busy_polls",   0, 1, 2, 3, 4, 6, 8, 12, 16, 24, 32) \
+    X(CONV_US,      "conv_us",      70000, 75000, 80000, 85000, 90000, 100000, 120000, 150000, 200000, 250000, 500000) \
+    X(SAMPLE_US,    "sample_us",    500, 1000, 2000, 5000, 10000, 50000, 80000, 90000, 100000, 150000, 250000) \
+    X(CYCLE_US,     "cycle_us",     75000, 80000, 85000, 90000, 100000, 120000, 150000, 200000, 250000, 300000, 500000) \
+    X(WIFI_MS,      "wifi_ms",      100, 200, 500, 1000, 2000, 3000, 5000, 8000, 12000, 15000, 30000) \
+    X(UPLOAD_RTT_US, "upload_rtt_us", 1000, 2000, 5000, 10000, 20000, 50000, 100000, 150000, 200000, 250000, 500000)
+
+#define AHT10_STATS_X_ID(name, key, ...)    AHT10_STAT_##name,
+typedef enum { AHT10_STATS_HISTS(AHT10_STATS_X_ID) AHT10_STAT_COUNT } aht10_stat_id_t;
+
+typedef struct aht10_hist {
+    const char *key;
+    const uint32_t *le;                 /* upper bucket bounds, ascending */
+    uint8_t nle;                        /* buckets = nle + 1 */
+    uint32_t count;
+    uint64_t sum;
+    uint32_t max;
+    uint32_t buckets[AHT10_HIST_MAX_BUCKETS];
+} aht10_hist_t;
+
+void aht10_stats_record(aht10_stat_id_t id, uint32_t value);
+const aht10_hist_t *aht10_stats_hist(aht10_stat_id_t id);
+void aht10_stats_reset(void);
+
+/* value at or below which a share (per mille) of the recorded values lie,
+ * as the bound of the bucket it falls in; the max for the open last bucket */
+uint32_t aht10_hist_quantile(const aht10_hist_t *hist, uint32_t per_mille);
+
+/* snprintf at buf + *pos, advances *pos and never past len - 1; once the
+ * buffer is full later calls do nothing and the result ends in "..." */
+void aht10_stats_appendf(char *buf, size_t len, size_t *pos, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+/* "key":{"n":..,"sum":..,"max":..,"c":[..]} for every histogram, comma
+ * separated, for splicing into a JSON object. The bucket bounds are left
+ * out to keep the status packet in one datagram; they are the ones in
+ * AHT10_STATS_HISTS for the packet's version (status.h). */
+void aht10_stats_json_hists(char *buf, size_t len, size_t *pos);
+
+#endif /* _AHT10_STATS_H */
@@ -0,0 +1,320 @@
+/* associated header file */
+#include "aht10_task.h"
+
+/* others necessary headers */
+#include <limits.h>
+#include <stdio.h>
+#include "aht10_log.h"
+#include "status.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+/* asking for static memory on an SDK that can't do it would quietly put
+ * everything on the heap instead */
+#if AHT10_TASK_STATIC_ALLOC && !configSUPPORT_STATIC_ALLOCATION
+#error "AHT10_TASK_STATIC_ALLOC needs configSUPPORT_STATIC_ALLOCATION in the FreeRTOS config"
+#endif
+
+static TaskHandle_t s_aht10_task;
+static TimerHandle_t s_sample_timer;
+static TimerHandle_t s_step_timer;
+#if AHT10_TASK_STATIC_ALLOC
+static StaticTimer_t s_sample_timer_buf;
+static StaticTimer_t s_step_timer_buf;
+#endif
+
+/* samples on their way to the uploader */
+static sample_ring_t s_sample_ring;
+
+/* decides which samples make it into the ring */
+static aht10_agg_t s_agg;
+
+/* every sensor on the board and the routes to them */
+static aht10_sched_t s_sched;
+#if AHT10_MUX_CHANNEL_MASK
+static aht10_mux_t s_mux;
+static aht10_mux_port_t s_mux_ports[AHT10_MUX_CHANNELS];
+#endif
+#if AHT10_ALT_BUS
+static aht10_esp_bus_t s_alt_bus;
+#endif
+
+#if AHT10_CYCLE_MODE_ENABLE
+/* mode asked for by aht10_task_set_mode(), s_sched.mode is the one applied */
+static volatile aht10_mode_t s_requested_mode = AHT10_ACQ_MODE;
+#endif
+
+/* command link allocations seen when the first sample completed */
+static uint32_t s_allocs_at_steady_state;
+static uint8_t s_steady_state;
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+/* timer callbacks run in the timer service task, so they only hand the work
+ * over to the sensor task and never touch the bus themselves */
+static void sample_timer_cb(TimerHandle_t timer)
+{
+    xTaskNotify(s_aht10_task, AHT10_TASK_EVT_SAMPLE, eSetBits);
+}
+
+static void step_timer_cb(TimerHandle_t timer)
+{
+    xTaskNotify(s_aht10_task, AHT10_TASK_EVT_STEP, eSetBits);
+}
+
+static void schedule_step(uint32_t next_ms)
+{
+    TickType_t ticks = next_ms / portTICK_RATE_MS;
+
+    if (ticks == 0)
+    {
+        /* due now (or shorter than a tick), don't wait for the timer task */
+        xTaskNotify(s_aht10_task, AHT10_TASK_EVT_STEP, eSetBits);
+        return;
+    }
+    /* changing the period also (re)starts the one-shot timer */
+    xTimerChangePeriod(s_step_timer, ticks, 0);
+}
+
+#if AHT10_CYCLE_MODE_ENABLE
+/* only between cycles, otherwise it is retried when the running one is done */
+static void apply_mode(void)
+{
+    aht10_mode_t mode = s_requested_mode;
+    uint32_t period_ms;
+    esp_err_t ret;
+
+    if (mode == s_sched.mode || aht10_sched_running(&s_sched))
+    {
+        return;
+    }
+    ret = aht10_sched_set_mode(&s_sched, mode);
+    period_ms = AHT10_MODE_IS_CYCLE(mode) ? AHT10_SAMPLE_PERIOD_CYCLE_MS : AHT10_SAMPLE_PERIOD_MS;
+    xTimerChangePeriod(s_sample_timer, period_ms / portTICK_RATE_MS, portMAX_DELAY);
+    AHT10_LOG(TASK_MODE, mode, period_ms, ret);
+}
+#else
+/* normal mode only, which is what every sensor starts in */
+static void apply_mode(void)
+{
+}
+#endif
+
+static void add_sensor(const aht10_hal_t *hal)
+{
+    uint8_t id = s_sched.count;
+
+    if (aht10_sched_add(&s_sched, hal, id) != ESP_OK)
+    {
+        AHT10_LOG(TASK_TOO_MANY, AHT10_SCHED_MAX_SENSORS);
+        return;
+    }
+    aht10_init(hal);
+}
+
+static void setup_sensors(const aht10_hal_t *hal)
+{
+#if AHT10_MUX_CHANNEL_MASK
+    uint8_t channel;
+#endif
+
+    aht10_sched_init(&s_sched);
+#if AHT10_MUX_CHANNEL_MASK
+    aht10_mux_init(&s_mux, hal, AHT10_MUX_ADDR);
+    for (channel = 0; channel < AHT10_MUX_CHANNELS; channel++)
+    {
+        if (AHT10_MUX_CHANNEL_MASK & (1U << channel))
+        {
+            add_sensor(aht10_mux_port_init(&s_mux_ports[channel], &s_mux, channel));
+        }
+    }
+#else
+    add_sensor(hal);
+#endif
+#if AHT10_ALT_BUS
+    add_sensor(aht10_hal_esp_pins(&s_alt_bus, AHT10_ALT_SDA_IO, AHT10_ALT_SCL_IO));
+#endif
+    aht10_sched_set_burst(&s_sched, AHT10_BURST_COUNT, AHT10_BURST_FILTER, AHT10_BURST_TRIM);
+}
+
+static void push_sample(const aht10_sample_t *sample)
+{
+#if AHT10_AGG_ENABLE
+    aht10_sample_t out[AHT10_AGG_MAX_OUT];
+    uint8_t i, n;
+
+    n = aht10_agg_feed(&s_agg, sample, out);
+    for (i = 0; i < n; i++)
+    {
+        sample_ring_push(&s_sample_ring, &out[i]);
+    }
+#else
+    sample_ring_push(&s_sample_ring, sample);
+#endif
+}
+
+static void handle_cycle_done(void)
+{
+    aht10_reading_t reading;
+    aht10_sample_t sample;
+    aht10_heap_stats_t heap;
+    const aht10_sensor_t *sensor;
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    uint8_t i;
+
+    if (!s_steady_state)
+    {
+        /* init and the first cycle are allowed to allocate, nothing after */
+        s_allocs_at_steady_state = aht10_hal_esp_dynamic_allocs();
+        s_steady_state = 1;
+    }
+
+    for (i = 0; i < s_sched.count; i++)
+    {
+        sensor = &s_sched.sensors[i];
+        if (aht10_sched_take(&s_sched, i, &reading) != ESP_OK)
+        {
+            AHT10_LOG(TASK_NO_READING, sensor->id, sensor->health.missed, sensor->health.trigger_errors,
+                      sensor->health.rejected, sensor->health.consecutive_failures, sensor->health.recoveries);
+            continue;
+        }
+
+        aht10_sample_pack(&sample, now_ms, &reading);
+        sample.sensor = sensor->id;
+        push_sample(&sample);
+
+        AHT10_LOG(TASK_SAMPLE, sensor->id, AHT10_FIX_WHOLE(reading.humidity), AHT10_FIX_FRAC(reading.humidity),
+                  AHT10_LOG_FIX_SIGN(reading.temperature), AHT10_FIX_WHOLE(reading.temperature),
+                  AHT10_FIX_FRAC(reading.temperature));
+        AHT10_LOG(TASK_SAMPLE_META, sensor->id, reading.status, sensor->health.latency_us, sensor->health.latency_max_us);
+    }
+
+    aht10_task_heap_stats(&heap);
+    AHT10_LOG(TASK_CYCLE, s_sched.cycle_us, s_sched.count, s_sched.cycle_max_us);
+    AHT10_LOG(TASK_HEAP, heap.free_now, heap.free_min, heap.steady_allocs);
+    AHT10_LOG(TASK_RING, sample_ring_occupancy(&s_sample_ring), SAMPLE_RING_CAPACITY,
+              s_sample_ring.high_water, s_sample_ring.dropped);
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void aht10_task_heap_stats(aht10_heap_stats_t *stats)
+{
+    stats->free_now = esp_get_free_heap_size();
+    stats->free_min = esp_get_minimum_free_heap_size();
+    stats->hal_dynamic_allocs = aht10_hal_esp_dynamic_allocs();
+    stats->steady_allocs = s_steady_state ? stats->hal_dynamic_allocs - s_allocs_at_steady_state : 0;
+}
+
+sample_ring_t *aht10_task_ring(void)
+{
+    return &s_sample_ring;
+}
+
+const aht10_sched_t *aht10_task_sched(void)
+{
+    return &s_sched;
+}
+
+const aht10_agg_t *aht10_task_agg(void)
+{
+    return &s_agg;
+}
+
+#if AHT10_CYCLE_MODE_ENABLE
+void aht10_task_set_mode(aht10_mode_t mode)
+{
+    s_requested_mode = mode;
+    if (s_aht10_task != NULL)
+    {
+        xTaskNotify(s_aht10_task, AHT10_TASK_EVT_MODE, eSetBits);
+    }
+}
+#endif
+
+void i2c_task_aht10(void *arg)
+{
+    const aht10_hal_t *hal = (const aht10_hal_t *)arg;
+    uint32_t events, next_ms;
+    esp_err_t ret;
+
+    /* Basic flow
+     * 1) Send the init command to every sensor
+     * 2) The sample timer fires: send the measurement command to all of them
+     * 3) The step timer fires once the conversions should be done (~75ms),
+     *      the scheduler reads each result or keeps polling the busy bits
+     * 4) Perform transfer function on the received data
+     * Everything after 1) is driven by timer notifications, the task is
+     * blocked (and free for other events) in between */
+    s_aht10_task = xTaskGetCurrentTaskHandle();
+    status_register_task("i2c");
+
+    /* 1) Send the init command */
+    setup_sensors(hal);
+    aht10_agg_init(&s_agg, NULL);
+
+#if AHT10_TASK_STATIC_ALLOC
+    s_step_timer = xTimerCreateStatic("aht10_step", 1, pdFALSE, NULL, step_timer_cb, &s_step_timer_buf);
+    s_sample_timer = xTimerCreateStatic("aht10_sample", AHT10_SAMPLE_PERIOD_MS / portTICK_RATE_MS,
+                                        pdTRUE, NULL, sample_timer_cb, &s_sample_timer_buf);
+#else
+    s_step_timer = xTimerCreate("aht10_step", 1, pdFALSE, NULL, step_timer_cb);
+    s_sample_timer = xTimerCreate("aht10_sample", AHT10_SAMPLE_PERIOD_MS / portTICK_RATE_MS,
+                                  pdTRUE, NULL, sample_timer_cb);
+#endif
+    xTimerStart(s_sample_timer, portMAX_DELAY);
+    apply_mode();
+
+    /* take the first sample right away instead of a period from now */
+    xTaskNotify(s_aht10_task, AHT10_TASK_EVT_SAMPLE, eSetBits);
+
+    while (1)
+    {
+        xTaskNotifyWait(0, ULONG_MAX, &events, portMAX_DELAY);
+
+        if (events & AHT10_TASK_EVT_SAMPLE)
+        {
+            /* 2) Send the measurement commands, back to back */
+            ret = aht10_sched_start(&s_sched, &next_ms);
+            if (ret == ESP_OK)
+            {
+                schedule_step(next_ms);
+            }
+            else if (ret == ESP_ERR_NOT_FOUND)
+            {
+                /* nothing could be triggered this time, still report it */
+                handle_cycle_done();
+            }
+        }
+
+        if (events & AHT10_TASK_EVT_STEP)
+        {
+            /* 3) read the results or poll the busy bits */
+            /* a stale step from a cycle that already ended fails, drop it */
+            if (aht10_sched_step(&s_sched, &next_ms) == ESP_OK)
+            {
+                if (aht10_sched_running(&s_sched))
+                {
+                    schedule_step(next_ms);
+                }
+                else
+                {
+                    /* 4) report data */
+                    handle_cycle_done();
+                }
+            }
+        }
+
+        /* AHT10_TASK_EVT_MODE only wakes us up: a change asked for during a
+         * cycle waits for it to end, so look after every event */
+        apply_mode();
+    }
+    fflush(stdout);
+    hal->deinit(hal->ctx);
+}
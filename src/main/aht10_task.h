@@ -0,0 +1,94 @@
+#ifndef _AHT10_TASK_H
+#define _AHT10_TASK_H
+
+#include <stdint.h>
+#include "aht10_agg.h"
+#include "aht10_config.h"
+#include "aht10_mux.h"
+#include "aht10_sched.h"
+#include "sample_ring.h"
+
+#ifndef AHT10_SAMPLE_PERIOD_MS
+#define AHT10_SAMPLE_PERIOD_MS              5000                /* they recommend a maximum of once every 2 seconds */
+#endif
+#ifndef AHT10_SAMPLE_PERIOD_CYCLE_MS
+#define AHT10_SAMPLE_PERIOD_CYCLE_MS        500                 /* in AHT10_MODE_CYCLE, each sample is one read */
+#endif
+#define AHT10_TASK_STACK_DEPTH              2048                /* stack depth handed to FreeRTOS */
+#define AHT10_TASK_PRIORITY                 10
+#ifndef AHT10_TASK_STATIC_ALLOC
+#define AHT10_TASK_STATIC_ALLOC             1                   /* 1 creates the task and its timers from static memory */
+#endif
+#ifndef AHT10_AGG_ENABLE
+#define AHT10_AGG_ENABLE                    1                   /* 1 only passes on significant changes and heartbeats (aht10_agg.h) */
+#endif
+
+/* Sensor layout. By default a single AHT10 on the default pins. A non-zero
+ * channel mask puts a TCA9548A on the default pins with one AHT10 on each
+ * channel in the mask; AHT10_ALT_BUS adds one more AHT10 on a second pin
+ * pair. The mux part (AHT10_MUX_CHANNEL_MASK, AHT10_MUX_ADDR) is in
+ * aht10_mux.h. Sensor ids (as they appear in the samples) follow that order:
+ * mux channels from low to high, then the second bus. At most
+ * AHT10_SCHED_MAX_SENSORS in total. */
+#define AHT10_ALT_BUS                       0                   /* 1 adds a sensor on AHT10_ALT_SDA_IO/SCL_IO */
+#define AHT10_ALT_SDA_IO                    3                   /* RXD on the ESP-01S, costs the UART input */
+#define AHT10_ALT_SCL_IO                    1                   /* TXD on the ESP-01S, costs the console */
+
+/* Acquisition mode at boot (aht10_i2c.h). In AHT10_MODE_CYCLE the sensors
+ * convert continuously and a sample is a single read of the latest result,
+ * ~1 ms instead of ~80 ms, so the task samples every
+ * AHT10_SAMPLE_PERIOD_CYCLE_MS; the price is a sensor that never sleeps and
+ * somewhat more self-heating. A burst in cycle mode only makes sense with a
+ * sample period several conversions long, otherwise it reads the same result
+ * K times. aht10_task_set_mode() switches at runtime; neither it nor the
+ * switching exists with AHT10_CYCLE_MODE_ENABLE at 0. */
+#ifndef AHT10_ACQ_MODE
+#define AHT10_ACQ_MODE                      AHT10_MODE_NORMAL
+#endif
+
+/* Oversampling (aht10_filter.h): conversions per sensor per cycle and how
+ * they are reduced. Each extra conversion is ~80 ms more awake time per
+ * cycle; a burst of 1 is a single reading, still checked. */
+#ifndef AHT10_BURST_COUNT
+#define AHT10_BURST_COUNT                   1                   /* 1..AHT10_FILTER_MAX_BURST */
+#endif
+#define AHT10_BURST_FILTER                  AHT10_FILTER_MEDIAN
+#define AHT10_BURST_TRIM                    1                   /* per end, for AHT10_FILTER_TRIMMED_MEAN */
+
+/* Notification bits the sensor task waits on. Anything else that wants this
+ * task to do work between conversions gets its own bit here. */
+#define AHT10_TASK_EVT_SAMPLE               (1UL << 0)          /* sample period timer fired, start a conversion */
+#define AHT10_TASK_EVT_STEP                 (1UL << 1)          /* measurement engine asked to be stepped */
+#define AHT10_TASK_EVT_MODE                 (1UL << 2)          /* aht10_task_set_mode() asked for another mode */
+
+/* Heap bookkeeping for the sampling path. hal_dynamic_allocs only moves if a
+ * transaction had no prebuilt command link, so it should stay at zero once the
+ * task is running; the free heap figures cover the whole system. */
+typedef struct aht10_heap_stats {
+    uint32_t free_now;                  /* esp_get_free_heap_size() after the last cycle */
+    uint32_t free_min;                  /* esp_get_minimum_free_heap_size(), the high-water mark */
+    uint32_t hal_dynamic_allocs;        /* command links built on the heap since boot */
+    uint32_t steady_allocs;             /* of those, how many happened after the first completed sample */
+} aht10_heap_stats_t;
+
+void aht10_task_heap_stats(aht10_heap_stats_t *stats);
+
+/* ring the sensor task produces into, initialise it before starting the task */
+sample_ring_t *aht10_task_ring(void);
+
+/* the scheduler, for per-sensor health; read-only outside the task */
+const aht10_sched_t *aht10_task_sched(void);
+/* the report-on-change stage, for its counters; read-only outside the task */
+const aht10_agg_t *aht10_task_agg(void);
+
+#if AHT10_CYCLE_MODE_ENABLE
+/* Switch every sensor to the mode and the sample timer to its period. Safe
+ * from any task: it only records the request and notifies the sensor task,
+ * which applies it between cycles. */
+void aht10_task_set_mode(aht10_mode_t mode);
+#endif
+
+/* FreeRTOS task entry point, arg is the (const aht10_hal_t *) to sample through */
+void i2c_task_aht10(void *arg);
+
+#endif /* _AHT10_TASK_H */
@@ -0,0 +1,196 @@
+/* associated header file */
+#include "deep_sleep.h"
+
+/* others necessary headers */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "aht10_filter.h"
+#include "aht10_i2c.h"
+#include "aht10_log.h"
+#include "aht10_meas.h"
+#include "rtc_store.h"
+#include "time_sync.h"
+#include "upload_frame.h"
+#include "uploader.h"
+#include "wifi_logging.h"
+
+/* survives deep sleep, garbage after power-on (hence the CRC); words only,
+ * everything works on s_rtc_store and saves it back before sleeping */
+static RTC_DATA_ATTR uint32_t s_rtc_words[RTC_STORE_WORDS];
+static rtc_store_t s_rtc_store;
+static upload_frame_t s_frame;
+
+static const rtc_store_policy_t s_policy = {
+    .period_ms = DEEP_SLEEP_PERIOD_MS,
+    .flush_count = DEEP_SLEEP_FLUSH_COUNT,
+    .flush_age_ms = DEEP_SLEEP_FLUSH_AGE_MS,
+};
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static uint32_t clock_now_ms(void)
+{
+    return s_rtc_store.clock_ms + (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+/* the sensor keeps its state through deep sleep, so a wedged part or bus
+ * would cost every following wake too: start it over before sleeping */
+static void recover_sensor(const aht10_hal_t *hal)
+{
+    aht10_bus_recover(hal);
+    aht10_soft_reset(hal);
+    hal->delay_ms(hal->ctx, AHT10_DELAY_SOFT_RESET);
+    aht10_set_mode(hal, AHT10_MODE_NORMAL);
+}
+
+static esp_err_t sample_once(const aht10_hal_t *hal, aht10_meas_t *meas)
+{
+    uint32_t next_ms;
+    esp_err_t err;
+
+    if ((err = aht10_meas_start(meas, &next_ms)) != ESP_OK)
+    {
+        return err;
+    }
+    /* nothing else runs during a wake, so just sleep through the conversion */
+    while (meas->state != AHT10_MEAS_CONVERTED)
+    {
+        if (hal->time_us(hal->ctx) - meas->trigger_us >= (int64_t)DEEP_SLEEP_SAMPLE_DEADLINE_MS * 1000)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+        hal->delay_ms(hal->ctx, next_ms);
+        if ((err = aht10_meas_step(meas, &next_ms)) != ESP_OK)
+        {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t take_sample(const aht10_hal_t *hal, int power_on, aht10_sample_t *sample)
+{
+    aht10_meas_t meas;
+    aht10_reading_t reading;
+    esp_err_t err;
+
+    /* the sensor stays powered through deep sleep and keeps its mode, only
+     * a power-on needs the full init with its settling delays */
+    if (power_on)
+    {
+        aht10_init(hal);
+    }
+    else
+    {
+        hal->init(hal->ctx);
+    }
+    aht10_meas_init(&meas, hal);
+    if ((err = sample_once(hal, &meas)) != ESP_OK)
+    {
+        recover_sensor(hal);
+        return err;
+    }
+    aht10_meas_take(&meas, &reading);
+    if (aht10_reading_check(&reading) != AHT10_READING_OK)
+    {
+        /* uncalibrated or garbage, better no sample than a wrong one */
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    aht10_sample_pack(sample, clock_now_ms(), &reading);
+    return ESP_OK;
+}
+
+/* send everything in the store, as many frames as it takes */
+static int flush(void)
+{
+    uint8_t device_id[UPLOAD_FRAME_DEVICE_ID_LEN];
+    aht10_sample_t sample;
+    uint16_t i;
+
+    wifi_init_all();
+    if (!wifi_wait_link_up(DEEP_SLEEP_LINK_TIMEOUT_MS))
+    {
+        AHT10_LOG(SLEEP_NO_LINK, s_rtc_store.count);
+        return 0;
+    }
+
+    /* the sleep clock drifts by percents, every session corrects it; a
+     * failed sync keeps extrapolating from the last one */
+    time_sync_run(&s_rtc_store.time, clock_now_ms);
+
+    esp_read_mac(device_id, ESP_MAC_WIFI_STA);
+    while (s_rtc_store.count > 0)
+    {
+        upload_frame_begin(&s_frame, device_id, s_rtc_store.seq);
+        for (i = 0; i < UPLOAD_FRAME_MAX_SAMPLES && rtc_store_peek(&s_rtc_store, i, &sample) == ESP_OK; i++)
+        {
+            time_base_frame_add(&s_rtc_store.time, &s_frame, &sample);
+        }
+        upload_frame_finish(&s_frame);
+        if (uploader_send(&s_frame) != ESP_OK)
+        {
+            return 0;
+        }
+        AHT10_LOG(SLEEP_FRAME, s_rtc_store.seq, s_frame.count, s_frame.len);
+        s_rtc_store.seq++;
+        /* all i went out, except any the frame refused */
+        rtc_store_consume(&s_rtc_store, i);
+    }
+    return 1;
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void deep_sleep_run(const aht10_hal_t *hal)
+{
+    aht10_sample_t sample;
+    uint32_t awake_ms, sleep_ms, now_ms;
+    int power_on = 0;
+
+    rtc_store_load(&s_rtc_store, s_rtc_words);
+    if (esp_reset_reason() != ESP_RST_DEEPSLEEP || !rtc_store_valid(&s_rtc_store))
+    {
+        /* power-on (or anything else that isn't our own wake): start over */
+        rtc_store_init(&s_rtc_store);
+        power_on = 1;
+    }
+    s_rtc_store.wakes++;
+
+    if (take_sample(hal, power_on, &sample) == ESP_OK)
+    {
+        rtc_store_push(&s_rtc_store, &sample);
+    }
+    hal->deinit(hal->ctx);
+
+    now_ms = clock_now_ms();
+    if (rtc_store_flush_due(&s_rtc_store, &s_policy, now_ms))
+    {
+        rtc_store_flush_done(&s_rtc_store, flush(), clock_now_ms());
+    }
+
+    /* keep the cadence: the time spent awake comes out of the sleep */
+    awake_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    sleep_ms = (awake_ms < DEEP_SLEEP_PERIOD_MS) ? DEEP_SLEEP_PERIOD_MS - awake_ms : 0;
+    now_ms = clock_now_ms();
+
+    /* most wakes never touch the radio, those can skip RF calibration and
+     * keep it powered down entirely */
+    esp_deep_sleep_set_rf_option(rtc_store_flush_due_next(&s_rtc_store, &s_policy, now_ms) ? DEEP_SLEEP_RF_NO_CAL
+                                                                                            : DEEP_SLEEP_RF_OFF);
+
+    AHT10_LOG(SLEEP_WAKE, s_rtc_store.wakes, s_rtc_store.count, awake_ms, sleep_ms);
+    s_rtc_store.clock_ms += awake_ms + sleep_ms;
+    rtc_store_seal(&s_rtc_store);
+    rtc_store_save(&s_rtc_store, s_rtc_words);
+    /* the drain task won't run again before the power goes */
+    aht10_log_flush();
+
+    esp_deep_sleep((uint64_t)sleep_ms * 1000);
+}
@@ -0,0 +1,36 @@
+#ifndef _DEEP_SLEEP_H
+#define _DEEP_SLEEP_H
+
+#include <stdint.h>
+#include "aht10_config.h"
+#include "aht10_hal.h"
+
+/* Duty cycled operation for battery deployments.
+ *
+ * With AHT10_DEEP_SLEEP_MODE set, app_main doesn't start the sensor and
+ * uploader tasks. Each boot is one wake: take one measurement into the RTC
+ * memory buffer (rtc_store.h), bring up WiFi only if the buffer is full
+ * enough or old enough, then deep sleep until the next period.
+ *
+ * Waking from deep sleep on the ESP8266 needs GPIO16 (XPD_DCDC) wired to
+ * RST, which on the ESP-01S means a bodge wire to the chip. */
+
+#ifndef AHT10_DEEP_SLEEP_MODE
+#define AHT10_DEEP_SLEEP_MODE               0                   /* 1 replaces the always-on tasks with the wake/sleep cycle */
+#endif
+#ifndef DEEP_SLEEP_PERIOD_MS
+#define DEEP_SLEEP_PERIOD_MS                (60 * 1000)         /* one sample per wake */
+#endif
+#define DEEP_SLEEP_FLUSH_COUNT              30                  /* upload once this many samples are buffered */
+#define DEEP_SLEEP_FLUSH_AGE_MS             (60 * 60 * 1000)    /* ... or the oldest is this old */
+#define DEEP_SLEEP_LINK_TIMEOUT_MS          10000               /* give up on WiFi for this wake after this long */
+#define DEEP_SLEEP_SAMPLE_DEADLINE_MS       250                 /* trigger to result, then the wake goes without a sample */
+
+/* esp_deep_sleep_set_rf_option() values, for the RF state at the next wake */
+#define DEEP_SLEEP_RF_NO_CAL                2                   /* radio on, skip the RF calibration */
+#define DEEP_SLEEP_RF_OFF                   4                   /* radio powered down for the whole wake */
+
+/* one wake cycle, never returns (ends in esp_deep_sleep) */
+void deep_sleep_run(const aht10_hal_t *hal);
+
+#endif /* _DEEP_SLEEP_H */
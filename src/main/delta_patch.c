@@ -0,0 +1,389 @@
+/* associated header file */
+#include "delta_patch.h"
+
+/* others necessary headers */
+#include <string.h>
+
+typedef enum {
+    PATCH_HEADER = 0,
+    PATCH_OP,
+    PATCH_COPY_OFFSET,                  /* varint states: patch->varint collects the value */
+    PATCH_COPY_LEN,
+    PATCH_ZERO_RUN,
+    PATCH_LITERAL_COUNT,
+    PATCH_LITERALS,                     /* not varints from here on */
+    PATCH_INSERT_LEN,
+    PATCH_INSERT_DATA,
+    PATCH_DONE,
+} patch_state_t;
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static esp_err_t fail(delta_patch_t *patch, esp_err_t err)
+{
+    patch->err = err;
+    return err;
+}
+
+static esp_err_t flush_sector(delta_patch_t *patch)
+{
+    esp_err_t err;
+
+    if (patch->sector_fill == 0)
+    {
+        return ESP_OK;
+    }
+    sha256_update(&patch->new_hash, patch->sector, patch->sector_fill);
+    err = patch->io.write_new(patch->io.ctx, patch->written - patch->sector_fill, patch->sector, patch->sector_fill);
+    patch->sector_fill = 0;
+    return err;
+}
+
+static esp_err_t emit(delta_patch_t *patch, const uint8_t *data, uint32_t len)
+{
+    uint32_t n;
+    esp_err_t err;
+
+    if (len > patch->new_len - patch->written)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (len > 0)
+    {
+        n = DELTA_PATCH_SECTOR_SIZE - patch->sector_fill;
+        if (n > len)
+        {
+            n = len;
+        }
+        memcpy(&patch->sector[patch->sector_fill], data, n);
+        patch->sector_fill += n;
+        patch->written += n;
+        data += n;
+        len -= n;
+        if (patch->sector_fill == DELTA_PATCH_SECTOR_SIZE && (err = flush_sector(patch)) != ESP_OK)
+        {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+/* old image bytes at old_pos, at most len and never past the window;
+ * *out points into the window */
+static esp_err_t old_bytes(delta_patch_t *patch, uint32_t len, const uint8_t **out, uint32_t *got)
+{
+    uint32_t pos = patch->old_pos;
+    esp_err_t err;
+
+    if (pos < patch->window_off || pos >= patch->window_off + patch->window_len)
+    {
+        patch->window_off = pos;
+        patch->window_len = patch->old_len - pos;
+        if (patch->window_len > DELTA_PATCH_WINDOW)
+        {
+            patch->window_len = DELTA_PATCH_WINDOW;
+        }
+        if ((err = patch->io.read_old(patch->io.ctx, pos, patch->window, patch->window_len)) != ESP_OK)
+        {
+            patch->window_len = 0;
+            return err;
+        }
+    }
+    *out = &patch->window[pos - patch->window_off];
+    *got = patch->window_off + patch->window_len - pos;
+    if (*got > len)
+    {
+        *got = len;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t copy_zeros(delta_patch_t *patch, uint32_t len)
+{
+    const uint8_t *old;
+    uint32_t n;
+    esp_err_t err;
+
+    while (len > 0)
+    {
+        if ((err = old_bytes(patch, len, &old, &n)) != ESP_OK || (err = emit(patch, old, n)) != ESP_OK)
+        {
+            return err;
+        }
+        patch->old_pos += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t check_old(delta_patch_t *patch)
+{
+    uint8_t digest[SHA256_LEN];
+    sha256_t hash;
+    uint32_t off, n;
+    esp_err_t err;
+
+    sha256_init(&hash);
+    for (off = 0; off < patch->old_len; off += n)
+    {
+        n = patch->old_len - off;
+        if (n > DELTA_PATCH_WINDOW)
+        {
+            n = DELTA_PATCH_WINDOW;
+        }
+        if ((err = patch->io.read_old(patch->io.ctx, off, patch->window, n)) != ESP_OK)
+        {
+            return err;
+        }
+        sha256_update(&hash, patch->window, n);
+    }
+    patch->window_len = 0;
+    sha256_final(&hash, digest);
+    return memcmp(digest, &patch->header[12], SHA256_LEN) == 0 ? ESP_OK : ESP_ERR_INVALID_VERSION;
+}
+
+/* a COPY's add stream, from a zero run to the next one */
+static void next_run(delta_patch_t *patch, patch_state_t after_run)
+{
+    patch->state = (patch->left == 0) ? PATCH_OP : after_run;
+    patch->varint = 0;
+    patch->varint_shift = 0;
+}
+
+/* a complete varint in patch->varint for the current state */
+static esp_err_t take_varint(delta_patch_t *patch)
+{
+    uint32_t v = patch->varint;
+    int32_t delta;
+
+    switch (patch->state)
+    {
+        case PATCH_COPY_OFFSET:
+            delta = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+            patch->old_pos += (uint32_t)delta;
+            patch->state = PATCH_COPY_LEN;
+            break;
+        case PATCH_COPY_LEN:
+            if (patch->old_pos > patch->old_len || v > patch->old_len - patch->old_pos)
+            {
+                return ESP_ERR_INVALID_ARG;
+            }
+            patch->left = v;
+            next_run(patch, PATCH_ZERO_RUN);
+            return ESP_OK;
+        case PATCH_ZERO_RUN:
+            if (v > patch->left)
+            {
+                return ESP_ERR_INVALID_ARG;
+            }
+            patch->left -= v;
+            next_run(patch, PATCH_LITERAL_COUNT);
+            return copy_zeros(patch, v);
+        case PATCH_LITERAL_COUNT:
+            if (v == 0 || v > patch->left)
+            {
+                return ESP_ERR_INVALID_ARG;
+            }
+            patch->run = v;
+            patch->state = PATCH_LITERALS;
+            break;
+        case PATCH_INSERT_LEN:
+            patch->left = v;
+            patch->state = (v == 0) ? PATCH_OP : PATCH_INSERT_DATA;
+            break;
+        default:
+            break;
+    }
+    patch->varint = 0;
+    patch->varint_shift = 0;
+    return ESP_OK;
+}
+
+static esp_err_t start(delta_patch_t *patch)
+{
+    if (get_be32(patch->header) != DELTA_PATCH_MAGIC)
+    {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    patch->old_len = get_be32(&patch->header[4]);
+    patch->new_len = get_be32(&patch->header[8]);
+    patch->state = PATCH_OP;
+    return check_old(patch);
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void delta_patch_init(delta_patch_t *patch, const delta_patch_io_t *io)
+{
+    memset(patch, 0, sizeof(*patch));
+    patch->io = *io;
+    patch->state = PATCH_HEADER;
+    sha256_init(&patch->new_hash);
+}
+
+int delta_patch_started(const delta_patch_t *patch)
+{
+    return patch->state != PATCH_HEADER;
+}
+
+const uint8_t *delta_patch_new_hash(const delta_patch_t *patch)
+{
+    return &patch->header[12 + SHA256_LEN];
+}
+
+esp_err_t delta_patch_feed(delta_patch_t *patch, const uint8_t *data, size_t len)
+{
+    const uint8_t *end = data + len, *old;
+    uint8_t out[DELTA_PATCH_WINDOW];    /* literals applied; the window itself may be read again */
+    uint32_t n, i;
+    esp_err_t err;
+
+    if (patch->err != ESP_OK)
+    {
+        return patch->err;
+    }
+    patch->patch_bytes += (uint32_t)len;
+
+    while (data < end)
+    {
+        switch (patch->state)
+        {
+            case PATCH_HEADER:
+                n = (uint32_t)(end - data);
+                if (n > DELTA_PATCH_HEADER_LEN - patch->header_fill)
+                {
+                    n = DELTA_PATCH_HEADER_LEN - patch->header_fill;
+                }
+                memcpy(&patch->header[patch->header_fill], data, n);
+                patch->header_fill += n;
+                data += n;
+                if (patch->header_fill == DELTA_PATCH_HEADER_LEN && (err = start(patch)) != ESP_OK)
+                {
+                    return fail(patch, err);
+                }
+                break;
+
+            case PATCH_OP:
+                patch->op = *data++;
+                patch->ops++;
+                patch->varint = 0;
+                patch->varint_shift = 0;
+                if (patch->op == DELTA_OP_COPY)
+                {
+                    patch->state = PATCH_COPY_OFFSET;
+                }
+                else if (patch->op == DELTA_OP_INSERT)
+                {
+                    patch->state = PATCH_INSERT_LEN;
+                }
+                else if (patch->op == DELTA_OP_END)
+                {
+                    patch->state = PATCH_DONE;
+                }
+                else
+                {
+                    return fail(patch, ESP_ERR_INVALID_ARG);
+                }
+                break;
+
+            case PATCH_LITERALS:
+                /* new = old + literal, a window at a time */
+                n = (uint32_t)(end - data);
+                if (n > patch->run)
+                {
+                    n = patch->run;
+                }
+                if ((err = old_bytes(patch, n, &old, &n)) != ESP_OK)
+                {
+                    return fail(patch, err);
+                }
+                for (i = 0; i < n; i++)
+                {
+                    out[i] = (uint8_t)(old[i] + data[i]);
+                }
+                if ((err = emit(patch, out, n)) != ESP_OK)
+                {
+                    return fail(patch, err);
+                }
+                data += n;
+                patch->old_pos += n;
+                patch->run -= n;
+                patch->left -= n;
+                if (patch->run == 0)
+                {
+                    next_run(patch, PATCH_ZERO_RUN);
+                }
+                break;
+
+            case PATCH_INSERT_DATA:
+                n = (uint32_t)(end - data);
+                if (n > patch->left)
+                {
+                    n = patch->left;
+                }
+                if ((err = emit(patch, data, n)) != ESP_OK)
+                {
+                    return fail(patch, err);
+                }
+                data += n;
+                patch->left -= n;
+                if (patch->left == 0)
+                {
+                    patch->state = PATCH_OP;
+                }
+                break;
+
+            case PATCH_DONE:
+                /* nothing may follow END */
+                return fail(patch, ESP_ERR_INVALID_SIZE);
+
+            default:
+                /* one varint byte */
+                if (patch->varint_shift > 28)
+                {
+                    return fail(patch, ESP_ERR_INVALID_ARG);
+                }
+                patch->varint |= (uint32_t)(*data & 0x7F) << patch->varint_shift;
+                patch->varint_shift += 7;
+                if ((*data++ & 0x80) == 0 && (err = take_varint(patch)) != ESP_OK)
+                {
+                    return fail(patch, err);
+                }
+                break;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t delta_patch_finish(delta_patch_t *patch)
+{
+    uint8_t digest[SHA256_LEN];
+    esp_err_t err;
+
+    if (patch->err != ESP_OK)
+    {
+        return patch->err;
+    }
+    if (patch->state != PATCH_DONE || patch->written != patch->new_len)
+    {
+        return fail(patch, ESP_ERR_INVALID_SIZE);
+    }
+    if ((err = flush_sector(patch)) != ESP_OK)
+    {
+        return fail(patch, err);
+    }
+    sha256_final(&patch->new_hash, digest);
+    if (memcmp(digest, &patch->header[12 + SHA256_LEN], SHA256_LEN) != 0)
+    {
+        return fail(patch, ESP_ERR_INVALID_CRC);
+    }
+    return ESP_OK;
+}
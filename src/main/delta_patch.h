@@ -0,0 +1,98 @@
+#ifndef _DELTA_PATCH_H
+#define _DELTA_PATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sha256.h"
+
+/* Delta firmware patches and their streaming applier.
+ *
+ * A patch turns the running image (old) into the next one (new). It is
+ * made on the host (host/delta_diff.c) and applied on the device as it
+ * arrives, a TCP segment at a time, with only a flash sector and a small
+ * window of the old image in RAM:
+ *
+ * | magic "ADP1" | old len (4) | new len (4) | old sha256 (32) | new sha256 (32) | ops ... | END |
+ *
+ * ops, lengths and offsets as LEB128 varints:
+ *     COPY    0x01, old offset (zigzag, relative to where the last COPY
+ *             ended), len, then len bytes as new = old + add (mod 256),
+ *             the adds coded as runs: zero count, literal count, literals,
+ *             zero count, ... until len is covered
+ *     INSERT  0x02, len, len raw bytes
+ *     END     0x00
+ * Code that moved by a few bytes or had its call offsets shifted is a COPY
+ * whose adds are mostly zero, which is what keeps patches small (bsdiff's
+ * idea, with run coding in place of a compressor the device would have to
+ * carry).
+ *
+ * The applier checks the old image against its hash before writing
+ * anything (ESP_ERR_INVALID_VERSION: the patch is for another image), and
+ * the new one as a whole at the end (ESP_ERR_INVALID_CRC). Ops that reach
+ * outside either image are ESP_ERR_INVALID_ARG, a patch that ends before
+ * END is ESP_ERR_INVALID_SIZE. Errors stick. Whatever was written when it
+ * fails is garbage and must not be booted. */
+
+#define DELTA_PATCH_MAGIC                   0x41445031          /* "ADP1" */
+#define DELTA_PATCH_HEADER_LEN              (4 + 4 + 4 + 2 * SHA256_LEN)
+#define DELTA_PATCH_SECTOR_SIZE             4096                /* flash erase unit, new image written a sector at a time */
+#define DELTA_PATCH_WINDOW                  256                 /* old image read this much at a time */
+
+#define DELTA_OP_END                        0x00
+#define DELTA_OP_COPY                       0x01
+#define DELTA_OP_INSERT                     0x02
+
+typedef struct delta_patch_io {
+    void *ctx;
+    esp_err_t (*read_old)(void *ctx, uint32_t offset, void *buf, size_t len);
+    /* the new image in order, a sector at a time (the last one short) */
+    esp_err_t (*write_new)(void *ctx, uint32_t offset, const void *buf, size_t len);
+} delta_patch_io_t;
+
+typedef struct delta_patch {
+    delta_patch_io_t io;
+    uint8_t state;
+    uint8_t op;
+    esp_err_t err;                      /* sticky */
+
+    /* header, valid once header_fill reaches DELTA_PATCH_HEADER_LEN */
+    uint8_t header[DELTA_PATCH_HEADER_LEN];
+    size_t header_fill;
+    uint32_t old_len;
+    uint32_t new_len;
+
+    /* op decoding */
+    uint32_t varint;
+    uint8_t varint_shift;
+    uint32_t old_pos;
+    uint32_t left;                      /* bytes of the current op still to produce */
+    uint32_t run;                       /* of the current zero or literal run */
+
+    /* old image window */
+    uint8_t window[DELTA_PATCH_WINDOW];
+    uint32_t window_off;
+    uint32_t window_len;
+
+    /* new image output */
+    uint8_t sector[DELTA_PATCH_SECTOR_SIZE];
+    uint32_t sector_fill;
+    uint32_t written;                   /* bytes produced so far */
+    sha256_t new_hash;
+
+    /* statistics */
+    uint32_t patch_bytes;
+    uint32_t ops;
+} delta_patch_t;
+
+void delta_patch_init(delta_patch_t *patch, const delta_patch_io_t *io);
+/* any amount of patch bytes, in order; reads and writes flash as it goes */
+esp_err_t delta_patch_feed(delta_patch_t *patch, const uint8_t *data, size_t len);
+/* after the last byte: ESP_OK only if the patch was complete and the new image hashes right */
+esp_err_t delta_patch_finish(delta_patch_t *patch);
+/* the header has been parsed (and the old image checked) */
+int delta_patch_started(const delta_patch_t *patch);
+/* SHA-256 of the image the patch builds, once it has started */
+const uint8_t *delta_patch_new_hash(const delta_patch_t *patch);
+
+#endif /* _DELTA_PATCH_H */
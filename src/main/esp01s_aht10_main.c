@@ -53,13 +53,52 @@
 #include "esp_spi_flash.h"
 
 /* local main functions */
-#include "aht10_i2c.h"
+#include "aht10_hal.h"
+#include "aht10_log.h"
+#include "aht10_task.h"
+#include "deep_sleep.h"
+#include "ota_update.h"
+#include "uploader.h"
 #include "wifi_logging.h"
 
+#if AHT10_TASK_STATIC_ALLOC
+/* the sensor task lives for the life of the device, so keep it off the heap */
+static StackType_t s_aht10_task_stack[AHT10_TASK_STACK_DEPTH];
+static StaticTask_t s_aht10_task_tcb;
+#endif
+
 void app_main(void)
 {
+    /* first, so everything after can log */
+    aht10_log_start();
+
+#if AHT10_DEEP_SLEEP_MODE
+    /* battery mode: one sample per boot, the rest of this is never reached */
+    deep_sleep_run(aht10_hal_esp());
+#endif
+
+    /* a freshly updated image counts its boots and goes back if it can't
+     * confirm itself, see ota_trial.h */
+    if (OTA_UPDATE_ENABLE)
+    {
+        ota_update_boot_check();
+    }
+
+    /* the ring has to exist before either side of it starts */
+    sample_ring_init(aht10_task_ring(), SAMPLE_RING_DROP_OLDEST);
+
     /* start i2c task */
-    xTaskCreate(i2c_task_aht10, "i2c_task_aht10", 2048, NULL, 10, NULL);
+#if AHT10_TASK_STATIC_ALLOC
+    xTaskCreateStatic(i2c_task_aht10, "i2c_task_aht10", AHT10_TASK_STACK_DEPTH, (void *)aht10_hal_esp(),
+                      AHT10_TASK_PRIORITY, s_aht10_task_stack, &s_aht10_task_tcb);
+#else
+    xTaskCreate(i2c_task_aht10, "i2c_task_aht10", AHT10_TASK_STACK_DEPTH, (void *)aht10_hal_esp(),
+                AHT10_TASK_PRIORITY, NULL);
+#endif
+
+    /* start the uploader, it only ever sees samples through the ring */
+    xTaskCreate(uploader_task, "uploader_task", UPLOADER_TASK_STACK_DEPTH, (void *)aht10_task_ring(),
+                UPLOADER_TASK_PRIORITY, NULL);
 
     /* initialize wifi */
     wifi_init_all();
@@ -0,0 +1,75 @@
+/* associated header file */
+#include "ota_trial.h"
+
+/* others necessary headers */
+#include <string.h>
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void ota_trial_init(ota_trial_t *trial)
+{
+    memset(trial, 0, sizeof(*trial));
+    trial->magic = OTA_TRIAL_MAGIC;
+}
+
+void ota_trial_start(ota_trial_t *trial, uint32_t prev_addr, uint32_t new_addr, const uint8_t *new_hash)
+{
+    if (trial->magic != OTA_TRIAL_MAGIC)
+    {
+        ota_trial_init(trial);
+    }
+    trial->state = OTA_TRIAL_PENDING;
+    trial->boots = 0;
+    trial->prev_addr = prev_addr;
+    trial->new_addr = new_addr;
+    memcpy(trial->new_hash, new_hash, SHA256_LEN);
+}
+
+ota_trial_action_t ota_trial_boot(ota_trial_t *trial, uint32_t running_addr)
+{
+    if (trial->magic != OTA_TRIAL_MAGIC)
+    {
+        ota_trial_init(trial);
+    }
+    if (trial->state != OTA_TRIAL_PENDING)
+    {
+        return OTA_TRIAL_RUN;
+    }
+    if (running_addr != trial->new_addr)
+    {
+        /* the switch never happened, or this is the old image after a
+         * rollback: either way it is the confirmed one */
+        trial->state = OTA_TRIAL_NONE;
+        return OTA_TRIAL_RUN;
+    }
+    if (++trial->boots > OTA_TRIAL_BOOTS)
+    {
+        trial->state = OTA_TRIAL_NONE;
+        trial->rollbacks++;
+        memcpy(trial->rejected_hash, trial->new_hash, SHA256_LEN);
+        return OTA_TRIAL_ROLLBACK;
+    }
+    return OTA_TRIAL_RUN;
+}
+
+int ota_trial_confirm(ota_trial_t *trial)
+{
+    if (trial->magic != OTA_TRIAL_MAGIC || trial->state != OTA_TRIAL_PENDING)
+    {
+        return 0;
+    }
+    trial->state = OTA_TRIAL_NONE;
+    return 1;
+}
+
+int ota_trial_rejected(const ota_trial_t *trial, const uint8_t *new_hash)
+{
+    static const uint8_t none[SHA256_LEN];
+
+    if (trial->magic != OTA_TRIAL_MAGIC || memcmp(trial->rejected_hash, none, SHA256_LEN) == 0)
+    {
+        return 0;
+    }
+    return memcmp(trial->rejected_hash, new_hash, SHA256_LEN) == 0;
+}
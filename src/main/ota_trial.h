@@ -0,0 +1,60 @@
+#ifndef _OTA_TRIAL_H
+#define _OTA_TRIAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+/* Trial boots of a freshly updated image, and going back if it fails.
+ *
+ * The SDK's bootloader boots whatever slot otadata points at and has no
+ * rollback of its own, so the firmware keeps this record (in NVS,
+ * ota_update.c): after an update it names the new slot and the one to go
+ * back to. Every boot of the new slot counts; the image confirms itself
+ * once it has proven it works (the first frame the collector acked). An
+ * image that boots OTA_TRIAL_BOOTS times without confirming, because it
+ * crashes, hangs into the watchdog or never gets a frame through, is
+ * rolled back, and its hash is kept so the same patch isn't applied again
+ * the next day; only an image that differs is. Only the state machine
+ * lives here, it runs on the host too. */
+
+#define OTA_TRIAL_MAGIC                     0x4F544131          /* "OTA1" */
+#define OTA_TRIAL_BOOTS                     3
+
+typedef enum {
+    OTA_TRIAL_NONE = 0,                 /* running a confirmed image */
+    OTA_TRIAL_PENDING,                  /* new image on probation */
+} ota_trial_state_t;
+
+typedef enum {
+    OTA_TRIAL_RUN = 0,
+    OTA_TRIAL_ROLLBACK,                 /* boot prev_addr and restart */
+} ota_trial_action_t;
+
+typedef struct ota_trial {
+    uint32_t magic;
+    uint8_t state;                      /* ota_trial_state_t */
+    uint8_t boots;                      /* of the new image, unconfirmed */
+    uint16_t rollbacks;                 /* statistics */
+    uint32_t prev_addr;                 /* flash address of the slot to go back to */
+    uint32_t new_addr;
+    /* appended, records saved before them load with both zeroed */
+    uint8_t new_hash[SHA256_LEN];       /* of the image on probation */
+    uint8_t rejected_hash[SHA256_LEN];  /* of the last image rolled back, all zero for none */
+} ota_trial_t;
+
+/* length of a record from before new_hash, still accepted when loading */
+#define OTA_TRIAL_LEGACY_LEN                offsetof(ota_trial_t, new_hash)
+
+/* anything without the magic (nothing stored yet) is a confirmed image */
+void ota_trial_init(ota_trial_t *trial);
+/* the new image (SHA-256 new_hash) is written and otadata points at it */
+void ota_trial_start(ota_trial_t *trial, uint32_t prev_addr, uint32_t new_addr, const uint8_t *new_hash);
+/* on every boot, before the record is saved back; running_addr is this image's slot */
+ota_trial_action_t ota_trial_boot(ota_trial_t *trial, uint32_t running_addr);
+/* returns non-zero if the record changed and has to be saved */
+int ota_trial_confirm(ota_trial_t *trial);
+/* non-zero if an image with this hash already failed its trial here */
+int ota_trial_rejected(const ota_trial_t *trial, const uint8_t *new_hash);
+
+#endif /* _OTA_TRIAL_H */
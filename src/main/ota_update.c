@@ -0,0 +1,311 @@
+/* associated header file */
+#include "ota_update.h"
+
+/* others necessary headers */
+#include <stdlib.h>
+#include <string.h>
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "nvs_flash.h"
+#include "aht10_log.h"
+#include "delta_patch.h"
+#include "ota_trial.h"
+#include "upload_frame.h"
+
+/* one update in progress, on the heap only while it runs */
+typedef struct ota_session {
+    delta_patch_t patch;
+    const esp_partition_t *running;
+    const esp_partition_t *target;
+    esp_ota_handle_t handle;
+    uint8_t begun;                      /* esp_ota_begin() done, the target is being written */
+    uint8_t buf[OTA_RECV_CHUNK];
+} ota_session_t;
+
+static ota_trial_t s_trial;
+static uint8_t s_confirmed;
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static void load_trial(void)
+{
+    nvs_handle handle;
+    size_t len = sizeof(s_trial);
+    int ok = 0;
+
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK)
+    {
+        memset(&s_trial, 0, sizeof(s_trial));
+        ok = nvs_get_blob(handle, "trial", &s_trial, &len) == ESP_OK
+             && (len == sizeof(s_trial) || len == OTA_TRIAL_LEGACY_LEN);
+        nvs_close(handle);
+    }
+    if (!ok)
+    {
+        ota_trial_init(&s_trial);
+    }
+}
+
+static void save_trial(void)
+{
+    nvs_handle handle;
+
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+    {
+        return;
+    }
+    nvs_set_blob(handle, "trial", &s_trial, sizeof(s_trial));
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+static const esp_partition_t *app_at(uint32_t addr)
+{
+    esp_partition_iterator_t it = esp_partition_find(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, NULL);
+    const esp_partition_t *part = NULL;
+
+    for (; it != NULL; it = esp_partition_next(it))
+    {
+        if (esp_partition_get(it)->address == addr)
+        {
+            part = esp_partition_get(it);
+            break;
+        }
+    }
+    esp_partition_iterator_release(it);
+    return part;
+}
+
+static esp_err_t read_old(void *ctx, uint32_t offset, void *buf, size_t len)
+{
+    ota_session_t *s = (ota_session_t *)ctx;
+
+    return esp_partition_read(s->running, offset, buf, len);
+}
+
+static esp_err_t write_new(void *ctx, uint32_t offset, const void *buf, size_t len)
+{
+    ota_session_t *s = (ota_session_t *)ctx;
+    esp_err_t err;
+
+    /* the header is in by now, so the size is known: erase only that much */
+    if (!s->begun)
+    {
+        if (s->patch.new_len > s->target->size)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if ((err = esp_ota_begin(s->target, s->patch.new_len, &s->handle)) != ESP_OK)
+        {
+            return err;
+        }
+        s->begun = 1;
+    }
+    return esp_ota_write(s->handle, buf, len);
+}
+
+static int recv_all(int sock, uint8_t *buf, size_t len)
+{
+    int n;
+
+    while (len > 0)
+    {
+        if ((n = recv(sock, buf, len, 0)) <= 0)
+        {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static esp_err_t download(ota_session_t *s, int sock, const uint8_t *device_id)
+{
+    uint8_t request[OTA_REQUEST_LEN], len_be[4];
+    uint32_t left, want;
+    esp_err_t err;
+    int n;
+
+    request[0] = OTA_REQUEST_MAGIC >> 8;
+    request[1] = OTA_REQUEST_MAGIC & 0xFF;
+    request[2] = OTA_REQUEST_VERSION;
+    memcpy(&request[3], device_id, UPLOAD_FRAME_DEVICE_ID_LEN);
+    if (send(sock, request, sizeof(request), 0) != sizeof(request) || recv_all(sock, len_be, sizeof(len_be)) != 0)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+    left = ((uint32_t)len_be[0] << 24) | ((uint32_t)len_be[1] << 16) | ((uint32_t)len_be[2] << 8) | len_be[3];
+    if (left == 0)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    while (left > 0)
+    {
+        want = (left < sizeof(s->buf)) ? left : sizeof(s->buf);
+        if ((n = recv(sock, s->buf, want, 0)) <= 0)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+        left -= (uint32_t)n;
+        /* a patch for another image fails on its header, before the
+         * rest of it is downloaded or anything is erased */
+        if ((err = delta_patch_feed(&s->patch, s->buf, (size_t)n)) != ESP_OK)
+        {
+            return err;
+        }
+        /* the image that just failed its trial boots here, still on offer */
+        if (delta_patch_started(&s->patch) && ota_trial_rejected(&s_trial, delta_patch_new_hash(&s->patch)))
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    return delta_patch_finish(&s->patch);
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void ota_update_boot_check(void)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *prev;
+
+    /* wifi_init_all() does this too, later; a second call is a no-op */
+    nvs_flash_init();
+    load_trial();
+    switch (ota_trial_boot(&s_trial, running->address))
+    {
+        case OTA_TRIAL_ROLLBACK:
+            save_trial();
+            AHT10_LOG(OTA_ROLLBACK, OTA_TRIAL_BOOTS, s_trial.prev_addr);
+            aht10_log_flush();
+            prev = app_at(s_trial.prev_addr);
+            if (prev != NULL && esp_ota_set_boot_partition(prev) == ESP_OK)
+            {
+                esp_restart();
+            }
+            /* nowhere to go back to, keep running this one */
+            s_confirmed = 1;
+            break;
+        default:
+            save_trial();
+            s_confirmed = (s_trial.state != OTA_TRIAL_PENDING);
+            if (!s_confirmed)
+            {
+                AHT10_LOG(OTA_TRIAL, s_trial.boots, OTA_TRIAL_BOOTS, s_trial.new_addr);
+            }
+            break;
+    }
+}
+
+void ota_update_confirm(void)
+{
+    if (s_confirmed)
+    {
+        return;
+    }
+    s_confirmed = 1;
+    if (ota_trial_confirm(&s_trial))
+    {
+        save_trial();
+        AHT10_LOG(OTA_CONFIRMED, s_trial.new_addr);
+    }
+}
+
+int ota_update_confirmed(void)
+{
+    return s_confirmed;
+}
+
+esp_err_t ota_update_check(const uint8_t *device_id)
+{
+    const delta_patch_io_t io = { .read_old = read_old, .write_new = write_new };
+    struct timeval timeout = {
+        .tv_sec = OTA_TIMEOUT_MS / 1000,
+        .tv_usec = (OTA_TIMEOUT_MS % 1000) * 1000,
+    };
+    struct sockaddr_in dest;
+    int64_t start_us = esp_timer_get_time();
+    ota_session_t *s;
+    esp_err_t err, end_err;
+    int sock;
+
+    if ((s = calloc(1, sizeof(*s))) == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s->running = esp_ota_get_running_partition();
+    s->target = esp_ota_get_next_update_partition(NULL);
+    if (s->target == NULL)
+    {
+        /* single app partition table */
+        free(s);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    delta_patch_init(&s->patch, &io);
+    s->patch.io.ctx = s;
+
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(OTA_SERVER_PORT);
+    dest.sin_addr.s_addr = inet_addr(OTA_SERVER_ADDR);
+    if ((sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP)) < 0)
+    {
+        free(s);
+        return ESP_FAIL;
+    }
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (connect(sock, (const struct sockaddr *)&dest, sizeof(dest)) != 0)
+    {
+        err = ESP_ERR_TIMEOUT;
+    }
+    else
+    {
+        err = download(s, sock, device_id);
+    }
+    close(sock);
+
+    if (s->begun)
+    {
+        /* also the SDK's own check of the image (segments, checksum) */
+        end_err = esp_ota_end(s->handle);
+        if (err == ESP_OK)
+        {
+            err = end_err;
+        }
+    }
+    if (err == ESP_OK)
+    {
+        err = esp_ota_set_boot_partition(s->target);
+    }
+    if (err != ESP_OK)
+    {
+        /* a patch for another image is most likely the one this device already applied */
+        if (err == ESP_ERR_INVALID_STATE)
+        {
+            AHT10_LOG(OTA_REJECTED, s->patch.new_len);
+        }
+        else if (err != ESP_ERR_NOT_FOUND && err != ESP_ERR_INVALID_VERSION)
+        {
+            AHT10_LOG(OTA_FAILED, err, s->patch.patch_bytes);
+        }
+        free(s);
+        return err;
+    }
+
+    ota_trial_start(&s_trial, s->running->address, s->target->address, delta_patch_new_hash(&s->patch));
+    save_trial();
+    AHT10_LOG(OTA_APPLIED, s->patch.patch_bytes, s->patch.new_len,
+              (uint32_t)((esp_timer_get_time() - start_us) / 1000), s->target->address);
+    aht10_log_flush();
+    esp_restart();
+    return ESP_OK;
+}
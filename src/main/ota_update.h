@@ -0,0 +1,57 @@
+#ifndef _OTA_UPDATE_H
+#define _OTA_UPDATE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "aht10_config.h"
+#include "uploader.h"
+
+/* Delta firmware updates, device side.
+ *
+ * The flash holds two app slots (partitions.csv). Every OTA_CHECK_PERIOD_MS
+ * the uploader asks the update server, over TCP:
+ *     request   magic "AO" | version 1 | device id (6)
+ *     response  patch length (4, big endian, 0: nothing for this device) | patch
+ * and feeds the patch (delta_patch.h) straight from the socket into the
+ * other slot, reading the running image for the unchanged parts. Only once
+ * the new image hashed right and passed the SDK's image check does otadata
+ * switch to it; the device reboots into it on probation (ota_trial.h) and
+ * goes back to the old slot if it can't confirm itself.
+ *
+ * host/delta_ota makes patches and serves them (delta_ota serve). The deep
+ * sleep mode doesn't update: every wake is a boot there. With
+ * OTA_UPDATE_ENABLE at 0 the callers test it as a constant and none of this
+ * is linked in. */
+
+#ifndef OTA_UPDATE_ENABLE
+#define OTA_UPDATE_ENABLE                   1
+#endif
+
+#define OTA_SERVER_ADDR                     UPLOAD_COLLECTOR_ADDR
+#define OTA_SERVER_PORT                     47011
+#define OTA_CHECK_PERIOD_MS                 (24 * 60 * 60 * 1000)   /* 0 disables updates */
+#define OTA_TIMEOUT_MS                      (10 * 1000)         /* connect, and between segments */
+#define OTA_RECV_CHUNK                      1460                /* one TCP segment */
+#define OTA_NVS_NAMESPACE                   "ota"
+
+#define OTA_REQUEST_MAGIC                   0x414F              /* "AO" */
+#define OTA_REQUEST_VERSION                 1
+#define OTA_REQUEST_LEN                     9
+
+/* early in app_main: counts trial boots, rolls back (and restarts) if due */
+void ota_update_boot_check(void);
+/* the running image works, ends its probation; cheap after the first call */
+void ota_update_confirm(void);
+/* not on probation: updating from a trial image could strand the device */
+int ota_update_confirmed(void);
+
+/* Asks the server and applies what it has. Doesn't return on success
+ * (reboots into the new image). ESP_ERR_NOT_FOUND if there is nothing for
+ * this device, ESP_ERR_INVALID_VERSION if the patch is for another image
+ * (typically: this device already runs the patch's new image),
+ * ESP_ERR_INVALID_STATE if the new image is the one that last failed its
+ * trial boots here (ota_trial.h), otherwise the socket, patch or flash error; the running image stays
+ * bootable in every case. */
+esp_err_t ota_update_check(const uint8_t *device_id);
+
+#endif /* _OTA_UPDATE_H */
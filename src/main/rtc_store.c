@@ -0,0 +1,143 @@
+/* associated header file */
+#include "rtc_store.h"
+
+/* others necessary headers */
+#include <stddef.h>
+#include <string.h>
+#include "upload_frame.h"
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static uint32_t store_crc(const rtc_store_t *store)
+{
+    return upload_frame_crc32((const uint8_t *)store, offsetof(rtc_store_t, crc));
+}
+
+static int due(const rtc_store_t *store, const rtc_store_policy_t *policy, uint32_t now_ms, uint16_t count)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    if (store->retry_ms != 0 && (int32_t)(now_ms - store->retry_at_ms) < 0)
+    {
+        /* the last flush failed, don't burn the battery on the radio every wake */
+        return 0;
+    }
+    if (count >= policy->flush_count)
+    {
+        return 1;
+    }
+    return (now_ms - store->samples[store->head].timestamp_ms) >= policy->flush_age_ms;
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void rtc_store_init(rtc_store_t *store)
+{
+    memset(store, 0, sizeof(*store));
+    store->magic = RTC_STORE_MAGIC;
+    time_base_init(&store->time);
+    rtc_store_seal(store);
+}
+
+int rtc_store_valid(const rtc_store_t *store)
+{
+    return store->magic == RTC_STORE_MAGIC
+           && store->head < RTC_STORE_CAPACITY
+           && store->count <= RTC_STORE_CAPACITY
+           && store->crc == store_crc(store);
+}
+
+void rtc_store_seal(rtc_store_t *store)
+{
+    store->crc = store_crc(store);
+}
+
+void rtc_store_load(rtc_store_t *store, const volatile uint32_t *rtc)
+{
+    uint32_t word;
+    size_t i;
+
+    for (i = 0; i < RTC_STORE_WORDS; i++)
+    {
+        word = rtc[i];
+        memcpy((uint8_t *)store + i * sizeof(word), &word, sizeof(word));
+    }
+}
+
+void rtc_store_save(const rtc_store_t *store, volatile uint32_t *rtc)
+{
+    uint32_t word;
+    size_t i;
+
+    for (i = 0; i < RTC_STORE_WORDS; i++)
+    {
+        memcpy(&word, (const uint8_t *)store + i * sizeof(word), sizeof(word));
+        rtc[i] = word;
+    }
+}
+
+void rtc_store_push(rtc_store_t *store, const aht10_sample_t *sample)
+{
+    if (store->count == RTC_STORE_CAPACITY)
+    {
+        store->head = (uint16_t)((store->head + 1) % RTC_STORE_CAPACITY);
+        store->count--;
+        store->dropped++;
+    }
+    store->samples[(store->head + store->count) % RTC_STORE_CAPACITY] = *sample;
+    store->count++;
+}
+
+esp_err_t rtc_store_peek(const rtc_store_t *store, uint16_t idx, aht10_sample_t *sample)
+{
+    if (idx >= store->count)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *sample = store->samples[(store->head + idx) % RTC_STORE_CAPACITY];
+    return ESP_OK;
+}
+
+void rtc_store_consume(rtc_store_t *store, uint16_t n)
+{
+    if (n > store->count)
+    {
+        n = store->count;
+    }
+    store->head = (uint16_t)((store->head + n) % RTC_STORE_CAPACITY);
+    store->count -= n;
+}
+
+int rtc_store_flush_due(const rtc_store_t *store, const rtc_store_policy_t *policy, uint32_t now_ms)
+{
+    return due(store, policy, now_ms, store->count);
+}
+
+int rtc_store_flush_due_next(const rtc_store_t *store, const rtc_store_policy_t *policy, uint32_t now_ms)
+{
+    uint16_t count = store->count < RTC_STORE_CAPACITY ? store->count + 1 : store->count;
+    return due(store, policy, now_ms + policy->period_ms, count);
+}
+
+void rtc_store_flush_done(rtc_store_t *store, int ok, uint32_t now_ms)
+{
+    if (ok)
+    {
+        store->flushes++;
+        store->flush_failures = 0;
+        store->retry_ms = 0;
+        return;
+    }
+    store->flush_failures++;
+    store->retry_ms = (store->retry_ms == 0) ? RTC_STORE_RETRY_MIN_MS : store->retry_ms * 2;
+    if (store->retry_ms > RTC_STORE_RETRY_MAX_MS)
+    {
+        store->retry_ms = RTC_STORE_RETRY_MAX_MS;
+    }
+    store->retry_at_ms = now_ms + store->retry_ms;
+}
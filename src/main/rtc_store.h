@@ -0,0 +1,87 @@
+#ifndef _RTC_STORE_H
+#define _RTC_STORE_H
+
+#include <stdint.h>
+#include "sample_ring.h"
+#include "time_base.h"
+
+/* Sample buffer for the deep sleep mode.
+ *
+ * The ESP8266 keeps its 512 bytes of RTC user memory powered through deep
+ * sleep, everything else is lost. This struct is sized to live there: a small
+ * drop-oldest ring of samples plus the bits of state that have to survive a
+ * sleep (the device clock, the upload sequence number, the flush backoff).
+ *
+ * RTC memory only takes aligned 32-bit accesses, so the struct is never used
+ * in place: rtc_store_load() copies it into a working copy in DRAM at wake,
+ * and rtc_store_save() copies that back just before sleeping, both a word at
+ * a time.
+ *
+ * RTC memory holds garbage after a power-on, so the struct carries a magic
+ * and a CRC; rtc_store_valid() says whether the loaded copy can be trusted
+ * and rtc_store_seal() has to be called after the last change before saving.
+ *
+ * Timestamps are on the store's own clock (clock_ms): milliseconds of device
+ * time summed over all wake and sleep periods since the store was reset. */
+
+#define RTC_STORE_MAGIC                     0x41485453          /* "AHTS" */
+#define RTC_STORE_MAX_BYTES                 512                 /* RTC user memory */
+#define RTC_STORE_CAPACITY                  36                  /* samples, keep sizeof(rtc_store_t) under RTC_STORE_MAX_BYTES */
+#define RTC_STORE_RETRY_MIN_MS              (60 * 1000)         /* first wait after a failed flush */
+#define RTC_STORE_RETRY_MAX_MS              (60 * 60 * 1000)
+
+/* when the duty cycled device bothers to bring up the radio */
+typedef struct rtc_store_policy {
+    uint32_t period_ms;                 /* one wake (and one sample) per period */
+    uint16_t flush_count;               /* upload once this many samples are buffered */
+    uint32_t flush_age_ms;              /* ... or once the oldest one is this old */
+} rtc_store_policy_t;
+
+typedef struct rtc_store {
+    uint32_t magic;
+    uint32_t clock_ms;                  /* device time at the start of this wake */
+    uint32_t retry_at_ms;               /* no flush before this, after a failed one */
+    uint32_t retry_ms;                  /* current flush backoff, 0 after a success */
+    uint16_t head;                      /* oldest sample */
+    uint16_t count;
+    uint16_t seq;                       /* next upload frame sequence number */
+    uint16_t flush_failures;            /* consecutive */
+
+    /* statistics */
+    uint32_t wakes;
+    uint32_t flushes;
+    uint32_t dropped;                   /* overwritten before they could be uploaded */
+
+    time_base_t time;                   /* clock_ms to UTC, synced on flushes */
+    aht10_sample_t samples[RTC_STORE_CAPACITY];
+    uint32_t crc;                       /* over everything above */
+} rtc_store_t;
+
+#define RTC_STORE_WORDS                     (sizeof(rtc_store_t) / sizeof(uint32_t))
+
+_Static_assert(sizeof(rtc_store_t) <= RTC_STORE_MAX_BYTES, "rtc_store_t doesn't fit the RTC user memory");
+_Static_assert(sizeof(rtc_store_t) % sizeof(uint32_t) == 0, "rtc_store_t has to be whole words");
+
+void rtc_store_init(rtc_store_t *store);
+int rtc_store_valid(const rtc_store_t *store);
+void rtc_store_seal(rtc_store_t *store);
+/* word by word between the RTC memory (RTC_STORE_WORDS words) and the working copy */
+void rtc_store_load(rtc_store_t *store, const volatile uint32_t *rtc);
+void rtc_store_save(const rtc_store_t *store, volatile uint32_t *rtc);
+
+/* drops the oldest sample when full */
+void rtc_store_push(rtc_store_t *store, const aht10_sample_t *sample);
+/* idx 0 is the oldest, ESP_ERR_NOT_FOUND past the end */
+esp_err_t rtc_store_peek(const rtc_store_t *store, uint16_t idx, aht10_sample_t *sample);
+/* remove the n oldest samples, after they were uploaded */
+void rtc_store_consume(rtc_store_t *store, uint16_t n);
+
+/* does the buffer warrant bringing up WiFi now */
+int rtc_store_flush_due(const rtc_store_t *store, const rtc_store_policy_t *policy, uint32_t now_ms);
+/* will it one period from now, with one more sample in (decides whether the
+ * next wake needs the RF calibrated) */
+int rtc_store_flush_due_next(const rtc_store_t *store, const rtc_store_policy_t *policy, uint32_t now_ms);
+/* record the outcome of a flush attempt, a failure backs off exponentially */
+void rtc_store_flush_done(rtc_store_t *store, int ok, uint32_t now_ms);
+
+#endif /* _RTC_STORE_H */
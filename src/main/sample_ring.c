@@ -0,0 +1,163 @@
+/* associated header file */
+#include "sample_ring.h"
+
+/* others necessary headers */
+#include <string.h>
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+/* Aligned 32-bit loads and stores are atomic on both the L106 and the host,
+ * the builtins just pin down the ordering between the index and the slot. */
+static inline uint32_t ring_load(const uint32_t *p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void ring_store(uint32_t *p, uint32_t v)
+{
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+/* The L106 has no compare-and-swap instruction, so on the device the CAS is
+ * a few instructions with interrupts masked; that is still non-blocking with
+ * respect to the other task. */
+static inline int ring_cas(uint32_t *p, uint32_t expected, uint32_t desired)
+{
+#ifdef ESP_PLATFORM
+    int swapped = 0;
+
+    portENTER_CRITICAL();
+    if (*p == expected)
+    {
+        *p = desired;
+        swapped = 1;
+    }
+    portEXIT_CRITICAL();
+    return swapped;
+#else
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void sample_ring_init(sample_ring_t *ring, sample_ring_policy_t policy)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->policy = policy;
+}
+
+esp_err_t sample_ring_push(sample_ring_t *ring, const aht10_sample_t *sample)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = ring_load(&ring->tail);
+    uint32_t used = head - tail;
+
+    ring->pushed++;
+
+    if (ring->policy == SAMPLE_RING_DOWNSAMPLE && used >= SAMPLE_RING_DOWNSAMPLE_WATERMARK)
+    {
+        /* falling behind: thin the stream out instead of losing the tail end */
+        if (++ring->downsample_count < SAMPLE_RING_DOWNSAMPLE_FACTOR)
+        {
+            ring->dropped++;
+            return ESP_FAIL;
+        }
+        ring->downsample_count = 0;
+    }
+    else
+    {
+        ring->downsample_count = 0;
+    }
+
+    if (used >= SAMPLE_RING_CAPACITY)
+    {
+        if (ring->policy != SAMPLE_RING_DROP_OLDEST)
+        {
+            ring->dropped++;
+            return ESP_FAIL;
+        }
+
+        /* Claim the oldest slot before touching it. If the consumer got there
+         * first the CAS fails, which is fine: it freed the slot for us. A
+         * consumer that was halfway through copying the slot will see its own
+         * CAS fail and throw the copy away. */
+        if (ring_cas(&ring->tail, tail, tail + 1))
+        {
+            ring->dropped++;
+        }
+        used = head - ring_load(&ring->tail);
+    }
+
+    ring->slots[head & SAMPLE_RING_MASK] = *sample;
+    ring_store(&ring->head, head + 1);
+
+    if (used + 1 > ring->high_water)
+    {
+        ring->high_water = used + 1;
+    }
+    return ESP_OK;
+}
+
+esp_err_t sample_ring_pop(sample_ring_t *ring, aht10_sample_t *sample)
+{
+    uint32_t tail, head;
+
+    while (1)
+    {
+        tail = ring_load(&ring->tail);
+        head = ring_load(&ring->head);
+        if (tail == head)
+        {
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        *sample = ring->slots[tail & SAMPLE_RING_MASK];
+
+        /* only keep the copy if the producer didn't reclaim the slot meanwhile */
+        if (ring_cas(&ring->tail, tail, tail + 1))
+        {
+            ring->popped++;
+            return ESP_OK;
+        }
+    }
+}
+
+uint32_t sample_ring_occupancy(const sample_ring_t *ring)
+{
+    uint32_t tail = ring_load(&ring->tail);
+    uint32_t head = ring_load(&ring->head);
+    return head - tail;
+}
+
+void aht10_sample_pack(aht10_sample_t *sample, uint32_t timestamp_ms, const aht10_reading_t *reading)
+{
+    uint32_t hum = reading->humidity_raw & AHT10_CODE_MAX;
+    uint32_t temp = reading->temperature_raw & AHT10_CODE_MAX;
+
+    sample->timestamp_ms = timestamp_ms;
+    sample->status = reading->status;
+    sample->sensor = 0;
+    sample->data[0] = (uint8_t)(hum >> 12);
+    sample->data[1] = (uint8_t)(hum >> 4);
+    sample->data[2] = (uint8_t)(((hum & 0x0F) << 4) | (temp >> 16));
+    sample->data[3] = (uint8_t)(temp >> 8);
+    sample->data[4] = (uint8_t)temp;
+}
+
+uint32_t aht10_sample_humidity_raw(const aht10_sample_t *sample)
+{
+    return ((uint32_t)sample->data[0] << 12) | ((uint32_t)sample->data[1] << 4) | ((uint32_t)sample->data[2] >> 4);
+}
+
+uint32_t aht10_sample_temperature_raw(const aht10_sample_t *sample)
+{
+    return (((uint32_t)sample->data[2] & 0x0F) << 16) | ((uint32_t)sample->data[3] << 8) | (uint32_t)sample->data[4];
+}
@@ -0,0 +1,77 @@
+#ifndef _SAMPLE_RING_H
+#define _SAMPLE_RING_H
+
+#include <stdint.h>
+#include "aht10_config.h"
+#include "aht10_i2c.h"
+
+/* Fixed-capacity single-producer/single-consumer ring of samples.
+ *
+ * The sensor task is the only producer and the uploader the only consumer.
+ * Neither side ever blocks or takes a lock: the producer only writes head,
+ * the consumer only advances tail, and a full ring is handled by the
+ * overflow policy instead of by waiting, so a slow or disconnected network
+ * can never hold up the sample cadence.
+ *
+ * Indices are free running 32-bit counters, the slot is index & mask, so
+ * SAMPLE_RING_CAPACITY has to be a power of two. */
+
+#ifndef SAMPLE_RING_CAPACITY
+#define SAMPLE_RING_CAPACITY                64                  /* 5 minutes of samples at the 5 s cadence */
+#endif
+#define SAMPLE_RING_MASK                    (SAMPLE_RING_CAPACITY - 1)
+#define SAMPLE_RING_DOWNSAMPLE_FACTOR       4                   /* keep 1 in N once past the watermark */
+#define SAMPLE_RING_DOWNSAMPLE_WATERMARK    (SAMPLE_RING_CAPACITY * 3 / 4)
+
+#if (SAMPLE_RING_CAPACITY & SAMPLE_RING_MASK) != 0
+#error "SAMPLE_RING_CAPACITY must be a power of two"
+#endif
+
+/* A timestamped sample, packed the way the sensor sent it: the 5 result
+ * bytes hold the 20-bit humidity code followed by the 20-bit temperature code */
+typedef struct aht10_sample {
+    uint32_t timestamp_ms;
+    uint8_t status;
+    uint8_t data[5];
+    uint8_t sensor;                     /* which probe on this device (aht10_sensor_t id), 0 for a single one */
+} aht10_sample_t;
+
+/* What the producer does when the consumer has fallen behind */
+typedef enum {
+    SAMPLE_RING_DROP_OLDEST = 0,        /* overwrite the oldest sample, always keep the latest data */
+    SAMPLE_RING_DOWNSAMPLE,             /* past the watermark keep only every Nth sample, drop the newest when full */
+} sample_ring_policy_t;
+
+typedef struct sample_ring {
+    aht10_sample_t slots[SAMPLE_RING_CAPACITY];
+    uint32_t head;                      /* next slot to write, producer owned */
+    uint32_t tail;                      /* next slot to read, consumer owned (producer may bump it on drop-oldest) */
+    sample_ring_policy_t policy;
+
+    /* producer side counters */
+    uint32_t pushed;                    /* samples offered by the producer */
+    uint32_t dropped;                   /* samples lost to the overflow policy */
+    uint32_t high_water;                /* highest occupancy seen */
+    uint32_t downsample_count;
+
+    /* consumer side counters */
+    uint32_t popped;
+} sample_ring_t;
+
+void sample_ring_init(sample_ring_t *ring, sample_ring_policy_t policy);
+
+/* producer: never blocks, returns ESP_FAIL if the sample itself was dropped */
+esp_err_t sample_ring_push(sample_ring_t *ring, const aht10_sample_t *sample);
+
+/* consumer: ESP_ERR_NOT_FOUND when empty */
+esp_err_t sample_ring_pop(sample_ring_t *ring, aht10_sample_t *sample);
+
+/* either side, a snapshot that may be stale by the time it is used */
+uint32_t sample_ring_occupancy(const sample_ring_t *ring);
+
+/* packing helpers, pack leaves sensor at 0 */
+void aht10_sample_pack(aht10_sample_t *sample, uint32_t timestamp_ms, const aht10_reading_t *reading);
+uint32_t aht10_sample_humidity_raw(const aht10_sample_t *sample);
+uint32_t aht10_sample_temperature_raw(const aht10_sample_t *sample);
+
+#endif /* _SAMPLE_RING_H */
@@ -0,0 +1,129 @@
+/* associated header file */
+#include "sha256.h"
+
+/* others necessary headers */
+#include <string.h>
+
+static const uint32_t s_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static uint32_t ror(uint32_t v, int n)
+{
+    return (v >> n) | (v << (32 - n));
+}
+
+static void compress(uint32_t *state, const uint8_t *block)
+{
+    uint32_t w[64], s[8], t1, t2;
+    int i;
+
+    for (i = 0; i < 16; i++)
+    {
+        w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16)
+               | ((uint32_t)block[4 * i + 2] << 8) | block[4 * i + 3];
+    }
+    for (i = 16; i < 64; i++)
+    {
+        w[i] = w[i - 16] + (ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3))
+               + w[i - 7] + (ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10));
+    }
+    memcpy(s, state, sizeof(s));
+    for (i = 0; i < 64; i++)
+    {
+        t1 = s[7] + (ror(s[4], 6) ^ ror(s[4], 11) ^ ror(s[4], 25)) + ((s[4] & s[5]) ^ (~s[4] & s[6])) + s_k[i] + w[i];
+        t2 = (ror(s[0], 2) ^ ror(s[0], 13) ^ ror(s[0], 22)) + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+        memmove(&s[1], &s[0], 7 * sizeof(s[0]));
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+    for (i = 0; i < 8; i++)
+    {
+        state[i] += s[i];
+    }
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void sha256_init(sha256_t *ctx)
+{
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    memcpy(ctx->state, iv, sizeof(iv));
+    ctx->len = 0;
+}
+
+void sha256_update(sha256_t *ctx, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    size_t fill = ctx->len % SHA256_BLOCK_LEN;
+    size_t n;
+
+    ctx->len += len;
+    while (len > 0)
+    {
+        if (fill == 0 && len >= SHA256_BLOCK_LEN)
+        {
+            compress(ctx->state, p);
+            p += SHA256_BLOCK_LEN;
+            len -= SHA256_BLOCK_LEN;
+            continue;
+        }
+        n = SHA256_BLOCK_LEN - fill;
+        if (n > len)
+        {
+            n = len;
+        }
+        memcpy(&ctx->block[fill], p, n);
+        fill += n;
+        p += n;
+        len -= n;
+        if (fill == SHA256_BLOCK_LEN)
+        {
+            compress(ctx->state, ctx->block);
+            fill = 0;
+        }
+    }
+}
+
+void sha256_final(sha256_t *ctx, uint8_t *digest)
+{
+    uint64_t bits = ctx->len * 8;
+    size_t fill = ctx->len % SHA256_BLOCK_LEN;
+    int i;
+
+    ctx->block[fill++] = 0x80;
+    if (fill > SHA256_BLOCK_LEN - 8)
+    {
+        memset(&ctx->block[fill], 0, SHA256_BLOCK_LEN - fill);
+        compress(ctx->state, ctx->block);
+        fill = 0;
+    }
+    memset(&ctx->block[fill], 0, SHA256_BLOCK_LEN - 8 - fill);
+    for (i = 0; i < 8; i++)
+    {
+        ctx->block[SHA256_BLOCK_LEN - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    compress(ctx->state, ctx->block);
+    for (i = 0; i < 8; i++)
+    {
+        digest[4 * i] = (uint8_t)(ctx->state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)ctx->state[i];
+    }
+}
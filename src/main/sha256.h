@@ -0,0 +1,24 @@
+#ifndef _SHA256_H
+#define _SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Plain SHA-256 (FIPS 180-4), portable so the OTA patch code hashes the
+ * same way on the device and on the host. Not constant time, it only ever
+ * sees firmware images. */
+
+#define SHA256_LEN                          32
+#define SHA256_BLOCK_LEN                    64
+
+typedef struct sha256 {
+    uint32_t state[8];
+    uint64_t len;                       /* bytes hashed so far */
+    uint8_t block[SHA256_BLOCK_LEN];
+} sha256_t;
+
+void sha256_init(sha256_t *ctx);
+void sha256_update(sha256_t *ctx, const void *data, size_t len);
+void sha256_final(sha256_t *ctx, uint8_t *digest);
+
+#endif /* _SHA256_H */
@@ -0,0 +1,126 @@
+/* associated header file */
+#include "status.h"
+
+/* others necessary headers */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "aht10_log.h"
+#include "aht10_stats.h"
+#include "aht10_task.h"
+#include "uploader.h"
+#include "wifi_logging.h"
+
+typedef struct status_task {
+    const char *name;
+    TaskHandle_t handle;
+} status_task_t;
+
+static status_task_t s_tasks[STATUS_MAX_TASKS];
+static uint8_t s_task_count;
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static void render_system(char *buf, size_t len, size_t *pos)
+{
+    aht10_heap_stats_t heap;
+    uint8_t mac[6];
+    uint8_t i;
+
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    aht10_task_heap_stats(&heap);
+    aht10_stats_appendf(buf, len, pos, "\"v\":%d,\"dev\":\"%02x%02x%02x%02x%02x%02x\",\"up_s\":%u",
+                        STATUS_VERSION, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5],
+                        (unsigned)(esp_timer_get_time() / 1000000));
+    aht10_stats_appendf(buf, len, pos, ",\"heap\":{\"free\":%u,\"min\":%u,\"hal_allocs\":%u}",
+                        heap.free_now, heap.free_min, heap.hal_dynamic_allocs);
+
+    aht10_stats_appendf(buf, len, pos, ",\"stack\":{");
+    for (i = 0; i < s_task_count; i++)
+    {
+        aht10_stats_appendf(buf, len, pos, "%s\"%s\":%u", i ? "," : "", s_tasks[i].name,
+                            (unsigned)(uxTaskGetStackHighWaterMark(s_tasks[i].handle) * sizeof(StackType_t)));
+    }
+    aht10_stats_appendf(buf, len, pos, "}");
+}
+
+static void render_sensors(char *buf, size_t len, size_t *pos)
+{
+    const aht10_sched_t *sched = aht10_task_sched();
+    const aht10_sensor_t *sensor;
+    const sample_ring_t *ring = aht10_task_ring();
+    const aht10_agg_t *agg = aht10_task_agg();
+    uint8_t i;
+
+    aht10_stats_appendf(buf, len, pos, ",\"sensors\":[");
+    for (i = 0; i < sched->count; i++)
+    {
+        sensor = &sched->sensors[i];
+        aht10_stats_appendf(buf, len, pos,
+                            "%s{\"id\":%u,\"state\":\"%s\",\"n\":%u,\"missed\":%u,\"trig_err\":%u,"
+                            "\"rejected\":%u,\"recov\":%u,\"lat_us\":%u,\"lat_max_us\":%u}",
+                            i ? "," : "", sensor->id, aht10_health_name(sensor->health.state),
+                            sensor->health.samples, sensor->health.missed, sensor->health.trigger_errors,
+                            sensor->health.rejected, sensor->health.recoveries, sensor->health.latency_us, sensor->health.latency_max_us);
+    }
+    aht10_stats_appendf(buf, len, pos, "],\"cycle\":{\"mode\":%u,\"n\":%u,\"last_us\":%u,\"max_us\":%u,\"retries\":%u}",
+                        sched->mode, sched->cycles, sched->cycle_us, sched->cycle_max_us, aht10_i2c_retries());
+    aht10_stats_appendf(buf, len, pos, ",\"agg\":{\"fed\":%u,\"reports\":%u,\"heartbeats\":%u}",
+                        agg->fed, agg->reports, agg->heartbeats);
+    aht10_stats_appendf(buf, len, pos, ",\"ring\":{\"queued\":%u,\"high\":%u,\"dropped\":%u}",
+                        sample_ring_occupancy(ring), ring->high_water, ring->dropped);
+}
+
+static void render_network(char *buf, size_t len, size_t *pos)
+{
+    uploader_stats_t upload;
+    wifi_link_stats_t wifi;
+    aht10_log_stats_t log;
+
+    uploader_get_stats(&upload);
+    wifi_get_link_stats(&wifi);
+    aht10_log_get_stats(&log);
+    aht10_stats_appendf(buf, len, pos,
+                        ",\"upload\":{\"frames\":%u,\"errors\":%u,\"acks\":%u,\"ack_missed\":%u,\"rtt_us\":%u,\"rejected\":%u}",
+                        upload.frames_sent, upload.send_errors, upload.acks, upload.acks_missed, upload.last_rtt_us,
+                        upload.samples_rejected);
+    aht10_stats_appendf(buf, len, pos, ",\"time\":{\"syncs\":%u,\"failures\":%u,\"error_ms\":%d,\"skew_ppm\":%d}",
+                        upload.time_syncs, upload.time_sync_failures, upload.time_error_ms, upload.time_skew_ppm);
+    aht10_stats_appendf(buf, len, pos, ",\"wifi\":{\"connects\":%u,\"fast\":%u,\"failures\":%u,\"rssi\":%d}",
+                        wifi.connects, wifi.fast_connects, wifi.failures, wifi.rssi);
+    aht10_stats_appendf(buf, len, pos, ",\"log\":{\"written\":%u,\"dropped\":%u}", log.written, log.dropped);
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void status_register_task(const char *name)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    portENTER_CRITICAL();
+    if (s_task_count < STATUS_MAX_TASKS)
+    {
+        s_tasks[s_task_count].name = name;
+        s_tasks[s_task_count].handle = self;
+        s_task_count++;
+    }
+    portEXIT_CRITICAL();
+}
+
+size_t status_render(char *buf, size_t len)
+{
+    size_t pos = 0;
+
+    aht10_stats_appendf(buf, len, &pos, "{");
+    render_system(buf, len, &pos);
+    render_sensors(buf, len, &pos);
+    render_network(buf, len, &pos);
+    aht10_stats_appendf(buf, len, &pos, ",\"hist\":{");
+    aht10_stats_json_hists(buf, len, &pos);
+    aht10_stats_appendf(buf, len, &pos, "}}");
+    return pos;
+}
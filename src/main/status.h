@@ -0,0 +1,35 @@
+#ifndef _STATUS_H
+#define _STATUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Status packet: everything needed to see where a device's time and memory
+ * go without a serial cable. The uploader sends it to the collector every
+ * UPLOAD_STATUS_PERIOD_MS as one UDP datagram of compact JSON (so
+ * `nc -ul 47010` is enough to read it too):
+ *
+ *     {"v":1,"dev":"..","up_s":..,
+ *      "heap":{"free":..,"min":..,"hal_allocs":..},
+ *      "stack":{"<task>":<bytes never used>,..},
+ *      "sensors":[{"id":..,"state":"ok","n":..,"missed":..,"trig_err":..,"rejected":..,"lat_us":..,"lat_max_us":..},..],
+ *      "cycle":{"n":..,"last_us":..,"max_us":..},
+ *      "agg":{"fed":..,"reports":..,"heartbeats":..},
+ *      "ring":{"queued":..,"high":..,"dropped":..},
+ *      "upload":{"frames":..,"errors":..,"acks":..,"ack_missed":..,"rtt_us":..},
+ *      "wifi":{"connects":..,"fast":..,"failures":..,"rssi":..},
+ *      "log":{"written":..,"dropped":..},
+ *      "hist":{<aht10_stats.h histograms>}}
+ *
+ * Tasks register themselves so their stack high-water marks are included. */
+
+#define STATUS_PACKET_MAX                   1400                /* one datagram, under the MTU */
+#define STATUS_MAX_TASKS                    6
+#define STATUS_VERSION                      1
+
+/* call from the task itself, once */
+void status_register_task(const char *name);
+/* renders the packet into buf, returns its length */
+size_t status_render(char *buf, size_t len);
+
+#endif /* _STATUS_H */
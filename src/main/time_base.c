@@ -0,0 +1,192 @@
+/* associated header file */
+#include "time_base.h"
+
+/* others necessary headers */
+#include <string.h>
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static void put_be64(uint8_t *p, uint64_t v)
+{
+    int i;
+
+    for (i = 7; i >= 0; i--)
+    {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+static uint64_t get_be64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/* 32.32 fixed point seconds since 1900 to Unix ms. Seconds below 2^31 are
+ * taken as the era after the 2036 wrap, as RFC 4330 suggests. */
+static int64_t ntp_to_unix_ms(uint64_t ntp)
+{
+    uint64_t seconds = ntp >> 32;
+
+    if (seconds < 0x80000000ULL)
+    {
+        seconds += 0x100000000ULL;
+    }
+    return (int64_t)(seconds - TIME_BASE_NTP_UNIX_OFFSET_S) * 1000
+           + (int64_t)(((ntp & 0xFFFFFFFFULL) * 1000) >> 32);
+}
+
+static int32_t clamp_i32(int64_t v, int32_t limit)
+{
+    return (v > limit) ? limit : (v < -limit) ? -limit : (int32_t)v;
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void time_base_init(time_base_t *tb)
+{
+    memset(tb, 0, sizeof(*tb));
+}
+
+int time_base_valid(const time_base_t *tb)
+{
+    return tb->syncs > 0;
+}
+
+int32_t time_base_sync(time_base_t *tb, uint32_t local_ms, int64_t utc_ms)
+{
+    uint32_t elapsed = local_ms - tb->local_ref_ms;
+    int64_t measured;
+    int32_t error = 0;
+
+    if (time_base_valid(tb))
+    {
+        error = clamp_i32(utc_ms - time_base_to_utc(tb, local_ms), INT32_MAX);
+        tb->interval_ms = elapsed;
+        tb->interval_ppm = tb->skew_ppm;
+        if (elapsed >= TIME_BASE_SKEW_MIN_INTERVAL_MS)
+        {
+            /* what this interval says on its own, independent of the old estimate */
+            measured = ((utc_ms - tb->utc_ref_ms) - (int64_t)elapsed) * 1000000 / (int64_t)elapsed;
+            measured = clamp_i32(measured, TIME_BASE_MAX_SKEW_PPM);
+            tb->interval_ppm = (int32_t)measured;
+            if (tb->skew_estimates == 0)
+            {
+                tb->skew_ppm = (int32_t)measured;
+            }
+            else
+            {
+                tb->skew_ppm += (int32_t)((measured - tb->skew_ppm) / TIME_BASE_SKEW_WEIGHT);
+            }
+            if (tb->skew_estimates < UINT16_MAX)
+            {
+                tb->skew_estimates++;
+            }
+        }
+    }
+    tb->utc_ref_ms = utc_ms;
+    tb->local_ref_ms = local_ms;
+    tb->last_error_ms = error;
+    if (tb->syncs < UINT16_MAX)
+    {
+        tb->syncs++;
+    }
+    return error;
+}
+
+int64_t time_base_to_utc(const time_base_t *tb, uint32_t local_ms)
+{
+    /* signed: samples from before the last sync map back from it */
+    int64_t elapsed = (int32_t)(local_ms - tb->local_ref_ms);
+    int32_t ppm = tb->skew_ppm;
+
+    if (!time_base_valid(tb))
+    {
+        return 0;
+    }
+    if (elapsed < 0 && -elapsed <= (int64_t)tb->interval_ms)
+    {
+        ppm = tb->interval_ppm;
+    }
+    return tb->utc_ref_ms + elapsed + elapsed * ppm / 1000000;
+}
+
+esp_err_t time_base_frame_add(const time_base_t *tb, upload_frame_t *frame, const aht10_sample_t *sample)
+{
+    aht10_sample_t stamped;
+    int64_t utc_ms;
+
+    if (frame->count == 0 && time_base_valid(tb))
+    {
+        upload_frame_set_epoch(frame, (uint32_t)(time_base_to_utc(tb, sample->timestamp_ms) / 1000));
+    }
+    if (!(frame->flags & UPLOAD_FRAME_FLAG_UTC))
+    {
+        /* started on the device clock, stays on it */
+        return upload_frame_add(frame, sample);
+    }
+    stamped = *sample;
+    utc_ms = time_base_to_utc(tb, sample->timestamp_ms) - (int64_t)frame->epoch_s * 1000;
+    if (utc_ms < 0 || utc_ms > UINT32_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    stamped.timestamp_ms = (uint32_t)utc_ms;
+    return upload_frame_add(frame, &stamped);
+}
+
+void time_base_sntp_request(uint8_t *buf, uint64_t nonce)
+{
+    memset(buf, 0, TIME_BASE_SNTP_PACKET_LEN);
+    buf[0] = (0 << 6) | (4 << 3) | 3;   /* no leap warning, version 4, client */
+    put_be64(&buf[40], nonce);
+}
+
+esp_err_t time_base_sntp_parse(const uint8_t *buf, size_t len, uint64_t nonce, uint32_t sent_local_ms,
+                               uint32_t recv_local_ms, int64_t *utc_ms, uint32_t *rtt_ms)
+{
+    uint8_t leap, version, mode, stratum;
+    int64_t server_rx_ms, server_tx_ms, one_way_ms;
+    uint32_t rtt;
+
+    if (len < TIME_BASE_SNTP_PACKET_LEN)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    leap = buf[0] >> 6;
+    version = (buf[0] >> 3) & 0x07;
+    mode = buf[0] & 0x07;
+    stratum = buf[1];
+    /* leap 3 is an unsynchronized server, stratum 0 a kiss-o'-death */
+    if (leap == 3 || version < 3 || version > 4 || mode != 4 || stratum == 0 || stratum > 15)
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (get_be64(&buf[24]) != nonce || get_be64(&buf[40]) == 0)
+    {
+        /* a late answer to an earlier request, or a spoof */
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    server_rx_ms = ntp_to_unix_ms(get_be64(&buf[32]));
+    server_tx_ms = ntp_to_unix_ms(get_be64(&buf[40]));
+    rtt = recv_local_ms - sent_local_ms;
+    one_way_ms = ((int64_t)rtt - (server_tx_ms - server_rx_ms)) / 2;
+    if (one_way_ms < 0)
+    {
+        one_way_ms = 0;
+    }
+    *utc_ms = server_tx_ms + one_way_ms;
+    *rtt_ms = rtt;
+    return ESP_OK;
+}
@@ -0,0 +1,80 @@
+#ifndef _TIME_BASE_H
+#define _TIME_BASE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "upload_frame.h"
+
+/* Wall-clock time for sample timestamps.
+ *
+ * Samples are stamped on the device clock: milliseconds since boot, or the
+ * deep sleep mode's RTC store clock, which only adds up the planned sleep
+ * times and so runs off by whatever the RTC oscillator is off by (percents,
+ * not ppm). The time base ties that clock to UTC: at every sync (SNTP, once
+ * per WiFi session, time_sync.c) it records the pair (device ms, UTC ms),
+ * and from the second sync on it also measures how fast UTC ran against the
+ * device clock over the interval. Conversions in between extrapolate from
+ * the last pair with that skew, so a device that only sees the network
+ * every few hours still stamps its samples to within the skew's own error.
+ *
+ * Going forward the skew is each interval's own measurement, smoothed over
+ * TIME_BASE_SKEW_WEIGHT syncs; intervals shorter than
+ * TIME_BASE_SKEW_MIN_INTERVAL_MS only move the reference, the sync error
+ * would swamp the skew. Going back, device times within the last interval
+ * are interpolated between its two syncs instead, which is what the deep
+ * sleep mode needs: it converts its buffered samples right after the sync
+ * that ends their interval, so only how much the skew wandered within the
+ * interval shows. Every sync steps the reference to the new pair.
+ *
+ * Frames built with time_base_frame_add() carry the UTC second of their
+ * first sample (UPLOAD_FRAME_FLAG_UTC) and every sample as a small ms offset
+ * from it, corrected for the skew; until the first sync they go out on the
+ * device clock as before and the collector stamps them on arrival.
+ *
+ * The struct is 32 bytes so it fits the deep sleep mode's RTC store. */
+
+#define TIME_BASE_SKEW_MIN_INTERVAL_MS      (10 * 60 * 1000)    /* a 10 ms sync error is 17 ppm over this */
+#define TIME_BASE_SKEW_WEIGHT               4                   /* new estimates count 1/4 once there is one */
+#define TIME_BASE_MAX_SKEW_PPM              100000              /* the RTC slow clock can be this far off, 10 % */
+
+/* SNTP (RFC 4330) */
+#define TIME_BASE_SNTP_PACKET_LEN           48
+#define TIME_BASE_NTP_UNIX_OFFSET_S         2208988800ULL       /* 1900 to 1970 */
+
+typedef struct time_base {
+    int64_t utc_ref_ms;                 /* UTC at local_ref_ms, 0 before the first sync */
+    uint32_t local_ref_ms;              /* device clock at the last sync */
+    int32_t skew_ppm;                   /* UTC runs this much faster than the device clock */
+    uint16_t syncs;
+    uint16_t skew_estimates;            /* syncs that measured the skew */
+    int32_t last_error_ms;              /* UTC minus the prediction at the last sync */
+    uint32_t interval_ms;               /* device time between the last two syncs */
+    int32_t interval_ppm;               /* skew measured over it, for times within it */
+} time_base_t;
+
+void time_base_init(time_base_t *tb);
+int time_base_valid(const time_base_t *tb);
+/* new reference pair; returns the prediction error it corrected */
+int32_t time_base_sync(time_base_t *tb, uint32_t local_ms, int64_t utc_ms);
+/* UTC ms of a device clock reading (before or after the reference, up to
+ * 24 days either way), 0 if never synced */
+int64_t time_base_to_utc(const time_base_t *tb, uint32_t local_ms);
+
+/* upload_frame_add() with the sample moved to UTC when the time base is
+ * valid; the first sample of the frame sets its epoch. sample is left alone.
+ * A resync that stepped the clock back can put a sample before the frame's
+ * epoch or its previous sample: ESP_ERR_INVALID_ARG, so finish UTC frames
+ * before syncing. */
+esp_err_t time_base_frame_add(const time_base_t *tb, upload_frame_t *frame, const aht10_sample_t *sample);
+
+/* client request; nonce goes in the transmit timestamp for the server to echo */
+void time_base_sntp_request(uint8_t *buf, uint64_t nonce);
+/* Server reply to the request carrying nonce, sent and received at the given
+ * device times. *utc_ms is UTC at recv_local_ms, half the round trip (minus
+ * the server's own hold time) after the server's transmit time.
+ * ESP_ERR_INVALID_RESPONSE for anything but a synchronized server answering
+ * this request (including kiss-o'-death), ESP_ERR_INVALID_SIZE if short. */
+esp_err_t time_base_sntp_parse(const uint8_t *buf, size_t len, uint64_t nonce, uint32_t sent_local_ms,
+                               uint32_t recv_local_ms, int64_t *utc_ms, uint32_t *rtt_ms);
+
+#endif /* _TIME_BASE_H */
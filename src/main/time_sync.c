@@ -0,0 +1,97 @@
+/* associated header file */
+#include "time_sync.h"
+
+/* others necessary headers */
+#include <string.h>
+#include "esp_system.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
+#include "aht10_log.h"
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static esp_err_t resolve(struct sockaddr_in *server)
+{
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_DGRAM,
+    };
+    struct addrinfo *res = NULL;
+
+    if (getaddrinfo(TIME_SYNC_SERVER, NULL, &hints, &res) != 0 || res == NULL)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    memcpy(server, res->ai_addr, sizeof(*server));
+    server->sin_port = htons(TIME_SYNC_PORT);
+    freeaddrinfo(res);
+    return ESP_OK;
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+esp_err_t time_sync_run(time_base_t *tb, uint32_t (*now_ms)(void))
+{
+    struct timeval timeout = {
+        .tv_sec = TIME_SYNC_TIMEOUT_MS / 1000,
+        .tv_usec = (TIME_SYNC_TIMEOUT_MS % 1000) * 1000,
+    };
+    uint8_t buf[TIME_BASE_SNTP_PACKET_LEN];
+    struct sockaddr_in server;
+    uint32_t sent_ms, recv_ms, rtt_ms, best_rtt_ms = UINT32_MAX, best_local_ms = 0;
+    int64_t utc_ms, best_utc_ms = 0;
+    uint64_t nonce;
+    esp_err_t err;
+    int sock, len, i;
+
+    if ((err = resolve(&server)) != ESP_OK)
+    {
+        AHT10_LOG(TIME_SYNC_FAIL, err);
+        return err;
+    }
+    if ((sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP)) < 0)
+    {
+        AHT10_LOG(TIME_SYNC_FAIL, ESP_FAIL);
+        return ESP_FAIL;
+    }
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    for (i = 0; i < TIME_SYNC_TRIES; i++)
+    {
+        nonce = ((uint64_t)esp_random() << 32) | esp_random();
+        time_base_sntp_request(buf, nonce);
+        sent_ms = now_ms();
+        if (sendto(sock, buf, sizeof(buf), 0, (const struct sockaddr *)&server, sizeof(server)) != sizeof(buf))
+        {
+            continue;
+        }
+        /* skip stale replies to earlier tries until this one's comes or the wait ends */
+        while ((len = recv(sock, buf, sizeof(buf), 0)) > 0)
+        {
+            recv_ms = now_ms();
+            if (time_base_sntp_parse(buf, (size_t)len, nonce, sent_ms, recv_ms, &utc_ms, &rtt_ms) == ESP_OK)
+            {
+                if (rtt_ms < best_rtt_ms)
+                {
+                    best_rtt_ms = rtt_ms;
+                    best_local_ms = recv_ms;
+                    best_utc_ms = utc_ms;
+                }
+                break;
+            }
+        }
+    }
+    close(sock);
+
+    if (best_rtt_ms == UINT32_MAX)
+    {
+        AHT10_LOG(TIME_SYNC_FAIL, ESP_ERR_TIMEOUT);
+        return ESP_ERR_TIMEOUT;
+    }
+    time_base_sync(tb, best_local_ms, best_utc_ms);
+    AHT10_LOG(TIME_SYNC, best_rtt_ms, tb->last_error_ms, tb->skew_ppm, tb->syncs);
+    return ESP_OK;
+}
@@ -0,0 +1,27 @@
+#ifndef _TIME_SYNC_H
+#define _TIME_SYNC_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "time_base.h"
+
+/* SNTP client for the time base (time_base.h), device only.
+ *
+ * One sync is TIME_SYNC_TRIES requests to TIME_SYNC_SERVER; the reply with
+ * the shortest round trip wins, its error is at most half that round trip.
+ * The uploader runs one per WiFi session (and every TIME_SYNC_RESYNC_MS
+ * while the session lasts), the deep sleep mode one per flush. A failed
+ * sync leaves the time base as it was, it keeps extrapolating. */
+
+#define TIME_SYNC_SERVER                    "pool.ntp.org"
+#define TIME_SYNC_PORT                      123
+#define TIME_SYNC_TRIES                     3
+#define TIME_SYNC_TIMEOUT_MS                1000                /* per request */
+#define TIME_SYNC_RESYNC_MS                 (6 * 60 * 60 * 1000)
+#define TIME_SYNC_RETRY_MS                  (60 * 1000)         /* after a failed sync, uploader only */
+
+/* blocks up to TIME_SYNC_TRIES * TIME_SYNC_TIMEOUT_MS plus the DNS lookup;
+ * now_ms is the clock the samples are stamped with */
+esp_err_t time_sync_run(time_base_t *tb, uint32_t (*now_ms)(void));
+
+#endif /* _TIME_SYNC_H */
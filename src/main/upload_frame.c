@@ -0,0 +1,396 @@
+/* associated header file */
+#include "upload_frame.h"
+
+/* others necessary headers */
+#include <string.h>
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static void put_be16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint16_t get_be16(const uint8_t *p)
+{
+    return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static size_t put_varint(uint8_t *p, uint32_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+/* returns bytes consumed, 0 if the varint runs off the end or is too long */
+static size_t get_varint(const uint8_t *p, size_t avail, uint32_t *v)
+{
+    uint32_t result = 0;
+    size_t n;
+
+    for (n = 0; n < avail && n < 5; n++)
+    {
+        result |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+        if ((p[n] & 0x80) == 0)
+        {
+            *v = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+
+/* CRC-32 (IEEE 802.3, the zlib one) with a 16 entry table to keep flash use down */
+uint32_t upload_frame_crc32(const uint8_t *data, size_t len)
+{
+    static const uint32_t nibble_table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    uint32_t crc = 0xFFFFFFFF;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ nibble_table[crc & 0x0F];
+        crc = (crc >> 4) ^ nibble_table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+void upload_frame_begin(upload_frame_t *frame, const uint8_t *device_id, uint16_t seq)
+{
+    uint8_t *p = frame->buf;
+
+    put_be16(&p[0], UPLOAD_FRAME_MAGIC);
+    p[2] = UPLOAD_FRAME_VERSION;
+    p[3] = 0;
+    memcpy(&p[4], device_id, UPLOAD_FRAME_DEVICE_ID_LEN);
+    put_be16(&p[10], seq);
+    put_be32(&p[12], 0);
+    p[16] = 0;
+
+    frame->len = UPLOAD_FRAME_HEADER_LEN;
+    frame->seq = seq;
+    frame->count = 0;
+    frame->flags = 0;
+    frame->epoch_s = 0;
+    frame->seen = 0;
+}
+
+esp_err_t upload_frame_set_epoch(upload_frame_t *frame, uint32_t epoch_s)
+{
+    if (frame->count > 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    frame->flags |= UPLOAD_FRAME_FLAG_UTC;
+    frame->epoch_s = epoch_s;
+    frame->buf[3] = frame->flags;
+    put_be32(&frame->buf[UPLOAD_FRAME_HEADER_LEN], epoch_s);
+    frame->len = UPLOAD_FRAME_HEADER_LEN + UPLOAD_FRAME_EPOCH_LEN;
+    return ESP_OK;
+}
+
+esp_err_t upload_frame_add(upload_frame_t *frame, const aht10_sample_t *sample)
+{
+    const aht10_sample_t *ref;
+    uint8_t *p;
+    uint32_t flags;
+    int status_changed;
+
+    if (frame->count >= UPLOAD_FRAME_MAX_SAMPLES)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    if (sample->sensor >= UPLOAD_FRAME_MAX_SENSORS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* times only go forward within a frame, a step back would wrap the delta */
+    if (frame->count > 0 && sample->timestamp_ms - frame->prev.timestamp_ms > UPLOAD_FRAME_MAX_DT_MS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    p = &frame->buf[frame->len];
+    ref = &frame->last[sample->sensor];
+    if (frame->count == 0)
+    {
+        /* the first sample goes in verbatim and sets the base time */
+        put_be32(&frame->buf[12], sample->timestamp_ms);
+        *p++ = sample->sensor;
+    }
+    else
+    {
+        status_changed = (frame->seen & (1U << sample->sensor)) && sample->status != ref->status;
+        flags = (sample->timestamp_ms - frame->prev.timestamp_ms) << 2;
+        flags |= (sample->sensor != frame->prev.sensor) ? 2 : 0;
+        flags |= status_changed ? 1 : 0;
+
+        p += put_varint(p, flags);
+        if (flags & 2)
+        {
+            *p++ = sample->sensor;
+        }
+    }
+
+    if (!(frame->seen & (1U << sample->sensor)))
+    {
+        /* nothing to delta against yet for this sensor */
+        *p++ = sample->status;
+        memcpy(p, sample->data, sizeof(sample->data));
+        p += sizeof(sample->data);
+        frame->seen |= (uint8_t)(1U << sample->sensor);
+    }
+    else
+    {
+        if (sample->status != ref->status)
+        {
+            *p++ = sample->status;
+        }
+        p += put_varint(p, zigzag((int32_t)aht10_sample_humidity_raw(sample)
+                                  - (int32_t)aht10_sample_humidity_raw(ref)));
+        p += put_varint(p, zigzag((int32_t)aht10_sample_temperature_raw(sample)
+                                  - (int32_t)aht10_sample_temperature_raw(ref)));
+    }
+    frame->len = (size_t)(p - frame->buf);
+
+    frame->prev = *sample;
+    frame->last[sample->sensor] = *sample;
+    frame->count++;
+    return ESP_OK;
+}
+
+size_t upload_frame_finish(upload_frame_t *frame)
+{
+    frame->buf[16] = frame->count;
+    put_be32(&frame->buf[frame->len], upload_frame_crc32(frame->buf, frame->len));
+    frame->len += UPLOAD_FRAME_CRC_LEN;
+    return frame->len;
+}
+
+const uint8_t *upload_frame_device_id(const uint8_t *buf, size_t len)
+{
+    if (len < UPLOAD_FRAME_HEADER_LEN + UPLOAD_FRAME_CRC_LEN || get_be16(buf) != UPLOAD_FRAME_MAGIC)
+    {
+        return NULL;
+    }
+    return &buf[4];
+}
+
+esp_err_t upload_frame_reader_init(upload_frame_reader_t *reader, const uint8_t *buf, size_t len)
+{
+    upload_frame_header_t *header = &reader->header;
+
+    if (upload_frame_device_id(buf, len) == NULL)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (buf[2] != UPLOAD_FRAME_VERSION && buf[2] != 1)
+    {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    reader->end = buf + len - UPLOAD_FRAME_CRC_LEN;
+    if (upload_frame_crc32(buf, len - UPLOAD_FRAME_CRC_LEN) != get_be32(reader->end))
+    {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    header->version = buf[2];
+    header->flags = buf[3];
+    memcpy(header->device_id, &buf[4], UPLOAD_FRAME_DEVICE_ID_LEN);
+    header->seq = get_be16(&buf[10]);
+    header->base_ms = get_be32(&buf[12]);
+    header->count = buf[16];
+    header->epoch_s = 0;
+
+    reader->p = buf + UPLOAD_FRAME_HEADER_LEN;
+    if (header->flags & UPLOAD_FRAME_FLAG_UTC)
+    {
+        if (reader->end - reader->p < UPLOAD_FRAME_EPOCH_LEN)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        header->epoch_s = get_be32(reader->p);
+        reader->p += UPLOAD_FRAME_EPOCH_LEN;
+    }
+    reader->index = 0;
+    reader->sensor = 0;
+    reader->seen = 0;
+    reader->timestamp_ms = header->base_ms;
+    return ESP_OK;
+}
+
+esp_err_t upload_frame_reader_next(upload_frame_reader_t *reader, aht10_sample_t *sample)
+{
+    const uint8_t *p = reader->p, *end = reader->end;
+    aht10_sample_t *last;
+    aht10_reading_t reading;
+    uint32_t v = 0, hum, temp;
+    uint8_t status;
+    int v1 = (reader->header.version == 1);
+    size_t n;
+
+    if (reader->index >= reader->header.count)
+    {
+        /* everything read, and nothing may be left over */
+        return (p == end) ? ESP_ERR_NOT_FOUND : ESP_ERR_INVALID_SIZE;
+    }
+
+    if (reader->index == 0)
+    {
+        if (!v1)
+        {
+            if (p >= end)
+            {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            reader->sensor = *p++;
+        }
+    }
+    else
+    {
+        if ((n = get_varint(p, (size_t)(end - p), &v)) == 0)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        p += n;
+        reader->timestamp_ms += v1 ? v >> 1 : v >> 2;
+        if (!v1 && (v & 2))
+        {
+            if (p >= end)
+            {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            reader->sensor = *p++;
+        }
+    }
+    if (reader->sensor >= UPLOAD_FRAME_MAX_SENSORS)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    last = &reader->last[reader->sensor];
+
+    if (!(reader->seen & (1U << reader->sensor)))
+    {
+        if (end - p < 6)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        sample->status = p[0];
+        memcpy(sample->data, &p[1], sizeof(sample->data));
+        p += 6;
+        reader->seen |= (uint8_t)(1U << reader->sensor);
+    }
+    else
+    {
+        status = last->status;
+        if (v & 1)
+        {
+            if (p >= end)
+            {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            status = *p++;
+        }
+        if ((n = get_varint(p, (size_t)(end - p), &hum)) == 0)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        p += n;
+        if ((n = get_varint(p, (size_t)(end - p), &temp)) == 0)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        p += n;
+
+        reading.status = status;
+        reading.humidity_raw = (uint32_t)((int32_t)aht10_sample_humidity_raw(last) + unzigzag(hum));
+        reading.temperature_raw = (uint32_t)((int32_t)aht10_sample_temperature_raw(last) + unzigzag(temp));
+        aht10_sample_pack(sample, 0, &reading);
+    }
+    sample->timestamp_ms = reader->timestamp_ms;
+    sample->sensor = reader->sensor;
+    *last = *sample;
+    reader->p = p;
+    reader->index++;
+    return ESP_OK;
+}
+
+esp_err_t upload_frame_decode(const uint8_t *buf, size_t len, upload_frame_header_t *header,
+                              aht10_sample_t *samples, size_t max_samples)
+{
+    upload_frame_reader_t reader;
+    esp_err_t ret;
+    size_t i = 0;
+
+    if ((ret = upload_frame_reader_init(&reader, buf, len)) != ESP_OK)
+    {
+        return ret;
+    }
+    *header = reader.header;
+    if (header->count > max_samples)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    while ((ret = upload_frame_reader_next(&reader, &samples[i])) == ESP_OK)
+    {
+        i++;
+    }
+    return (ret == ESP_ERR_NOT_FOUND) ? ESP_OK : ret;
+}
+
+size_t upload_frame_ack(uint16_t seq, uint8_t *buf)
+{
+    put_be16(&buf[0], UPLOAD_ACK_MAGIC);
+    put_be16(&buf[2], seq);
+    return UPLOAD_ACK_LEN;
+}
+
+esp_err_t upload_frame_parse_ack(const uint8_t *buf, size_t len, uint16_t *seq)
+{
+    if (len != UPLOAD_ACK_LEN || get_be16(buf) != UPLOAD_ACK_MAGIC)
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    *seq = get_be16(&buf[2]);
+    return ESP_OK;
+}
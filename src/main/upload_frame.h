@@ -0,0 +1,134 @@
+#ifndef _UPLOAD_FRAME_H
+#define _UPLOAD_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sample_ring.h"
+
+/* Compact binary batch of samples, one per UDP datagram.
+ *
+ * All multi-byte header fields are big endian.
+ * _____________________________________________________________________________________
+ * | magic "AH" | version | flags | device id (6) | seq (2) | base ms (4) | count (1) |
+ * | [epoch (4), with UPLOAD_FRAME_FLAG_UTC]                                            |
+ * |------------------------------------------------------------------------------------|
+ * | sample 0: sensor (1) + status (1) + the five raw result bytes                      |
+ * | sample 1..N-1: varint (dt_ms << 2 | sensor follows << 1 | status follows)          |
+ * |                [sensor (1)]                                                        |
+ * |                first sample of that sensor in the frame: status + five raw bytes   |
+ * |                otherwise: [status (1)], zigzag varint humidity delta,              |
+ * |                           zigzag varint temperature delta                          |
+ * |------------------------------------------------------------------------------------|
+ * | CRC-32 (4) over everything above                                                   |
+ * -------------------------------------------------------------------------------------
+ *
+ * dt is against the previous sample in the frame, whatever its sensor. The
+ * sensor byte is only there when it differs from the previous sample's, and
+ * the status and code deltas are against the previous sample of the same
+ * sensor, so probes in different rooms interleaved in one frame still delta
+ * well. At a steady cadence a sample after the first typically costs 4-6
+ * bytes instead of the 12 it takes in the ring.
+ *
+ * With UPLOAD_FRAME_FLAG_UTC the device's time base (time_base.h) was synced:
+ * the sample times are ms since the epoch field (UTC seconds, Unix time),
+ * so UTC = epoch * 1000 + base ms + the dts. Without it they are on the
+ * device clock and only the differences mean anything.
+ *
+ * Version 1 frames (single sensor: no sensor byte, flags are dt_ms << 1 |
+ * status follows) still decode, with every sample on sensor 0.
+ *
+ * The collector answers every frame it decoded with a 4 byte ack,
+ * magic "AK" + the frame's seq, so the device can time the round trip.
+ * The device doesn't depend on it: a missing ack is only counted.
+ *
+ * Datagrams starting with '{' on the same port are status packets
+ * (status.h), JSON text. */
+
+#define UPLOAD_FRAME_DEFAULT_PORT           47010               /* UDP port the collector listens on */
+#define UPLOAD_FRAME_MAGIC                  0x4148              /* "AH" */
+#define UPLOAD_FRAME_VERSION                2
+#define UPLOAD_FRAME_DEVICE_ID_LEN          6                   /* station MAC */
+#define UPLOAD_FRAME_HEADER_LEN             17
+#define UPLOAD_FRAME_CRC_LEN                4
+#define UPLOAD_FRAME_EPOCH_LEN              4
+#define UPLOAD_FRAME_FLAG_UTC               0x01                /* epoch field present, times are UTC */
+#define UPLOAD_FRAME_MAX_SAMPLES            64
+#define UPLOAD_FRAME_MAX_SENSORS            8                   /* sensor ids 0..7 */
+#define UPLOAD_FRAME_MAX_DT_MS              0x3FFFFFFFU         /* sample to sample, the time delta shares its varint with 2 flag bits */
+#define UPLOAD_ACK_MAGIC                    0x414B              /* "AK" */
+#define UPLOAD_ACK_LEN                      4
+/* worst case per later sample: 5 byte varint time + sensor + status + 2 x 3 byte varint deltas */
+#define UPLOAD_FRAME_MAX_LEN                (UPLOAD_FRAME_HEADER_LEN + UPLOAD_FRAME_EPOCH_LEN + 7 + (UPLOAD_FRAME_MAX_SAMPLES - 1) * 13 + UPLOAD_FRAME_CRC_LEN)
+
+typedef struct upload_frame_header {
+    uint8_t version;
+    uint8_t flags;
+    uint8_t device_id[UPLOAD_FRAME_DEVICE_ID_LEN];
+    uint16_t seq;
+    uint32_t base_ms;                   /* timestamp of the first sample */
+    uint8_t count;
+    uint32_t epoch_s;                   /* with UPLOAD_FRAME_FLAG_UTC, else 0 */
+} upload_frame_header_t;
+
+/* Incremental encoder so the uploader can pull samples off the ring one at
+ * a time straight into the outgoing buffer */
+typedef struct upload_frame {
+    uint8_t buf[UPLOAD_FRAME_MAX_LEN];
+    size_t len;
+    uint16_t seq;
+    uint8_t count;
+    uint8_t flags;                      /* UPLOAD_FRAME_FLAG_* */
+    uint32_t epoch_s;
+    aht10_sample_t prev;                /* previous sample, the time reference */
+    aht10_sample_t last[UPLOAD_FRAME_MAX_SENSORS]; /* previous sample per sensor, the code reference */
+    uint8_t seen;                       /* bit per sensor already in this frame */
+} upload_frame_t;
+
+void upload_frame_begin(upload_frame_t *frame, const uint8_t *device_id, uint16_t seq);
+/* sample times from here on are ms since epoch_s (UTC); only before the
+ * first sample, ESP_ERR_INVALID_STATE after */
+esp_err_t upload_frame_set_epoch(upload_frame_t *frame, uint32_t epoch_s);
+/* ESP_ERR_NO_MEM once UPLOAD_FRAME_MAX_SAMPLES are in,
+ * ESP_ERR_INVALID_ARG for a sensor id past UPLOAD_FRAME_MAX_SENSORS or a
+ * timestamp before the previous sample's (or more than
+ * UPLOAD_FRAME_MAX_DT_MS after it); the frame is left as it was */
+esp_err_t upload_frame_add(upload_frame_t *frame, const aht10_sample_t *sample);
+/* patches in the count and appends the CRC, returns the final length */
+size_t upload_frame_finish(upload_frame_t *frame);
+
+/* Streaming decoder for the collector side: reads one sample at a time
+ * straight out of the received datagram, nothing is copied and no sample
+ * array is needed. The buffer has to stay put until the last sample. */
+typedef struct upload_frame_reader {
+    upload_frame_header_t header;       /* valid after init */
+    const uint8_t *p;
+    const uint8_t *end;                 /* start of the CRC */
+    uint8_t index;                      /* samples read so far */
+    uint8_t sensor;
+    uint8_t seen;
+    uint32_t timestamp_ms;
+    aht10_sample_t last[UPLOAD_FRAME_MAX_SENSORS];
+} upload_frame_reader_t;
+
+/* where the device id sits in a frame, NULL if it can't be one; no CRC
+ * check, just enough to route the frame before anything else looks at it */
+const uint8_t *upload_frame_device_id(const uint8_t *buf, size_t len);
+/* checks magic, version and CRC and parses the header, same errors as
+ * upload_frame_decode() */
+esp_err_t upload_frame_reader_init(upload_frame_reader_t *reader, const uint8_t *buf, size_t len);
+/* next sample; ESP_ERR_NOT_FOUND after the last one (if the frame ended
+ * exactly there), ESP_ERR_INVALID_SIZE on malformed input */
+esp_err_t upload_frame_reader_next(upload_frame_reader_t *reader, aht10_sample_t *sample);
+
+/* Decoder for the collector side, the whole frame at once. Returns ESP_ERR_INVALID_CRC,
+ * ESP_ERR_INVALID_VERSION or ESP_ERR_INVALID_SIZE on malformed input. */
+esp_err_t upload_frame_decode(const uint8_t *buf, size_t len, upload_frame_header_t *header,
+                              aht10_sample_t *samples, size_t max_samples);
+
+/* collector -> device acknowledgement, buf needs UPLOAD_ACK_LEN bytes */
+size_t upload_frame_ack(uint16_t seq, uint8_t *buf);
+esp_err_t upload_frame_parse_ack(const uint8_t *buf, size_t len, uint16_t *seq);
+
+uint32_t upload_frame_crc32(const uint8_t *data, size_t len);
+
+#endif /* _UPLOAD_FRAME_H */
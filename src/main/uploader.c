@@ -0,0 +1,293 @@
+/* associated header file */
+#include "uploader.h"
+
+/* others necessary headers */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "aht10_log.h"
+#include "aht10_stats.h"
+#include "ota_update.h"
+#include "status.h"
+#include "time_sync.h"
+#include "upload_frame.h"
+#include "wifi_logging.h"
+
+/* the frame being filled (or waiting to be resent), kept off the task stack */
+static upload_frame_t s_frame;
+static uploader_stats_t s_stats;
+static char s_status[STATUS_PACKET_MAX];
+static int s_sock = -1;
+/* device clock (esp_timer ms, what the sensor task stamps with) to UTC */
+static time_base_t s_time;
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static esp_err_t open_socket(void)
+{
+    struct timeval timeout = {
+        .tv_sec = UPLOAD_ACK_TIMEOUT_MS / 1000,
+        .tv_usec = (UPLOAD_ACK_TIMEOUT_MS % 1000) * 1000,
+    };
+
+    if (s_sock >= 0)
+    {
+        return ESP_OK;
+    }
+    if ((s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP)) < 0)
+    {
+        return ESP_FAIL;
+    }
+    /* bounds the ack wait; the socket is only ever read for acks */
+    setsockopt(s_sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return ESP_OK;
+}
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+/* once per WiFi session, every TIME_SYNC_RESYNC_MS within a long one, and
+ * every TIME_SYNC_RETRY_MS while failing */
+static void sync_time(void)
+{
+    static uint32_t synced_session;
+    static TickType_t last_attempt_tick;
+    static uint8_t failing;
+    wifi_link_stats_t wifi;
+    TickType_t since;
+    int due;
+
+    wifi_get_link_stats(&wifi);
+    since = xTaskGetTickCount() - last_attempt_tick;
+    if (failing)
+    {
+        due = since >= TIME_SYNC_RETRY_MS / portTICK_RATE_MS;
+    }
+    else
+    {
+        due = !time_base_valid(&s_time) || wifi.connects != synced_session
+              || since >= TIME_SYNC_RESYNC_MS / portTICK_RATE_MS;
+    }
+    if (!due)
+    {
+        return;
+    }
+    last_attempt_tick = xTaskGetTickCount();
+    synced_session = wifi.connects;
+    if (time_sync_run(&s_time, now_ms) != ESP_OK)
+    {
+        failing = 1;
+        s_stats.time_sync_failures++;
+        return;
+    }
+    failing = 0;
+    s_stats.time_syncs++;
+    s_stats.time_error_ms = s_time.last_error_ms;
+    s_stats.time_skew_ppm = s_time.skew_ppm;
+}
+
+/* every OTA_CHECK_PERIOD_MS, the first time as soon as the image is confirmed */
+static void check_update(const uint8_t *device_id)
+{
+    static TickType_t last_check_tick;
+    static uint8_t checked;
+
+    if (!OTA_UPDATE_ENABLE || OTA_CHECK_PERIOD_MS == 0 || !ota_update_confirmed()
+        || (checked && (xTaskGetTickCount() - last_check_tick) < OTA_CHECK_PERIOD_MS / portTICK_RATE_MS))
+    {
+        return;
+    }
+    checked = 1;
+    last_check_tick = xTaskGetTickCount();
+    /* only returns if there was nothing to do or the update failed */
+    ota_update_check(device_id);
+}
+
+static void drain_acks(void)
+{
+    uint8_t buf[UPLOAD_ACK_LEN];
+
+    while (recv(s_sock, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+    {
+    }
+}
+
+static void wait_ack(uint16_t seq, int64_t sent_us)
+{
+    int64_t deadline_us = sent_us + (int64_t)UPLOAD_ACK_TIMEOUT_MS * 1000;
+    uint8_t buf[UPLOAD_ACK_LEN + 1];
+    uint16_t acked;
+    int len;
+
+    while (esp_timer_get_time() < deadline_us)
+    {
+        len = recv(s_sock, buf, sizeof(buf), 0);
+        if (len < 0)
+        {
+            break;
+        }
+        if (upload_frame_parse_ack(buf, (size_t)len, &acked) == ESP_OK && acked == seq)
+        {
+            s_stats.acks++;
+            /* a frame made it all the way: an updated image has proven itself */
+            if (OTA_UPDATE_ENABLE)
+            {
+                ota_update_confirm();
+            }
+            s_stats.last_rtt_us = (uint32_t)(esp_timer_get_time() - sent_us);
+            aht10_stats_record(AHT10_STAT_UPLOAD_RTT_US, s_stats.last_rtt_us);
+            return;
+        }
+    }
+    s_stats.acks_missed++;
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void uploader_get_stats(uploader_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+esp_err_t uploader_send_raw(const void *data, size_t len)
+{
+    struct sockaddr_in dest;
+    int sent;
+
+    if (open_socket() != ESP_OK)
+    {
+        s_stats.send_errors++;
+        return ESP_FAIL;
+    }
+
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(UPLOAD_COLLECTOR_PORT);
+    dest.sin_addr.s_addr = inet_addr(UPLOAD_COLLECTOR_ADDR);
+
+    sent = sendto(s_sock, data, len, 0, (const struct sockaddr *)&dest, sizeof(dest));
+    if (sent != (int)len)
+    {
+        s_stats.send_errors++;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t uploader_send(const upload_frame_t *frame)
+{
+    int64_t sent_us;
+
+    /* acks of frames that timed out earlier would be taken for this one's */
+    drain_acks();
+    if (uploader_send_raw(frame->buf, frame->len) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+    sent_us = esp_timer_get_time();
+    s_stats.frames_sent++;
+    s_stats.samples_sent += frame->count;
+    s_stats.bytes_sent += frame->len;
+
+    if (UPLOAD_ACK_TIMEOUT_MS > 0)
+    {
+        wait_ack(frame->seq, sent_us);
+    }
+    return ESP_OK;
+}
+
+void uploader_task(void *arg)
+{
+    sample_ring_t *ring = (sample_ring_t *)arg;
+    aht10_sample_t sample;
+    uint8_t device_id[UPLOAD_FRAME_DEVICE_ID_LEN];
+    uint16_t seq = 0;
+    uint8_t finished = 0;               /* s_frame is complete and waiting to go out */
+    TickType_t first_sample_tick = 0;
+    TickType_t last_status_tick = 0;
+    size_t status_len;
+
+    status_register_task("uploader");
+    esp_read_mac(device_id, ESP_MAC_WIFI_STA);
+
+    upload_frame_begin(&s_frame, device_id, seq);
+
+    while (1)
+    {
+        vTaskDelay(UPLOADER_PERIOD_MS / portTICK_RATE_MS);
+
+        /* a resync may step the clock back, so never in the middle of a UTC
+         * frame: the next one starts right after this one is sent */
+        if (wifi_link_is_up() && (finished || s_frame.count == 0 || !(s_frame.flags & UPLOAD_FRAME_FLAG_UTC)))
+        {
+            sync_time();
+        }
+        if (wifi_link_is_up())
+        {
+            check_update(device_id);
+        }
+
+        /* the status packet goes out on its own cadence, frames or not */
+
+        if (UPLOAD_STATUS_PERIOD_MS > 0 && wifi_link_is_up()
+            && (xTaskGetTickCount() - last_status_tick) >= UPLOAD_STATUS_PERIOD_MS / portTICK_RATE_MS)
+        {
+            last_status_tick = xTaskGetTickCount();
+            status_len = status_render(s_status, sizeof(s_status));
+            if (uploader_send_raw(s_status, status_len) == ESP_OK)
+            {
+                s_stats.status_sent++;
+            }
+        }
+
+        /* move what the sensor task produced into the frame, stop at the fill
+         * level so the rest stays in the ring for the next frame */
+        while (!finished && s_frame.count < UPLOAD_FLUSH_FILL && sample_ring_pop(ring, &sample) == ESP_OK)
+        {
+            if (s_frame.count == 0)
+            {
+                first_sample_tick = xTaskGetTickCount();
+            }
+            if (time_base_frame_add(&s_time, &s_frame, &sample) != ESP_OK)
+            {
+                s_stats.samples_rejected++;
+            }
+        }
+
+        if (!finished)
+        {
+            if (s_frame.count == 0)
+            {
+                continue;
+            }
+            if (s_frame.count < UPLOAD_FLUSH_FILL
+                && (xTaskGetTickCount() - first_sample_tick) < UPLOAD_FLUSH_INTERVAL_MS / portTICK_RATE_MS)
+            {
+                continue;
+            }
+            upload_frame_finish(&s_frame);
+            finished = 1;
+        }
+
+        /* one datagram per batch; if the network is down the frame is kept
+         * and retried, new samples pile up in the ring meanwhile */
+        if (!wifi_link_is_up())
+        {
+            continue;
+        }
+        if (uploader_send(&s_frame) == ESP_OK)
+        {
+            AHT10_LOG(UPLOAD_FRAME, seq, s_frame.count, s_frame.len);
+            finished = 0;
+            upload_frame_begin(&s_frame, device_id, ++seq);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef _UPLOADER_H
+#define _UPLOADER_H
+
+#include <stdint.h>
+#include "aht10_config.h"
+#include "sample_ring.h"
+#include "upload_frame.h"
+
+#define UPLOADER_TASK_STACK_DEPTH           2048
+#define UPLOADER_TASK_PRIORITY              5                   /* below the sensor task, network work can always wait */
+#define UPLOADER_PERIOD_MS                  1000                /* how often the ring gets drained */
+
+/* Where batches go and how big they get before they do. A frame is sent as
+ * soon as it holds UPLOAD_FLUSH_FILL samples or its oldest sample is
+ * UPLOAD_FLUSH_INTERVAL_MS old, whichever comes first. */
+#ifndef UPLOAD_COLLECTOR_ADDR
+#define UPLOAD_COLLECTOR_ADDR               "192.168.1.2"
+#endif
+#define UPLOAD_COLLECTOR_PORT               UPLOAD_FRAME_DEFAULT_PORT
+#ifndef UPLOAD_FLUSH_FILL
+#define UPLOAD_FLUSH_FILL                   24                  /* 2 minutes of samples at the 5 s cadence */
+#endif
+#define UPLOAD_FLUSH_INTERVAL_MS            (5 * 60 * 1000)
+#define UPLOAD_ACK_TIMEOUT_MS               250                 /* wait this long for the collector's ack, 0 doesn't wait */
+#define UPLOAD_STATUS_PERIOD_MS             (60 * 1000)         /* status packet (status.h) cadence, 0 disables it */
+
+/* past the watermark the ring starts thinning out samples */
+#if UPLOAD_FLUSH_FILL >= SAMPLE_RING_DOWNSAMPLE_WATERMARK
+#error "UPLOAD_FLUSH_FILL has to stay below SAMPLE_RING_DOWNSAMPLE_WATERMARK"
+#endif
+#if UPLOAD_FLUSH_FILL > UPLOAD_FRAME_MAX_SAMPLES
+#error "UPLOAD_FLUSH_FILL has to fit one frame (UPLOAD_FRAME_MAX_SAMPLES)"
+#endif
+
+typedef struct uploader_stats {
+    uint32_t frames_sent;
+    uint32_t send_errors;
+    uint32_t samples_sent;
+    uint32_t samples_rejected;          /* the frame wouldn't take them, see upload_frame_add() */
+    uint32_t bytes_sent;
+    uint32_t acks;                      /* frames the collector confirmed */
+    uint32_t acks_missed;               /* no ack within UPLOAD_ACK_TIMEOUT_MS */
+    uint32_t last_rtt_us;               /* send to ack, last confirmed frame */
+    uint32_t status_sent;
+    uint32_t time_syncs;                /* SNTP, once per WiFi session (time_sync.h) */
+    uint32_t time_sync_failures;
+    int32_t time_error_ms;              /* correction the last sync applied */
+    int32_t time_skew_ppm;
+} uploader_stats_t;
+
+void uploader_get_stats(uploader_stats_t *stats);
+
+/* send one finished frame to the collector, also used by the deep sleep mode.
+ * Waits up to UPLOAD_ACK_TIMEOUT_MS for the ack to time the round trip, a
+ * missing ack isn't an error. */
+esp_err_t uploader_send(const upload_frame_t *frame);
+/* any other datagram to the collector (status packets) */
+esp_err_t uploader_send_raw(const void *data, size_t len);
+
+/* FreeRTOS task entry point, arg is the (sample_ring_t *) to consume */
+void uploader_task(void *arg);
+
+#endif /* _UPLOADER_H */
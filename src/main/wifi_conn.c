@@ -0,0 +1,180 @@
+/* associated header file */
+#include "wifi_conn.h"
+
+/* others necessary headers */
+#include <string.h>
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static void start_attempt(wifi_conn_t *conn)
+{
+    const wifi_conn_cache_t *cache = NULL;
+
+    conn->fast = conn->cache.valid && !conn->skip_fast;
+    if (conn->fast)
+    {
+        cache = &conn->cache;
+    }
+    conn->attempt_start_ms = conn->ops.now_ms(conn->ops.ctx);
+    conn->assoc_valid = 0;
+
+    /* the address mode has to be settled before association, otherwise the
+     * DHCP client starts as soon as the link comes up */
+    conn->ops.configure_ip(conn->ops.ctx, (conn->fast && conn->use_static_ip && conn->cache.ip_valid) ? cache : NULL);
+    conn->ops.connect(conn->ops.ctx, cache);
+    conn->ops.set_timer(conn->ops.ctx, WIFI_CONN_ATTEMPT_TIMEOUT_MS);
+    conn->state = WIFI_CONN_CONNECTING;
+}
+
+static void fail_attempt(wifi_conn_t *conn)
+{
+    conn->failures++;
+    if (conn->fast)
+    {
+        /* stale cache (AP moved channel, new router, lease gone...): the next
+         * attempt does it the slow way and refreshes the cache */
+        conn->skip_fast = 1;
+        if (conn->state == WIFI_CONN_WAIT_IP)
+        {
+            conn->cache.ip_valid = 0;
+        }
+    }
+    conn->attempt++;
+    conn->last_backoff_ms = wifi_conn_backoff_ms(conn);
+    conn->ops.set_timer(conn->ops.ctx, conn->last_backoff_ms);
+    conn->state = WIFI_CONN_BACKOFF;
+}
+
+static void link_up(wifi_conn_t *conn, const wifi_conn_event_t *event)
+{
+    wifi_conn_cache_t updated = conn->cache;
+
+    conn->ops.set_timer(conn->ops.ctx, 0);
+    conn->connects++;
+    if (conn->fast)
+    {
+        conn->fast_connects++;
+    }
+    conn->last_connect_ms = conn->ops.now_ms(conn->ops.ctx) - conn->attempt_start_ms;
+    conn->attempt = 0;
+    conn->skip_fast = 0;
+    conn->state = WIFI_CONN_CONNECTED;
+
+    updated.version = WIFI_CONN_CACHE_VERSION;
+    if (conn->assoc_valid)
+    {
+        updated.valid = 1;
+        memcpy(updated.bssid, conn->assoc_bssid, sizeof(updated.bssid));
+        updated.channel = conn->assoc_channel;
+    }
+    updated.ip_valid = 1;
+    updated.ip = event->ip;
+    updated.gw = event->gw;
+    updated.netmask = event->netmask;
+    /* only write flash when something actually changed */
+    if (memcmp(&updated, &conn->cache, sizeof(updated)) != 0)
+    {
+        conn->cache = updated;
+        conn->ops.save_cache(conn->ops.ctx, &conn->cache);
+    }
+
+    conn->ops.link_changed(conn->ops.ctx, 1);
+}
+
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
+void wifi_conn_init(wifi_conn_t *conn, const wifi_conn_ops_t *ops, const wifi_conn_cache_t *cache,
+                    uint8_t use_static_ip)
+{
+    memset(conn, 0, sizeof(*conn));
+    conn->ops = *ops;
+    conn->use_static_ip = use_static_ip;
+    if (cache != NULL && cache->version == WIFI_CONN_CACHE_VERSION)
+    {
+        conn->cache = *cache;
+    }
+    conn->cache.version = WIFI_CONN_CACHE_VERSION;
+    conn->state = WIFI_CONN_IDLE;
+}
+
+uint32_t wifi_conn_backoff_ms(wifi_conn_t *conn)
+{
+    uint32_t shift = (conn->attempt > 0) ? conn->attempt - 1 : 0;
+    uint32_t delay = WIFI_CONN_BACKOFF_MAX_MS;
+
+    if (shift < 16 && (WIFI_CONN_BACKOFF_BASE_MS << shift) < WIFI_CONN_BACKOFF_MAX_MS)
+    {
+        delay = WIFI_CONN_BACKOFF_BASE_MS << shift;
+    }
+    /* "equal jitter": half fixed, half random, so a building full of sensors
+     * that lost the same AP don't all come back in lock step */
+    return delay / 2 + conn->ops.random(conn->ops.ctx) % (delay / 2 + 1);
+}
+
+void wifi_conn_handle(wifi_conn_t *conn, const wifi_conn_event_t *event)
+{
+    switch (event->id)
+    {
+        case WIFI_CONN_EVT_START:
+            if (conn->state == WIFI_CONN_IDLE)
+            {
+                start_attempt(conn);
+            }
+            break;
+
+        case WIFI_CONN_EVT_ASSOCIATED:
+            if (conn->state == WIFI_CONN_CONNECTING)
+            {
+                memcpy(conn->assoc_bssid, event->bssid, sizeof(conn->assoc_bssid));
+                conn->assoc_channel = event->channel;
+                conn->assoc_valid = 1;
+                conn->state = WIFI_CONN_WAIT_IP;
+            }
+            break;
+
+        case WIFI_CONN_EVT_GOT_IP:
+            if (conn->state == WIFI_CONN_CONNECTING || conn->state == WIFI_CONN_WAIT_IP)
+            {
+                link_up(conn, event);
+            }
+            break;
+
+        case WIFI_CONN_EVT_DISCONNECTED:
+            if (conn->state == WIFI_CONN_CONNECTED)
+            {
+                /* we had a working link a moment ago, the cached AP is the
+                 * best bet so go again straight away */
+                conn->ops.link_changed(conn->ops.ctx, 0);
+                start_attempt(conn);
+            }
+            else if (conn->state == WIFI_CONN_CONNECTING || conn->state == WIFI_CONN_WAIT_IP)
+            {
+                fail_attempt(conn);
+            }
+            /* anything else is the driver confirming an abort we asked for */
+            break;
+
+        case WIFI_CONN_EVT_TIMER:
+            if (conn->state == WIFI_CONN_CONNECTING || conn->state == WIFI_CONN_WAIT_IP)
+            {
+                conn->ops.disconnect(conn->ops.ctx);
+                fail_attempt(conn);
+            }
+            else if (conn->state == WIFI_CONN_BACKOFF)
+            {
+                start_attempt(conn);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+int wifi_conn_is_up(const wifi_conn_t *conn)
+{
+    return conn->state == WIFI_CONN_CONNECTED;
+}
@@ -0,0 +1,106 @@
+#ifndef _WIFI_CONN_H
+#define _WIFI_CONN_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/* Long-lived WiFi station connection manager.
+ *
+ * This is only the state machine: it is fed events (from the SDK's event
+ * loop on the device, from a fake event source on the host) and asks for
+ * things to happen through wifi_conn_ops_t. It never gives up; after a
+ * failure it waits an exponentially growing, jittered backoff and tries again.
+ *
+ * Fast reconnect: once a connection succeeds the AP's BSSID and channel (and
+ * optionally the DHCP lease) are cached in NVS. The next attempt hands those
+ * to the driver so it can skip the scan (and DHCP). If a fast attempt fails
+ * the following one falls back to a full scan. */
+
+#define WIFI_CONN_BACKOFF_BASE_MS           500
+#define WIFI_CONN_BACKOFF_MAX_MS            (60 * 1000)
+#define WIFI_CONN_ATTEMPT_TIMEOUT_MS        (15 * 1000)         /* association + IP, per attempt */
+#define WIFI_CONN_CACHE_VERSION             1
+
+typedef enum {
+    WIFI_CONN_IDLE = 0,                 /* not started */
+    WIFI_CONN_CONNECTING,               /* association in progress */
+    WIFI_CONN_WAIT_IP,                  /* associated, waiting for DHCP (or the static IP to apply) */
+    WIFI_CONN_CONNECTED,                /* link up */
+    WIFI_CONN_BACKOFF,                  /* waiting before the next attempt */
+} wifi_conn_state_t;
+
+typedef enum {
+    WIFI_CONN_EVT_START = 0,            /* station started */
+    WIFI_CONN_EVT_ASSOCIATED,           /* associated with an AP, bssid/channel valid */
+    WIFI_CONN_EVT_DISCONNECTED,         /* lost or failed to get the association */
+    WIFI_CONN_EVT_GOT_IP,               /* ip/gw/netmask valid */
+    WIFI_CONN_EVT_TIMER,                /* the timer armed through set_timer expired */
+} wifi_conn_event_id_t;
+
+typedef struct wifi_conn_event {
+    wifi_conn_event_id_t id;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;                        /* network byte order, as lwIP keeps them */
+    uint32_t gw;
+    uint32_t netmask;
+    uint8_t reason;                     /* disconnect reason from the driver */
+} wifi_conn_event_t;
+
+/* what gets persisted between sessions (and across deep sleep) */
+typedef struct wifi_conn_cache {
+    uint8_t version;
+    uint8_t valid;                      /* bssid/channel are usable */
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t ip_valid;                   /* ip/gw/netmask are usable as a static configuration */
+    uint32_t ip;
+    uint32_t gw;
+    uint32_t netmask;
+} wifi_conn_cache_t;
+
+typedef struct wifi_conn_ops {
+    void *ctx;
+    /* start an association, cache is NULL for a full scan */
+    void (*connect)(void *ctx, const wifi_conn_cache_t *cache);
+    /* abort the current association attempt */
+    void (*disconnect)(void *ctx);
+    /* apply the cached address and skip DHCP, or (cache NULL) run DHCP */
+    void (*configure_ip)(void *ctx, const wifi_conn_cache_t *cache);
+    /* one-shot timer, 0 cancels */
+    void (*set_timer)(void *ctx, uint32_t ms);
+    void (*save_cache)(void *ctx, const wifi_conn_cache_t *cache);
+    void (*link_changed)(void *ctx, int up);
+    uint32_t (*random)(void *ctx);
+    uint32_t (*now_ms)(void *ctx);
+} wifi_conn_ops_t;
+
+typedef struct wifi_conn {
+    wifi_conn_ops_t ops;
+    wifi_conn_state_t state;
+    wifi_conn_cache_t cache;
+    uint8_t use_static_ip;              /* reuse the last lease instead of running DHCP */
+    uint8_t fast;                       /* current attempt is using the cache */
+    uint8_t skip_fast;                  /* the last fast attempt failed, do a full scan next */
+    uint32_t attempt;                   /* consecutive failed attempts, drives the backoff */
+    uint32_t attempt_start_ms;
+    uint8_t assoc_valid;                /* AP of the current attempt, goes into the cache on link up */
+    uint8_t assoc_bssid[6];
+    uint8_t assoc_channel;
+
+    /* statistics */
+    uint32_t connects;
+    uint32_t fast_connects;
+    uint32_t failures;
+    uint32_t last_connect_ms;           /* attempt start to link up, last successful attempt */
+    uint32_t last_backoff_ms;
+} wifi_conn_t;
+
+/* cache may be NULL (nothing persisted yet) */
+void wifi_conn_init(wifi_conn_t *conn, const wifi_conn_ops_t *ops, const wifi_conn_cache_t *cache,
+                    uint8_t use_static_ip);
+void wifi_conn_handle(wifi_conn_t *conn, const wifi_conn_event_t *event);
+int wifi_conn_is_up(const wifi_conn_t *conn);
+uint32_t wifi_conn_backoff_ms(wifi_conn_t *conn);
+
+#endif /* _WIFI_CONN_H */
@@ -4,43 +4,248 @@
 #include <string.h>
 #include "esp_netif.h"
 #include "esp_event.h"
+#include "esp_system.h"
 #include "esp_wifi.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
+#include "wifi_conn.h"
+#include "aht10_log.h"
+#include "aht10_stats.h"
 
-/* FreeRTOS event group to signal when we are connected*/
+/* FreeRTOS event group to signal when we are connected, lives for the life of the device */
 static EventGroupHandle_t s_wifi_event_group;
-/* track the number of wifi retries */
-static int s_retry_num = 0;
+/* the connection manager only runs in its own task; the event loop task and
+ * the timer task just queue events for it. The lock is for the stats readers */
+static SemaphoreHandle_t s_conn_lock;
+static QueueHandle_t s_conn_queue;
+static TimerHandle_t s_conn_timer;
+static volatile int s_conn_timer_missed;
+static wifi_conn_t s_conn;
+
+/* ====================================
+ * ======= CONNECTION MANAGER OPS =====
+ * ==================================== */
+
+static void conn_connect(void *ctx, const wifi_conn_cache_t *cache)
+{
+    wifi_config_t wifi_config = {
+        .sta = {
+            .ssid = ESP_WIFI_WIFI_SSID,
+            .password = ESP_WIFI_WIFI_PASS
+        },
+    };
+
+    /* Setting a password implies station will connect to all security modes including WEP/WPA.
+        * However these modes are deprecated and not advisable to be used. Incase your Access point
+        * doesn't support WPA2, these mode can be enabled by commenting below line */
+
+    if (strlen((char *)wifi_config.sta.password)) {
+        wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+    }
+
+    /* fast path: go straight for the AP we used last time, no scan */
+    if (cache != NULL) {
+        wifi_config.sta.bssid_set = 1;
+        memcpy(wifi_config.sta.bssid, cache->bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = cache->channel;
+    }
+
+    esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
+    esp_wifi_connect();
+}
+
+static void conn_disconnect(void *ctx)
+{
+    esp_wifi_disconnect();
+}
+
+static void conn_configure_ip(void *ctx, const wifi_conn_cache_t *cache)
+{
+    tcpip_adapter_ip_info_t ip_info;
+
+    if (cache == NULL) {
+        tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+        return;
+    }
+
+    /* reuse the last lease, saves the DHCP round trips */
+    tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+    ip_info.ip.addr = cache->ip;
+    ip_info.gw.addr = cache->gw;
+    ip_info.netmask.addr = cache->netmask;
+    tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &ip_info);
+}
+
+static void conn_set_timer(void *ctx, uint32_t ms)
+{
+    TickType_t ticks = ms / portTICK_RATE_MS;
+    BaseType_t sent;
+
+    /* called from the connection task, which can afford to wait; a lost stop
+     * or start would leave the state machine waiting for the wrong timeout */
+    for (;;) {
+        if (ms == 0) {
+            sent = xTimerStop(s_conn_timer, WIFI_CONN_TIMER_CMD_WAIT_MS / portTICK_RATE_MS);
+        } else {
+            sent = xTimerChangePeriod(s_conn_timer, ticks > 0 ? ticks : 1,
+                                      WIFI_CONN_TIMER_CMD_WAIT_MS / portTICK_RATE_MS);
+        }
+        if (sent == pdPASS) {
+            return;
+        }
+        AHT10_LOG(WIFI_TIMER_RETRY);
+    }
+}
+
+static void conn_save_cache(void *ctx, const wifi_conn_cache_t *cache)
+{
+    nvs_handle handle;
+
+    if (nvs_open(ESP_WIFI_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    nvs_set_blob(handle, "cache", cache, sizeof(*cache));
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+static void conn_link_changed(void *ctx, int up)
+{
+    if (up) {
+        aht10_stats_record(AHT10_STAT_WIFI_MS, s_conn.last_connect_ms);
+        if (s_conn.fast) {
+            AHT10_LOG(WIFI_UP_FAST, s_conn.last_connect_ms);
+        } else {
+            AHT10_LOG(WIFI_UP_SCAN, s_conn.last_connect_ms);
+        }
+        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    } else {
+        AHT10_LOG(WIFI_DOWN);
+        xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    }
+}
+
+static uint32_t conn_random(void *ctx)
+{
+    return esp_random();
+}
+
+static uint32_t conn_now_ms(void *ctx)
+{
+    return xTaskGetTickCount() * portTICK_RATE_MS;
+}
+
+static const wifi_conn_ops_t s_conn_ops = {
+    .ctx = NULL,
+    .connect = conn_connect,
+    .disconnect = conn_disconnect,
+    .configure_ip = conn_configure_ip,
+    .set_timer = conn_set_timer,
+    .save_cache = conn_save_cache,
+    .link_changed = conn_link_changed,
+    .random = conn_random,
+    .now_ms = conn_now_ms,
+};
+
+/* ====================================
+ * ========= STATIC FUNCTIONS =========
+ * ==================================== */
+
+static void conn_dispatch(const wifi_conn_event_t *event)
+{
+    xSemaphoreTake(s_conn_lock, portMAX_DELAY);
+    wifi_conn_handle(&s_conn, event);
+    xSemaphoreGive(s_conn_lock);
+}
+
+static void conn_task(void *arg)
+{
+    wifi_conn_event_t event;
+
+    for (;;) {
+        xQueueReceive(s_conn_queue, &event, portMAX_DELAY);
+        conn_dispatch(&event);
+        if (s_conn_timer_missed) {
+            s_conn_timer_missed = 0;
+            event.id = WIFI_CONN_EVT_TIMER;
+            conn_dispatch(&event);
+        }
+    }
+}
+
+/* runs in the timer task, which must not block or touch NVS */
+static void conn_timer_cb(TimerHandle_t timer)
+{
+    wifi_conn_event_t event;
+
+    memset(&event, 0, sizeof(event));
+    event.id = WIFI_CONN_EVT_TIMER;
+    if (xQueueSend(s_conn_queue, &event, 0) != pdPASS) {
+        /* the queue is full of driver events, so the task is awake anyway
+         * and picks the timeout up after the next one */
+        s_conn_timer_missed = 1;
+    }
+}
 
 static void event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data)
 {
+    wifi_conn_event_t event;
+
+    memset(&event, 0, sizeof(event));
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
+        event.id = WIFI_CONN_EVT_START;
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t* connected = (wifi_event_sta_connected_t*) event_data;
+        event.id = WIFI_CONN_EVT_ASSOCIATED;
+        memcpy(event.bssid, connected->bssid, sizeof(event.bssid));
+        event.channel = connected->channel;
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < ESP_WIFI_MAXIMUM_RETRY) {
-            esp_wifi_connect();
-            s_retry_num++;
-            printf("retry to connect to the AP");
-        } else {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-        }
-        printf("connect to the AP fail");
+        wifi_event_sta_disconnected_t* disconnected = (wifi_event_sta_disconnected_t*) event_data;
+        event.id = WIFI_CONN_EVT_DISCONNECTED;
+        event.reason = disconnected->reason;
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
-        ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        printf("got ip:%s", ip4addr_ntoa(&event->ip_info.ip));
-        s_retry_num = 0;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        ip_event_got_ip_t* got_ip = (ip_event_got_ip_t*) event_data;
+        AHT10_LOG(WIFI_GOT_IP, ip4_addr1(&got_ip->ip_info.ip), ip4_addr2(&got_ip->ip_info.ip),
+                  ip4_addr3(&got_ip->ip_info.ip), ip4_addr4(&got_ip->ip_info.ip));
+        event.id = WIFI_CONN_EVT_GOT_IP;
+        event.ip = got_ip->ip_info.ip.addr;
+        event.gw = got_ip->ip_info.gw.addr;
+        event.netmask = got_ip->ip_info.netmask.addr;
+    } else {
+        return;
     }
+    /* the event loop can wait, the driver's events must not get lost */
+    xQueueSend(s_conn_queue, &event, portMAX_DELAY);
 }
 
 static void wifi_init_station(void)
 {
+    wifi_conn_cache_t cache;
+    size_t cache_len = sizeof(cache);
+    nvs_handle handle;
+    int have_cache = 0;
+
     s_wifi_event_group = xEventGroupCreate();
+    s_conn_lock = xSemaphoreCreateMutex();
+    s_conn_queue = xQueueCreate(WIFI_CONN_QUEUE_LEN, sizeof(wifi_conn_event_t));
+    s_conn_timer = xTimerCreate("wifi_conn", 1, pdFALSE, NULL, conn_timer_cb);
+
+    /* whatever the last session learned about the AP */
+    if (nvs_open(ESP_WIFI_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        have_cache = nvs_get_blob(handle, "cache", &cache, &cache_len) == ESP_OK && cache_len == sizeof(cache);
+        nvs_close(handle);
+    }
+    wifi_conn_init(&s_conn, &s_conn_ops, have_cache ? &cache : NULL, ESP_WIFI_USE_STATIC_IP);
+    xTaskCreate(conn_task, "wifi_conn", WIFI_CONN_TASK_STACK_DEPTH, NULL, WIFI_CONN_TASK_PRIORITY, NULL);
 
     tcpip_adapter_init();
 
@@ -49,57 +254,64 @@ static void wifi_init_station(void)
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     esp_wifi_init(&cfg);
 
+    /* the handlers stay registered for good so later disconnects get handled too */
     esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL);
     esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL);
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = ESP_WIFI_WIFI_SSID,
-            .password = ESP_WIFI_WIFI_PASS
-        },
-    };
-
-    /* Setting a password implies station will connect to all security modes including WEP/WPA.
-        * However these modes are deprecated and not advisable to be used. Incase your Access point
-        * doesn't support WPA2, these mode can be enabled by commenting below line */
-
-    if (strlen((char *)wifi_config.sta.password)) {
-        wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
-    }
-
+    /* the connection manager keeps its own AP cache, and the driver copying
+     * every esp_wifi_set_config into flash would cost a write per attempt */
+    esp_wifi_set_storage(WIFI_STORAGE_RAM);
     esp_wifi_set_mode(WIFI_MODE_STA);
-    esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
     esp_wifi_start();
 
-    printf("wifi_init_sta finished.");
-
-    /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
-     * number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see above) */
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-            pdFALSE,
-            pdFALSE,
-            portMAX_DELAY);
-
-    /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
-     * happened. */
-    if (bits & WIFI_CONNECTED_BIT) {
-        printf("connected to ap SSID:%s password:%s",
-                    ESP_WIFI_WIFI_SSID, ESP_WIFI_WIFI_PASS);
-    } else if (bits & WIFI_FAIL_BIT) {
-        printf("Failed to connect to SSID:%s, password:%s",
-                 ESP_WIFI_WIFI_SSID, ESP_WIFI_WIFI_PASS);
-    } else {
-        printf("UNEXPECTED EVENT");
-    }
-
-    esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler);
-    esp_event_handler_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler);
-    vEventGroupDelete(s_wifi_event_group);
+    /* no waiting here: WIFI_EVENT_STA_START kicks off the connection manager
+     * and everyone else checks wifi_link_is_up() when they need the network */
+    AHT10_LOG_NOW(AHT10_LOG_INFO, "wifi_init_sta finished, connecting to SSID:%s\n", ESP_WIFI_WIFI_SSID);
 }
 
+/* ====================================
+ * ========= GLOBAL FUNCTIONS =========
+ * ==================================== */
 void wifi_init_all()
 {
     nvs_flash_init();
     wifi_init_station();
 }
+
+int wifi_link_is_up(void)
+{
+    return s_wifi_event_group != NULL
+           && (xEventGroupGetBits(s_wifi_event_group) & WIFI_CONNECTED_BIT) != 0;
+}
+
+int wifi_wait_link_up(uint32_t timeout_ms)
+{
+    EventBits_t bits;
+
+    if (s_wifi_event_group == NULL) {
+        return 0;
+    }
+    bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE,
+                               timeout_ms / portTICK_RATE_MS);
+    return (bits & WIFI_CONNECTED_BIT) != 0;
+}
+
+void wifi_get_link_stats(wifi_link_stats_t *stats)
+{
+    wifi_ap_record_t ap;
+
+    memset(stats, 0, sizeof(*stats));
+    if (s_conn_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_conn_lock, portMAX_DELAY);
+    stats->connects = s_conn.connects;
+    stats->fast_connects = s_conn.fast_connects;
+    stats->failures = s_conn.failures;
+    stats->last_connect_ms = s_conn.last_connect_ms;
+    xSemaphoreGive(s_conn_lock);
+
+    if (wifi_link_is_up() && esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        stats->rssi = ap.rssi;
+    }
+}
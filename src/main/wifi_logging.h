@@ -1,20 +1,45 @@
 #ifndef _WIFI_LOGGING_H
 #define _WIFI_LOGGING_H
 
+#include <stdint.h>
+#include "aht10_config.h"
+
 /* This is an untracked file where I store the SSID information */
 #include "ssid_info.untracked.h"
 #define ESP_WIFI_WIFI_SSID      CONFIG_ESP_WIFI_SSID
 #define ESP_WIFI_WIFI_PASS      CONFIG_ESP_WIFI_PASSWORD
-#define ESP_WIFI_MAXIMUM_RETRY  10
+#ifndef ESP_WIFI_USE_STATIC_IP
+#define ESP_WIFI_USE_STATIC_IP  0                               /* 1 reuses the last DHCP lease on fast reconnects */
+#endif
+#define ESP_WIFI_NVS_NAMESPACE  "wifi_conn"                     /* where the AP/lease cache lives in NVS */
+
+/* the task that runs the connection manager, fed by the event loop and the timer */
+#define WIFI_CONN_TASK_STACK_DEPTH          2048
+#define WIFI_CONN_TASK_PRIORITY             6                   /* above the uploader, it waits for the link */
+#define WIFI_CONN_QUEUE_LEN                 8                   /* events, the driver sends a handful per attempt */
+#define WIFI_CONN_TIMER_CMD_WAIT_MS         100                 /* per try at getting a command into the timer task */
 
-/* The event group allows multiple bits for each event, but we only care about two events:
- * - we are connected to the AP with an IP
- * - we failed to connect after the maximum amount of retries
+/* The event group only carries the link state now; the connection manager
+ * (wifi_conn.c) keeps retrying forever, so there is no failure bit.
  * (see event group defined in wifi_logging.c -- static EventGroupHandle_t s_wifi_event_group */
 #define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
+
+/* connection manager counters, for the status packet */
+typedef struct wifi_link_stats {
+    uint32_t connects;
+    uint32_t fast_connects;
+    uint32_t failures;
+    uint32_t last_connect_ms;
+    int8_t rssi;                        /* of the current AP, 0 while the link is down */
+} wifi_link_stats_t;
 
 /* global functions */
 void wifi_init_all();
 
+/* non-blocking link state for the uploader */
+int wifi_link_is_up(void);
+/* block up to timeout_ms for the link, returns non-zero if it is up */
+int wifi_wait_link_up(uint32_t timeout_ms);
+void wifi_get_link_stats(wifi_link_stats_t *stats);
+
 #endif /* _WIFI_LOGGING_H */